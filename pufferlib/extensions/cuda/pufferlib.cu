@@ -4,6 +4,9 @@
 
 namespace pufferlib {
 
+// Threads in the single block that normalizes priorities. Power of 2
+#define PRIO_THREADS 1024
+
 __host__ __device__ void puff_advantage_row_cuda(float* values, float* rewards, float* dones,
         float* importance, float* advantages, float gamma, float lambda,
         float rho_clip, float c_clip, int horizon) {
@@ -81,8 +84,97 @@ void compute_puff_advantage_cuda(torch::Tensor values, torch::Tensor rewards,
     }
 }
 
+// Advantages and the row's sampling weight sum(|adv|)^alpha in one pass
+__global__ void puff_advantage_prio_kernel(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float* prio_weights,
+        float gamma, float lambda, float rho_clip, float c_clip, float alpha,
+        int num_steps, int horizon) {
+    int row = blockIdx.x*blockDim.x + threadIdx.x;
+    if (row >= num_steps) {
+        return;
+    }
+    int offset = row*horizon;
+    puff_advantage_row_cuda(values + offset, rewards + offset, dones + offset,
+        importance + offset, advantages + offset, gamma, lambda, rho_clip, c_clip, horizon);
+
+    float total = 0;
+    for (int t = 0; t < horizon; t++) {
+        total += fabsf(advantages[offset + t]);
+    }
+    float weight = powf(total, alpha);
+    prio_weights[row] = isfinite(weight) ? weight : 0.0f;
+}
+
+// Single block. Deterministic tree sum of the weights, then normalize
+__global__ void prio_normalize_kernel(float* prio_weights, float* prio_probs, int num_steps) {
+    __shared__ float partial[PRIO_THREADS];
+    float total = 0;
+    for (int i = threadIdx.x; i < num_steps; i += blockDim.x) {
+        total += prio_weights[i];
+    }
+    partial[threadIdx.x] = total;
+    __syncthreads();
+    for (int stride = blockDim.x/2; stride > 0; stride /= 2) {
+        if (threadIdx.x < stride) {
+            partial[threadIdx.x] += partial[threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+    float denom = partial[0] + 1e-6f;
+    for (int i = threadIdx.x; i < num_steps; i += blockDim.x) {
+        prio_probs[i] = (prio_weights[i] + 1e-6f)/denom;
+    }
+}
+
+void compute_puff_advantage_prio_cuda(torch::Tensor values, torch::Tensor rewards,
+        torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
+        torch::Tensor prio_weights, torch::Tensor prio_probs, double gamma,
+        double lambda, double rho_clip, double c_clip, double alpha) {
+    int num_steps = values.size(0);
+    int horizon = values.size(1);
+    vtrace_check_cuda(values, rewards, dones, importance, advantages, num_steps, horizon);
+    TORCH_CHECK(values.is_cuda(), "All tensors must be on GPU");
+    for (const torch::Tensor& t : {prio_weights, prio_probs}) {
+        TORCH_CHECK(t.dim() == 1, "Priority tensors must be 1D");
+        TORCH_CHECK(t.device() == values.device(), "All tensors must be on same device");
+        TORCH_CHECK(t.size(0) == num_steps, "Priority tensors must have num_steps elements");
+        TORCH_CHECK(t.dtype() == torch::kFloat32, "All tensors must be float32");
+        TORCH_CHECK(t.is_contiguous(), "Priority tensors must be contiguous");
+    }
+
+    int threads_per_block = 256;
+    int blocks = (num_steps + threads_per_block - 1) / threads_per_block;
+
+    puff_advantage_prio_kernel<<<blocks, threads_per_block>>>(
+        values.data_ptr<float>(),
+        rewards.data_ptr<float>(),
+        dones.data_ptr<float>(),
+        importance.data_ptr<float>(),
+        advantages.data_ptr<float>(),
+        prio_weights.data_ptr<float>(),
+        gamma,
+        lambda,
+        rho_clip,
+        c_clip,
+        alpha,
+        num_steps,
+        horizon
+    );
+    prio_normalize_kernel<<<1, PRIO_THREADS>>>(
+        prio_weights.data_ptr<float>(),
+        prio_probs.data_ptr<float>(),
+        num_steps
+    );
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+        throw std::runtime_error(cudaGetErrorString(err));
+    }
+}
+
 TORCH_LIBRARY_IMPL(pufferlib, CUDA, m) {
   m.impl("compute_puff_advantage", &compute_puff_advantage_cuda);
+  m.impl("compute_puff_advantage_prio", &compute_puff_advantage_prio_cuda);
 }
 
 }
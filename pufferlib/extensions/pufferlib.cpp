@@ -2,7 +2,14 @@
 #include <ATen/Operators.h>
 #include <torch/all.h>
 #include <torch/library.h>
+#include <ATen/Parallel.h>
 #include <vector>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PUFF_X86 1
+#endif
 
 extern "C" {
   /* Creates a dummy empty _C module that can be imported from Python.
@@ -59,11 +66,163 @@ void vtrace_check(torch::Tensor values, torch::Tensor rewards,
 }
 
 
-// [num_steps, horizon]
-void puff_advantage(float* values, float* rewards, float* dones, float* importance,
-        float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
-        int num_steps, const int horizon){
-    for (int offset = 0; offset < num_steps*horizon; offset+=horizon) {
+#ifdef PUFF_X86
+// Rows processed together by the AVX2 kernel
+#define PUFF_LANES 8
+
+// In-place 8x8 transpose. Row i of the tile becomes column i
+__attribute__((target("avx2")))
+static inline void transpose8(__m256 r[8]) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Loads columns [col, col + n) of 8 rows as n vectors across rows
+__attribute__((target("avx2")))
+static inline void load_tile(const float* src, int horizon, int col, int n, __m256 tile[8]) {
+    if (n == PUFF_LANES) {
+        for (int i = 0; i < PUFF_LANES; i++) {
+            tile[i] = _mm256_loadu_ps(src + i*horizon + col);
+        }
+        transpose8(tile);
+        return;
+    }
+    alignas(32) float buf[PUFF_LANES][PUFF_LANES] = {};
+    for (int i = 0; i < PUFF_LANES; i++) {
+        for (int k = 0; k < n; k++) {
+            buf[k][i] = src[i*horizon + col + k];
+        }
+    }
+    for (int k = 0; k < PUFF_LANES; k++) {
+        tile[k] = _mm256_load_ps(buf[k]);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void store_tile(float* dst, int horizon, int col, int n, __m256 tile[8]) {
+    if (n == PUFF_LANES) {
+        transpose8(tile);
+        for (int i = 0; i < PUFF_LANES; i++) {
+            _mm256_storeu_ps(dst + i*horizon + col, tile[i]);
+        }
+        return;
+    }
+    alignas(32) float buf[PUFF_LANES][PUFF_LANES];
+    for (int k = 0; k < n; k++) {
+        _mm256_store_ps(buf[k], tile[k]);
+    }
+    for (int i = 0; i < PUFF_LANES; i++) {
+        for (int k = 0; k < n; k++) {
+            dst[i*horizon + col + k] = buf[k][i];
+        }
+    }
+}
+
+// 1.0 - dones in double then rounded, as in the scalar row
+__attribute__((target("avx2")))
+static inline __m256 not_done(__m256 dones) {
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d lo = _mm256_sub_pd(one, _mm256_cvtps_pd(_mm256_castps256_ps128(dones)));
+    __m256d hi = _mm256_sub_pd(one, _mm256_cvtps_pd(_mm256_extractf128_ps(dones, 1)));
+    return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+}
+
+// puff_advantage_row on 8 rows at once. Tiles of 8 timesteps are
+// transposed so each step of the recurrence is one vector op across rows.
+// Same operations in the same order as the scalar row, and no FMA, so
+// the results are bitwise identical
+__attribute__((target("avx2")))
+static void puff_advantage_rows_avx2(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float gamma, float lambda,
+        float rho_clip, float c_clip, int horizon) {
+    __m256 gamma_v = _mm256_set1_ps(gamma);
+    __m256 gamma_lambda = _mm256_set1_ps(gamma*lambda);
+    __m256 rho_clip_v = _mm256_set1_ps(rho_clip);
+    __m256 c_clip_v = _mm256_set1_ps(c_clip);
+    __m256 lastpufferlam = _mm256_setzero_ps();
+    __m256 next_value = _mm256_setzero_ps();
+    __m256 next_reward = _mm256_setzero_ps();
+    __m256 next_nonterminal = _mm256_setzero_ps();
+
+    __m256 val[8], rew[8], done[8], imp[8], adv[8];
+    int col = ((horizon - 1) / PUFF_LANES) * PUFF_LANES;
+    for (; col >= 0; col -= PUFF_LANES) {
+        int n = horizon - col < PUFF_LANES ? horizon - col : PUFF_LANES;
+        load_tile(values, horizon, col, n, val);
+        load_tile(rewards, horizon, col, n, rew);
+        load_tile(dones, horizon, col, n, done);
+        load_tile(importance, horizon, col, n, imp);
+
+        for (int k = n - 1; k >= 0; k--) {
+            adv[k] = _mm256_setzero_ps();
+            if (col + k < horizon - 1) {
+                __m256 rho_t = _mm256_min_ps(imp[k], rho_clip_v);
+                __m256 c_t = _mm256_min_ps(imp[k], c_clip_v);
+                __m256 delta = _mm256_mul_ps(rho_t, _mm256_sub_ps(_mm256_add_ps(next_reward,
+                    _mm256_mul_ps(_mm256_mul_ps(gamma_v, next_value), next_nonterminal)), val[k]));
+                lastpufferlam = _mm256_add_ps(delta, _mm256_mul_ps(_mm256_mul_ps(
+                    _mm256_mul_ps(gamma_lambda, c_t), lastpufferlam), next_nonterminal));
+                adv[k] = lastpufferlam;
+            }
+            next_value = val[k];
+            next_reward = rew[k];
+            next_nonterminal = not_done(done[k]);
+        }
+
+        // The last timestep has no advantage and is left untouched
+        if (col + n == horizon) {
+            n -= 1;
+        }
+        if (n > 0) {
+            store_tile(advantages, horizon, col, n, adv);
+        }
+    }
+}
+
+static bool puff_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+// Advantages for rows [row, row + rows), at most 8. Vectorized when
+// AVX2 is available
+static void puff_advantage_block(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float gamma, float lambda,
+        float rho_clip, float c_clip, int row, int rows, int horizon) {
+    int64_t offset = (int64_t)row*horizon;
+#ifdef PUFF_X86
+    if (rows == PUFF_LANES && puff_has_avx2()) {
+        puff_advantage_rows_avx2(values + offset, rewards + offset,
+            dones + offset, importance + offset, advantages + offset,
+            gamma, lambda, rho_clip, c_clip, horizon
+        );
+        return;
+    }
+#endif
+    for (int r = 0; r < rows; r++, offset += horizon) {
         puff_advantage_row(values + offset, rewards + offset,
             dones + offset, importance + offset, advantages + offset,
             gamma, lambda, rho_clip, c_clip, horizon
@@ -71,6 +230,61 @@ void puff_advantage(float* values, float* rewards, float* dones, float* importan
     }
 }
 
+// [num_steps, horizon]. Rows are independent, so blocks of rows are
+// split across the ATen thread pool
+void puff_advantage(float* values, float* rewards, float* dones, float* importance,
+        float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
+        int num_steps, const int horizon){
+    const int block = 8;
+    int num_blocks = (num_steps + block - 1) / block;
+    int64_t grain = 1 + 32768 / ((int64_t)block*horizon);
+    at::parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; b++) {
+            int row = b*block;
+            int rows = num_steps - row < block ? num_steps - row : block;
+            puff_advantage_block(values, rewards, dones, importance, advantages,
+                gamma, lambda, rho_clip, c_clip, row, rows, horizon);
+        }
+    });
+}
+
+// Advantages plus minibatch sampling priorities in one pass. Each row's
+// weight is sum(|adv|)^alpha, with nan/inf mapped to 0, and probs are
+// (weight + 1e-6)/(sum(weights) + 1e-6). Rows are summed while still in cache
+void puff_advantage_prio(float* values, float* rewards, float* dones, float* importance,
+        float* advantages, float* prio_weights, float* prio_probs, float gamma,
+        float lambda, float rho_clip, float c_clip, float alpha,
+        int num_steps, const int horizon){
+    const int block = 8;
+    int num_blocks = (num_steps + block - 1) / block;
+    int64_t grain = 1 + 32768 / ((int64_t)block*horizon);
+    at::parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; b++) {
+            int row = b*block;
+            int rows = num_steps - row < block ? num_steps - row : block;
+            puff_advantage_block(values, rewards, dones, importance, advantages,
+                gamma, lambda, rho_clip, c_clip, row, rows, horizon);
+            for (int r = row; r < row + rows; r++) {
+                float* adv = advantages + (int64_t)r*horizon;
+                float total = 0;
+                for (int t = 0; t < horizon; t++) {
+                    total += fabsf(adv[t]);
+                }
+                float weight = powf(total, alpha);
+                prio_weights[r] = std::isfinite(weight) ? weight : 0.0f;
+            }
+        }
+    });
+
+    double weight_sum = 0;
+    for (int r = 0; r < num_steps; r++) {
+        weight_sum += prio_weights[r];
+    }
+    float denom = (float)weight_sum + 1e-6f;
+    for (int r = 0; r < num_steps; r++) {
+        prio_probs[r] = (prio_weights[r] + 1e-6f)/denom;
+    }
+}
 
 void compute_puff_advantage_cpu(torch::Tensor values, torch::Tensor rewards,
         torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
@@ -84,12 +298,40 @@ void compute_puff_advantage_cpu(torch::Tensor values, torch::Tensor rewards,
     );
 }
 
+void prio_check(torch::Tensor values, torch::Tensor prio_weights,
+        torch::Tensor prio_probs, int num_steps) {
+    for (const torch::Tensor& t : {prio_weights, prio_probs}) {
+        TORCH_CHECK(t.dim() == 1, "Priority tensors must be 1D");
+        TORCH_CHECK(t.device() == values.device(), "All tensors must be on same device");
+        TORCH_CHECK(t.size(0) == num_steps, "Priority tensors must have num_steps elements");
+        TORCH_CHECK(t.dtype() == torch::kFloat32, "All tensors must be float32");
+        TORCH_CHECK(t.is_contiguous(), "Priority tensors must be contiguous");
+    }
+}
+
+void compute_puff_advantage_prio_cpu(torch::Tensor values, torch::Tensor rewards,
+        torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
+        torch::Tensor prio_weights, torch::Tensor prio_probs, double gamma,
+        double lambda, double rho_clip, double c_clip, double alpha) {
+    int num_steps = values.size(0);
+    int horizon = values.size(1);
+    vtrace_check(values, rewards, dones, importance, advantages, num_steps, horizon);
+    prio_check(values, prio_weights, prio_probs, num_steps);
+    puff_advantage_prio(values.data_ptr<float>(), rewards.data_ptr<float>(),
+        dones.data_ptr<float>(), importance.data_ptr<float>(), advantages.data_ptr<float>(),
+        prio_weights.data_ptr<float>(), prio_probs.data_ptr<float>(),
+        gamma, lambda, rho_clip, c_clip, alpha, num_steps, horizon
+    );
+}
+
 TORCH_LIBRARY(pufferlib, m) {
    m.def("compute_puff_advantage(Tensor(a!) values, Tensor(b!) rewards, Tensor(c!) dones, Tensor(d!) importance, Tensor(e!) advantages, float gamma, float lambda, float rho_clip, float c_clip) -> ()");
+   m.def("compute_puff_advantage_prio(Tensor(a!) values, Tensor(b!) rewards, Tensor(c!) dones, Tensor(d!) importance, Tensor(e!) advantages, Tensor(f!) prio_weights, Tensor(g!) prio_probs, float gamma, float lambda, float rho_clip, float c_clip, float alpha) -> ()");
  }
 
 TORCH_LIBRARY_IMPL(pufferlib, CPU, m) {
   m.impl("compute_puff_advantage", &compute_puff_advantage_cpu);
+  m.impl("compute_puff_advantage_prio", &compute_puff_advantage_prio_cpu);
 }
 
 }
@@ -3,23 +3,47 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
-
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PUFFERNET_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PUFFERNET_NEON 1
+#endif
+
+// Every arena allocation starts on a 64-byte boundary
+#define ARENA_ALIGN 64
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Scratch is memory a layer only needs during its own forward call, so one
+// region sized to the largest request is shared. Outputs that are dead once
+// the following layer has read them alternate between two activation
+// regions, each sized to its largest request
 typedef struct {
     void* data;
     size_t capacity;
     size_t used;
+    float* scratch;
+    size_t scratch_size;
+    float* activation[2];
+    size_t activation_size[2];
 } Arena;
 
 Arena* make_allocator(size_t total_size) {
-    void* buffer = calloc(1, total_size + sizeof(Arena));
+    void* buffer = calloc(1, sizeof(Arena) + ARENA_ALIGN + total_size);
     Arena* allocator = (Arena*)buffer;
-    allocator->data = (void*)((char*)buffer + sizeof(Arena));
+    uintptr_t start = (uintptr_t)buffer + sizeof(Arena);
+    allocator->data = (void*)ARENA_ROUND(start);
     allocator->capacity = total_size;
     allocator->used = 0;
     return allocator;
 }
 
 void* alloc(Arena* allocator, size_t size) {
+    size = ARENA_ROUND(size);
     void* ptr = (void*)((char*)allocator->data + allocator->used);
     if (allocator->used + size > allocator->capacity) {
         return NULL;
@@ -28,12 +52,23 @@ void* alloc(Arena* allocator, size_t size) {
     return ptr;
 }
 
+// Arrays computed from loaded weights, like the stacked LSTM matrices.
+// Keyed by the offset of the weights they were built from
+typedef struct DerivedWeights DerivedWeights;
+struct DerivedWeights {
+    DerivedWeights* next;
+    int idx;
+    int size;
+    float data[];
+};
+
 // File format is obained by flattening and concatenating all pytorch layers
 typedef struct Weights Weights;
 struct Weights {
     float* data;
     int size;
     int idx;
+    DerivedWeights* derived;
 };
 
 void _load_weights(const char* filename, float* weights, size_t num_weights) {
@@ -66,6 +101,35 @@ float* get_weights(Weights* weights, int num_weights) {
     return data;
 }
 
+// Every layer made from the same weights shares one derived array. Returns
+// a zeroed array and sets *fresh the first time, so the caller fills it once
+float* get_derived_weights(Weights* weights, int idx, int size, bool* fresh) {
+    for (DerivedWeights* d = weights->derived; d != NULL; d = d->next) {
+        if (d->idx == idx && d->size == size) {
+            *fresh = false;
+            return d->data;
+        }
+    }
+    DerivedWeights* d = calloc(1, sizeof(DerivedWeights) + size*sizeof(float));
+    assert(d != NULL);
+    d->next = weights->derived;
+    d->idx = idx;
+    d->size = size;
+    weights->derived = d;
+    *fresh = true;
+    return d->data;
+}
+
+void free_weights(Weights* weights) {
+    DerivedWeights* d = weights->derived;
+    while (d != NULL) {
+        DerivedWeights* next = d->next;
+        free(d);
+        d = next;
+    }
+    free(weights);
+}
+
 // PufferNet implementation of PyTorch functions
 // These are tested against the PyTorch implementation
 void _relu(float* input, float* output, int size) {
@@ -85,71 +149,273 @@ inline float _sigmoid(float x) {
     return 1.0f / (1.0f + expf(-x));
 }
 
-void _linear(float* input, float* weights, float* bias, float* output,
-        int batch_size, int input_dim, int output_dim) {
+// Linear layers. weights are [output_dim, input_dim] like torch, so each
+// output is a dot product of two contiguous rows. The SIMD kernels compute
+// 2 batch rows x 4 outputs per tile, keeping the 4 weight rows in L1 while
+// every batch row streams past them. Summation order differs from the
+// scalar loop, so results match to float tolerance, not bitwise
+#define LINEAR_TILE_B 2
+#define LINEAR_TILE_O 4
+
+static inline void _linear_store(float* output, float* bias, int output_dim,
+        int b, int o, float sum, bool accumulate) {
+    if (accumulate) {
+        output[b*output_dim + o] += sum + bias[o];
+    } else {
+        output[b*output_dim + o] = sum + bias[o];
+    }
+}
+
+static void _linear_scalar(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim, bool accumulate) {
     for (int b = 0; b < batch_size; b++) {
         for (int o = 0; o < output_dim; o++) {
             float sum = 0.0f;
             for (int i = 0; i < input_dim; i++)
                 sum += input[b*input_dim + i] * weights[o*input_dim + i];
-            output[b*output_dim + o] = sum + bias[o];
+            _linear_store(output, bias, output_dim, b, o, sum, accumulate);
+        }
+    }
+}
+
+#ifdef PUFFERNET_AVX2
+__attribute__((target("avx2,fma")))
+static inline float _hsum_avx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// rows x outs tile starting at batch b, output o. rows and outs are
+// constants at each call site, so the accumulators stay in registers
+__attribute__((target("avx2,fma"), always_inline))
+static inline void _linear_tile_avx2(float* input, float* weights, float* bias,
+        float* output, int input_dim, int output_dim, int b, int o,
+        int rows, int outs, bool accumulate) {
+    __m256 acc[LINEAR_TILE_B][LINEAR_TILE_O];
+    for (int r = 0; r < rows; r++)
+        for (int k = 0; k < outs; k++)
+            acc[r][k] = _mm256_setzero_ps();
+
+    float* x = input + b*input_dim;
+    float* w = weights + o*input_dim;
+    int i = 0;
+    for (; i + 8 <= input_dim; i += 8) {
+        __m256 wv[LINEAR_TILE_O];
+        for (int k = 0; k < outs; k++)
+            wv[k] = _mm256_loadu_ps(w + k*input_dim + i);
+        for (int r = 0; r < rows; r++) {
+            __m256 xv = _mm256_loadu_ps(x + r*input_dim + i);
+            for (int k = 0; k < outs; k++)
+                acc[r][k] = _mm256_fmadd_ps(xv, wv[k], acc[r][k]);
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int k = 0; k < outs; k++) {
+            float sum = _hsum_avx2(acc[r][k]);
+            for (int j = i; j < input_dim; j++)
+                sum += x[r*input_dim + j] * w[k*input_dim + j];
+            _linear_store(output, bias, output_dim, b + r, o + k, sum, accumulate);
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void _linear_avx2(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim, bool accumulate) {
+    int o = 0;
+    for (; o + LINEAR_TILE_O <= output_dim; o += LINEAR_TILE_O) {
+        int b = 0;
+        for (; b + LINEAR_TILE_B <= batch_size; b += LINEAR_TILE_B)
+            _linear_tile_avx2(input, weights, bias, output, input_dim, output_dim,
+                b, o, LINEAR_TILE_B, LINEAR_TILE_O, accumulate);
+        for (; b < batch_size; b++)
+            _linear_tile_avx2(input, weights, bias, output, input_dim, output_dim,
+                b, o, 1, LINEAR_TILE_O, accumulate);
+    }
+    for (; o < output_dim; o++)
+        for (int b = 0; b < batch_size; b++)
+            _linear_tile_avx2(input, weights, bias, output, input_dim, output_dim,
+                b, o, 1, 1, accumulate);
+}
+#endif
+
+#ifdef PUFFERNET_NEON
+__attribute__((always_inline))
+static inline void _linear_tile_neon(float* input, float* weights, float* bias,
+        float* output, int input_dim, int output_dim, int b, int o,
+        int rows, int outs, bool accumulate) {
+    float32x4_t acc[LINEAR_TILE_B][LINEAR_TILE_O];
+    for (int r = 0; r < rows; r++)
+        for (int k = 0; k < outs; k++)
+            acc[r][k] = vdupq_n_f32(0.0f);
+
+    float* x = input + b*input_dim;
+    float* w = weights + o*input_dim;
+    int i = 0;
+    for (; i + 4 <= input_dim; i += 4) {
+        float32x4_t wv[LINEAR_TILE_O];
+        for (int k = 0; k < outs; k++)
+            wv[k] = vld1q_f32(w + k*input_dim + i);
+        for (int r = 0; r < rows; r++) {
+            float32x4_t xv = vld1q_f32(x + r*input_dim + i);
+            for (int k = 0; k < outs; k++)
+                acc[r][k] = vfmaq_f32(acc[r][k], xv, wv[k]);
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int k = 0; k < outs; k++) {
+            float sum = vaddvq_f32(acc[r][k]);
+            for (int j = i; j < input_dim; j++)
+                sum += x[r*input_dim + j] * w[k*input_dim + j];
+            _linear_store(output, bias, output_dim, b + r, o + k, sum, accumulate);
         }
     }
 }
 
+static void _linear_neon(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim, bool accumulate) {
+    int o = 0;
+    for (; o + LINEAR_TILE_O <= output_dim; o += LINEAR_TILE_O) {
+        int b = 0;
+        for (; b + LINEAR_TILE_B <= batch_size; b += LINEAR_TILE_B)
+            _linear_tile_neon(input, weights, bias, output, input_dim, output_dim,
+                b, o, LINEAR_TILE_B, LINEAR_TILE_O, accumulate);
+        for (; b < batch_size; b++)
+            _linear_tile_neon(input, weights, bias, output, input_dim, output_dim,
+                b, o, 1, LINEAR_TILE_O, accumulate);
+    }
+    for (; o < output_dim; o++)
+        for (int b = 0; b < batch_size; b++)
+            _linear_tile_neon(input, weights, bias, output, input_dim, output_dim,
+                b, o, 1, 1, accumulate);
+}
+#endif
+
+static void _linear_dispatch(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim, bool accumulate) {
+#if defined(PUFFERNET_AVX2)
+    static int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    if (has_avx2) {
+        _linear_avx2(input, weights, bias, output, batch_size, input_dim, output_dim, accumulate);
+        return;
+    }
+#elif defined(PUFFERNET_NEON)
+    _linear_neon(input, weights, bias, output, batch_size, input_dim, output_dim, accumulate);
+    return;
+#endif
+    _linear_scalar(input, weights, bias, output, batch_size, input_dim, output_dim, accumulate);
+}
+
+void _linear(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim) {
+    _linear_dispatch(input, weights, bias, output, batch_size, input_dim, output_dim, false);
+}
+
 void _linear_accumulate(float* input, float* weights, float* bias, float* output,
         int batch_size, int input_dim, int output_dim) {
-    for (int b = 0; b < batch_size; b++) {
-        for (int o = 0; o < output_dim; o++) {
-            float sum = 0.0f;
-            for (int i = 0; i < input_dim; i++)
-                sum += input[b*input_dim + i] * weights[o*input_dim + i];
-            output[b*output_dim + o] += sum + bias[o];
-        }
+    _linear_dispatch(input, weights, bias, output, batch_size, input_dim, output_dim, true);
+}
+
+// Conv2d as im2col + the linear GEMM. Patches of chunk images are
+// unrolled into col [chunk*positions, in_channels*kernel_size^2] rows, so
+// each output position is one row times the [out_channels, k] weights.
+// The GEMM writes NHWC into gemm_out, which is transposed back to NCHW
+// unless there is a single output position
+
+// Images per GEMM are capped so col stays around L2 size
+#define CONV_COL_BYTES (256*1024)
+
+int _conv2d_chunk(int batch_size, int in_width, int in_height,
+        int in_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    size_t image_bytes = (size_t)h_out*w_out*in_channels*kernel_size*kernel_size*sizeof(float);
+    int chunk = CONV_COL_BYTES / image_bytes;
+    if (chunk < 1) {
+        chunk = 1;
     }
+    if (chunk > batch_size) {
+        chunk = batch_size;
+    }
+    return chunk;
 }
 
-void _conv2d(float* input, float* weights, float* bias,
-        float* output, int batch_size, int in_width, int in_height,
-        int in_channels, int out_channels, int kernel_size, int stride) {
+static void _im2col(float* input, float* col, int num_images, int in_width,
+        int in_height, int in_channels, int kernel_size, int stride) {
     int h_out = (in_height - kernel_size)/stride + 1;
     int w_out = (in_width - kernel_size)/stride + 1;
-    for (int b = 0; b < batch_size; b++) {
-        for (int oc = 0; oc < out_channels; oc++) {
-            for (int h = 0; h < h_out; h++) {
-                for (int w = 0; w < w_out; w++) {
-                    int out_adr = (
-                        b*out_channels*h_out*w_out
-                        + oc*h_out*w_out+ 
-                        + h*w_out
-                        + w
-                    );
-                    output[out_adr] = bias[oc];
-                    for (int ic = 0; ic < in_channels; ic++) {
-                        for (int kh = 0; kh < kernel_size; kh++) {
-                            for (int kw = 0; kw < kernel_size; kw++) {
-                                int in_adr = (
-                                    b*in_channels*in_height*in_width
-                                    + ic*in_height*in_width
-                                    + (h*stride + kh)*in_width
-                                    + (w*stride + kw)
-                                );
-                                int weight_adr = (
-                                    oc*in_channels*kernel_size*kernel_size
-                                    + ic*kernel_size*kernel_size
-                                    + kh*kernel_size
-                                    + kw
-                                );
-                                output[out_adr] += input[in_adr]*weights[weight_adr];
-                            }
-                        }
+    int k = in_channels*kernel_size*kernel_size;
+    for (int b = 0; b < num_images; b++) {
+        float* image = input + b*in_channels*in_height*in_width;
+        for (int h = 0; h < h_out; h++) {
+            for (int w = 0; w < w_out; w++) {
+                float* row = col + ((b*h_out + h)*w_out + w)*k;
+                for (int ic = 0; ic < in_channels; ic++) {
+                    for (int kh = 0; kh < kernel_size; kh++) {
+                        float* src = image + ic*in_height*in_width
+                            + (h*stride + kh)*in_width + w*stride;
+                        memcpy(row, src, kernel_size*sizeof(float));
+                        row += kernel_size;
                     }
-               }
+                }
             }
         }
     }
 }
 
+// col holds chunk*positions*k floats and gemm_out chunk*positions*out_channels
+void _conv2d_gemm(float* input, float* weights, float* bias, float* output,
+        float* col, float* gemm_out, int chunk, int batch_size, int in_width,
+        int in_height, int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = h_out*w_out;
+    int k = in_channels*kernel_size*kernel_size;
+    int in_size = in_channels*in_height*in_width;
+    int out_size = out_channels*positions;
+    for (int b = 0; b < batch_size; b += chunk) {
+        int n = batch_size - b < chunk ? batch_size - b : chunk;
+        _im2col(input + b*in_size, col, n, in_width, in_height,
+            in_channels, kernel_size, stride);
+        if (positions == 1) {
+            _linear(col, weights, bias, output + b*out_size, n, k, out_channels);
+            continue;
+        }
+        _linear(col, weights, bias, gemm_out, n*positions, k, out_channels);
+        for (int i = 0; i < n; i++) {
+            float* src = gemm_out + i*out_size;
+            float* dst = output + (b + i)*out_size;
+            for (int p = 0; p < positions; p++) {
+                for (int oc = 0; oc < out_channels; oc++) {
+                    dst[oc*positions + p] = src[p*out_channels + oc];
+                }
+            }
+        }
+    }
+}
+
+// Standalone version. Layers use conv2d, which keeps its scratch buffers
+void _conv2d(float* input, float* weights, float* bias,
+        float* output, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = h_out*w_out;
+    int chunk = _conv2d_chunk(batch_size, in_width, in_height,
+        in_channels, kernel_size, stride);
+    float* col = calloc((size_t)chunk*positions*in_channels*kernel_size*kernel_size, sizeof(float));
+    float* gemm_out = calloc((size_t)chunk*positions*out_channels, sizeof(float));
+    _conv2d_gemm(input, weights, bias, output, col, gemm_out, chunk, batch_size,
+        in_width, in_height, in_channels, out_channels, kernel_size, stride);
+    free(col);
+    free(gemm_out);
+}
+
 void _conv3d(float* input, float* weights, float* bias,
         float* output, int batch_size, int in_width, int in_height, int in_depth,
         int in_channels, int out_channels, int kernel_size, int stride) {
@@ -199,42 +465,156 @@ void _conv3d(float* input, float* weights, float* bias,
     }
 }
 
+// LSTM gate pass over [batch, 4*hidden] pre-activations in torch gate order
+// (input, forget, cell, output). Updates state_c and state_h in one sweep.
+// The AVX2 path uses a polynomial expf (Cephes, ~1e-7 relative error) for
+// sigmoid and tanh
+static void _lstm_gates_scalar(float* gates, float* state_h, float* state_c,
+        int batch_size, int hidden_size, int start) {
+    for (int b = 0; b < batch_size; b++) {
+        float* g = gates + 4*b*hidden_size;
+        float* h = state_h + b*hidden_size;
+        float* c = state_c + b*hidden_size;
+        for (int i = start; i < hidden_size; i++) {
+            float input_gate = _sigmoid(g[i]);
+            float forget_gate = _sigmoid(g[hidden_size + i]);
+            float cell_gate = tanhf(g[2*hidden_size + i]);
+            float output_gate = _sigmoid(g[3*hidden_size + i]);
+            c[i] = forget_gate*c[i] + input_gate*cell_gate;
+            h[i] = output_gate*tanhf(c[i]);
+        }
+    }
+}
+
+#ifdef PUFFERNET_AVX2
+__attribute__((target("avx2,fma")))
+static inline __m256 _exp_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f)),
+        _mm256_set1_ps(88.3762626647949f));
+    __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f),
+        _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+    __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894E-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201E-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    __m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx),
+        _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 _sigmoid_avx2(__m256 x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = _exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 _tanh_avx2(__m256 x) {
+    __m256 two = _mm256_set1_ps(2.0f);
+    return _mm256_sub_ps(_mm256_mul_ps(two, _sigmoid_avx2(_mm256_mul_ps(two, x))),
+        _mm256_set1_ps(1.0f));
+}
+
+__attribute__((target("avx2,fma")))
+static void _lstm_gates_avx2(float* gates, float* state_h, float* state_c,
+        int batch_size, int hidden_size) {
+    int vec_end = hidden_size & ~7;
+    for (int b = 0; b < batch_size; b++) {
+        float* g = gates + 4*b*hidden_size;
+        float* h = state_h + b*hidden_size;
+        float* c = state_c + b*hidden_size;
+        for (int i = 0; i < vec_end; i += 8) {
+            __m256 input_gate = _sigmoid_avx2(_mm256_loadu_ps(g + i));
+            __m256 forget_gate = _sigmoid_avx2(_mm256_loadu_ps(g + hidden_size + i));
+            __m256 cell_gate = _tanh_avx2(_mm256_loadu_ps(g + 2*hidden_size + i));
+            __m256 output_gate = _sigmoid_avx2(_mm256_loadu_ps(g + 3*hidden_size + i));
+            __m256 cell = _mm256_fmadd_ps(forget_gate, _mm256_loadu_ps(c + i),
+                _mm256_mul_ps(input_gate, cell_gate));
+            _mm256_storeu_ps(c + i, cell);
+            _mm256_storeu_ps(h + i, _mm256_mul_ps(output_gate, _tanh_avx2(cell)));
+        }
+    }
+    if (vec_end < hidden_size) {
+        _lstm_gates_scalar(gates, state_h, state_c, batch_size, hidden_size, vec_end);
+    }
+}
+#endif
+
+void _lstm_gates(float* gates, float* state_h, float* state_c,
+        int batch_size, int hidden_size) {
+#ifdef PUFFERNET_AVX2
+    static int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    if (has_avx2) {
+        _lstm_gates_avx2(gates, state_h, state_c, batch_size, hidden_size);
+        return;
+    }
+#endif
+    _lstm_gates_scalar(gates, state_h, state_c, batch_size, hidden_size, 0);
+}
+
 void _lstm(float* input, float* state_h, float* state_c, float* weights_input,
         float* weights_state, float* bias_input, float*bias_state,
         float *buffer, int batch_size, int input_size, int hidden_size) {
     _linear(input, weights_input, bias_input, buffer, batch_size, input_size, 4*hidden_size);
     _linear_accumulate(state_h, weights_state, bias_state, buffer, batch_size, hidden_size, 4*hidden_size);
+    _lstm_gates(buffer, state_h, state_c, batch_size, hidden_size);
+}
 
-    // Activation functions
-    for (int b=0; b<batch_size; b++) {
-        int b_offset = 4*b*hidden_size;
-        for (int i=0; i<2*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = _sigmoid(buffer[buf_adr]);
-        }
-        for (int i=2*hidden_size; i<3*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = tanh(buffer[buf_adr]);
-        }
-        for (int i=3*hidden_size; i<4*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = _sigmoid(buffer[buf_adr]);
-        }
+// Fused cell. xh is [batch, input_size + hidden_size] scratch and
+// weights_cat holds [weights_input, weights_state] stacked per gate row, so
+// both projections are one GEMM. bias_cat is bias_input + bias_state
+void _lstm_fused(float* input, float* state_h, float* state_c, float* weights_cat,
+        float* bias_cat, float* xh, float* buffer, int batch_size,
+        int input_size, int hidden_size) {
+    int cat_size = input_size + hidden_size;
+    for (int b = 0; b < batch_size; b++) {
+        memcpy(xh + b*cat_size, input + b*input_size, input_size*sizeof(float));
+        memcpy(xh + b*cat_size + input_size, state_h + b*hidden_size, hidden_size*sizeof(float));
     }
+    _linear(xh, weights_cat, bias_cat, buffer, batch_size, cat_size, 4*hidden_size);
+    _lstm_gates(buffer, state_h, state_c, batch_size, hidden_size);
+}
 
-    // Gates
-    for (int b=0; b<batch_size; b++) {
-        int hidden_offset = b*hidden_size;
-        int b_offset = 4*b*hidden_size;
-        for (int i=0; i<hidden_size; i++) {
-            state_c[hidden_offset + i] = (
-                buffer[b_offset + hidden_size + i] * state_c[hidden_offset + i]
-                + buffer[b_offset + i] * buffer[b_offset + 2*hidden_size + i]
-            );
-            state_h[hidden_offset + i] = (
-                buffer[b_offset + 3*hidden_size + i] * tanh(state_c[hidden_offset + i])
-            );
-        }
+// Runs seq_len steps over input [seq_len, batch, input_size] and writes
+// each step's state_h to output [seq_len, batch, hidden_size]. The input
+// projection for all steps is a single GEMM into buffer
+// [seq_len, batch, 4*hidden_size], leaving only the hidden projection
+// inside the recurrence. bias_cat is bias_input + bias_state
+void _lstm_sequence(float* input, float* state_h, float* state_c,
+        float* weights_input, float* weights_state, float* bias_cat,
+        float* zero_bias, float* buffer, float* output, int batch_size,
+        int input_size, int hidden_size, int seq_len) {
+    int gate_size = 4*batch_size*hidden_size;
+    _linear(input, weights_input, bias_cat, buffer, seq_len*batch_size,
+        input_size, 4*hidden_size);
+    for (int t = 0; t < seq_len; t++) {
+        float* gates = buffer + t*gate_size;
+        _linear_accumulate(state_h, weights_state, zero_bias, gates,
+            batch_size, hidden_size, 4*hidden_size);
+        _lstm_gates(gates, state_h, state_c, batch_size, hidden_size);
+        memcpy(output + t*batch_size*hidden_size, state_h,
+            batch_size*hidden_size*sizeof(float));
+    }
+}
+
+// Builds the weights_cat and bias_cat used by _lstm_fused
+void _lstm_stack_weights(float* weights_input, float* weights_state, float* bias_input,
+        float* bias_state, float* weights_cat, float* bias_cat, int input_size, int hidden_size) {
+    int cat_size = input_size + hidden_size;
+    for (int o = 0; o < 4*hidden_size; o++) {
+        memcpy(weights_cat + o*cat_size, weights_input + o*input_size, input_size*sizeof(float));
+        memcpy(weights_cat + o*cat_size + input_size, weights_state + o*hidden_size,
+            hidden_size*sizeof(float));
+        bias_cat[o] = bias_input[o] + bias_state[o];
     }
 }
 
@@ -356,6 +736,75 @@ void _max_dim1(float* input, float* output, int batch_size, int seq_len, int fea
     }
 }
 
+// Bytes a layer needs for its struct, its output and its forward scratch
+typedef struct {
+    size_t layer;
+    size_t buffer;
+    size_t scratch;
+} LayerSize;
+
+// Adds a layer to a zeroed Arena that only counts sizes. slot is as in
+// layer_alloc, so plan and build must agree on it layer by layer
+static void arena_plan(Arena* plan, int slot, LayerSize size) {
+    plan->used += ARENA_ROUND(size.layer);
+    if (slot >= 0) {
+        if (ARENA_ROUND(size.buffer) > plan->activation_size[slot]) {
+            plan->activation_size[slot] = ARENA_ROUND(size.buffer);
+        }
+    } else {
+        plan->used += ARENA_ROUND(size.buffer);
+    }
+    if (ARENA_ROUND(size.scratch) > plan->scratch_size) {
+        plan->scratch_size = ARENA_ROUND(size.scratch);
+    }
+}
+
+// One allocation holding the planned layers, then scratch, then both
+// activation regions
+static Arena* make_model_arena(Arena* plan) {
+    size_t* activation_size = plan->activation_size;
+    Arena* arena = make_allocator(plan->used + plan->scratch_size
+        + activation_size[0] + activation_size[1]);
+    arena->capacity = plan->used;
+    arena->scratch_size = plan->scratch_size;
+    arena->scratch = (float*)((char*)arena->data + plan->used);
+    arena->activation_size[0] = activation_size[0];
+    arena->activation_size[1] = activation_size[1];
+    arena->activation[0] = (float*)((char*)arena->scratch + plan->scratch_size);
+    arena->activation[1] = (float*)((char*)arena->activation[0] + activation_size[0]);
+    return arena;
+}
+
+// Allocates a layer struct, its output buffer and its scratch. Without an
+// arena they share one calloc block so free(layer) releases everything.
+// With one, slot 0 or 1 puts the output in that activation region instead
+// of its own buffer. Use it only when the next layer is the sole reader, and
+// alternate slots along a chain so no layer reads and writes the same one.
+// Elementwise layers like ReLU and GELU may stay in their input's slot
+static void* layer_alloc(Arena* arena, int slot, LayerSize size,
+        void** buffer, void** scratch) {
+    if (arena == NULL) {
+        char* layer = calloc(1, size.layer + size.buffer + size.scratch);
+        if (buffer) *buffer = layer + size.layer;
+        if (scratch) *scratch = layer + size.layer + size.buffer;
+        return layer;
+    }
+    void* layer = alloc(arena, size.layer);
+    assert(layer != NULL);
+    if (buffer && slot >= 0) {
+        assert(ARENA_ROUND(size.buffer) <= arena->activation_size[slot]);
+        *buffer = arena->activation[slot];
+    } else if (buffer) {
+        *buffer = alloc(arena, size.buffer);
+        assert(*buffer != NULL);
+    }
+    if (scratch) {
+        assert(ARENA_ROUND(size.scratch) <= arena->scratch_size);
+        *scratch = arena->scratch;
+    }
+    return layer;
+}
+
 // User API. Provided to help organize layers
 typedef struct Linear Linear;
 struct Linear {
@@ -367,11 +816,17 @@ struct Linear {
     int output_dim;
 };
 
-Linear* make_linear(Weights* weights, int batch_size, int input_dim, int output_dim) {
-    size_t buffer_size = batch_size*output_dim*sizeof(float);
-    Linear* layer = calloc(1, sizeof(Linear) + buffer_size);
+LayerSize linear_size(int batch_size, int input_dim, int output_dim) {
+    return (LayerSize){sizeof(Linear), batch_size*output_dim*sizeof(float), 0};
+}
+
+Linear* make_linear_in(Arena* arena, int slot, Weights* weights,
+        int batch_size, int input_dim, int output_dim) {
+    void* buffer;
+    Linear* layer = layer_alloc(arena, slot,
+        linear_size(batch_size, input_dim, output_dim), &buffer, NULL);
     *layer = (Linear){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .weights = get_weights(weights, output_dim*input_dim),
         .bias = get_weights(weights, output_dim),
         .batch_size = batch_size,
@@ -381,6 +836,10 @@ Linear* make_linear(Weights* weights, int batch_size, int input_dim, int output_
     return layer;
 }
 
+Linear* make_linear(Weights* weights, int batch_size, int input_dim, int output_dim) {
+    return make_linear_in(NULL, -1, weights, batch_size, input_dim, output_dim);
+}
+
 void linear(Linear* layer, float* input) {
     _linear(input, layer->weights, layer->bias, layer->output,
         layer->batch_size, layer->input_dim, layer->output_dim);
@@ -398,17 +857,25 @@ struct ReLU {
     int input_dim;
 };
 
-ReLU* make_relu(int batch_size, int input_dim) {
-    size_t buffer_size = batch_size*input_dim*sizeof(float);
-    ReLU* layer = calloc(1, sizeof(ReLU) + buffer_size);
+LayerSize relu_size(int batch_size, int input_dim) {
+    return (LayerSize){sizeof(ReLU), batch_size*input_dim*sizeof(float), 0};
+}
+
+ReLU* make_relu_in(Arena* arena, int slot, int batch_size, int input_dim) {
+    void* buffer;
+    ReLU* layer = layer_alloc(arena, slot, relu_size(batch_size, input_dim), &buffer, NULL);
     *layer = (ReLU){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .batch_size = batch_size,
         .input_dim = input_dim,
     };
     return layer;
 }
 
+ReLU* make_relu(int batch_size, int input_dim) {
+    return make_relu_in(NULL, -1, batch_size, input_dim);
+}
+
 void relu(ReLU* layer, float* input) {
     _relu(input, layer->output, layer->batch_size*layer->input_dim);
 }
@@ -420,17 +887,25 @@ struct GELU {
     int input_dim;
 };
 
-GELU* make_gelu(int batch_size, int input_dim) {
-    size_t buffer_size = batch_size*input_dim*sizeof(float);
-    GELU* layer = calloc(1, sizeof(GELU) + buffer_size);
+LayerSize gelu_size(int batch_size, int input_dim) {
+    return (LayerSize){sizeof(GELU), batch_size*input_dim*sizeof(float), 0};
+}
+
+GELU* make_gelu_in(Arena* arena, int slot, int batch_size, int input_dim) {
+    void* buffer;
+    GELU* layer = layer_alloc(arena, slot, gelu_size(batch_size, input_dim), &buffer, NULL);
     *layer = (GELU){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .batch_size = batch_size,
         .input_dim = input_dim,
     };
     return layer;
 }
 
+GELU* make_gelu(int batch_size, int input_dim) {
+    return make_gelu_in(NULL, -1, batch_size, input_dim);
+}
+
 void gelu(GELU* layer, float* input) {
     _gelu(input, layer->output, layer->batch_size*layer->input_dim);
 }
@@ -445,9 +920,11 @@ struct MaxDim1 {
 
 MaxDim1* make_max_dim1(int batch_size, int seq_len, int feature_dim) {
     size_t buffer_size = batch_size*feature_dim*sizeof(float);
-    MaxDim1* layer = calloc(1, sizeof(MaxDim1) + buffer_size);
+    void* buffer;
+    MaxDim1* layer = layer_alloc(NULL, -1, (LayerSize){sizeof(MaxDim1), buffer_size, 0},
+        &buffer, NULL);
     *layer = (MaxDim1){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .batch_size = batch_size,
         .seq_len = seq_len,
         .feature_dim = feature_dim,
@@ -464,6 +941,9 @@ struct Conv2D {
     float* output;
     float* weights;
     float* bias;
+    float* col;
+    float* gemm_out;
+    int chunk;
     int batch_size;
     int in_width;
     int in_height;
@@ -473,15 +953,40 @@ struct Conv2D {
     int stride;
 };
 
-Conv2D* make_conv2d(Weights* weights, int batch_size, int in_width, int in_height,
+static size_t _conv2d_col_size(int chunk, int in_width, int in_height,
+        int in_channels, int kernel_size, int stride) {
+    int positions = ((in_height - kernel_size)/stride + 1)*((in_width - kernel_size)/stride + 1);
+    return (size_t)chunk*positions*in_channels*kernel_size*kernel_size*sizeof(float);
+}
+
+// Scratch for im2col is sized once here from the batch size
+LayerSize conv2d_size(int batch_size, int in_width, int in_height,
         int in_channels, int out_channels, int kernel_size, int stride) {
-    size_t buffer_size = batch_size*out_channels*in_height*in_width*sizeof(float);
+    int positions = ((in_height - kernel_size)/stride + 1)*((in_width - kernel_size)/stride + 1);
+    int chunk = _conv2d_chunk(batch_size, in_width, in_height, in_channels, kernel_size, stride);
+    size_t col_size = _conv2d_col_size(chunk, in_width, in_height, in_channels, kernel_size, stride);
+    size_t gemm_size = (size_t)chunk*positions*out_channels*sizeof(float);
+    return (LayerSize){sizeof(Conv2D),
+        batch_size*out_channels*in_height*in_width*sizeof(float), col_size + gemm_size};
+}
+
+Conv2D* make_conv2d_in(Arena* arena, int slot, Weights* weights, int batch_size,
+        int in_width, int in_height, int in_channels, int out_channels,
+        int kernel_size, int stride) {
     int num_weights = out_channels*in_channels*kernel_size*kernel_size;
-    Conv2D* layer = calloc(1, sizeof(Conv2D) + buffer_size);
+    int chunk = _conv2d_chunk(batch_size, in_width, in_height, in_channels, kernel_size, stride);
+    size_t col_size = _conv2d_col_size(chunk, in_width, in_height, in_channels, kernel_size, stride);
+    void* buffer;
+    void* scratch;
+    Conv2D* layer = layer_alloc(arena, slot, conv2d_size(batch_size, in_width, in_height,
+        in_channels, out_channels, kernel_size, stride), &buffer, &scratch);
     *layer = (Conv2D){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .weights = get_weights(weights, num_weights),
         .bias = get_weights(weights, out_channels),
+        .col = (float*)scratch,
+        .gemm_out = (float*)((char*)scratch + col_size),
+        .chunk = chunk,
         .batch_size = batch_size,
         .in_width = in_width,
         .in_height = in_height,
@@ -493,10 +998,17 @@ Conv2D* make_conv2d(Weights* weights, int batch_size, int in_width, int in_heigh
     return layer;
 }
 
+Conv2D* make_conv2d(Weights* weights, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    return make_conv2d_in(NULL, -1, weights, batch_size, in_width, in_height,
+        in_channels, out_channels, kernel_size, stride);
+}
+
 void conv2d(Conv2D* layer, float* input) {
-    _conv2d(input, layer->weights, layer->bias, layer->output,
-        layer->batch_size, layer->in_width, layer->in_height,
-        layer->in_channels, layer->out_channels, layer->kernel_size, layer->stride);
+    _conv2d_gemm(input, layer->weights, layer->bias, layer->output,
+        layer->col, layer->gemm_out, layer->chunk, layer->batch_size,
+        layer->in_width, layer->in_height, layer->in_channels,
+        layer->out_channels, layer->kernel_size, layer->stride);
 }
 
 typedef struct Conv3D Conv3D;
@@ -519,9 +1031,11 @@ Conv3D* make_conv3d(Weights* weights, int batch_size, int in_width, int in_heigh
     
     size_t buffer_size = batch_size*out_channels*in_depth*in_height*in_width*sizeof(float);
     int num_weights = out_channels*in_channels*kernel_size*kernel_size*kernel_size;
-    Conv3D* layer = calloc(1, sizeof(Conv3D) + buffer_size);
+    void* buffer;
+    Conv3D* layer = layer_alloc(NULL, -1, (LayerSize){sizeof(Conv3D), buffer_size, 0},
+        &buffer, NULL);
     *layer = (Conv3D){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .weights = get_weights(weights, num_weights),
         .bias = get_weights(weights, out_channels),
         .batch_size = batch_size,
@@ -550,36 +1064,82 @@ struct LSTM {
     float* weights_state;
     float* bias_input;
     float*bias_state;
+    float* weights_cat;
+    float* bias_cat;
+    float* zero_bias;
+    float* xh;
     float *buffer;
     int batch_size;
     int input_size;
     int hidden_size;
+    int max_seq_len;
 };
 
-LSTM* make_lstm(Weights* weights, int batch_size, int input_size, int hidden_size) {
+// The recurrent state is the buffer, so an LSTM never takes an activation slot
+LayerSize lstm_size(int batch_size, int input_size, int hidden_size, int max_seq_len) {
+    int state_size = batch_size*hidden_size;
+    int cat_size = input_size + hidden_size;
+    return (LayerSize){sizeof(LSTM), 2*state_size*sizeof(float),
+        (4*state_size*max_seq_len + batch_size*cat_size)*sizeof(float)};
+}
+
+// max_seq_len > 1 sizes the gate buffer for lstm_sequence. The stacked
+// weights are built once per Weights and shared by every instance
+LSTM* make_lstm_in(Arena* arena, Weights* weights, int batch_size, int input_size,
+        int hidden_size, int max_seq_len) {
     int state_size = batch_size*hidden_size;
-    LSTM* layer = calloc(1, sizeof(LSTM) + 6*state_size*sizeof(float));
-    float* buffer = (float*)(layer + 1);
+    int cat_size = input_size + hidden_size;
+    void* buffer;
+    void* scratch;
+    LSTM* layer = layer_alloc(arena, -1,
+        lstm_size(batch_size, input_size, hidden_size, max_seq_len), &buffer, &scratch);
+    bool fresh;
+    float* weights_cat = get_derived_weights(weights, weights->idx,
+        4*hidden_size*cat_size + 8*hidden_size, &fresh);
     *layer = (LSTM){
-        .state_h = buffer,
-        .state_c = buffer + state_size,
+        .state_h = (float*)buffer,
+        .state_c = (float*)buffer + state_size,
         .weights_input = get_weights(weights, 4*hidden_size*input_size),
         .weights_state = get_weights(weights, 4*hidden_size*hidden_size),
         .bias_input = get_weights(weights, 4*hidden_size),
         .bias_state = get_weights(weights, 4*hidden_size),
-        .buffer = buffer + 2*state_size,
+        .buffer = (float*)scratch,
+        .weights_cat = weights_cat,
+        .bias_cat = weights_cat + 4*hidden_size*cat_size,
+        .zero_bias = weights_cat + 4*hidden_size*cat_size + 4*hidden_size,
+        .xh = (float*)scratch + 4*state_size*max_seq_len,
         .batch_size = batch_size,
         .input_size = input_size,
         .hidden_size = hidden_size,
-
+        .max_seq_len = max_seq_len,
     };
+    if (fresh) {
+        _lstm_stack_weights(layer->weights_input, layer->weights_state, layer->bias_input,
+            layer->bias_state, layer->weights_cat, layer->bias_cat, input_size, hidden_size);
+    }
     return layer;
 }
 
+LSTM* make_lstm_sequence(Weights* weights, int batch_size, int input_size,
+        int hidden_size, int max_seq_len) {
+    return make_lstm_in(NULL, weights, batch_size, input_size, hidden_size, max_seq_len);
+}
+
+LSTM* make_lstm(Weights* weights, int batch_size, int input_size, int hidden_size) {
+    return make_lstm_in(NULL, weights, batch_size, input_size, hidden_size, 1);
+}
+
 void lstm(LSTM* layer, float* input) {
-    _lstm(input, layer->state_h, layer->state_c, layer->weights_input,
-        layer->weights_state, layer->bias_input, layer->bias_state,
-        layer->buffer, layer->batch_size, layer->input_size, layer->hidden_size);
+    _lstm_fused(input, layer->state_h, layer->state_c, layer->weights_cat,
+        layer->bias_cat, layer->xh, layer->buffer, layer->batch_size,
+        layer->input_size, layer->hidden_size);
+}
+
+void lstm_sequence(LSTM* layer, float* input, float* output, int seq_len) {
+    assert(seq_len <= layer->max_seq_len);
+    _lstm_sequence(input, layer->state_h, layer->state_c, layer->weights_input,
+        layer->weights_state, layer->bias_cat, layer->zero_bias, layer->buffer,
+        output, layer->batch_size, layer->input_size, layer->hidden_size, seq_len);
 }
 
 typedef struct Embedding Embedding;
@@ -593,9 +1153,11 @@ struct Embedding {
 
 Embedding* make_embedding(Weights* weights, int batch_size, int num_embeddings, int embedding_dim) {
     size_t output_size = batch_size*embedding_dim*sizeof(float);
-    Embedding* layer = (Embedding*)calloc(1, sizeof(Embedding) + batch_size + output_size);
+    void* buffer;
+    Embedding* layer = layer_alloc(NULL, -1,
+        (LayerSize){sizeof(Embedding), batch_size + output_size, 0}, &buffer, NULL);
     *layer = (Embedding){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .weights = get_weights(weights, num_embeddings*embedding_dim),
         .batch_size = batch_size,
         .num_embeddings = num_embeddings,
@@ -619,9 +1181,11 @@ struct LayerNorm {
 
 LayerNorm* make_layernorm(Weights* weights, int batch_size, int input_dim) {
     size_t output_size = batch_size*input_dim*sizeof(float);
-    LayerNorm* layer = calloc(1, sizeof(LayerNorm) + output_size);
+    void* buffer;
+    LayerNorm* layer = layer_alloc(NULL, -1, (LayerSize){sizeof(LayerNorm), output_size, 0},
+        &buffer, NULL);
     *layer = (LayerNorm){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .weights = get_weights(weights, input_dim),
         .bias = get_weights(weights, input_dim),
         .batch_size = batch_size,
@@ -645,9 +1209,11 @@ struct OneHot {
 
 OneHot* make_one_hot(int batch_size, int input_size, int num_classes) {
     size_t buffer_size = batch_size*input_size*num_classes*sizeof(int);
-    OneHot* layer = calloc(1, sizeof(OneHot) + buffer_size);
+    void* buffer;
+    OneHot* layer = layer_alloc(NULL, -1, (LayerSize){sizeof(OneHot), buffer_size, 0},
+        &buffer, NULL);
     *layer = (OneHot){
-        .output = (int*)(layer + 1),
+        .output = (int*)buffer,
         .batch_size = batch_size,
         .input_size = input_size,
         .num_classes = num_classes,
@@ -669,9 +1235,11 @@ struct CatDim1 {
 
 CatDim1* make_cat_dim1(int batch_size, int x_size, int y_size) {
     size_t buffer_size = batch_size*(x_size + y_size)*sizeof(float);
-    CatDim1* layer = calloc(1, sizeof(CatDim1) + buffer_size);
+    void* buffer;
+    CatDim1* layer = layer_alloc(NULL, -1, (LayerSize){sizeof(CatDim1), buffer_size, 0},
+        &buffer, NULL);
     *layer = (CatDim1){
-        .output = (float*)(layer + 1),
+        .output = (float*)buffer,
         .batch_size = batch_size,
         .x_size = x_size,
         .y_size = y_size,
@@ -690,14 +1258,19 @@ struct Multidiscrete {
     int num_actions;
 };
 
-Multidiscrete* make_multidiscrete(int batch_size, int logit_sizes[], int num_actions) {
-    Multidiscrete* layer = calloc(1, sizeof(Multidiscrete));
+Multidiscrete* make_multidiscrete_in(Arena* arena, int batch_size, int logit_sizes[], int num_actions) {
+    Multidiscrete* layer = layer_alloc(arena, -1, (LayerSize){sizeof(Multidiscrete), 0, 0},
+        NULL, NULL);
     layer->batch_size = batch_size;
     layer->num_actions = num_actions;
     memcpy(layer->logit_sizes, logit_sizes, num_actions*sizeof(int));
     return layer;
 }
 
+Multidiscrete* make_multidiscrete(int batch_size, int logit_sizes[], int num_actions) {
+    return make_multidiscrete_in(NULL, batch_size, logit_sizes, num_actions);
+}
+
 void argmax_multidiscrete(Multidiscrete* layer, float* input, int* output) {
     _argmax_multidiscrete(input, output, layer->batch_size, layer->logit_sizes, layer->num_actions);
 }
@@ -710,6 +1283,7 @@ void softmax_multidiscrete(Multidiscrete* layer, float* input, int* output) {
 
 typedef struct Default Default;
 struct Default {
+    Arena* arena;
     int num_agents;
     float* obs;
     Linear* encoder;
@@ -719,27 +1293,38 @@ struct Default {
     Multidiscrete* multidiscrete;
 };
 
+static void plan_default(Arena* plan, int num_agents, int input_dim, int hidden_dim, int action_dim) {
+    arena_plan(plan, -1, (LayerSize){sizeof(Default), num_agents*input_dim*sizeof(float), 0});
+    arena_plan(plan, 0, linear_size(num_agents, input_dim, hidden_dim));
+    arena_plan(plan, 0, relu_size(num_agents, hidden_dim));
+    arena_plan(plan, -1, linear_size(num_agents, hidden_dim, action_dim));
+    arena_plan(plan, -1, linear_size(num_agents, hidden_dim, 1));
+    arena_plan(plan, -1, (LayerSize){sizeof(Multidiscrete), 0, 0});
+}
+
+// The whole model is a single arena allocation, sized before it is built
 Default* make_default(Weights* weights, int num_agents, int input_dim, int hidden_dim, int action_dim) {
-    Default* net = calloc(1, sizeof(Default));
+    Arena plan = {0};
+    plan_default(&plan, num_agents, input_dim, hidden_dim, action_dim);
+    Arena* arena = make_model_arena(&plan);
+    void* obs;
+    Default* net = layer_alloc(arena, -1,
+        (LayerSize){sizeof(Default), num_agents*input_dim*sizeof(float), 0}, &obs, NULL);
+    net->arena = arena;
     net->num_agents = num_agents;
-    net->obs = (float*)calloc(num_agents*input_dim, sizeof(float));
-    net->encoder = make_linear(weights, num_agents, input_dim, hidden_dim);
-    net->relu1 = make_relu(num_agents, hidden_dim);
-    net->actor = make_linear(weights, num_agents, hidden_dim, action_dim);
-    net->value_fn = make_linear(weights, num_agents, hidden_dim, 1);
+    net->obs = (float*)obs;
+    net->encoder = make_linear_in(arena, 0, weights, num_agents, input_dim, hidden_dim);
+    net->relu1 = make_relu_in(arena, 0, num_agents, hidden_dim);
+    net->actor = make_linear_in(arena, -1, weights, num_agents, hidden_dim, action_dim);
+    net->value_fn = make_linear_in(arena, -1, weights, num_agents, hidden_dim, 1);
     int logit_sizes[1] = {action_dim};
-    net->multidiscrete = make_multidiscrete(num_agents, logit_sizes, 1);
+    net->multidiscrete = make_multidiscrete_in(arena, num_agents, logit_sizes, 1);
+    assert(arena->used == arena->capacity);
     return net;
 }
 
 void free_default(Default* net) {
-    free(net->obs);
-    free(net->encoder);
-    free(net->relu1);
-    free(net->actor);
-    free(net->value_fn);
-    free(net->multidiscrete);
-    free(net);
+    free(net->arena);
 }
 
 void forward_default(Default* net, float* observations, int* actions) {
@@ -752,6 +1337,7 @@ void forward_default(Default* net, float* observations, int* actions) {
 
 typedef struct LinearLSTM LinearLSTM;
 struct LinearLSTM {
+    Arena* arena;
     int num_agents;
     float* obs;
     Linear* encoder;
@@ -762,32 +1348,42 @@ struct LinearLSTM {
     Multidiscrete* multidiscrete;
 };
 
+static void plan_linearlstm(Arena* plan, int num_agents, int input_dim, int atn_sum) {
+    arena_plan(plan, -1, (LayerSize){sizeof(LinearLSTM), num_agents*input_dim*sizeof(float), 0});
+    arena_plan(plan, 0, linear_size(num_agents, input_dim, 128));
+    arena_plan(plan, 0, gelu_size(num_agents, 128));
+    arena_plan(plan, -1, linear_size(num_agents, 128, atn_sum));
+    arena_plan(plan, -1, linear_size(num_agents, 128, 1));
+    arena_plan(plan, -1, lstm_size(num_agents, 128, 128, 1));
+    arena_plan(plan, -1, (LayerSize){sizeof(Multidiscrete), 0, 0});
+}
+
 LinearLSTM* make_linearlstm(Weights* weights, int num_agents, int input_dim, int logit_sizes[], int num_actions) {
-    LinearLSTM* net = calloc(1, sizeof(LinearLSTM));
-    net->num_agents = num_agents;
-    net->obs = calloc(num_agents*input_dim, sizeof(float));
-    net->encoder = make_linear(weights, num_agents, input_dim, 128);
-    net->gelu1 = make_gelu(num_agents, 128);
     int atn_sum = 0;
     for (int i = 0; i < num_actions; i++) {
         atn_sum += logit_sizes[i];
     }
-    net->actor = make_linear(weights, num_agents, 128, atn_sum);
-    net->value_fn = make_linear(weights, num_agents, 128, 1);
-    net->lstm = make_lstm(weights, num_agents, 128, 128);
-    net->multidiscrete = make_multidiscrete(num_agents, logit_sizes, num_actions);
+    Arena plan = {0};
+    plan_linearlstm(&plan, num_agents, input_dim, atn_sum);
+    Arena* arena = make_model_arena(&plan);
+    void* obs;
+    LinearLSTM* net = layer_alloc(arena, -1,
+        (LayerSize){sizeof(LinearLSTM), num_agents*input_dim*sizeof(float), 0}, &obs, NULL);
+    net->arena = arena;
+    net->num_agents = num_agents;
+    net->obs = (float*)obs;
+    net->encoder = make_linear_in(arena, 0, weights, num_agents, input_dim, 128);
+    net->gelu1 = make_gelu_in(arena, 0, num_agents, 128);
+    net->actor = make_linear_in(arena, -1, weights, num_agents, 128, atn_sum);
+    net->value_fn = make_linear_in(arena, -1, weights, num_agents, 128, 1);
+    net->lstm = make_lstm_in(arena, weights, num_agents, 128, 128, 1);
+    net->multidiscrete = make_multidiscrete_in(arena, num_agents, logit_sizes, num_actions);
+    assert(arena->used == arena->capacity);
     return net;
 }
 
 void free_linearlstm(LinearLSTM* net) {
-    free(net->obs);
-    free(net->encoder);
-    free(net->gelu1);
-    free(net->actor);
-    free(net->value_fn);
-    free(net->lstm);
-    free(net->multidiscrete);
-    free(net);
+    free(net->arena);
 }
 
 void forward_linearlstm(LinearLSTM* net, float* observations, int* actions) {
@@ -800,6 +1396,7 @@ void forward_linearlstm(LinearLSTM* net, float* observations, int* actions) {
 }
 
 typedef struct ConvLSTM ConvLSTM; struct ConvLSTM {
+    Arena* arena;
     int num_agents;
     float* obs;
     Conv2D* conv1;
@@ -813,37 +1410,52 @@ typedef struct ConvLSTM ConvLSTM; struct ConvLSTM {
     Multidiscrete* multidiscrete;
 };
 
+static void plan_convlstm(Arena* plan, int num_agents, int input_dim,
+        int input_channels, int cnn_channels, int hidden_dim, int action_dim) {
+    arena_plan(plan, -1, (LayerSize){sizeof(ConvLSTM),
+        num_agents*input_dim*input_dim*input_channels*sizeof(float), 0});
+    arena_plan(plan, 0, conv2d_size(num_agents, input_dim, input_dim,
+        input_channels, cnn_channels, 5, 3));
+    arena_plan(plan, 0, relu_size(num_agents, hidden_dim*3*3));
+    arena_plan(plan, 1, conv2d_size(num_agents, 3, 3, cnn_channels, cnn_channels, 3, 1));
+    arena_plan(plan, 1, relu_size(num_agents, hidden_dim));
+    arena_plan(plan, 0, linear_size(num_agents, cnn_channels, hidden_dim));
+    arena_plan(plan, -1, linear_size(num_agents, hidden_dim, action_dim));
+    arena_plan(plan, -1, linear_size(num_agents, hidden_dim, 1));
+    arena_plan(plan, -1, lstm_size(num_agents, hidden_dim, hidden_dim, 1));
+    arena_plan(plan, -1, (LayerSize){sizeof(Multidiscrete), 0, 0});
+}
+
 ConvLSTM* make_convlstm(Weights* weights, int num_agents, int input_dim,
         int input_channels, int cnn_channels, int hidden_dim, int action_dim) {
-    ConvLSTM* net = calloc(1, sizeof(ConvLSTM));
+    Arena plan = {0};
+    plan_convlstm(&plan, num_agents, input_dim, input_channels, cnn_channels,
+        hidden_dim, action_dim);
+    Arena* arena = make_model_arena(&plan);
+    void* obs;
+    ConvLSTM* net = layer_alloc(arena, -1, (LayerSize){sizeof(ConvLSTM),
+        num_agents*input_dim*input_dim*input_channels*sizeof(float), 0}, &obs, NULL);
+    net->arena = arena;
     net->num_agents = num_agents;
-    net->obs = calloc(num_agents*input_dim*input_dim*input_channels, sizeof(float));
-    net->conv1 = make_conv2d(weights, num_agents, input_dim,
+    net->obs = (float*)obs;
+    net->conv1 = make_conv2d_in(arena, 0, weights, num_agents, input_dim,
         input_dim, input_channels, cnn_channels, 5, 3);
-    net->relu1 = make_relu(num_agents, hidden_dim*3*3);
-    net->conv2 = make_conv2d(weights, num_agents, 3, 3, cnn_channels, cnn_channels, 3, 1);
-    net->relu2 = make_relu(num_agents, hidden_dim);
-    net->linear = make_linear(weights, num_agents, cnn_channels, hidden_dim);
-    net->actor = make_linear(weights, num_agents, hidden_dim, action_dim);
-    net->value_fn = make_linear(weights, num_agents, hidden_dim, 1);
-    net->lstm = make_lstm(weights, num_agents, hidden_dim, hidden_dim);
+    net->relu1 = make_relu_in(arena, 0, num_agents, hidden_dim*3*3);
+    net->conv2 = make_conv2d_in(arena, 1, weights, num_agents, 3, 3,
+        cnn_channels, cnn_channels, 3, 1);
+    net->relu2 = make_relu_in(arena, 1, num_agents, hidden_dim);
+    net->linear = make_linear_in(arena, 0, weights, num_agents, cnn_channels, hidden_dim);
+    net->actor = make_linear_in(arena, -1, weights, num_agents, hidden_dim, action_dim);
+    net->value_fn = make_linear_in(arena, -1, weights, num_agents, hidden_dim, 1);
+    net->lstm = make_lstm_in(arena, weights, num_agents, hidden_dim, hidden_dim, 1);
     int logit_sizes[1] = {action_dim};
-    net->multidiscrete = make_multidiscrete(num_agents, logit_sizes, 1);
+    net->multidiscrete = make_multidiscrete_in(arena, num_agents, logit_sizes, 1);
+    assert(arena->used == arena->capacity);
     return net;
 }
 
 void free_convlstm(ConvLSTM* net) {
-    free(net->obs);
-    free(net->conv1);
-    free(net->relu1);
-    free(net->conv2);
-    free(net->relu2);
-    free(net->linear);
-    free(net->actor);
-    free(net->value_fn);
-    free(net->lstm);
-    free(net->multidiscrete);
-    free(net);
+    free(net->arena);
 }
 
 void forward_convlstm(ConvLSTM* net, float* observations, int* actions) {
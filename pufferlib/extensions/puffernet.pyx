@@ -30,6 +30,15 @@ cdef extern from "puffernet.h":
     void _lstm(float* input, float* state_h, float* state_c, float* weights_input,
         float* weights_state, float* bias_input, float*bias_state,
         float *buffer, int batch_size, int input_size, int hidden_size)
+    void _lstm_fused(float* input, float* state_h, float* state_c, float* weights_cat,
+        float* bias_cat, float* xh, float* buffer, int batch_size,
+        int input_size, int hidden_size)
+    void _lstm_stack_weights(float* weights_input, float* weights_state, float* bias_input,
+        float* bias_state, float* weights_cat, float* bias_cat, int input_size, int hidden_size)
+    void _lstm_sequence(float* input, float* state_h, float* state_c,
+        float* weights_input, float* weights_state, float* bias_cat,
+        float* zero_bias, float* buffer, float* output, int batch_size,
+        int input_size, int hidden_size, int seq_len)
     void _layernorm(float* input, float* weights, float* bias, float* output,
         int batch_size, int input_size)
     void _one_hot(int* input, int* output, int batch_size,
@@ -71,6 +80,31 @@ def puf_lstm(cnp.ndarray input, cnp.ndarray state_h, cnp.ndarray state_c, cnp.nd
         <float*> weights_input.data, <float*> weights_state.data, <float*> bias_input.data,
         <float*> bias_state.data, <float*> buffer.data, batch_size, input_size, hidden_size)
 
+def puf_lstm_fused(cnp.ndarray input, cnp.ndarray state_h, cnp.ndarray state_c, cnp.ndarray weights_input,
+        cnp.ndarray weights_state, cnp.ndarray bias_input, cnp.ndarray bias_state,
+        cnp.ndarray buffer, int batch_size, int input_size, int hidden_size):
+    cdef cnp.ndarray weights_cat = np.zeros((4*hidden_size, input_size + hidden_size), dtype=np.float32)
+    cdef cnp.ndarray bias_cat = np.zeros(4*hidden_size, dtype=np.float32)
+    cdef cnp.ndarray xh = np.zeros((batch_size, input_size + hidden_size), dtype=np.float32)
+    _lstm_stack_weights(<float*> weights_input.data, <float*> weights_state.data,
+        <float*> bias_input.data, <float*> bias_state.data, <float*> weights_cat.data,
+        <float*> bias_cat.data, input_size, hidden_size)
+    _lstm_fused(<float*> input.data, <float*> state_h.data, <float*> state_c.data,
+        <float*> weights_cat.data, <float*> bias_cat.data, <float*> xh.data,
+        <float*> buffer.data, batch_size, input_size, hidden_size)
+
+def puf_lstm_sequence(cnp.ndarray input, cnp.ndarray state_h, cnp.ndarray state_c,
+        cnp.ndarray weights_input, cnp.ndarray weights_state, cnp.ndarray bias_input,
+        cnp.ndarray bias_state, cnp.ndarray output, int batch_size, int input_size,
+        int hidden_size, int seq_len):
+    cdef cnp.ndarray bias_cat = (bias_input + bias_state).astype(np.float32)
+    cdef cnp.ndarray zero_bias = np.zeros(4*hidden_size, dtype=np.float32)
+    cdef cnp.ndarray buffer = np.zeros((seq_len, batch_size, 4*hidden_size), dtype=np.float32)
+    _lstm_sequence(<float*> input.data, <float*> state_h.data, <float*> state_c.data,
+        <float*> weights_input.data, <float*> weights_state.data, <float*> bias_cat.data,
+        <float*> zero_bias.data, <float*> buffer.data, <float*> output.data,
+        batch_size, input_size, hidden_size, seq_len)
+
 def puf_embedding(cnp.ndarray input, cnp.ndarray weights, cnp.ndarray output,
         int batch_size, int num_embeddings, int embedding_dim):
     _embedding(<int*> input.data, <float*> weights.data, <float*> output.data,
@@ -28,7 +28,10 @@ int main() {
         .num_agents = 1024,
         .num_armies = 8,
     };
-    init(&env);
+    if (!init(&env)) {
+        fprintf(stderr, "Failed to allocate the neighbor grid\n");
+        return 1;
+    }
 
     // Allocate these manually since they aren't being passed from Python
     int num_obs = 3*env.num_armies + 4*16 + 22 + 8;
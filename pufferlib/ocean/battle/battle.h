@@ -14,6 +14,8 @@
 #include "raymath.h"
 #include "rlgl.h"
 #include "simplex.h"
+#include "../puffer_rand.h"
+#include "../spatial_grid.h"
 
 #define RLIGHTS_IMPLEMENTATION
 #include "rlights.h"
@@ -65,12 +67,12 @@ float clip_angle(float theta) {
     return theta;
 }
 
-float randf(float min, float max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randf(uint64_t* rng, float min, float max) {
+    return min + (max - min)*puffer_randf(rng);
 }
 
-float randi(int min, int max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randi(uint64_t* rng, int min, int max) {
+    return min + (max - min)*puffer_randf(rng);
 }
 
 typedef struct {
@@ -120,6 +122,7 @@ typedef struct {
 
 typedef struct {
     Log log;
+    uint64_t rng;
     Client* client;
     Entity* agents;
     Entity* bases;
@@ -137,6 +140,12 @@ typedef struct {
     int num_agents;
     int num_armies;
     float* terrain;
+    // Agents are refiled as they move, so queries see current positions.
+    // naive_neighbors makes observations, scripted moves and attacks scan
+    // all agents instead, which gives the same results and is kept for testing
+    SpatialGrid grid;
+    int* grid_hits;
+    int naive_neighbors;
 } Battle;
 
 int map_idx(Battle* env, float x, float y) {
@@ -197,13 +206,49 @@ void perlin_noise(float* map, int width, int height,
     }
 }
 
-void init(Battle* env) {
+// Returns false if the neighbor grid cannot be allocated
+bool init(Battle* env) {
     env->agents = calloc(env->num_agents, sizeof(Entity));
     env->bases = calloc(env->num_armies, sizeof(Entity));
     env->terrain_width = 256*env->size_x;
     env->terrain_height = 256*env->size_z;
     env->terrain = calloc(env->terrain_width*env->terrain_height, sizeof(float));
     perlin_noise(env->terrain, env->terrain_width, env->terrain_height, 1.0/2048.0, 8, 0, 0, 256);
+
+    // Roughly cubic cells, about two agents per cell if spread evenly
+    float lo[3] = {-env->size_x, -env->size_y, -env->size_z};
+    float hi[3] = {env->size_x, env->size_y, env->size_z};
+    float volume = 8.0f*env->size_x*env->size_y*env->size_z;
+    float side = cbrtf(volume / (env->num_agents/2.0f));
+    int dims[3];
+    for (int d=0; d<3; d++) {
+        dims[d] = (hi[d] - lo[d]) / side;
+        dims[d] = (dims[d] < 1) ? 1 : (dims[d] > 64) ? 64 : dims[d];
+    }
+    if (!grid_init(&env->grid, lo, hi, dims, env->num_agents)) {
+        return false;
+    }
+    env->grid_hits = calloc(env->num_agents, sizeof(int));
+    return env->grid_hits != NULL;
+}
+
+void build_grid(Battle* env) {
+    grid_build(&env->grid, &env->agents[0].x, sizeof(Entity), env->num_agents);
+}
+
+typedef struct {
+    Entity* agents;
+    int army;
+} ArmyFilter;
+
+bool skip_allies(void* ctx, int idx) {
+    ArmyFilter* filter = ctx;
+    return filter->agents[idx].army == filter->army;
+}
+
+bool skip_enemies(void* ctx, int idx) {
+    ArmyFilter* filter = ctx;
+    return filter->agents[idx].army != filter->army;
 }
 
 void update_abilities(Entity* agent) {
@@ -401,6 +446,21 @@ bool attack_aa(Entity *agent, Entity *target) {
     if (angle < PI/6) {
         return true;
     }
+    return false;
+}
+
+bool can_attack(Entity* agent, Entity* target) {
+    if (agent->army == target->army) {
+        return false;
+    }
+    if (agent->unit == INFANTRY || agent->unit == TANK) {
+        return attack_ground(agent, target);
+    } else if (agent->unit == ARTILLERY) {
+        return attack_aa(agent, target);
+    } else if (agent->unit == BOMBER) {
+        return attack_bomber(agent, target);
+    }
+    return attack_air(agent, target);
 }
 
 void move_basic(Battle* env, Entity* agent, float* actions) {
@@ -448,24 +508,55 @@ void move_ground(Battle* env, Entity* agent, float* actions) {
     agent->y = ground_height(env, agent->x, agent->z);
 }
 
-Entity* nearest_enemy(Battle* env, Entity* agent) {
-    Entity* nearest = NULL;
-    float nearest_dist = 999999;
-    for (int i=0; i<env->num_agents; i++) {
-        Entity* other = &env->agents[i];
-        if (other->army == agent->army) {
-            continue;
+// Writes up to k nearest allies or enemies of agent, nearest first. Ties go
+// to the lower index in both paths
+int nearest_agents(Battle* env, Entity* agent, bool same_team, int k,
+        int* out_idx, float* out_dist) {
+    if (!env->naive_neighbors) {
+        ArmyFilter filter = {env->agents, agent->army};
+        return grid_knn(&env->grid, &env->agents[0].x, sizeof(Entity),
+            agent->x, agent->y, agent->z, k, out_idx, out_dist,
+            same_team ? skip_enemies : skip_allies, &filter);
+    }
+
+    // Each full scan takes the nearest agent ranked after the previous pick
+    int n = 0;
+    for (; n<k; n++) {
+        int best = -1;
+        float best_dist = FLT_MAX;
+        for (int i=0; i<env->num_agents; i++) {
+            Entity* other = &env->agents[i];
+            if ((other->army == agent->army) != same_team) {
+                continue;
+            }
+            float dx = other->x - agent->x;
+            float dy = other->y - agent->y;
+            float dz = other->z - agent->z;
+            float dd = dx*dx + dy*dy + dz*dz;
+            if (n > 0 && (dd < out_dist[n-1] || (dd == out_dist[n-1] && i <= out_idx[n-1]))) {
+                continue;
+            }
+            if (best == -1 || dd < best_dist) {
+                best = i;
+                best_dist = dd;
+            }
         }
-        float dx = other->x - agent->x;
-        float dy = other->y - agent->y;
-        float dz = other->z - agent->z;
-        float dd = dx*dx + dy*dy + dz*dz;
-        if (dd < nearest_dist) {
-            nearest_dist = dd;
-            nearest = other;
+        if (best == -1) {
+            break;
         }
+        out_idx[n] = best;
+        out_dist[n] = best_dist;
     }
-    return nearest;
+    return n;
+}
+
+Entity* nearest_enemy(Battle* env, Entity* agent) {
+    int idx;
+    float dist;
+    if (nearest_agents(env, agent, false, 1, &idx, &dist) == 0) {
+        return NULL;
+    }
+    return &env->agents[idx];
 }
 
 // Cheats physics and moves directly to the nearest enemy
@@ -479,9 +570,9 @@ void scripted_move(Battle* env, Entity* agent, bool is_air) {
     float dz = target->z - agent->z;
 
     // Add some noise
-    dx += randf(-0.1f, 0.1f);
-    dy += randf(-0.1f, 0.1f);
-    dz += randf(-0.1f, 0.1f);
+    dx += randf(&env->rng, -0.1f, 0.1f);
+    dy += randf(&env->rng, -0.1f, 0.1f);
+    dz += randf(&env->rng, -0.1f, 0.1f);
 
     float dd = dx*dx + dz*dz;
     if (is_air) {
@@ -610,28 +701,9 @@ void move_ship(Battle* env, Entity* agent, float* actions, int i) {
     agent->z = clampf(agent->z, -env->size_z, env->size_z);
 }
 
-typedef struct {
-    float distance;
-    float dx;
-    float dy;
-    float dz;
-    float same_team;
-    int idx;
-} AgentObs;
-
-int compare_agent_obs(const void* a, const void* b) {
-    AgentObs* oa = (AgentObs*)a;
-    AgentObs* ob = (AgentObs*)b;
-    if (oa->distance < ob->distance) {
-        return -1;
-    } else if (oa->distance > ob->distance) {
-        return 1;
-    }
-    return 0;
-}
-
 void compute_observations(Battle* env) {
-    AgentObs agent_obs[env->num_agents];
+    int near_idx[AGENT_OBS];
+    float near_dist[AGENT_OBS];
 
     int obs_idx = 0;
     for (int a=0; a<env->num_agents/2; a++) {
@@ -661,37 +733,22 @@ void compute_observations(Battle* env) {
         obs_idx += 3*env->num_armies;
 
 
-        // Distance to each agent. Slow O(n^2) naive implementation
-        float x = agent->x;
-        float y = agent->y;
-        float z = agent->z;
-        for (int i=0; i<env->num_agents; i++) {
-            Entity* other = &env->agents[i];
-            float dx = other->x - x;
-            float dy = other->y - y;
-            float dz = other->z - z;
-            float distance = dx*dx + dy*dy + dz*dz;
-            AgentObs* o = &agent_obs[i];
-            o->dx = dx;
-            o->dy = dy;
-            o->dz = dz;
-            if (other->army == agent->army) {
-                o->same_team = 1.0f;
-                o->distance = 99999.0f;
-            } else {
-                o->same_team = 0.0f;
-                o->distance = distance;
+        // Nearest enemies first, then nearest allies if there are not enough
+        int found = 0;
+        for (int same_team=0; same_team<2 && found<AGENT_OBS; same_team++) {
+            int n = nearest_agents(env, agent, same_team, AGENT_OBS - found,
+                near_idx, near_dist);
+            for (int i=0; i<n; i++) {
+                Entity* other = &env->agents[near_idx[i]];
+                env->observations[obs_idx++] = other->x - agent->x;
+                env->observations[obs_idx++] = other->y - agent->y;
+                env->observations[obs_idx++] = other->z - agent->z;
+                env->observations[obs_idx++] = same_team;
             }
-            o->idx = i;
-        }
-        qsort(agent_obs, env->num_agents, sizeof(AgentObs), compare_agent_obs);
-
-        for (int i=0; i<AGENT_OBS; i++) {
-            env->observations[obs_idx++] = agent_obs[i].dx;
-            env->observations[obs_idx++] = agent_obs[i].dy;
-            env->observations[obs_idx++] = agent_obs[i].dz;
-            env->observations[obs_idx++] = agent_obs[i].same_team;
+            found += n;
         }
+        memset(&env->observations[obs_idx], 0, 4*(AGENT_OBS - found)*sizeof(float));
+        obs_idx += 4*(AGENT_OBS - found);
 
         // Individual agent stats
         env->observations[obs_idx++] = agent->vx/MAX_SPEED;
@@ -731,8 +788,8 @@ void c_reset(Battle* env) {
         bool spawn = false;
         Entity* base = &env->bases[i];
         while (!spawn) {
-            base->x = randf(0.5 - env->size_x, env->size_x - 0.5);
-            base->z = randf(0.5 - env->size_z, env->size_z - 0.5);
+            base->x = randf(&env->rng, 0.5 - env->size_x, env->size_x - 0.5);
+            base->z = randf(&env->rng, 0.5 - env->size_z, env->size_z - 0.5);
             base->y = ground_height(env, base->x, base->z);
             base->army = i;
             spawn = true;
@@ -778,6 +835,7 @@ void c_reset(Battle* env) {
             respawn(env, idx);
         }
     }
+    build_grid(env);
     compute_observations(env);
 }
 
@@ -850,42 +908,53 @@ void c_step(Battle* env) {
                 scripted_move(env, agent, true);
             }
         }
+        grid_move(&env->grid, i, agent->x, agent->y, agent->z);
     }
 
     for (int i=0; i<env->num_agents; i++) {
         Entity* agent = &env->agents[i];
-        for (int j=0; j<env->num_agents; j++) {
-            if (j == i) {
-                continue;
-            }
-            Entity* target = &env->agents[j];
-            if (agent->army == target->army) {
-                continue;
-            }
-            bool can_attack = false;
-            if (agent->unit == INFANTRY || agent->unit == TANK) {
-                can_attack = attack_ground(agent, target);
-            } else if (agent->unit == ARTILLERY) {
-                can_attack = attack_aa(agent, target);
-            } else if (agent->unit == BOMBER) {
-                can_attack = attack_bomber(agent, target);
-            } else {
-                can_attack = attack_air(agent, target);
-            }
-            if (!can_attack) {
-                continue;
+
+        // Lowest index valid target. The grid path only tests units inside
+        // the attacker's range box
+        int j = -1;
+        if (env->naive_neighbors) {
+            for (int k=0; k<env->num_agents && j == -1; k++) {
+                if (k != i && can_attack(agent, &env->agents[k])) {
+                    j = k;
+                }
             }
-            agent->target = j;
-            if (i < env->num_agents/2) {
-                env->rewards[i] += 0.25f;
-                agent->episode_return += 0.25f;
+        } else {
+            // Every attack has a range. Only air attacks are limited in height
+            bool air = !(agent->unit == INFANTRY || agent->unit == TANK
+                || agent->unit == ARTILLERY || agent->unit == BOMBER);
+            float r = agent->attack_range;
+            float lo[3] = {agent->x - r, air ? agent->y - r : -env->size_y, agent->z - r};
+            float hi[3] = {agent->x + r, air ? agent->y + r : env->size_y, agent->z + r};
+            int hits = grid_query_box(&env->grid, lo, hi, env->grid_hits, env->num_agents);
+            assert(hits <= env->num_agents);
+            for (int h=0; h<hits; h++) {
+                int k = env->grid_hits[h];
+                if (k == i || (j != -1 && k > j)) {
+                    continue;
+                }
+                if (can_attack(agent, &env->agents[k])) {
+                    j = k;
+                }
             }
-            target->health -= agent->attack_damage;
-            break;
         }
+        if (j == -1) {
+            continue;
+        }
+        Entity* target = &env->agents[j];
+        agent->target = j;
+        if (i < env->num_agents/2) {
+            env->rewards[i] += 0.25f;
+            agent->episode_return += 0.25f;
+        }
+        target->health -= agent->attack_damage;
     }
 
-    if (rand() % 9000 == 0) {
+    if (puffer_rand(&env->rng) % 9000 == 0) {
         c_reset(env);
     }
 
@@ -1190,6 +1259,8 @@ void c_render(Battle* env) {
 void c_close(Battle* env) {
     free(env->agents);
     free(env->bases);
+    free(env->grid_hits);
+    grid_free(&env->grid);
     if (env->client != NULL) {
         Client* client = env->client;
         //UnloadTexture(client->sprites);
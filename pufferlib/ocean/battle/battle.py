@@ -9,7 +9,8 @@ from pufferlib.ocean.battle import binding
 class Battle(pufferlib.PufferEnv):
     def __init__(self, num_envs=1, width=1920, height=1080, size_x=1.0,
             size_y=1.0, size_z=1.0, num_agents=1024, num_factories=32,
-            num_armies=4, render_mode=None, log_interval=128, buf=None, seed=0):
+            num_armies=4, render_mode=None, log_interval=128, buf=None, seed=0,
+            naive_neighbors=False):
         self.single_observation_space = gymnasium.spaces.Box(low=0, high=1,
             shape=(num_armies*3 + 4*16 + 22 + 8,), dtype=np.float32)
         self.single_action_space = gymnasium.spaces.Box(
@@ -34,7 +35,7 @@ class Battle(pufferlib.PufferEnv):
                 self.truncations[i*num_agents:(i+1)*num_agents],
                 seed, width=width, height=height, size_x=size_x, size_y=size_y, size_z=size_z,
                 num_agents=num_agents*2, num_factories=num_factories,
-                num_armies=num_armies)
+                num_armies=num_armies, naive_neighbors=naive_neighbors)
             c_envs.append(c_env)
 
         self.c_envs = binding.vectorize(*c_envs)
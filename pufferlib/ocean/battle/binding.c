@@ -11,7 +11,11 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->size_z = unpack(kwargs, "size_z");
     env->num_agents = unpack(kwargs, "num_agents");
     env->num_armies = unpack(kwargs, "num_armies");
-    init(env);
+    env->naive_neighbors = unpack(kwargs, "naive_neighbors");
+    if (!init(env)) {
+        PyErr_NoMemory();
+        return -1;
+    }
     return 0;
 }
 
@@ -37,6 +37,7 @@ int demo() {
     Client* client = make_client(&env);
     unsigned int seed = 12345;
     srand(seed);
+    puffer_seed(&env.rng, seed);
     c_reset(&env);
     int running = 1;
     while (running) {
@@ -52,7 +53,7 @@ int demo() {
         }
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     close_client(client);
     free_allocated(&env);
     return 0;
@@ -65,6 +66,7 @@ void perftest(float test_time) {
     allocate(&env, env.num_obs);
     unsigned int seed = 12345;
     srand(seed);
+    puffer_seed(&env.rng, seed);
     c_reset(&env);
     int start = time(NULL);
     int steps = 0;
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
@@ -89,6 +90,7 @@ typedef struct Blastar {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
 } Blastar;
 
 void add_log(Blastar* env) {
@@ -113,8 +115,8 @@ void c_reset(Blastar* env) {
     env->player.player_speed = 2.0f;
     env->enemy.enemy_speed = 1.0f;
     scale_speeds(env);
-    env->player.x = (float)(rand() % (SCREEN_WIDTH - PLAYER_WIDTH));
-    env->player.y = (float)(rand() % (SCREEN_HEIGHT - PLAYER_HEIGHT));
+    env->player.x = (float)(puffer_rand(&env->rng) % (SCREEN_WIDTH - PLAYER_WIDTH));
+    env->player.y = (float)(puffer_rand(&env->rng) % (SCREEN_HEIGHT - PLAYER_HEIGHT));
     env->player.score = 0;
     env->player.lives = PLAYER_MAX_LIVES;
     env->player.bullet_fired = false;
@@ -231,9 +233,9 @@ void c_step(Blastar* env) {
         if (env->enemy_explosion_timer == 0) {
             env->enemy.crossed_screen = 0;
             float respawn_bias = 0.1f;
-            if ((float)rand() / (float)RAND_MAX > respawn_bias) {
+            if (puffer_randf(&env->rng) > respawn_bias) {
                 env->enemy.x = -ENEMY_WIDTH;
-                env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+                env->enemy.y = puffer_rand(&env->rng) % (SCREEN_HEIGHT - ENEMY_HEIGHT);
                 env->enemy_respawns += 1;
             }
             env->enemy.active = true;
@@ -290,7 +292,7 @@ void c_step(Blastar* env) {
     if (fabs(player_center_x - enemy_center_x) < SPEED_SCALE &&
         !env->enemy.attacking && env->enemy.active &&
         env->enemy.y < env->player.y - (ENEMY_HEIGHT / 2)) {
-        if (rand() % 2 == 0) {
+        if (puffer_rand(&env->rng) % 2 == 0) {
             env->enemy.attacking = true;
             if (!env->enemy.bullet.active) {
                 env->enemy.bullet.active = true;
@@ -321,7 +323,7 @@ void c_step(Blastar* env) {
         env->enemy.active = false;
         env->enemy_explosion_timer = 30;
         env->enemy.x = -ENEMY_WIDTH;
-        env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+        env->enemy.y = puffer_rand(&env->rng) % (SCREEN_HEIGHT - ENEMY_HEIGHT);
         env->player_explosion_timer = 30;
         env->player.player_stuck = false;
 
@@ -363,7 +365,7 @@ void c_step(Blastar* env) {
         env->player.player_stuck = false;
         env->enemy.attacking = false;
         env->enemy.x = -ENEMY_WIDTH;
-        env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+        env->enemy.y = puffer_rand(&env->rng) % (SCREEN_HEIGHT - ENEMY_HEIGHT);
 
         if (env->player.lives <= 0) {
             env->player.lives = 0;
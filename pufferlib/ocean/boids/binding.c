@@ -10,7 +10,11 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->centering_factor = unpack(kwargs, "centering_factor");
     env->avoid_factor = unpack(kwargs, "avoid_factor");
     env->matching_factor = unpack(kwargs, "matching_factor");
-    init(env);
+    env->naive_neighbors = unpack(kwargs, "naive_neighbors");
+    if (!init(env)) {
+        PyErr_NoMemory();
+        return -1;
+    }
     return 0;
 }
 
@@ -26,6 +26,7 @@ void generate_dummy_actions(Boids* env) {
 void demo() {
     // Initialize Boids environment struct
     Boids env = {0}; 
+    puffer_seed(&env.rng, time(NULL));
     env.num_boids = NUM_BOIDS_DEMO;
     
     // In the Python binding, these pointers are assigned from NumPy arrays.
@@ -42,7 +43,11 @@ void demo() {
         return;
     }
 
-    init(&env); 
+    if (!init(&env)) {
+        fprintf(stderr, "ERROR: Failed to allocate the neighbor grid.\n");
+        free(env.observations); free(env.actions); free(env.rewards);
+        return;
+    }
     Client* client = make_client(&env);
 
     if (client == NULL) {
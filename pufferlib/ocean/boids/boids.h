@@ -1,12 +1,15 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <assert.h>
 #include <math.h>
 #include <string.h>
 #include <limits.h>
 #include <stdbool.h>
 
 #include "raylib.h"
+#include "../puffer_rand.h"
+#include "../spatial_grid.h"
 
 #define TOP_MARGIN 50
 #define BOTTOM_MARGIN 50
@@ -15,6 +18,7 @@
 #define VELOCITY_CAP 5
 #define VISUAL_RANGE 20
 #define PROTECTED_RANGE 100
+#define NEIGHBOR_RANGE (VISUAL_RANGE > PROTECTED_RANGE ? VISUAL_RANGE : PROTECTED_RANGE)
 #define WIDTH 1080
 #define HEIGHT 720
 #define BOID_WIDTH 32
@@ -57,37 +61,59 @@ typedef struct {
     float matching_factor;
     unsigned tick;
     Log log;
+    uint64_t rng;
     Log* boid_logs;
     unsigned report_interval;
     Client* client;
-
+    // Neighbors come from a grid unless naive_neighbors is set, which
+    // scans all boids. Results match, the naive path is kept for testing
+    SpatialGrid grid;
+    int* neighbors;
+    int naive_neighbors;
 } Boids;
 
 static inline float flmax(float a, float b) { return a > b ? a : b; }
 static inline float flmin(float a, float b) { return a > b ? b : a; }
 static inline float flclip(float x,float lo,float hi) { return flmin(hi,flmax(lo,x)); }
-static inline float rndf(float lo,float hi) { return lo + (float)rand()/(float)RAND_MAX*(hi-lo); }
+static inline float rndf(uint64_t* rng, float lo,float hi) { return lo + puffer_randf(rng)*(hi-lo); }
 
 static void respawn_boid(Boids *env, unsigned int i) {
-    env->boids[i].x = rndf(LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
-    env->boids[i].y = rndf(BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
+    env->boids[i].x = rndf(&env->rng, LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
+    env->boids[i].y = rndf(&env->rng, BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
     env->boids[i].velocity.x = 0;
     env->boids[i].velocity.y = 0;
     env->boid_logs[i]       = (Log){0};
+    grid_move(&env->grid, i, env->boids[i].x, env->boids[i].y, 0);
 }
 
-void init(Boids *env) {
+// Returns false if the neighbor grid cannot be allocated
+bool init(Boids *env) {
     env->boids = (Boid*)calloc(env->num_boids, sizeof(Boid));
     env->boid_logs = (Log*)calloc(env->num_boids, sizeof(Log));
     env->log = (Log){0};
     env->tick = 0;
 
+    // Cells at least NEIGHBOR_RANGE wide, and a single cell along z. The
+    // grid reads velocity.x as z, which one z cell ignores
+    float lo[3] = {0, 0, 0};
+    float hi[3] = {WIDTH, HEIGHT, 0};
+    int dims[3] = {WIDTH/NEIGHBOR_RANGE, HEIGHT/NEIGHBOR_RANGE, 1};
+    if (!grid_init(&env->grid, lo, hi, dims, env->num_boids)) {
+        return false;
+    }
+    env->neighbors = calloc(env->num_boids, sizeof(int));
+    if (env->neighbors == NULL) {
+        return false;
+    }
+
     for (unsigned current_indx = 0; current_indx < env->num_boids; current_indx++) {
-        env->boids[current_indx].x = rndf(LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
-        env->boids[current_indx].y = rndf(BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
+        env->boids[current_indx].x = rndf(&env->rng, LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
+        env->boids[current_indx].y = rndf(&env->rng, BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
         env->boids[current_indx].velocity.x = 0;
         env->boids[current_indx].velocity.y = 0;
     }
+    grid_build(&env->grid, &env->boids[0].x, sizeof(Boid), env->num_boids);
+    return true;
 }
 
 
@@ -139,11 +165,26 @@ void c_step(Boids *env) {
         }
         current_boid->x = flclip(current_boid->x + current_boid->velocity.x, 0, WIDTH  - BOID_WIDTH);
         current_boid->y = flclip(current_boid->y + current_boid->velocity.y, 0, HEIGHT - BOID_HEIGHT);
+        grid_move(&env->grid, current_indx, current_boid->x, current_boid->y, 0);
+
+        // candidate neighbors
+        unsigned num_neighbors = env->num_boids;
+        if (env->naive_neighbors) {
+            for (unsigned observed_indx = 0; observed_indx < env->num_boids; observed_indx++) {
+                env->neighbors[observed_indx] = observed_indx;
+            }
+        } else {
+            float lo[3] = {current_boid->x - NEIGHBOR_RANGE, current_boid->y - NEIGHBOR_RANGE, 0};
+            float hi[3] = {current_boid->x + NEIGHBOR_RANGE, current_boid->y + NEIGHBOR_RANGE, 0};
+            num_neighbors = grid_query_box(&env->grid, lo, hi, env->neighbors, env->num_boids);
+            assert(num_neighbors <= env->num_boids);
+        }
 
         // reward calculation
         current_boid_reward = 0.0f, protected_dist_sum = 0.0f, protected_count = 0.0f;
         visual_count = 0.0f, vis_vx_sum = 0.0f, vis_vy_sum = 0.0f, vis_x_sum = 0.0f, vis_y_sum = 0.0f;
-        for (unsigned observed_indx = 0; observed_indx < env->num_boids; observed_indx++) {
+        for (unsigned neighbor = 0; neighbor < num_neighbors; neighbor++) {
+            unsigned observed_indx = env->neighbors[neighbor];
             if (current_indx == observed_indx) continue;
             observed_boid = env->boids[observed_indx];
             diff_x = current_boid->x - observed_boid.x;
@@ -221,6 +262,8 @@ void c_close_client(Client* client) {
 void c_close(Boids* env) {
     free(env->boids);
     free(env->boid_logs);
+    free(env->neighbors);
+    grid_free(&env->grid);
     if (env->client != NULL) {
         c_close_client(env->client);
     }
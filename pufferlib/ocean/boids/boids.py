@@ -21,7 +21,8 @@ class Boids(pufferlib.PufferEnv):
         margin_turn_factor=1.0,
         centering_factor=0.0,
         avoid_factor=0.0,
-        matching_factor=0.0
+        matching_factor=0.0,
+        naive_neighbors=False
     ):
         ACTION_SPACE_SIZE = 2
         self.num_agents = num_envs * num_boids
@@ -62,6 +63,7 @@ class Boids(pufferlib.PufferEnv):
                 centering_factor=centering_factor,
                 avoid_factor=avoid_factor,
                 matching_factor=matching_factor,
+                naive_neighbors=naive_neighbors,
             ))
         
         self.c_envs = binding.vectorize(*c_envs)
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define NOOP 0
 #define LEFT 1
@@ -40,6 +41,7 @@ typedef struct Client {
 typedef struct Breakout {
     Client* client;
     Log log;
+    uint64_t rng;
     float* observations;
     float* actions;
     float* rewards;
@@ -425,7 +427,7 @@ void step_frame(Breakout* env, float action) {
 
         env->ball_vy = cos(direction) * env->ball_speed * TICK_RATE;
         env->ball_vx = sin(direction) * env->ball_speed * TICK_RATE;
-        if (rand() % 2 == 0) {
+        if (puffer_rand(&env->rng) % 2 == 0) {
             env->ball_vx = -env->ball_vx;
         }
     }   
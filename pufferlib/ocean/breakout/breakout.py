@@ -18,7 +18,7 @@ class Breakout(pufferlib.PufferEnv):
             ball_width=32, ball_height=32,
             brick_width=32, brick_height=12,
             brick_rows=6, brick_cols=18, continuous=False, log_interval=128,
-            buf=None, seed=0):
+            num_threads=1, buf=None, seed=0):
         self.single_observation_space = gymnasium.spaces.Box(low=0, high=1,
             shape=(10 + brick_rows*brick_cols,), dtype=np.float32)
         self.render_mode = render_mode
@@ -43,7 +43,7 @@ class Breakout(pufferlib.PufferEnv):
             self.terminals, self.truncations, num_envs, seed, frameskip=frameskip, width=width, height=height,
             paddle_width=paddle_width, paddle_height=paddle_height, ball_width=ball_width, ball_height=ball_height,
             brick_width=brick_width, brick_height=brick_height, brick_rows=brick_rows,
-            brick_cols=brick_cols, continuous=continuous
+            brick_cols=brick_cols, continuous=continuous, num_threads=num_threads
         )
 
     def reset(self, seed=0):
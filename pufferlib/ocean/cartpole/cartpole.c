@@ -30,6 +30,7 @@ void demo() {
     int logit_sizes[1] = {ACTIONS_SIZE};
     net = make_linearlstm(weights, 1, OBSERVATIONS_SIZE, logit_sizes, 1);
     Cartpole env = {0};
+    puffer_seed(&env.rng, time(NULL));
     env.continuous = CONTINUOUS;
     allocate(&env);
     c_reset(&env);
@@ -61,7 +62,7 @@ void demo() {
     }
 
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
 }
 
@@ -5,6 +5,7 @@
 #include <math.h>
 #include <time.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define GRAVITY 9.8f
 #define MASSCART 1.0f
@@ -45,6 +46,7 @@ struct Cartpole {
     unsigned char* terminals;
     unsigned char* truncations;
     Log log;
+    uint64_t rng;
     Client* client;
     float x;
     float x_dot;
@@ -144,10 +146,10 @@ void compute_observations(Cartpole* env) {
 
 void c_reset(Cartpole* env) {
     env->episode_return = 0.0f;
-    env->x = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->x_dot = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->theta = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->theta_dot = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
+    env->x = puffer_randf(&env->rng) * 0.08f - 0.04f;
+    env->x_dot = puffer_randf(&env->rng) * 0.08f - 0.04f;
+    env->theta = puffer_randf(&env->rng) * 0.08f - 0.04f;
+    env->theta_dot = puffer_randf(&env->rng) * 0.08f - 0.04f;
     env->tick = 0;
     
     compute_observations(env);
@@ -1,12 +1,44 @@
+#include <Python.h>
+
 #include "connect4.h"
+
+static PyObject* set_opponent(PyObject* self, PyObject* args);
+
 #define Env CConnect4
+#define MY_METHODS {"set_opponent", set_opponent, METH_VARARGS, "Set the scripted opponent's search depth and node budget"}
 #include "../env_binding.h"
 
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
+    env->search_depth = unpack(kwargs, "search_depth");
+    env->max_nodes = unpack(kwargs, "max_nodes");
     init(env);
     return 0;
 }
 
+// Curriculum hook: takes effect from each env's next opponent move
+static PyObject* set_opponent(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 3) {
+        PyErr_SetString(PyExc_TypeError, "set_opponent requires 3 arguments");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    int search_depth = PyLong_AsLong(PyTuple_GetItem(args, 1));
+    int max_nodes = PyLong_AsLong(PyTuple_GetItem(args, 2));
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    // Async steps read these from worker threads
+    vec_wait_async(vec);
+    for (int i = 0; i < vec->num_envs; i++) {
+        vec->envs[i]->search_depth = search_depth;
+        vec->envs[i]->max_nodes = max_nodes;
+    }
+    Py_RETURN_NONE;
+}
+
 static int my_log(PyObject* dict, Log* log) {
     assign_to_dict(dict, "perf", log->perf);
     assign_to_dict(dict, "score", log->score);
@@ -10,6 +10,8 @@ void interactive() {
     LinearLSTM* net = make_linearlstm(weights, 1, 42, logit_sizes, 1);
 
     CConnect4 env = {
+        .search_depth = 4,
+        .max_nodes = 4096,
     };
     allocate_cconnect4(&env);
     c_reset(&env);
@@ -46,7 +48,7 @@ void interactive() {
         c_render(&env);
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     close_client(env.client);
     free_allocated_cconnect4(&env);
 }
@@ -54,6 +56,8 @@ void interactive() {
 void performance_test() {
     long test_time = 10;
     CConnect4 env = {
+        .search_depth = 4,
+        .max_nodes = 4096,
     };
     allocate_cconnect4(&env);
     c_reset(&env);
@@ -2,7 +2,9 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define WIN_CONDITION 4
 const int PLAYER_WIN = 1.0;
@@ -16,9 +18,17 @@ const int HEIGHT = 576;
 const int PIECE_WIDTH = 96;
 const int PIECE_HEIGHT = 96;
 
-const float MAX_VALUE = 31;
-const float WIN_VALUE = 30;
-const float DRAW_VALUE = 0;
+// Transposition table entries pack the position key in the low 50 bits, then
+// the value (offset by TT_VALUE_OFFSET), the bound type and the search depth
+#define TT_BITS 12
+#define TT_SIZE (1 << TT_BITS)
+#define TT_KEY_BITS 50
+#define TT_VALUE_OFFSET 32
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+#define SEARCH_INF 64
+static const int COLUMN_ORDER[7] = {3, 2, 4, 1, 5, 0, 6};
 
 typedef struct Log Log;
 struct Log {
@@ -38,6 +48,7 @@ struct CConnect4 {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
     Client* client;
 
     // Bit string representation from:
@@ -46,24 +57,40 @@ struct CConnect4 {
     uint64_t player_pieces;
     uint64_t env_pieces;
 
+    // Scripted opponent strength. search_depth counts plies including the
+    // opponent's own move, 0 plays uniformly random legal moves and 4 plays
+    // about as well as the old fixed 4-ply opponent. Past max_nodes
+    // positions per move, unexplored lines score as unknown (0), though
+    // immediate wins and forced blocks are still seen
+    int search_depth;
+    int max_nodes;
+    int nodes;
+    uint64_t* tt;
+
     int tick;
 };
 
+void init(CConnect4* env);
+
 void allocate_cconnect4(CConnect4* env) {
+    init(env);
     env->observations = (float*)calloc(42, sizeof(float));
     env->actions = (int*)calloc(1, sizeof(int));
     env->terminals = (unsigned char*)calloc(1, sizeof(unsigned char));
     env->rewards = (float*)calloc(1, sizeof(float));
 }
 
+void c_close(CConnect4* env) {
+    free(env->tt);
+    env->tt = NULL;
+}
+
 void free_allocated_cconnect4(CConnect4* env) {
     free(env->actions);
     free(env->observations);
     free(env->terminals);
     free(env->rewards);
-}
-
-void c_close(CConnect4* env) {
+    c_close(env);
 }
 
 void add_log(CConnect4* env) {
@@ -77,6 +104,7 @@ void add_log(CConnect4* env) {
 void init(CConnect4* env) {
     env->log = (Log){0};
     env->tick = 0;
+    env->tt = (uint64_t*)calloc(TT_SIZE, sizeof(uint64_t));
 }
 
 // Get the bit at the top of 'column'. Column can be played if bit is 0
@@ -137,85 +165,199 @@ bool won(uint64_t pieces) {
     return false;
 }
 
-// https://en.wikipedia.org/wiki/Negamax#Negamax_variant_with_no_color_parameter
-float negamax(uint64_t pieces, uint64_t other_pieces, int depth) {
-    uint64_t piece_mask = pieces | other_pieces;
-    if (won(other_pieces)) {
-        return pow(10, depth);
+// All cells of 'column'
+uint64_t column_mask(uint64_t column) {
+    return ((UINT64_C(1) << ROWS) - 1) << column * (ROWS + 1);
+}
+
+// One bit at the bottom of every column
+uint64_t bottom_row() {
+    uint64_t row = 0;
+    for (int column = 0; column < COLUMNS; column++) {
+        row |= bottom_mask(column);
     }
-    if (won(pieces)) {
-        return 0;
+    return row;
+}
+
+// The lowest free cell of every column that is not full
+uint64_t possible_moves(uint64_t mask) {
+    uint64_t bottom = bottom_row();
+    return (mask + bottom) & (bottom * ((UINT64_C(1) << ROWS) - 1));
+}
+
+// Empty cells that would complete a line of 4 for 'pieces'. From
+// http://blog.gamesolver.org/solving-connect-four/09-anticipate-losing-moves/
+uint64_t winning_cells(uint64_t pieces, uint64_t mask) {
+    // Vertical
+    uint64_t r = (pieces << 1) & (pieces << 2) & (pieces << 3);
+
+    // Horizontal and the two diagonals
+    int shifts[3] = {ROWS + 1, ROWS, ROWS + 2};
+    for (int i = 0; i < 3; i++) {
+        int s = shifts[i];
+        uint64_t p = (pieces << s) & (pieces << 2*s);
+        r |= p & (pieces << 3*s);
+        r |= p & (pieces >> s);
+        p = (pieces >> s) & (pieces >> 2*s);
+        r |= p & (pieces << s);
+        r |= p & (pieces >> 3*s);
     }
 
-    if (depth == 0 || draw(piece_mask)) {
+    uint64_t board = bottom_row() * ((UINT64_C(1) << ROWS) - 1);
+    return r & (board ^ mask);
+}
+
+// Unique key for the position with 'pieces' to move
+// Never zero, so empty table slots cannot match
+uint64_t position_key(uint64_t pieces, uint64_t mask) {
+    return pieces + mask + c_bottom();
+}
+
+// Negamax with alpha-beta pruning, center-first ordering and a per-env
+// transposition table. 'pieces' belong to the side to move and 'depth' counts
+// the plies left, starting with this one. Scores follow
+// http://blog.gamesolver.org/solving-connect-four/02-test-protocol/ so that
+// quicker wins score higher, and positions past the depth limit score 0.
+// Once the node budget runs out, the remaining lines score 0 and nothing more
+// is stored
+int negamax(CConnect4* env, uint64_t pieces, uint64_t mask, int depth, int alpha, int beta) {
+    env->nodes++;
+    int moves = __builtin_popcountll(mask);
+    if (depth == 0 || draw(mask)) {
+        return 0;
+    }
+    uint64_t possible = possible_moves(mask);
+    if (winning_cells(pieces, mask) & possible) {
+        return (ROWS*COLUMNS + 1 - moves) / 2;
+    }
+    if (depth == 1 || env->nodes > env->max_nodes) {
         return 0;
     }
 
-    float value = 0;
-    for (uint64_t column = 0; column < 7; column ++) {
-        if (invalid_move(column, piece_mask)) {
+    // Block the opponent's immediate wins and never play right under one
+    uint64_t threats = winning_cells(pieces ^ mask, mask);
+    uint64_t forced = possible & threats;
+    if (forced) {
+        if (forced & (forced - 1)) {
+            return -(ROWS*COLUMNS - moves) / 2;
+        }
+        possible = forced;
+    }
+    possible &= ~(threats >> 1);
+    if (!possible) {
+        return -(ROWS*COLUMNS - moves) / 2;
+    }
+
+    // No immediate win, so the best case is winning on our following move
+    int max = (ROWS*COLUMNS - 1 - moves) / 2;
+    if (beta > max) {
+        beta = max;
+        if (alpha >= beta) {
+            return beta;
+        }
+    }
+
+    uint64_t key = position_key(pieces, mask);
+    uint64_t* slot = &env->tt[(key * 0x9E3779B97F4A7C15ULL) >> (64 - TT_BITS)];
+    uint64_t entry = *slot;
+    if ((entry & ((UINT64_C(1) << TT_KEY_BITS) - 1)) == key && (int)(entry >> 58) >= depth) {
+        int value = (int)((entry >> TT_KEY_BITS) & 63) - TT_VALUE_OFFSET;
+        int bound = (entry >> 56) & 3;
+        if (bound == TT_EXACT) {
+            return value;
+        } else if (bound == TT_LOWER && value > alpha) {
+            alpha = value;
+        } else if (bound == TT_UPPER && value < beta) {
+            beta = value;
+        }
+        if (alpha >= beta) {
+            return value;
+        }
+    }
+
+    int alpha_start = alpha;
+    int best = -SEARCH_INF;
+    for (int i = 0; i < COLUMNS; i++) {
+        uint64_t move = possible & column_mask(COLUMN_ORDER[i]);
+        if (!move) {
             continue;
         }
-        uint64_t child_pieces = play(column, piece_mask, other_pieces);
-        value -= negamax(other_pieces, child_pieces, depth - 1);
+        int value = -negamax(env, pieces ^ mask, mask | move, depth - 1, -beta, -alpha);
+        if (value > best) {
+            best = value;
+        }
+        if (value > alpha) {
+            alpha = value;
+        }
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    if (env->nodes > env->max_nodes) {
+        return best;
     }
-    return value;
+    int bound = TT_EXACT;
+    if (best <= alpha_start) {
+        bound = TT_UPPER;
+    } else if (best >= beta) {
+        bound = TT_LOWER;
+    }
+    *slot = key | ((uint64_t)(best + TT_VALUE_OFFSET) << TT_KEY_BITS)
+        | ((uint64_t)bound << 56) | ((uint64_t)depth << 58);
+    return best;
+}
+
+int random_env_move(CConnect4* env, uint64_t piece_mask) {
+    int legal[7];
+    int num_legal = 0;
+    for (int column = 0; column < COLUMNS; column++) {
+        if (!invalid_move(column, piece_mask)) {
+            legal[num_legal++] = column;
+        }
+    }
+    return legal[puffer_rand(&env->rng) % num_legal];
 }
 
 int compute_env_move(CConnect4* env) {
     uint64_t piece_mask = env->player_pieces | env->env_pieces;
-    uint64_t hash = env->player_pieces + piece_mask + c_bottom();
-
-    // Hard coded opening book to handle some early game traps
-    // TODO: Add more opening book moves
-    switch (hash) {
-        case 4398050705408:
-            // Respond to _ _ _ o _ _ _
-            // with       _ _ x o _ _ _
-            return 2;
-        case 4398583382016:
-            // Respond to _ _ _ _ o _ _
-            // with       _ _ _ x o _ _
-            return 3;
+    // Full board. c_step scores the invalid move as before
+    if (draw(piece_mask)) {
+        return 0;
     }
-
-    float best_value = 9999;
-    float values[7];
-    for (int i = 0; i < 7; i++) {
-        values[i] = 9999;
+    if (env->search_depth <= 0) {
+        return random_env_move(env, piece_mask);
     }
-    for (uint64_t column = 0; column < 7; column ++) {
-        if (invalid_move(column, piece_mask)) {
-            continue;
-        }
-        uint64_t child_env_pieces = play(column, piece_mask, env->player_pieces);
-        if (won(child_env_pieces)) {
+    uint64_t wins = winning_cells(env->env_pieces, piece_mask) & possible_moves(piece_mask);
+    for (int column = 0; column < COLUMNS; column++) {
+        if (wins & column_mask(column)) {
             return column;
         }
-        float val = -negamax(env->player_pieces, child_env_pieces, 3);
-        values[column] = val;
-        if (val < best_value) {
-            best_value = val;
-        }
     }
+
+    int columns[7];
     int num_ties = 0;
-    for (uint64_t column = 0; column < 7; column ++) {
-        if (values[column] == best_value) {
-            num_ties++;
+    int best_value = -SEARCH_INF;
+    env->nodes = 0;
+    for (int i = 0; i < COLUMNS; i++) {
+        int column = COLUMN_ORDER[i];
+        if (invalid_move(column, piece_mask)) {
+            continue;
         }
-    }
-    //printf("Values: %f, %f, %f, %f, %f, %f, %f\n", values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
-    int best_tie = rand() % num_ties;
-    for (uint64_t column = 0; column < 7; column ++) {
-        if (values[column] == best_value) {
-            if (best_tie == 0) {
-                return column;
-
-            }
-            best_tie--;
+        uint64_t child_mask = piece_mask | (piece_mask + bottom_mask(column));
+        // Window opens one below the best so far so that ties come back
+        // exact and can be broken at random
+        int value = -negamax(env, env->env_pieces ^ piece_mask, child_mask,
+            env->search_depth - 1, -SEARCH_INF, -(best_value - 1));
+        if (value > best_value) {
+            best_value = value;
+            num_ties = 0;
+        }
+        if (value == best_value) {
+            columns[num_ties++] = column;
         }
     }
-    return 0;
+    return columns[puffer_rand(&env->rng) % num_ties];
 }
 
 void compute_observation(CConnect4* env) {
@@ -14,7 +14,7 @@ from pufferlib.ocean.connect4 import binding
 
 class Connect4(pufferlib.PufferEnv):
     def __init__(self, num_envs=1, render_mode=None, report_interval=128,
-             buf=None, seed=0):
+             search_depth=4, max_nodes=4096, buf=None, seed=0):
 
         self.single_observation_space = gymnasium.spaces.Box(low=0, high=1,
             shape=(42,), dtype=np.float32)
@@ -25,7 +25,8 @@ class Connect4(pufferlib.PufferEnv):
 
         super().__init__(buf=buf)
         self.c_envs = binding.vec_init(self.observations, self.actions, self.rewards,
-            self.terminals, self.truncations, num_envs, seed)
+            self.terminals, self.truncations, num_envs, seed,
+            search_depth=search_depth, max_nodes=max_nodes)
 
     def reset(self, seed=None):
         self.tick = 0
@@ -49,6 +50,10 @@ class Connect4(pufferlib.PufferEnv):
         return (self.observations, self.rewards,
             self.terminals, self.truncations, info)
 
+    def set_opponent(self, search_depth, max_nodes=4096):
+        '''Curriculum knob: 0 plays random moves, deeper searches play better'''
+        binding.set_opponent(self.c_envs, search_depth, max_nodes)
+
     def render(self):
         binding.vec_render(self.c_envs, 0)
 
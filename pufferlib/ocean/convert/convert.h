@@ -8,6 +8,7 @@
 #include <string.h>
 #include <math.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 typedef struct {
     float perf;
@@ -39,6 +40,7 @@ typedef struct {
 
 typedef struct {
     Log log;
+    uint64_t rng;
     Client* client;
     Agent* agents;
     Factory* factories;
@@ -95,16 +97,16 @@ void compute_observations(Convert* env) {
 
 void c_reset(Convert* env) {
     for (int i=0; i<env->num_agents; i++) {
-        env->agents[i].x = 16 + rand()%(env->width-16);
-        env->agents[i].y = 16 + rand()%(env->height-16);
-        env->agents[i].item = rand() % env->num_resources;
+        env->agents[i].x = 16 + puffer_rand(&env->rng)%(env->width-16);
+        env->agents[i].y = 16 + puffer_rand(&env->rng)%(env->height-16);
+        env->agents[i].item = puffer_rand(&env->rng) % env->num_resources;
         env->agents[i].episode_length = 0;
     }
     for (int i=0; i<env->num_factories; i++) {
-        env->factories[i].x = 16 + rand()%(env->width-16);
-        env->factories[i].y = 16 + rand()%(env->height-16);
+        env->factories[i].x = 16 + puffer_rand(&env->rng)%(env->width-16);
+        env->factories[i].y = 16 + puffer_rand(&env->rng)%(env->height-16);
         env->factories[i].item = i % env->num_resources;
-        env->factories[i].heading = (rand() % 360)*PI/180.0f;
+        env->factories[i].heading = (puffer_rand(&env->rng) % 360)*PI/180.0f;
     }
     compute_observations(env);
 }
@@ -137,9 +139,9 @@ void c_step(Convert* env) {
         agent->y += agent->speed*sinf(agent->heading);
         agent->y = clip(agent->y, 16, env->height-16);
 
-        if (rand() % env->num_agents == 0) {
-            env->agents[i].x = rand() % env->width;
-            env->agents[i].y = rand() % env->height;
+        if (puffer_rand(&env->rng) % env->num_agents == 0) {
+            env->agents[i].x = puffer_rand(&env->rng) % env->width;
+            env->agents[i].y = puffer_rand(&env->rng) % env->height;
         }
 
         for (int f=0; f<env->num_factories; f++) {
@@ -170,7 +172,7 @@ void c_step(Convert* env) {
         float factory_y = clip(factory->y, 16, env->height-16);
 
         if (factory_x != factory->x || factory_y != factory->y) {
-            factory->heading = (rand() % 360)*PI/180.0f;
+            factory->heading = (puffer_rand(&env->rng) % 360)*PI/180.0f;
             factory->x = factory_x;
             factory->y = factory_y;
         }
@@ -14,6 +14,7 @@ int main() {
       .radius = 400,
   };
   srand(time(NULL));
+  puffer_seed(&env.rng, time(NULL));
   init(&env);
 
   int num_obs = 2 * env.num_resources + 4 + env.num_resources;
@@ -5,6 +5,7 @@
  */
 
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,6 +40,7 @@ typedef struct {
 
 typedef struct {
   Log log;
+  uint64_t rng;
   Client *client;
   Agent *agents;
   Factory *factories;
@@ -55,8 +57,8 @@ typedef struct {
   int radius;
 } ConvertCircle;
 
-static inline float random_float(float low, float high) {
-  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+static inline float random_float(uint64_t *rng, float low, float high) {
+  return low + (high - low) * puffer_randf(rng);
 }
 
 void init(ConvertCircle *env) {
@@ -101,9 +103,9 @@ void compute_observations(ConvertCircle *env) {
 
 void c_reset(ConvertCircle *env) {
   for (int i = 0; i < env->num_agents; i++) {
-    env->agents[i].x = env->width / 2.0f + random_float(-10.0f, 10.0f);
-    env->agents[i].y = env->height / 2.0f + random_float(-10.0f, 10.0f);
-    env->agents[i].item = rand() % env->num_resources;
+    env->agents[i].x = env->width / 2.0f + random_float(&env->rng, -10.0f, 10.0f);
+    env->agents[i].y = env->height / 2.0f + random_float(&env->rng, -10.0f, 10.0f);
+    env->agents[i].item = puffer_rand(&env->rng) % env->num_resources;
     env->agents[i].episode_length = 0;
   }
   float angle;
@@ -112,12 +114,12 @@ void c_reset(ConvertCircle *env) {
     if (env->equidistant) {
       angle = i * delta_angle;
     } else {
-      angle = random_float(0, 2.0f * PI);
+      angle = random_float(&env->rng, 0, 2.0f * PI);
     }
     env->factories[i].x = env->width / 2.0f + env->radius * cosf(angle);
     env->factories[i].y = env->height / 2.0f + env->radius * sinf(angle);
     env->factories[i].item = i % env->num_resources;
-    env->factories[i].heading = (rand() % 360) * PI / 180.0f;
+    env->factories[i].heading = (puffer_rand(&env->rng) % 360) * PI / 180.0f;
   }
   compute_observations(env);
 }
@@ -150,9 +152,9 @@ void c_step(ConvertCircle *env) {
     agent->y += agent->speed * sinf(agent->heading);
     agent->y = clip(agent->y, 16, env->height - 16);
 
-    if (rand() % env->num_agents == 0) {
-      env->agents[i].x = env->width / 2.0f + random_float(-10.0f, 10.0f);
-      env->agents[i].y = env->height / 2.0f + random_float(-10.0f, 10.0f);
+    if (puffer_rand(&env->rng) % env->num_agents == 0) {
+      env->agents[i].x = env->width / 2.0f + random_float(&env->rng, -10.0f, 10.0f);
+      env->agents[i].y = env->height / 2.0f + random_float(&env->rng, -10.0f, 10.0f);
     }
 
     for (int f = 0; f < env->num_factories; f++) {
@@ -183,7 +185,7 @@ void c_step(ConvertCircle *env) {
     float factory_y = clip(factory->y, 16, env->height - 16);
 
     if (factory_x != factory->x || factory_y != factory->y) {
-      factory->heading = (rand() % 360) * PI / 180.0f;
+      factory->heading = (puffer_rand(&env->rng) % 360) * PI / 180.0f;
       factory->x = factory_x;
       factory->y = factory_y;
     }
@@ -67,6 +67,11 @@ static int my_put(Env* env, PyObject* args, PyObject* kwargs) {
     return 0;
 }
 
+// Maps sampled by the last call stay cached until the next one, so the envs
+// created in between attach to them instead of loading them again
+static MapCache** shared_maps = NULL;
+static int shared_map_count = 0;
+
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_agents = unpack(kwargs, "num_agents");
     int num_maps = unpack(kwargs, "num_maps");
@@ -77,31 +82,39 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     int max_envs = num_agents;
     PyObject* agent_offsets = PyList_New(max_envs+1);
     PyObject* map_ids = PyList_New(max_envs);
+    MapCache** maps = calloc(max_envs, sizeof(MapCache*));
     // getting env count
     while(total_agent_count < num_agents && env_count < max_envs){
         char map_file[100];
         int map_id = rand() % num_maps;
-        Drive* env = calloc(1, sizeof(Drive));
         sprintf(map_file, "resources/drive/binaries/map_%03d.bin", map_id);
-        env->entities = load_map_binary(map_file, env);
-        set_active_agents(env);
+        MapCache* map = map_cache_acquire(map_file);
+        if (map == NULL) {
+            for (int i = 0; i < env_count; i++) {
+                map_cache_release(maps[i]);
+            }
+            free(maps);
+            Py_DECREF(agent_offsets);
+            Py_DECREF(map_ids);
+            PyErr_Format(PyExc_FileNotFoundError, "Failed to load map %s", map_file);
+            return NULL;
+        }
+        maps[env_count] = map;
         // Store map_id
         PyObject* map_id_obj = PyLong_FromLong(map_id);
         PyList_SetItem(map_ids, env_count, map_id_obj);
         // Store agent offset
         PyObject* offset = PyLong_FromLong(total_agent_count);
         PyList_SetItem(agent_offsets, env_count, offset);
-        total_agent_count += env->active_agent_count;
+        total_agent_count += map->header->agent_count;
         env_count++;
-        for(int j=0;j<env->num_entities;j++) {
-            free_entity(&env->entities[j]);
-        }
-        free(env->entities);
-        free(env->active_agent_indices);
-        free(env->static_car_indices);
-        free(env->expert_static_car_indices);
-        free(env);
     }
+    for (int i = 0; i < shared_map_count; i++) {
+        map_cache_release(shared_maps[i]);
+    }
+    free(shared_maps);
+    shared_maps = maps;
+    shared_map_count = env_count;
     if(total_agent_count >= num_agents){
         total_agent_count = num_agents;
     }
@@ -124,9 +137,6 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     //Py_DECREF(num);
     /*
     for(int i = 0;i<num_envs; i++) {
-        for(int j=0;j<temp_envs[i].num_entities;j++) {
-            free_entity(&temp_envs[i].entities[j]);
-        }
         free(temp_envs[i].entities);
         free(temp_envs[i].active_agent_indices);
         free(temp_envs[i].static_car_indices);
@@ -148,6 +158,10 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
 
     char map_file[100];
     sprintf(map_file, "resources/drive/binaries/map_%03d.bin", map_id);
+    if (access(map_file, R_OK) != 0) {
+        PyErr_Format(PyExc_FileNotFoundError, "Map %s not found", map_file);
+        return 1;
+    }
     env->num_agents = max_agents;
     env->map_name = strdup(map_file);
     init(env);
@@ -288,7 +288,7 @@ void demo() {
     close_client(env.client);
     free_allocated(&env);
     free_drivenet(net);
-    free(weights);
+    free_weights(weights);
 }
 
 void performance_test() {
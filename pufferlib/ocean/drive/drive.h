@@ -6,6 +6,11 @@
 #include <math.h>
 #include <assert.h>
 #include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "raylib.h"
 #include "raymath.h"
 #include "rlgl.h"
@@ -86,6 +91,7 @@ static const int collision_offsets[25][2] = {
 struct timespec ts;
 
 typedef struct Drive Drive;
+typedef struct MapCache MapCache;
 typedef struct Client Client;
 typedef struct Log Log;
 
@@ -137,20 +143,9 @@ struct Entity {
     int collided_before_goal;
     int reached_goal_this_episode;
     int active_agent;
+    int removed;  // static car taken out because an expert drives through it
 };
 
-void free_entity(Entity* entity){
-    // free trajectory arrays
-    free(entity->traj_x);
-    free(entity->traj_y);
-    free(entity->traj_z);
-    free(entity->traj_vx);
-    free(entity->traj_vy);
-    free(entity->traj_vz);
-    free(entity->traj_heading);
-    free(entity->traj_valid);
-}
-
 float relative_distance(float a, float b){
     float distance = sqrtf(powf(a - b, 2));
     return distance;
@@ -170,11 +165,13 @@ struct Drive {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
     Log* logs;
     int num_agents;
     int active_agent_count;
     int* active_agent_indices;
     int human_agent_idx;
+    MapCache* map;
     Entity* entities;
     int num_entities;
     int num_cars;
@@ -186,6 +183,7 @@ struct Drive {
     int* expert_static_car_indices;
     int timestep;
     int dynamics_model;
+    // Static map data below points into the shared map cache
     float* map_corners;
     int* grid_cells;  // holds entity ids and geometry index per cell
     int grid_cols;
@@ -202,6 +200,18 @@ struct Drive {
     int spawn_immunity_timer;
     float reward_goal_post_respawn;
     float reward_vehicle_collision_post_respawn;
+    // SoA copy of car state in observation order (active agents, then static
+    // cars), refreshed before each observation pass. One allocation
+    int car_count;
+    float* car_state;
+    float* car_x;
+    float* car_y;
+    float* car_heading_x;
+    float* car_heading_y;
+    float* car_width;
+    float* car_length;
+    float* car_speed;
+    int* car_respawned;
 };
 
 void add_log(Drive* env) {
@@ -229,58 +239,76 @@ void add_log(Drive* env) {
     }
 }
 
+static inline void* map_take(char** cursor, size_t bytes) {
+    void* ptr = *cursor;
+    *cursor += bytes;
+    return ptr;
+}
+
+// Loads a map into one allocation: the Entity array followed by the rest of
+// the file. The file already stores each trajectory field as a contiguous
+// array, so the traj_* pointers aim straight into the payload and a single
+// free(entities) releases the whole map
 Entity* load_map_binary(const char* filename, Drive* env) {
     FILE* file = fopen(filename, "rb");
     if (!file) return NULL;
-    fread(&env->num_objects, sizeof(int), 1, file);
-    fread(&env->num_roads, sizeof(int), 1, file);
-    env->num_entities = env->num_objects + env->num_roads; 
-    Entity* entities = (Entity*)malloc(env->num_entities * sizeof(Entity));
-    for (int i = 0; i < env->num_entities; i++) {
-	// Read base entity data
-        fread(&entities[i].type, sizeof(int), 1, file);
-        fread(&entities[i].array_size, sizeof(int), 1, file);
-        // Allocate arrays based on type
-        int size = entities[i].array_size;
-        entities[i].traj_x = (float*)malloc(size * sizeof(float));
-        entities[i].traj_y = (float*)malloc(size * sizeof(float));
-        entities[i].traj_z = (float*)malloc(size * sizeof(float));
-        if (entities[i].type == 1 || entities[i].type == 2 || entities[i].type == 3) {  // Object type
-            // Allocate arrays for object-specific data
-            entities[i].traj_vx = (float*)malloc(size * sizeof(float));
-            entities[i].traj_vy = (float*)malloc(size * sizeof(float));
-            entities[i].traj_vz = (float*)malloc(size * sizeof(float));
-            entities[i].traj_heading = (float*)malloc(size * sizeof(float));
-            entities[i].traj_valid = (int*)malloc(size * sizeof(int));
-        } else {
-            // Roads don't use these arrays
-            entities[i].traj_vx = NULL;
-            entities[i].traj_vy = NULL;
-            entities[i].traj_vz = NULL;
-            entities[i].traj_heading = NULL;
-            entities[i].traj_valid = NULL;
-        }
-        // Read array data
-        fread(entities[i].traj_x, sizeof(float), size, file);
-        fread(entities[i].traj_y, sizeof(float), size, file);
-        fread(entities[i].traj_z, sizeof(float), size, file);
-        if (entities[i].type == 1 || entities[i].type == 2 || entities[i].type == 3) {  // Object type
-            fread(entities[i].traj_vx, sizeof(float), size, file);
-            fread(entities[i].traj_vy, sizeof(float), size, file);
-            fread(entities[i].traj_vz, sizeof(float), size, file);
-            fread(entities[i].traj_heading, sizeof(float), size, file);
-            fread(entities[i].traj_valid, sizeof(int), size, file);
-        }
-        // Read remaining scalar fields
-        fread(&entities[i].width, sizeof(float), 1, file);
-        fread(&entities[i].length, sizeof(float), 1, file);
-        fread(&entities[i].height, sizeof(float), 1, file);
-        fread(&entities[i].goal_position_x, sizeof(float), 1, file);
-        fread(&entities[i].goal_position_y, sizeof(float), 1, file);
-        fread(&entities[i].goal_position_z, sizeof(float), 1, file);
-        fread(&entities[i].mark_as_expert, sizeof(int), 1, file);
+    int header[2];
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size < (long)sizeof(header) || fread(header, sizeof(int), 2, file) != 2) {
+        fclose(file);
+        return NULL;
     }
+    env->num_objects = header[0];
+    env->num_roads = header[1];
+    env->num_entities = env->num_objects + env->num_roads;
+    size_t entity_bytes = env->num_entities*sizeof(Entity);
+    size_t payload_bytes = file_size - sizeof(header);
+    char* arena = (char*)calloc(1, entity_bytes + payload_bytes);
+    char* cursor = arena + entity_bytes;
+    char* end = cursor + payload_bytes;
+    size_t read = fread(cursor, 1, payload_bytes, file);
     fclose(file);
+    if (read != payload_bytes) {
+        free(arena);
+        return NULL;
+    }
+    Entity* entities = (Entity*)arena;
+    int i = 0;
+    for (; i < env->num_entities; i++) {
+        Entity* e = &entities[i];
+        if (end - cursor < 2*(long)sizeof(int)) break;
+        memcpy(&e->type, map_take(&cursor, sizeof(int)), sizeof(int));
+        memcpy(&e->array_size, map_take(&cursor, sizeof(int)), sizeof(int));
+        size_t size = e->array_size;
+        int is_object = e->type == 1 || e->type == 2 || e->type == 3;
+        // x, y, z, then vx, vy, vz, heading, valid for objects, then 7 scalars
+        size_t fields = is_object ? 8 : 3;
+        if (e->array_size < 0 || (size_t)(end - cursor) < (fields*size + 7)*sizeof(float)) break;
+        e->traj_x = map_take(&cursor, size*sizeof(float));
+        e->traj_y = map_take(&cursor, size*sizeof(float));
+        e->traj_z = map_take(&cursor, size*sizeof(float));
+        if (is_object) {
+            e->traj_vx = map_take(&cursor, size*sizeof(float));
+            e->traj_vy = map_take(&cursor, size*sizeof(float));
+            e->traj_vz = map_take(&cursor, size*sizeof(float));
+            e->traj_heading = map_take(&cursor, size*sizeof(float));
+            e->traj_valid = map_take(&cursor, size*sizeof(int));
+        }
+        memcpy(&e->width, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->length, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->height, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->goal_position_x, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->goal_position_y, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->goal_position_z, map_take(&cursor, sizeof(float)), sizeof(float));
+        memcpy(&e->mark_as_expert, map_take(&cursor, sizeof(int)), sizeof(int));
+    }
+    if (i < env->num_entities) {
+        printf("Truncated map file %s\n", filename);
+        free(arena);
+        return NULL;
+    }
     return entities;
 }
 
@@ -288,16 +316,10 @@ void set_start_position(Drive* env){
     //InitWindow(800, 600, "GPU Drive");
     //BeginDrawing();
     for(int i = 0; i < env->num_entities; i++){
-        int is_active = 0;
-        for(int j = 0; j < env->active_agent_count; j++){
-            if(env->active_agent_indices[j] == i){
-                is_active = 1;
-                break;
-            }
-        }
         Entity* e = &env->entities[i];
-        e->x = e->traj_x[0];
-        e->y = e->traj_y[0];
+        int is_active = e->active_agent;
+        e->x = e->removed ? -10000 : e->traj_x[0];
+        e->y = e->removed ? -10000 : e->traj_y[0];
         e->z = e->traj_z[0];
         //printf("Entity %d is at (%f, %f, %f)\n", i, e->x, e->y, e->z);
         //if (e->type < 4) {
@@ -883,41 +905,364 @@ void remove_bad_trajectories(Drive* env){
         for(int j = 0; j < env->static_car_count; j++){
             int static_car_idx = env->static_car_indices[j];
             if(static_car_idx != collided_with_indices[i]) continue;
-            env->entities[static_car_idx].traj_x[0] = -10000;
-            env->entities[static_car_idx].traj_y[0] = -10000;
+            env->entities[static_car_idx].removed = 1;
         }
     }
     env->timestep = 0;
 }
+// Process-wide cache of static map data, keyed by map file and reference
+// counted across envs. Each map is one read-only blob: header, entity records,
+// the trajectory payload with world means subtracted, the road grid and the
+// neighbor cache. The blob is also written to <map>.cache and mmapped by later
+// loads, so worker processes share its pages
+#define MAP_CACHE_MAGIC 0x4d415044
+#define MAP_CACHE_VERSION 1
+
+typedef struct MapCacheHeader MapCacheHeader;
+struct MapCacheHeader {
+    int magic;
+    int version;
+    int64_t source_size;
+    int64_t source_mtime;
+    int64_t total_bytes;
+    int num_objects;
+    int num_roads;
+    int agent_count;  // active agents when not capped by num_agents
+    int grid_cols;
+    int grid_rows;
+    int vision_range;
+    float world_mean_x;
+    float world_mean_y;
+    float map_corners[4];
+    int64_t payload_offset;
+    int64_t grid_cells_offset;
+    int64_t neighbor_offsets_offset;
+    int64_t neighbor_cache_indices_offset;
+    int64_t neighbor_cache_entities_offset;
+};
+
+// Trajectory fields sit back to back at traj_offset in the payload:
+// x, y, z, then vx, vy, vz, heading, valid for objects
+typedef struct MapRecord MapRecord;
+struct MapRecord {
+    int type;
+    int array_size;
+    int traj_offset;
+    float width;
+    float length;
+    float height;
+    float goal_position_x;
+    float goal_position_y;
+    float goal_position_z;
+    int mark_as_expert;
+};
+
+struct MapCache {
+    char* path;
+    int refs;
+    int mmapped;
+    size_t bytes;
+    MapCacheHeader* header;
+    MapCache* next;
+};
+
+static MapCache* map_cache_head = NULL;
+static pthread_mutex_t map_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char* map_cache_build(const char* path, struct stat* source, size_t* out_bytes) {
+    Drive tmp = {0};
+    tmp.entities = load_map_binary(path, &tmp);
+    if (tmp.entities == NULL) {
+        return NULL;
+    }
+    set_means(&tmp);
+    init_grid_map(&tmp);
+    tmp.vision_range = 21;
+    init_neighbor_offsets(&tmp);
+    int cell_count = tmp.grid_cols*tmp.grid_rows;
+    tmp.neighbor_cache_indices = (int*)calloc(cell_count + 1, sizeof(int));
+    cache_neighbor_offsets(&tmp);
+
+    char* payload = (char*)tmp.entities + tmp.num_entities*sizeof(Entity);
+    size_t payload_bytes = source->st_size - 2*sizeof(int);
+    size_t grid_bytes = (size_t)cell_count*SLOTS_PER_CELL*sizeof(int);
+    size_t offsets_bytes = (size_t)tmp.vision_range*tmp.vision_range*2*sizeof(int);
+    size_t indices_bytes = (size_t)(cell_count + 1)*sizeof(int);
+    size_t entities_bytes = (size_t)tmp.neighbor_cache_indices[cell_count]*sizeof(int);
+
+    MapCacheHeader h = {0};
+    h.magic = MAP_CACHE_MAGIC;
+    h.version = MAP_CACHE_VERSION;
+    h.source_size = source->st_size;
+    h.source_mtime = source->st_mtime;
+    h.num_objects = tmp.num_objects;
+    h.num_roads = tmp.num_roads;
+    h.grid_cols = tmp.grid_cols;
+    h.grid_rows = tmp.grid_rows;
+    h.vision_range = tmp.vision_range;
+    h.world_mean_x = tmp.world_mean_x;
+    h.world_mean_y = tmp.world_mean_y;
+    memcpy(h.map_corners, tmp.map_corners, sizeof(h.map_corners));
+    h.payload_offset = sizeof(MapCacheHeader) + tmp.num_entities*sizeof(MapRecord);
+    h.grid_cells_offset = h.payload_offset + payload_bytes;
+    h.neighbor_offsets_offset = h.grid_cells_offset + grid_bytes;
+    h.neighbor_cache_indices_offset = h.neighbor_offsets_offset + offsets_bytes;
+    h.neighbor_cache_entities_offset = h.neighbor_cache_indices_offset + indices_bytes;
+    h.total_bytes = h.neighbor_cache_entities_offset + entities_bytes;
+
+    char* blob = (char*)malloc(h.total_bytes);
+    MapRecord* records = (MapRecord*)(blob + sizeof(MapCacheHeader));
+    for (int i = 0; i < tmp.num_entities; i++) {
+        Entity* e = &tmp.entities[i];
+        records[i] = (MapRecord){
+            .type = e->type,
+            .array_size = e->array_size,
+            .traj_offset = (int)((char*)e->traj_x - payload),
+            .width = e->width,
+            .length = e->length,
+            .height = e->height,
+            .goal_position_x = e->goal_position_x,
+            .goal_position_y = e->goal_position_y,
+            .goal_position_z = e->goal_position_z,
+            .mark_as_expert = e->mark_as_expert,
+        };
+    }
+    memcpy(blob + h.payload_offset, payload, payload_bytes);
+    memcpy(blob + h.grid_cells_offset, tmp.grid_cells, grid_bytes);
+    memcpy(blob + h.neighbor_offsets_offset, tmp.neighbor_offsets, offsets_bytes);
+    memcpy(blob + h.neighbor_cache_indices_offset, tmp.neighbor_cache_indices, indices_bytes);
+    memcpy(blob + h.neighbor_cache_entities_offset, tmp.neighbor_cache_entities, entities_bytes);
+
+    // Counted last because it shrinks car sizes in place
+    set_active_agents(&tmp);
+    h.agent_count = tmp.active_agent_count;
+    memcpy(blob, &h, sizeof(h));
+
+    free(tmp.entities);
+    free(tmp.map_corners);
+    free(tmp.grid_cells);
+    free(tmp.neighbor_offsets);
+    free(tmp.neighbor_cache_indices);
+    free(tmp.neighbor_cache_entities);
+    free(tmp.active_agent_indices);
+    free(tmp.static_car_indices);
+    free(tmp.expert_static_car_indices);
+    *out_bytes = h.total_bytes;
+    return blob;
+}
+
+// Maps a cache file read-only, or returns NULL if it is missing or stale
+static char* map_cache_mmap(const char* cache_path, struct stat* source, size_t* out_bytes) {
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapCacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    char* blob = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (blob == MAP_FAILED) {
+        return NULL;
+    }
+    MapCacheHeader* h = (MapCacheHeader*)blob;
+    if (h->magic != MAP_CACHE_MAGIC || h->version != MAP_CACHE_VERSION
+            || h->total_bytes != st.st_size || h->source_size != source->st_size
+            || h->source_mtime != source->st_mtime) {
+        munmap(blob, st.st_size);
+        return NULL;
+    }
+    *out_bytes = st.st_size;
+    return blob;
+}
+
+static int map_cache_write(const char* cache_path, const char* blob, size_t bytes) {
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", cache_path, (int)getpid());
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    int ok = fwrite(blob, 1, bytes, file) == bytes;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, cache_path) != 0) {
+        unlink(tmp_path);
+        return 0;
+    }
+    return 1;
+}
+
+static MapCache* map_cache_open(const char* path) {
+    struct stat source;
+    if (stat(path, &source) != 0) {
+        return NULL;
+    }
+    char cache_path[1024];
+    snprintf(cache_path, sizeof(cache_path), "%s.cache", path);
+    size_t bytes = 0;
+    int mmapped = 1;
+    char* blob = map_cache_mmap(cache_path, &source, &bytes);
+    if (blob == NULL) {
+        // One process builds the file while the others wait, then everyone maps it
+        char lock_path[1040];
+        snprintf(lock_path, sizeof(lock_path), "%s.lock", cache_path);
+        int lock = open(lock_path, O_RDWR | O_CREAT, 0644);
+        if (lock >= 0) {
+            flock(lock, LOCK_EX);
+        }
+        blob = map_cache_mmap(cache_path, &source, &bytes);
+        if (blob == NULL) {
+            mmapped = 0;
+            blob = map_cache_build(path, &source, &bytes);
+            if (blob != NULL && map_cache_write(cache_path, blob, bytes)) {
+                size_t mapped_bytes = 0;
+                char* mapped = map_cache_mmap(cache_path, &source, &mapped_bytes);
+                if (mapped != NULL) {
+                    free(blob);
+                    blob = mapped;
+                    mmapped = 1;
+                }
+            }
+        }
+        if (lock >= 0) {
+            flock(lock, LOCK_UN);
+            close(lock);
+        }
+    }
+    if (blob == NULL) {
+        return NULL;
+    }
+    MapCache* map = (MapCache*)calloc(1, sizeof(MapCache));
+    map->path = strdup(path);
+    map->mmapped = mmapped;
+    map->bytes = bytes;
+    map->header = (MapCacheHeader*)blob;
+    return map;
+}
+
+MapCache* map_cache_acquire(const char* path) {
+    pthread_mutex_lock(&map_cache_lock);
+    MapCache* map = map_cache_head;
+    while (map != NULL && strcmp(map->path, path) != 0) {
+        map = map->next;
+    }
+    if (map == NULL) {
+        map = map_cache_open(path);
+        if (map != NULL) {
+            map->next = map_cache_head;
+            map_cache_head = map;
+        }
+    }
+    if (map != NULL) {
+        map->refs++;
+    }
+    pthread_mutex_unlock(&map_cache_lock);
+    return map;
+}
+
+void map_cache_release(MapCache* map) {
+    if (map == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&map_cache_lock);
+    if (--map->refs == 0) {
+        MapCache** link = &map_cache_head;
+        while (*link != map) {
+            link = &(*link)->next;
+        }
+        *link = map->next;
+        if (map->mmapped) {
+            munmap(map->header, map->bytes);
+        } else {
+            free(map->header);
+        }
+        free(map->path);
+        free(map);
+    }
+    pthread_mutex_unlock(&map_cache_lock);
+}
+
+// Points env at the shared static data and gives it its own entity state
+void map_cache_attach(Drive* env, MapCache* map) {
+    MapCacheHeader* h = map->header;
+    char* blob = (char*)h;
+    MapRecord* records = (MapRecord*)(blob + sizeof(MapCacheHeader));
+    char* payload = blob + h->payload_offset;
+    env->map = map;
+    env->num_objects = h->num_objects;
+    env->num_roads = h->num_roads;
+    env->num_entities = h->num_objects + h->num_roads;
+    env->entities = (Entity*)calloc(env->num_entities, sizeof(Entity));
+    for (int i = 0; i < env->num_entities; i++) {
+        MapRecord* r = &records[i];
+        Entity* e = &env->entities[i];
+        int size = r->array_size;
+        float* traj = (float*)(payload + r->traj_offset);
+        e->type = r->type;
+        e->array_size = size;
+        e->traj_x = traj;
+        e->traj_y = traj + size;
+        e->traj_z = traj + 2*size;
+        if (e->type == 1 || e->type == 2 || e->type == 3) {
+            e->traj_vx = traj + 3*size;
+            e->traj_vy = traj + 4*size;
+            e->traj_vz = traj + 5*size;
+            e->traj_heading = traj + 6*size;
+            e->traj_valid = (int*)(traj + 7*size);
+        }
+        e->width = r->width;
+        e->length = r->length;
+        e->height = r->height;
+        e->goal_position_x = r->goal_position_x;
+        e->goal_position_y = r->goal_position_y;
+        e->goal_position_z = r->goal_position_z;
+        e->mark_as_expert = r->mark_as_expert;
+    }
+    env->world_mean_x = h->world_mean_x;
+    env->world_mean_y = h->world_mean_y;
+    env->map_corners = h->map_corners;
+    env->grid_cols = h->grid_cols;
+    env->grid_rows = h->grid_rows;
+    env->vision_range = h->vision_range;
+    env->grid_cells = (int*)(blob + h->grid_cells_offset);
+    env->neighbor_offsets = (int*)(blob + h->neighbor_offsets_offset);
+    env->neighbor_cache_indices = (int*)(blob + h->neighbor_cache_indices_offset);
+    env->neighbor_cache_entities = (int*)(blob + h->neighbor_cache_entities_offset);
+}
+
 void init(Drive* env){
     env->human_agent_idx = 0;
     env->timestep = 0;
-    env->entities = load_map_binary(env->map_name, env);
+    MapCache* map = map_cache_acquire(env->map_name);
+    if (map == NULL) {
+        fprintf(stderr, "Failed to load map %s\n", env->map_name);
+        exit(1);
+    }
+    map_cache_attach(env, map);
     env->dynamics_model = CLASSIC;
-    set_means(env);
-    init_grid_map(env);
-    env->vision_range = 21;
-    init_neighbor_offsets(env);
-    env->neighbor_cache_indices = (int*)calloc((env->grid_cols*env->grid_rows) + 1, sizeof(int));
-    cache_neighbor_offsets(env);
     set_active_agents(env);
     remove_bad_trajectories(env);
     set_start_position(env);
     env->logs = (Log*)calloc(env->active_agent_count, sizeof(Log));
+    env->car_state = (float*)calloc(8*MAX_CARS, sizeof(float));
+    env->car_x = env->car_state;
+    env->car_y = env->car_x + MAX_CARS;
+    env->car_heading_x = env->car_y + MAX_CARS;
+    env->car_heading_y = env->car_heading_x + MAX_CARS;
+    env->car_width = env->car_heading_y + MAX_CARS;
+    env->car_length = env->car_width + MAX_CARS;
+    env->car_speed = env->car_length + MAX_CARS;
+    env->car_respawned = (int*)(env->car_speed + MAX_CARS);
 }
 
 void c_close(Drive* env){
-    for(int i = 0; i < env->num_entities; i++){
-        free_entity(&env->entities[i]);
-    }
     free(env->entities);
+    free(env->car_state);
     free(env->active_agent_indices);
     free(env->logs);
-    free(env->map_corners);
-    free(env->grid_cells);
-    free(env->neighbor_offsets);
-    free(env->neighbor_cache_entities);
-    free(env->neighbor_cache_indices);
+    map_cache_release(env->map);
     free(env->static_car_indices);
     free(env->expert_static_car_indices);
     // free(env->map_name);
@@ -1018,7 +1363,27 @@ float reverse_normalize_value(float value, float min, float max){
     return value*50.0f;
 }
 
+void gather_car_state(Drive* env) {
+    int n = 0;
+    for(; n < env->num_cars && n < MAX_CARS; n++) {
+        int index = (n < env->active_agent_count) ? env->active_agent_indices[n]
+            : env->static_car_indices[n - env->active_agent_count];
+        Entity* e = &env->entities[index];
+        if(e->type > 3) break;
+        env->car_x[n] = e->x;
+        env->car_y[n] = e->y;
+        env->car_heading_x[n] = e->heading_x;
+        env->car_heading_y[n] = e->heading_y;
+        env->car_width[n] = e->width / MAX_VEH_WIDTH;
+        env->car_length[n] = e->length / MAX_VEH_LEN;
+        env->car_speed[n] = sqrtf(e->vx*e->vx + e->vy*e->vy) / MAX_SPEED;
+        env->car_respawned[n] = e->respawn_timestep != -1;
+    }
+    env->car_count = n;
+}
+
 void compute_observations(Drive* env) {
+    gather_car_state(env);
     int max_obs = 7 + 7*(MAX_CARS - 1) + 7*MAX_ROAD_SEGMENT_OBSERVATIONS;
     memset(env->observations, 0, max_obs*env->active_agent_count*sizeof(float));
     float (*observations)[max_obs] = (float(*)[max_obs])env->observations; 
@@ -1050,48 +1415,39 @@ void compute_observations(Drive* env) {
         obs[4] = ego_entity->length / MAX_VEH_LEN;
         obs[5] = (ego_entity->collision_state > 0) ? 1 : 0;
         
-        // Relative Pos of other cars
+        // Relative Pos of other cars. Compute every car in one branch-free pass
+        // over the SoA state, then copy the visible ones out in order
         int obs_idx = 7;  // Start after goal distances
         int cars_seen = 0;
-        for(int j = 0; j < MAX_CARS; j++) {
-            int index = -1;
-            if(j < env->active_agent_count){
-                index = env->active_agent_indices[j];
-            } else if (j < env->num_cars){
-                index = env->static_car_indices[j - env->active_agent_count];
-            } 
-            if(index == -1) continue;
-            if(env->entities[index].type > 3) break;
-            if(index == env->active_agent_indices[i]) continue;  // Skip self, but don't increment obs_idx
-            Entity* other_entity = &env->entities[index];
-            if(ego_entity->respawn_timestep != -1) continue;
-            if(other_entity->respawn_timestep != -1) continue;
-            // Store original relative positions
-            float dx = other_entity->x - ego_entity->x;
-            float dy = other_entity->y - ego_entity->y;
+        int car_count = (ego_entity->respawn_timestep != -1) ? 0 : env->car_count;
+        float rel_x[MAX_CARS];
+        float rel_y[MAX_CARS];
+        float rel_heading_x[MAX_CARS];
+        float rel_heading_y[MAX_CARS];
+        int visible[MAX_CARS];
+        for(int j = 0; j < car_count; j++) {
+            float dx = env->car_x[j] - ego_entity->x;
+            float dy = env->car_y[j] - ego_entity->y;
             float dist = (dx*dx + dy*dy);
-            if(dist > 2500.0f) continue;
             // Rotate to ego vehicle's frame
-            float rel_x = dx*cos_heading + dy*sin_heading;
-            float rel_y = -dx*sin_heading + dy*cos_heading;
-            // Store observations with correct indexing
-            obs[obs_idx] = rel_x * 0.02f;
-            obs[obs_idx + 1] = rel_y * 0.02f;
-            obs[obs_idx + 2] = other_entity->width / MAX_VEH_WIDTH;
-            obs[obs_idx + 3] = other_entity->length / MAX_VEH_LEN;
-            // relative heading
-            float rel_heading_x = other_entity->heading_x * ego_entity->heading_x + 
-                     other_entity->heading_y * ego_entity->heading_y;  // cos(a-b) = cos(a)cos(b) + sin(a)sin(b)
-            float rel_heading_y = other_entity->heading_y * ego_entity->heading_x - 
-                                other_entity->heading_x * ego_entity->heading_y;  // sin(a-b) = sin(a)cos(b) - cos(a)sin(b)
-
-            obs[obs_idx + 4] = rel_heading_x;
-            obs[obs_idx + 5] = rel_heading_y;
-            // obs[obs_idx + 4] = cosf(rel_heading) / MAX_ORIENTATION_RAD;
-            // obs[obs_idx + 5] = sinf(rel_heading) / MAX_ORIENTATION_RAD;
-            // // relative speed
-            float other_speed = sqrtf(other_entity->vx*other_entity->vx + other_entity->vy*other_entity->vy);
-            obs[obs_idx + 6] = other_speed / MAX_SPEED;
+            rel_x[j] = (dx*cos_heading + dy*sin_heading) * 0.02f;
+            rel_y[j] = (-dx*sin_heading + dy*cos_heading) * 0.02f;
+            // cos(a-b) = cos(a)cos(b) + sin(a)sin(b), sin(a-b) = sin(a)cos(b) - cos(a)sin(b)
+            rel_heading_x[j] = env->car_heading_x[j]*cos_heading + env->car_heading_y[j]*sin_heading;
+            rel_heading_y[j] = env->car_heading_y[j]*cos_heading - env->car_heading_x[j]*sin_heading;
+            visible[j] = !(dist > 2500.0f) & !env->car_respawned[j];
+        }
+        // Active agents lead the car order, so the ego car sits at slot i
+        if(i < car_count) visible[i] = 0;
+        for(int j = 0; j < car_count; j++) {
+            if(!visible[j]) continue;
+            obs[obs_idx] = rel_x[j];
+            obs[obs_idx + 1] = rel_y[j];
+            obs[obs_idx + 2] = env->car_width[j];
+            obs[obs_idx + 3] = env->car_length[j];
+            obs[obs_idx + 4] = rel_heading_x[j];
+            obs[obs_idx + 5] = rel_heading_y[j];
+            obs[obs_idx + 6] = env->car_speed[j];
             cars_seen++;
             obs_idx += 7;  // Move to next observation slot
         }
@@ -121,6 +121,7 @@ int main() {
     srand(time(NULL)); // Seed random number generator
 
     DroneRace *env = calloc(1, sizeof(DroneRace));
+    puffer_seed(&env->rng, time(NULL));
     env->max_moves = 1000;
     env->max_rings = 10;
 
@@ -39,6 +39,7 @@ struct DroneRace {
     unsigned char *terminals;
 
     Log log;
+    uint64_t rng;
     int tick;
     int report_interval;
     int score;
@@ -132,8 +133,8 @@ void c_reset(DroneRace *env) {
 
     Drone *drone = &env->drone;
 
-    float size = rndf(0.05f, 0.8);
-    init_drone(drone, size, 0.1f);
+    float size = rndf(&env->rng, 0.05f, 0.8);
+    init_drone(drone, size, 0.1f, &env->rng);
     
     //init_drone(drone, 0.8f, 0.0f);
     //init_drone(drone, 0.05f, 0.0f);
@@ -141,18 +142,18 @@ void c_reset(DroneRace *env) {
     // creates rings at least MARGIN apart
     float ring_radius = 2.0f;
     if (env->max_rings + 1 > 0) {
-        env->ring_buffer[0] = rndring(ring_radius);
+        env->ring_buffer[0] = rndring(&env->rng, ring_radius);
     }
 
     for (int i = 1; i < env->max_rings + 1; i++) {
         do {
-            env->ring_buffer[i] = rndring(ring_radius);
+            env->ring_buffer[i] = rndring(&env->rng, ring_radius);
         } while (norm3(sub3(env->ring_buffer[i].pos, env->ring_buffer[i - 1].pos)) < 2.0f*ring_radius);
     }
 
     // start drone at least MARGIN away from the first ring
     do {
-        drone->pos = (Vec3){rndf(-9, 9), rndf(-9, 9), rndf(-9, 9)};
+        drone->pos = (Vec3){rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9)};
     } while (norm3(sub3(drone->pos, env->ring_buffer[0].pos)) < 2.0f*ring_radius);
 
     drone->prev_pos = drone->pos;
@@ -170,7 +171,7 @@ void c_step(DroneRace *env) {
     env->log.score = 0;
 
     Drone *drone = &env->drone;
-    move_drone(drone, env->actions);
+    move_drone(drone, env->actions, &env->rng);
 
     // check out of bounds
     bool out_of_bounds = drone->pos.x < -GRID_SIZE || drone->pos.x > GRID_SIZE ||
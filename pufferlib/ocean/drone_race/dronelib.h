@@ -11,6 +11,7 @@
 #include <time.h>
 
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 // Visualisation properties
 #define WIDTH 1080
@@ -70,8 +71,8 @@ static inline float clampf(float v, float min, float max) {
     return v;
 }
 
-static inline float rndf(float a, float b) {
-    return a + ((float)rand() / (float)RAND_MAX) * (b - a);
+static inline float rndf(uint64_t* rng, float a, float b) {
+    return a + puffer_randf(rng) * (b - a);
 }
 
 static inline Vec3 add3(Vec3 a, Vec3 b) { return (Vec3){a.x + b.x, a.y + b.y, a.z + b.z}; }
@@ -126,10 +127,10 @@ static inline Vec3 quat_rotate(Quat q, Vec3 v) {
 
 static inline Quat quat_inverse(Quat q) { return (Quat){q.w, -q.x, -q.y, -q.z}; }
 
-Quat rndquat() {
-    float u1 = rndf(0.0f, 1.0f);
-    float u2 = rndf(0.0f, 1.0f);
-    float u3 = rndf(0.0f, 1.0f);
+Quat rndquat(uint64_t* rng) {
+    float u1 = rndf(rng, 0.0f, 1.0f);
+    float u2 = rndf(rng, 0.0f, 1.0f);
+    float u3 = rndf(rng, 0.0f, 1.0f);
 
     float sqrt_1_minus_u1 = sqrtf(1.0f - u1);
     float sqrt_u1 = sqrtf(u1);
@@ -153,14 +154,14 @@ typedef struct {
     float radius;
 } Ring;
 
-Ring rndring(float radius) {
+Ring rndring(uint64_t* rng, float radius) {
     Ring ring;
 
-    ring.pos.x = rndf(-GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
-    ring.pos.y = rndf(-GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
-    ring.pos.z = rndf(-GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
+    ring.pos.x = rndf(rng, -GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
+    ring.pos.y = rndf(rng, -GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
+    ring.pos.z = rndf(rng, -GRID_SIZE + 2*radius, GRID_SIZE - 2*radius);
 
-    ring.orientation = rndquat();
+    ring.orientation = rndquat(rng);
 
     Vec3 base_normal = {0.0f, 0.0f, 1.0f};
     ring.normal = quat_rotate(ring.orientation, base_normal);
@@ -230,48 +231,48 @@ typedef struct {
 #define BASE_MAX_OMEGA 50.0f // rad/s
 
 
-void init_drone(Drone* drone, float size, float dr) {
+void init_drone(Drone* drone, float size, float dr, uint64_t* rng) {
 
     drone->arm_len = size / 2.0f;
 
     // m ~ x^3
     float mass_scale = powf(drone->arm_len, 3.0f) / powf(BASE_ARM_LEN, 3.0f);
-    drone->mass = BASE_MASS * mass_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->mass = BASE_MASS * mass_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // I ~ mx^2
     float base_Iscale = BASE_MASS * BASE_ARM_LEN * BASE_ARM_LEN;
     float I_scale = drone->mass * powf(drone->arm_len, 2.0f) / base_Iscale;
-    drone->ixx = BASE_IXX * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->iyy = BASE_IYY * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->izz = BASE_IZZ * I_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->ixx = BASE_IXX * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->iyy = BASE_IYY * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->izz = BASE_IZZ * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_thrust ~ m/l
     float k_thrust_scale = (drone->mass * drone->arm_len) / (BASE_MASS * BASE_ARM_LEN);
-    drone->k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_ang_damp ~ I
     float base_avg_inertia = (BASE_IXX + BASE_IYY + BASE_IZZ) / 3.0f;
     float avg_inertia = (drone->ixx + drone->iyy + drone->izz) / 3.0f;
     float avg_inertia_scale = avg_inertia / base_avg_inertia;
-    drone->k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // drag ~ x^2
     float drag_scale = powf(drone->arm_len, 2.0f) / powf(BASE_ARM_LEN, 2.0f);
-    drone->k_drag = BASE_K_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->b_drag = BASE_B_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_drag = BASE_K_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->b_drag = BASE_B_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // Small gravity randomization
-    drone->gravity = BASE_GRAVITY * rndf(0.99f, 1.01f);
+    drone->gravity = BASE_GRAVITY * rndf(rng, 0.99f, 1.01f);
 
     // RPM ~ 1/x
     float rpm_scale = (BASE_ARM_LEN) / (drone->arm_len);
-    drone->max_rpm = BASE_MAX_RPM * rpm_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->max_rpm = BASE_MAX_RPM * rpm_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     drone->max_vel = BASE_MAX_VEL;
     drone->max_omega = BASE_MAX_OMEGA;
 }
 
-void move_drone(Drone* drone, float* actions) {
+void move_drone(Drone* drone, float* actions, uint64_t* rng) {
     clamp4(actions, -1.0f, 1.0f);
 
     // motor thrusts
@@ -318,7 +319,7 @@ void move_drone(Drone* drone, float* actions) {
     q_dot.z *= 0.5f;
 
     // Domain randomized dt
-    float dt = DT * rndf(1.0f - DT_RNG, 1.0 + DT_RNG);
+    float dt = DT * rndf(rng, 1.0f - DT_RNG, 1.0 + DT_RNG);
 
     // integrations
     drone->pos.x += drone->vel.x * dt;
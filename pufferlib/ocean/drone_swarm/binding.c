@@ -6,7 +6,11 @@
 static int my_init(Env *env, PyObject *args, PyObject *kwargs) {
     env->num_agents = unpack(kwargs, "num_agents");
     env->max_rings = unpack(kwargs, "max_rings");
-    init(env);
+    env->naive_neighbors = unpack(kwargs, "naive_neighbors");
+    if (!init(env)) {
+        PyErr_NoMemory();
+        return -1;
+    }
     return 0;
 }
 
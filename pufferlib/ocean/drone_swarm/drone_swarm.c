@@ -121,10 +121,15 @@ int main() {
     srand(time(NULL)); // Seed random number generator
 
     DroneSwarm *env = calloc(1, sizeof(DroneSwarm));
+    puffer_seed(&env->rng, time(NULL));
     env->num_agents = 64;
     env->max_rings = 10;
     env->task = TASK_ORBIT;
-    init(env);
+    if (!init(env)) {
+        fprintf(stderr, "ERROR: Failed to allocate the neighbor grid.\n");
+        free(env);
+        return 0;
+    }
 
     size_t obs_size = 41;
     size_t act_size = 4;
@@ -147,7 +152,6 @@ int main() {
         return 0;
     }
 
-    init(env);
     c_reset(env);
 
 #ifdef __EMSCRIPTEN__
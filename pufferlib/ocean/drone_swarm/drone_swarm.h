@@ -12,6 +12,7 @@
 
 #include "raylib.h"
 #include "dronelib.h"
+#include "../spatial_grid.h"
 
 #define TASK_IDLE 0
 #define TASK_HOVER 1
@@ -68,6 +69,7 @@ typedef struct {
     unsigned char *terminals;
 
     Log log;
+    uint64_t rng;
     int tick;
     int report_interval;
 
@@ -79,13 +81,44 @@ typedef struct {
     Ring* ring_buffer;
 
     Client *client;
+
+    // Drone positions for nearest_drone. Set naive_neighbors to scan all
+    // drones instead, which gives the same results
+    SpatialGrid grid;
+    int naive_neighbors;
 } DroneSwarm;
 
-void init(DroneSwarm *env) {
+// Returns false if the neighbor grid cannot be allocated
+bool init(DroneSwarm *env) {
     env->agents = calloc(env->num_agents, sizeof(Drone));
     env->ring_buffer = calloc(env->max_rings, sizeof(Ring));
     env->log = (Log){0};
     env->tick = 0;
+
+    // Cells sized for about one drone each, but no smaller than the 1.0
+    // collision radius
+    float lo[3] = {-GRID_X, -GRID_Y, -GRID_Z};
+    float hi[3] = {GRID_X, GRID_Y, GRID_Z};
+    float volume = 8.0f*GRID_X*GRID_Y*GRID_Z;
+    float cell = fmaxf(cbrtf(volume/env->num_agents), 1.0f);
+    int dims[3];
+    for (int d = 0; d < 3; d++) {
+        dims[d] = (hi[d] - lo[d]) / cell;
+        dims[d] = (dims[d] < 1) ? 1 : (dims[d] > 64) ? 64 : dims[d];
+    }
+    if (!grid_init(&env->grid, lo, hi, dims, env->num_agents)) {
+        return false;
+    }
+    grid_build(&env->grid, &env->agents[0].pos.x, sizeof(Drone), env->num_agents);
+    return true;
+}
+
+static inline void update_cell(DroneSwarm *env, Drone *agent) {
+    grid_move(&env->grid, agent - env->agents, agent->pos.x, agent->pos.y, agent->pos.z);
+}
+
+bool skip_self(void* ctx, int idx) {
+    return idx == *(int*)ctx;
 }
 
 void add_log(DroneSwarm *env, int idx, bool oob) {
@@ -104,8 +137,18 @@ void add_log(DroneSwarm *env, int idx, bool oob) {
     agent->episode_return = 0.0f;
 }
 
+// Compares squared distances, so ties go to the lower index in both paths
 Drone* nearest_drone(DroneSwarm* env, Drone *agent) {
-    float min_dist = 999999.0f;
+    if (!env->naive_neighbors) {
+        int self = agent - env->agents;
+        int idx = -1;
+        float dist = FLT_MAX;
+        int found = grid_knn(&env->grid, &env->agents[0].pos.x, sizeof(Drone),
+            agent->pos.x, agent->pos.y, agent->pos.z, 1, &idx, &dist, skip_self, &self);
+        return (found == 0) ? NULL : &env->agents[idx];
+    }
+
+    float min_dist = FLT_MAX;
     Drone *nearest = NULL;
     for (int i = 0; i < env->num_agents; i++) {
         Drone *other = &env->agents[i];
@@ -115,7 +158,7 @@ Drone* nearest_drone(DroneSwarm* env, Drone *agent) {
         float dx = agent->pos.x - other->pos.x;
         float dy = agent->pos.y - other->pos.y;
         float dz = agent->pos.z - other->pos.z;
-        float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+        float dist = dx*dx + dy*dy + dz*dz;
         if (dist < min_dist) {
             min_dist = dist;
             nearest = other;
@@ -233,8 +276,8 @@ void move_target(DroneSwarm* env, Drone *agent) {
 
 void set_target_idle(DroneSwarm* env, int idx) {
     Drone *agent = &env->agents[idx];
-    agent->target_pos = (Vec3){rndf(-MARGIN_X, MARGIN_X), rndf(-MARGIN_Y, MARGIN_Y), rndf(-MARGIN_Z, MARGIN_Z)};
-    agent->target_vel = (Vec3){rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET)};
+    agent->target_pos = (Vec3){rndf(&env->rng, -MARGIN_X, MARGIN_X), rndf(&env->rng, -MARGIN_Y, MARGIN_Y), rndf(&env->rng, -MARGIN_Z, MARGIN_Z)};
+    agent->target_vel = (Vec3){rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET)};
 }
 
 void set_target_hover(DroneSwarm* env, int idx) {
@@ -380,8 +423,9 @@ void reset_agent(DroneSwarm* env, Drone *agent, int idx) {
     agent->episode_length = 0;
     agent->collisions = 0.0f;
     agent->score = 0.0f;
-    agent->pos = (Vec3){rndf(-9, 9), rndf(-9, 9), rndf(-9, 9)};
+    agent->pos = (Vec3){rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9)};
     agent->spawn_pos = agent->pos;
+    update_cell(env, agent);
     agent->vel = (Vec3){0.0f, 0.0f, 0.0f};
     agent->omega = (Vec3){0.0f, 0.0f, 0.0f};
     agent->quat = (Quat){1.0f, 0.0f, 0.0f, 0.0f};
@@ -389,22 +433,22 @@ void reset_agent(DroneSwarm* env, Drone *agent, int idx) {
 
     //float size = 0.2f;
     //init_drone(agent, size, 0.0f);
-    float size = rndf(0.1f, 0.4);
-    init_drone(agent, size, 0.1f);
+    float size = rndf(&env->rng, 0.1f, 0.4);
+    init_drone(agent, size, 0.1f, &env->rng);
     compute_reward(env, agent, env->task != TASK_RACE);
 }
 
 void c_reset(DroneSwarm *env) {
     env->tick = 0;
-    //env->task = rand() % (TASK_N - 1);
+    //env->task = puffer_rand(&env->rng) % (TASK_N - 1);
     //env->task = TASK_FLAG;
     env->task = TASK_CONGO;
-    //env->task = rand() % (TASK_N - 1);
+    //env->task = puffer_rand(&env->rng) % (TASK_N - 1);
     /*
-    if (rand() % 4) {
+    if (puffer_rand(&env->rng) % 4) {
         env->task = TASK_RACE;
     } else {
-        env->task = rand() % (TASK_N - 1);
+        env->task = puffer_rand(&env->rng) % (TASK_N - 1);
     }
     */
     //env->task = TASK_RACE;
@@ -424,12 +468,12 @@ void c_reset(DroneSwarm *env) {
     if (env->task == TASK_RACE) {
         float ring_radius = 2.0f;
         if (env->max_rings + 1 > 0) {
-            env->ring_buffer[0] = rndring(ring_radius);
+            env->ring_buffer[0] = rndring(&env->rng, ring_radius);
         }
 
         for (int i = 1; i < env->max_rings; i++) {
             do {
-                env->ring_buffer[i] = rndring(ring_radius);
+                env->ring_buffer[i] = rndring(&env->rng, ring_radius);
             } while (norm3(sub3(env->ring_buffer[i].pos, env->ring_buffer[i - 1].pos)) < 2.0f*ring_radius);
         }
 
@@ -437,8 +481,9 @@ void c_reset(DroneSwarm *env) {
         for (int i = 0; i < env->num_agents; i++) {
             Drone *drone = &env->agents[i];
             do {
-                drone->pos = (Vec3){rndf(-9, 9), rndf(-9, 9), rndf(-9, 9)};
+                drone->pos = (Vec3){rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9), rndf(&env->rng, -9, 9)};
             } while (norm3(sub3(drone->pos, env->ring_buffer[0].pos)) < 2.0f*ring_radius);
+            update_cell(env, drone);
         }
     }
  
@@ -453,7 +498,8 @@ void c_step(DroneSwarm *env) {
         env->terminals[i] = 0;
 
         float* atn = &env->actions[4*i];
-        move_drone(agent, atn);
+        move_drone(agent, atn, &env->rng);
+        update_cell(env, agent);
 
         // check out of bounds
         bool out_of_bounds = agent->pos.x < -GRID_X || agent->pos.x > GRID_X ||
@@ -505,6 +551,7 @@ void c_close_client(Client *client) {
 }
 
 void c_close(DroneSwarm *env) {
+    grid_free(&env->grid);
     if (env->client != NULL) {
         c_close_client(env->client);
     }
@@ -14,6 +14,7 @@ class DroneSwarm(pufferlib.PufferEnv):
         report_interval=1024,
         buf=None,
         seed=0,
+        naive_neighbors=False,
     ):
         self.single_observation_space = gymnasium.spaces.Box(
             low=-1,
@@ -45,6 +46,7 @@ class DroneSwarm(pufferlib.PufferEnv):
                 i,
                 num_agents=num_drones,
                 max_rings=max_rings,
+                naive_neighbors=naive_neighbors,
             ))
 
         self.c_envs = binding.vectorize(*c_envs)
@@ -11,6 +11,7 @@
 #include <time.h>
 
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 // Visualisation properties
 #define WIDTH 1080
@@ -77,8 +78,8 @@ static inline float clampf(float v, float min, float max) {
     return v;
 }
 
-static inline float rndf(float a, float b) {
-    return a + ((float)rand() / (float)RAND_MAX) * (b - a);
+static inline float rndf(uint64_t* rng, float a, float b) {
+    return a + puffer_randf(rng) * (b - a);
 }
 
 static inline Vec3 add3(Vec3 a, Vec3 b) { return (Vec3){a.x + b.x, a.y + b.y, a.z + b.z}; }
@@ -133,10 +134,10 @@ static inline Vec3 quat_rotate(Quat q, Vec3 v) {
 
 static inline Quat quat_inverse(Quat q) { return (Quat){q.w, -q.x, -q.y, -q.z}; }
 
-Quat rndquat() {
-    float u1 = rndf(0.0f, 1.0f);
-    float u2 = rndf(0.0f, 1.0f);
-    float u3 = rndf(0.0f, 1.0f);
+Quat rndquat(uint64_t* rng) {
+    float u1 = rndf(rng, 0.0f, 1.0f);
+    float u2 = rndf(rng, 0.0f, 1.0f);
+    float u3 = rndf(rng, 0.0f, 1.0f);
 
     float sqrt_1_minus_u1 = sqrtf(1.0f - u1);
     float sqrt_u1 = sqrtf(u1);
@@ -160,14 +161,14 @@ typedef struct {
     float radius;
 } Ring;
 
-Ring rndring(float radius) {
+Ring rndring(uint64_t* rng, float radius) {
     Ring ring;
 
-    ring.pos.x = rndf(-GRID_X + 2*radius, GRID_X - 2*radius);
-    ring.pos.y = rndf(-GRID_Y + 2*radius, GRID_Y - 2*radius);
-    ring.pos.z = rndf(-GRID_Z + 2*radius, GRID_Z - 2*radius);
+    ring.pos.x = rndf(rng, -GRID_X + 2*radius, GRID_X - 2*radius);
+    ring.pos.y = rndf(rng, -GRID_Y + 2*radius, GRID_Y - 2*radius);
+    ring.pos.z = rndf(rng, -GRID_Z + 2*radius, GRID_Z - 2*radius);
 
-    ring.orientation = rndquat();
+    ring.orientation = rndquat(rng);
 
     Vec3 base_normal = {0.0f, 0.0f, 1.0f};
     ring.normal = quat_rotate(ring.orientation, base_normal);
@@ -225,41 +226,41 @@ typedef struct {
 } Drone;
 
 
-void init_drone(Drone* drone, float size, float dr) {
+void init_drone(Drone* drone, float size, float dr, uint64_t* rng) {
     drone->arm_len = size / 2.0f;
 
     // m ~ x^3
     float mass_scale = powf(drone->arm_len, 3.0f) / powf(BASE_ARM_LEN, 3.0f);
-    drone->mass = BASE_MASS * mass_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->mass = BASE_MASS * mass_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // I ~ mx^2
     float base_Iscale = BASE_MASS * BASE_ARM_LEN * BASE_ARM_LEN;
     float I_scale = drone->mass * powf(drone->arm_len, 2.0f) / base_Iscale;
-    drone->ixx = BASE_IXX * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->iyy = BASE_IYY * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->izz = BASE_IZZ * I_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->ixx = BASE_IXX * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->iyy = BASE_IYY * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->izz = BASE_IZZ * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_thrust ~ m/l
     float k_thrust_scale = (drone->mass * drone->arm_len) / (BASE_MASS * BASE_ARM_LEN);
-    drone->k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_ang_damp ~ I
     float base_avg_inertia = (BASE_IXX + BASE_IYY + BASE_IZZ) / 3.0f;
     float avg_inertia = (drone->ixx + drone->iyy + drone->izz) / 3.0f;
     float avg_inertia_scale = avg_inertia / base_avg_inertia;
-    drone->k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // drag ~ x^2
     float drag_scale = powf(drone->arm_len, 2.0f) / powf(BASE_ARM_LEN, 2.0f);
-    drone->k_drag = BASE_K_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->b_drag = BASE_B_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_drag = BASE_K_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->b_drag = BASE_B_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // Small gravity randomization
-    drone->gravity = BASE_GRAVITY * rndf(0.99f, 1.01f);
+    drone->gravity = BASE_GRAVITY * rndf(rng, 0.99f, 1.01f);
 
     // RPM ~ 1/x
     float rpm_scale = (BASE_ARM_LEN) / (drone->arm_len);
-    drone->max_rpm = BASE_MAX_RPM * rpm_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->max_rpm = BASE_MAX_RPM * rpm_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     drone->max_vel = BASE_MAX_VEL;
     drone->max_omega = BASE_MAX_OMEGA;
@@ -267,8 +268,8 @@ void init_drone(Drone* drone, float size, float dr) {
     for (int i = 0; i < 4; i++) {
         drone->rpms[i] = 0.0f;
     }
-    drone->k_mot = BASE_K_MOT * rndf(1.0f - dr, 1.0f + dr);
-    drone->j_mot = BASE_J_MOT * I_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->k_mot = BASE_K_MOT * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->j_mot = BASE_J_MOT * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 }
 
 void explicit_euler(Drone* drone, Vec3 v_dot, Quat q_dot, Vec3 w_dot, float rpm_dot[4], float dt) {
@@ -295,7 +296,7 @@ void explicit_euler(Drone* drone, Vec3 v_dot, Quat q_dot, Vec3 w_dot, float rpm_
     drone->rpms[3] += rpm_dot[3] * dt;
 }
 
-void move_drone(Drone* drone, float* actions) {
+void move_drone(Drone* drone, float* actions, uint64_t* rng) {
     // Physics outlined in: 
     // https://pmc.ncbi.nlm.nih.gov/articles/PMC10468397/pdf/41586_2023_Article_6419.pdf
     clamp4(actions, -1.0f, 1.0f);
@@ -372,7 +373,7 @@ void move_drone(Drone* drone, float* actions) {
     w_dot.z = (Tau_prop.z + Tau_aero.z + Tau_iner.z + Tau_mot_z) / drone->izz;
 
     // Domain randomized dt
-    float dt = DT * rndf(1.0f - DT_RNG, 1.0 + DT_RNG);
+    float dt = DT * rndf(rng, 1.0f - DT_RNG, 1.0 + DT_RNG);
 
     // update drone state
     drone->prev_pos = drone->pos;
@@ -61,7 +61,7 @@ int demo() {
     }
 
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
     return 0;
 }
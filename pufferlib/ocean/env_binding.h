@@ -1,5 +1,8 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "puffer_rand.h"
 
 // Forward declarations for env-specific functions supplied by user
 static int my_log(PyObject* dict, Log* log);
@@ -144,7 +147,7 @@ static PyObject* env_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     int seed = PyLong_AsLong(seed_arg);
  
     // Assumes each process has the same number of environments
-    srand(seed);
+    puffer_seed(&env->rng, seed);
 
     // If kwargs is NULL, create a new dictionary
     if (kwargs == NULL) {
@@ -259,11 +262,238 @@ static PyObject* env_put(PyObject* self, PyObject* args, PyObject* kwargs) {
     Py_RETURN_NONE;
 }
 
+// Busy-wait iterations before a pool thread parks on its condvar.
+// Back-to-back vec_step calls are picked up without a syscall, but
+// threads still sleep while the policy runs
+#define VEC_POOL_SPIN 4096
+
+struct VecEnv;
+
 typedef struct {
+    struct VecEnv* vec;
+    pthread_t thread;
+    int idx;
+    int seen;
+} VecWorker;
+
+typedef struct VecEnv {
     Env** envs;
     int num_envs;
+
+    // Optional persistent pool for vec_step. Each job's env range is split
+    // into num_threads contiguous chunks. The caller steps chunk 0 until
+    // the first vec_step_async, which starts a thread for it
+    int num_threads;
+    VecWorker* workers;
+    pthread_mutex_t pool_lock;
+    pthread_cond_t pool_start;
+    pthread_cond_t pool_done;
+    atomic_int pool_generation;
+    atomic_int pool_pending;
+    int pool_shutdown;
+    int pool_detached;
+    int job_start;
+    int job_end;
+    int async_pending;
 } VecEnv;
 
+static void vec_step_range(VecEnv* vec, int start, int end) {
+    for (int i = start; i < end; i++) {
+        c_step(vec->envs[i]);
+    }
+}
+
+static void vec_pool_chunk(VecEnv* vec, int idx, int* start, int* end) {
+    long n = vec->job_end - vec->job_start;
+    *start = vec->job_start + idx*n/vec->num_threads;
+    *end = vec->job_start + (idx + 1)*n/vec->num_threads;
+}
+
+static void* vec_pool_loop(void* arg) {
+    VecWorker* worker = (VecWorker*)arg;
+    VecEnv* vec = worker->vec;
+    int seen = worker->seen;
+    while (1) {
+        for (int spin = 0; spin < VEC_POOL_SPIN; spin++) {
+            if (atomic_load_explicit(&vec->pool_generation, memory_order_acquire) != seen) {
+                break;
+            }
+        }
+        if (atomic_load_explicit(&vec->pool_generation, memory_order_acquire) == seen) {
+            pthread_mutex_lock(&vec->pool_lock);
+            while (atomic_load_explicit(&vec->pool_generation, memory_order_acquire) == seen) {
+                pthread_cond_wait(&vec->pool_start, &vec->pool_lock);
+            }
+            pthread_mutex_unlock(&vec->pool_lock);
+        }
+        seen = atomic_load_explicit(&vec->pool_generation, memory_order_acquire);
+        if (vec->pool_shutdown) {
+            return NULL;
+        }
+
+        int start, end;
+        vec_pool_chunk(vec, worker->idx, &start, &end);
+        vec_step_range(vec, start, end);
+
+        // Last worker out wakes the caller
+        if (atomic_fetch_sub_explicit(&vec->pool_pending, 1, memory_order_acq_rel) == 1) {
+            pthread_mutex_lock(&vec->pool_lock);
+            pthread_cond_signal(&vec->pool_done);
+            pthread_mutex_unlock(&vec->pool_lock);
+        }
+    }
+}
+
+// Publishes envs [start, end) as a new generation. The previous job
+// must already be joined
+static void vec_pool_publish(VecEnv* vec, int start, int end) {
+    vec->job_start = start;
+    vec->job_end = end;
+    int threads = vec->pool_detached ? vec->num_threads : vec->num_threads - 1;
+    atomic_store_explicit(&vec->pool_pending, threads, memory_order_relaxed);
+    pthread_mutex_lock(&vec->pool_lock);
+    atomic_fetch_add_explicit(&vec->pool_generation, 1, memory_order_release);
+    pthread_cond_broadcast(&vec->pool_start);
+    pthread_mutex_unlock(&vec->pool_lock);
+}
+
+static void vec_pool_join(VecEnv* vec) {
+    for (int spin = 0; spin < VEC_POOL_SPIN; spin++) {
+        if (atomic_load_explicit(&vec->pool_pending, memory_order_acquire) == 0) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&vec->pool_lock);
+    while (atomic_load_explicit(&vec->pool_pending, memory_order_acquire) > 0) {
+        pthread_cond_wait(&vec->pool_done, &vec->pool_lock);
+    }
+    pthread_mutex_unlock(&vec->pool_lock);
+}
+
+// Steps all envs on the pool, including the caller's chunk, then joins.
+// Must be called without the GIL held
+static void vec_pool_step(VecEnv* vec) {
+    vec_pool_publish(vec, 0, vec->num_envs);
+    if (!vec->pool_detached) {
+        int start, end;
+        vec_pool_chunk(vec, 0, &start, &end);
+        vec_step_range(vec, start, end);
+    }
+    vec_pool_join(vec);
+}
+
+// Gives chunk 0 its own thread so jobs can run while the caller returns
+// to Python. Returns -1 if the thread could not be started
+static int vec_pool_detach(VecEnv* vec) {
+    if (vec->pool_detached) {
+        return 0;
+    }
+    VecWorker* worker = &vec->workers[0];
+    worker->seen = atomic_load_explicit(&vec->pool_generation, memory_order_acquire);
+    if (pthread_create(&worker->thread, NULL, vec_pool_loop, worker) != 0) {
+        return -1;
+    }
+    vec->pool_detached = 1;
+    return 0;
+}
+
+// Joins an outstanding vec_step_async job. Call with the GIL held
+static void vec_wait_async(VecEnv* vec) {
+    if (!vec->async_pending) {
+        return;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    vec_pool_join(vec);
+    Py_END_ALLOW_THREADS
+    vec->async_pending = 0;
+}
+
+static int vec_pool_init(VecEnv* vec, int num_threads) {
+    if (num_threads > vec->num_envs) {
+        num_threads = vec->num_envs;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    vec->workers = (VecWorker*)calloc(num_threads, sizeof(VecWorker));
+    if (!vec->workers) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env thread pool");
+        return -1;
+    }
+
+    pthread_mutex_init(&vec->pool_lock, NULL);
+    pthread_cond_init(&vec->pool_start, NULL);
+    pthread_cond_init(&vec->pool_done, NULL);
+    atomic_init(&vec->pool_generation, 0);
+    atomic_init(&vec->pool_pending, 0);
+    vec->pool_shutdown = 0;
+    vec->pool_detached = 0;
+    vec->async_pending = 0;
+    vec->num_threads = num_threads;
+
+    for (int t = 0; t < num_threads; t++) {
+        VecWorker* worker = &vec->workers[t];
+        worker->vec = vec;
+        worker->idx = t;
+        worker->seen = 0;
+    }
+
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&vec->workers[t].thread, NULL, vec_pool_loop, &vec->workers[t]) != 0) {
+            // Run with the threads we managed to start
+            vec->num_threads = t;
+            break;
+        }
+    }
+    return 0;
+}
+
+static void vec_pool_close(VecEnv* vec) {
+    if (!vec->workers) {
+        return;
+    }
+
+    pthread_mutex_lock(&vec->pool_lock);
+    vec->pool_shutdown = 1;
+    atomic_fetch_add_explicit(&vec->pool_generation, 1, memory_order_release);
+    pthread_cond_broadcast(&vec->pool_start);
+    pthread_mutex_unlock(&vec->pool_lock);
+
+    int first = vec->pool_detached ? 0 : 1;
+    for (int t = first; t < vec->num_threads; t++) {
+        pthread_join(vec->workers[t].thread, NULL);
+    }
+    pthread_cond_destroy(&vec->pool_start);
+    pthread_cond_destroy(&vec->pool_done);
+    pthread_mutex_destroy(&vec->pool_lock);
+    free(vec->workers);
+    vec->workers = NULL;
+    vec->num_threads = 1;
+    vec->pool_detached = 0;
+}
+
+// Reads the optional num_threads kwarg. Returns -1 with a Python error set
+static int unpack_num_threads(PyObject* kwargs) {
+    if (kwargs == NULL) {
+        return 1;
+    }
+    PyObject* val = PyDict_GetItemString(kwargs, "num_threads");
+    if (val == NULL || val == Py_None) {
+        return 1;
+    }
+    if (!PyLong_Check(val)) {
+        PyErr_SetString(PyExc_TypeError, "num_threads must be an integer");
+        return -1;
+    }
+    long num_threads = PyLong_AsLong(val);
+    if (num_threads < 1 || num_threads > 4096) {
+        PyErr_SetString(PyExc_ValueError, "num_threads must be between 1 and 4096");
+        return -1;
+    }
+    return num_threads;
+}
+
 static VecEnv* unpack_vecenv(PyObject* args) {
     PyObject* handle_obj = PyTuple_GetItem(args, 0);
     if (!PyObject_TypeCheck(handle_obj, &PyLong_Type)) {
@@ -395,6 +625,11 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         return NULL;
     }
 
+    int num_threads = unpack_num_threads(kwargs);
+    if (num_threads < 0) {
+        return NULL;
+    }
+
     // If kwargs is NULL, create a new dictionary
     if (kwargs == NULL) {
         kwargs = PyDict_New();
@@ -422,7 +657,7 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
 
         // Assumes each process has the same number of environments
         int env_seed = i + seed*vec->num_envs;
-        srand(env_seed);
+        puffer_seed(&env->rng, env_seed);
  
         // Add the seed to kwargs for this environment
         PyObject* py_seed = PyLong_FromLong(env_seed);
@@ -442,12 +677,15 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     }
 
     Py_DECREF(kwargs);
+    if (vec_pool_init(vec, num_threads) < 0) {
+        return NULL;
+    }
     return PyLong_FromVoidPtr(vec);
 }
 
 
 // Python function to close the environment
-static PyObject* vectorize(PyObject* self, PyObject* args) {
+static PyObject* vectorize(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_envs = PyTuple_Size(args);
     if (num_envs == 0) {
         PyErr_SetString(PyExc_TypeError, "make_vec requires at least 1 env id");
@@ -476,6 +714,10 @@ static PyObject* vectorize(PyObject* self, PyObject* args) {
         vec->envs[i] = (Env*)PyLong_AsVoidPtr(handle_obj);
     }
 
+    int num_threads = unpack_num_threads(kwargs);
+    if (num_threads < 0 || vec_pool_init(vec, num_threads) < 0) {
+        return NULL;
+    }
     return PyLong_FromVoidPtr(vec);
 }
 
@@ -497,9 +739,10 @@ static PyObject* vec_reset(PyObject* self, PyObject* args) {
     }
     int seed = PyLong_AsLong(seed_arg);
  
+    vec_wait_async(vec);
     for (int i = 0; i < vec->num_envs; i++) {
         // Assumes each process has the same number of environments
-        srand(i + seed*vec->num_envs);
+        puffer_seed(&vec->envs[i]->rng, i + seed*vec->num_envs);
         c_reset(vec->envs[i]);
     }
     Py_RETURN_NONE;
@@ -517,8 +760,87 @@ static PyObject* vec_step(PyObject* self, PyObject* arg) {
         return NULL;
     }
 
-    for (int i = 0; i < vec->num_envs; i++) {
-        c_step(vec->envs[i]);
+    vec_wait_async(vec);
+    if (vec->num_threads > 1 || vec->pool_detached) {
+        Py_BEGIN_ALLOW_THREADS
+        vec_pool_step(vec);
+        Py_END_ALLOW_THREADS
+    } else {
+        vec_step_range(vec, 0, vec->num_envs);
+    }
+    Py_RETURN_NONE;
+}
+
+// Starts stepping envs [start, end) on the pool and returns without
+// waiting. Results are valid after vec_wait or any other vec_* call
+static PyObject* vec_step_async(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 3) {
+        PyErr_SetString(PyExc_TypeError, "vec_step_async requires 3 arguments");
+        return NULL;
+    }
+
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+
+    int start = PyLong_AsLong(PyTuple_GetItem(args, 1));
+    int end = PyLong_AsLong(PyTuple_GetItem(args, 2));
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (start < 0 || end > vec->num_envs || start > end) {
+        PyErr_SetString(PyExc_ValueError, "vec_step_async env range out of bounds");
+        return NULL;
+    }
+
+    vec_wait_async(vec);
+    if (vec_pool_detach(vec) < 0) {
+        // No spare thread. Step inline so callers still see results
+        Py_BEGIN_ALLOW_THREADS
+        vec_step_range(vec, start, end);
+        Py_END_ALLOW_THREADS
+        Py_RETURN_NONE;
+    }
+    vec_pool_publish(vec, start, end);
+    vec->async_pending = 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject* vec_wait(PyObject* self, PyObject* args) {
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    vec_wait_async(vec);
+    Py_RETURN_NONE;
+}
+
+// Resizes the thread pool of an existing vec env
+static PyObject* vec_threads(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 2) {
+        PyErr_SetString(PyExc_TypeError, "vec_threads requires 2 arguments");
+        return NULL;
+    }
+
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+
+    long num_threads = PyLong_AsLong(PyTuple_GetItem(args, 1));
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (num_threads < 1 || num_threads > 4096) {
+        PyErr_SetString(PyExc_ValueError, "num_threads must be between 1 and 4096");
+        return NULL;
+    }
+
+    vec_wait_async(vec);
+    vec_pool_close(vec);
+    if (vec_pool_init(vec, num_threads) < 0) {
+        return NULL;
     }
     Py_RETURN_NONE;
 }
@@ -543,6 +865,7 @@ static PyObject* vec_render(PyObject* self, PyObject* args) {
     }
     int env_id = PyLong_AsLong(env_id_arg);
  
+    vec_wait_async(vec);
     c_render(vec->envs[env_id]);
     Py_RETURN_NONE;
 }
@@ -567,6 +890,8 @@ static PyObject* vec_log(PyObject* self, PyObject* args) {
         return NULL;
     }
 
+    vec_wait_async(vec);
+
     // Iterates over logs one float at a time. Will break
     // horribly if Log has non-float data.
     Log aggregate = {0};
@@ -603,6 +928,8 @@ static PyObject* vec_close(PyObject* self, PyObject* args) {
         return NULL;
     }
 
+    vec_wait_async(vec);
+    vec_pool_close(vec);
     for (int i = 0; i < vec->num_envs; i++) {
         c_close(vec->envs[i]);
         free(vec->envs[i]);
@@ -649,10 +976,13 @@ static PyMethodDef methods[] = {
     {"env_close", env_close, METH_VARARGS, "Close the environment"},
     {"env_get", env_get, METH_VARARGS, "Get the environment state"},
     {"env_put", (PyCFunction)env_put, METH_VARARGS | METH_KEYWORDS, "Put stuff into env"},
-    {"vectorize", vectorize, METH_VARARGS, "Make a vector of environment handles"},
-    {"vec_init", (PyCFunction)vec_init, METH_VARARGS | METH_KEYWORDS, "Initialize a vector of environments"},
+    {"vectorize", (PyCFunction)vectorize, METH_VARARGS | METH_KEYWORDS, "Make a vector of environment handles"},
+    {"vec_init", (PyCFunction)vec_init, METH_VARARGS | METH_KEYWORDS, "Initialize a vector of environments. Optional num_threads steps them on a thread pool"},
     {"vec_reset", vec_reset, METH_VARARGS, "Reset the vector of environments"},
     {"vec_step", vec_step, METH_VARARGS, "Step the vector of environments"},
+    {"vec_step_async", vec_step_async, METH_VARARGS, "Start stepping a range of environments on the thread pool"},
+    {"vec_wait", vec_wait, METH_VARARGS, "Wait for the last vec_step_async"},
+    {"vec_threads", vec_threads, METH_VARARGS, "Resize the vec env thread pool"},
     {"vec_log", vec_log, METH_VARARGS, "Log the vector of environments"},
     {"vec_render", vec_render, METH_VARARGS, "Render the vector of environments"},
     {"vec_close", vec_close, METH_VARARGS, "Close the vector of environments"},
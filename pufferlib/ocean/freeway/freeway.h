@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include "freeway_levels.h"
 
 #define min(a, b) (((a) < (b)) ? (a) : (b))
@@ -69,6 +70,7 @@ typedef struct Freeway Freeway;
 struct Freeway {
     Client* client;
     Log log;
+    uint64_t rng;
     float* observations;
     int* actions;
     int* human_actions;
@@ -152,7 +154,7 @@ void init(Freeway* env) {
     env->enemies = (FreewayEnemy*)calloc(NUM_LANES*MAX_ENEMIES_PER_LANE, sizeof(FreewayEnemy));
     env->human_actions = (int*)calloc(1, sizeof(int));
     if ((env->level < 0) || (env->level >= NUM_LEVELS)) {
-        env->level = rand() % NUM_LEVELS;
+        env->level = puffer_rand(&env->rng) % NUM_LEVELS;
     }
     load_level(env, env->level);
 }
@@ -213,7 +215,7 @@ void spawn_enemies(Freeway* env) {
     float lane_offset_x;
     FreewayEnemy* enemy;
     for (int lane = 0; lane < NUM_LANES; lane++) {
-        lane_offset_x =  env->width * (rand() / (float) RAND_MAX);
+        lane_offset_x =  env->width * puffer_randf(&env->rng);
         for (int i = 0; i < MAX_ENEMIES_PER_LANE; i++){
             enemy = &env->enemies[lane * MAX_ENEMIES_PER_LANE + i];
             if (enemy->is_enabled){
@@ -294,7 +296,7 @@ void clip_enemy_position(Freeway* env, FreewayEnemy* enemy){
 void randomize_enemy_speed(Freeway* env) {
     FreewayEnemy* enemy;
     for (int lane = 0; lane < NUM_LANES; lane++) {
-        int delta_speed = (rand() % 3) - 1; // Randomly increase or decrease speed
+        int delta_speed = (puffer_rand(&env->rng) % 3) - 1; // Randomly increase or decrease speed
         for (int i = 0; i < MAX_ENEMIES_PER_LANE; i++) {
             if (enemy->speed_randomization) {
                 enemy = &env->enemies[lane*MAX_ENEMIES_PER_LANE + i];
@@ -4,7 +4,9 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define SIZE 4
 #define EMPTY 0
@@ -28,19 +30,16 @@ typedef struct {
 
 typedef struct {
     Log log;                        // Required
+    uint64_t rng;                   // Required
     unsigned char* observations;    // Cheaper in memory if encoded in uint_8
     int* actions;                   // Required
     float* rewards;                 // Required
     unsigned char* terminals;       // Required
     int score;
     int tick;
-    unsigned char grid[SIZE][SIZE];
+    uint64_t board;                 // 4-bit tile exponents, row-major, cell (i, j) at nibble i*SIZE + j
     float episode_reward;           // Accumulate episode reward
-    
-    // Cached values to avoid recomputation
     int empty_count;
-    bool game_over_cached;
-    bool grid_changed;
 } Game;
 
 // Precomputed color table for rendering optimization
@@ -73,24 +72,154 @@ void c_step(Game* env);
 void c_render(Game* env);
 void c_close(Game* env);
 
-// Inline function for updating observations (avoid function call overhead)
-static inline void update_observations(Game* game) {
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            game->observations[i * SIZE + j] = game->grid[i][j];
+#define ROW_MASK 0xFFFFULL
+#define MAX_EXPONENT 15
+
+// Row tables indexed by a 16-bit row of 4 exponents, cell 0 in the low nibble.
+// Left moves slide toward cell 0. Right moves use the reversed row. Tiles at
+// MAX_EXPONENT (32768) do not merge since the result would not fit a nibble
+static uint16_t row_left_table[65536];
+static uint16_t row_right_table[65536];
+static float row_left_reward[65536];
+static float row_right_reward[65536];
+static float row_heuristic[65536];
+static bool tables_ready = false;
+
+static inline uint16_t reverse_row(uint16_t row) {
+    return (row >> 12) | ((row >> 4) & 0x00F0) | ((row << 4) & 0x0F00) | (row << 12);
+}
+
+static inline unsigned char get_tile(uint64_t board, int pos) {
+    return (board >> (4*pos)) & 0xF;
+}
+
+// Must run once before any env steps. Not thread safe, so call it from init
+static void init_move_tables(void) {
+    if (tables_ready) {
+        return;
+    }
+    for (int row = 0; row < 65536; row++) {
+        unsigned char line[SIZE];
+        for (int i = 0; i < SIZE; i++) {
+            line[i] = (row >> (4*i)) & 0xF;
+        }
+
+        // Score the row for the expectimax baseline: empty cells, merge
+        // opportunities and monotonic ordering
+        int empty = 0;
+        int merges = 0;
+        int prev = 0;
+        int counter = 0;
+        float mono_left = 0;
+        float mono_right = 0;
+        for (int i = 0; i < SIZE; i++) {
+            if (line[i] == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (prev == line[i]) {
+                counter++;
+            } else if (counter > 0) {
+                merges += 1 + counter;
+                counter = 0;
+            }
+            prev = line[i];
+        }
+        if (counter > 0) {
+            merges += 1 + counter;
+        }
+        for (int i = 1; i < SIZE; i++) {
+            float a = line[i - 1]*line[i - 1];
+            float b = line[i]*line[i];
+            if (line[i - 1] > line[i]) {
+                mono_left += a - b;
+            } else {
+                mono_right += b - a;
+            }
+        }
+        row_heuristic[row] = 270.0f*empty + 700.0f*merges
+            - 47.0f*(mono_left < mono_right ? mono_left : mono_right);
+
+        // Slide then merge toward cell 0, one merge per tile
+        float reward = 0.0f;
+        unsigned char out[SIZE] = {0};
+        int write_pos = 0;
+        bool mergeable = false;
+        for (int i = 0; i < SIZE; i++) {
+            if (line[i] == EMPTY) {
+                continue;
+            }
+            if (mergeable && out[write_pos - 1] == line[i] && line[i] < MAX_EXPONENT) {
+                out[write_pos - 1]++;
+                reward += ((float)out[write_pos - 1]) * REWARD_MULTIPLIER;
+                mergeable = false;
+            } else {
+                out[write_pos++] = line[i];
+                mergeable = true;
+            }
         }
+
+        uint16_t result = 0;
+        for (int i = 0; i < SIZE; i++) {
+            result |= out[i] << (4*i);
+        }
+        uint16_t reversed = reverse_row(row);
+        row_left_table[row] = result;
+        row_left_reward[row] = reward;
+        row_right_table[reversed] = reverse_row(result);
+        row_right_reward[reversed] = reward;
     }
+    tables_ready = true;
+}
+
+// Swaps rows and columns so up/down moves can reuse the row tables
+static inline uint64_t transpose(uint64_t x) {
+    uint64_t a1 = x & 0xF0F00F0FF0F00F0FULL;
+    uint64_t a2 = x & 0x0000F0F00000F0F0ULL;
+    uint64_t a3 = x & 0x0F0F00000F0F0000ULL;
+    uint64_t a = a1 | (a2 << 12) | (a3 >> 12);
+    uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+    uint64_t b2 = a & 0x00FF00FF00000000ULL;
+    uint64_t b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+// One bit per empty cell, at the low bit of its nibble
+static inline uint64_t empty_mask(uint64_t board) {
+    board |= (board >> 2) & 0x3333333333333333ULL;
+    board |= (board >> 1);
+    return ~board & 0x1111111111111111ULL;
+}
+
+static inline int count_empty(uint64_t board) {
+    return __builtin_popcountll(empty_mask(board));
 }
 
-// Cache empty cell count during grid operations
-static inline void update_empty_count(Game* game) {
-    int count = 0;
+// Applies a move to a bitboard. Returns the new board, which equals the old
+// one if nothing moved
+static inline uint64_t apply_move(uint64_t board, int direction, float* reward) {
+    uint16_t* table = (direction == UP || direction == LEFT) ? row_left_table : row_right_table;
+    float* rewards = (direction == UP || direction == LEFT) ? row_left_reward : row_right_reward;
+    bool vertical = direction == UP || direction == DOWN;
+    uint64_t src = vertical ? transpose(board) : board;
+    uint64_t out = 0;
+    float total = 0.0f;
     for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            if (game->grid[i][j] == EMPTY) count++;
-        }
+        uint16_t row = (src >> (16*i)) & ROW_MASK;
+        out |= (uint64_t)table[row] << (16*i);
+        total += rewards[row];
+    }
+    *reward += total;
+    return vertical ? transpose(out) : out;
+}
+
+// Inline function for updating observations (avoid function call overhead)
+static inline void update_observations(Game* game) {
+    uint64_t board = game->board;
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        game->observations[i] = board & 0xF;
+        board >>= 4;
     }
-    game->empty_count = count;
 }
 
 void add_log(Game* game) {
@@ -101,32 +230,30 @@ void add_log(Game* game) {
     game->log.n += 1;
 }
 
-void c_reset(Game* game) {
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            game->grid[i][j] = EMPTY;
-        }
+// Places tile on the k-th empty cell
+static inline uint64_t place_tile(uint64_t board, int k, unsigned char tile) {
+    uint64_t empty = empty_mask(board);
+    for (int i = 0; i < k; i++) {
+        empty &= empty - 1;
     }
+    return board | ((empty & -empty) * tile);
+}
 
+void c_reset(Game* game) {
+    game->board = 0;
     game->score = 0;
     game->tick = 0;
     game->episode_reward = 0;
     game->empty_count = SIZE * SIZE;
-    game->game_over_cached = false;
-    game->grid_changed = true;
     
     if (game->terminals) game->terminals[0] = 0;
     
-    // Add two random tiles at the start - optimized version
-    for (int added = 0; added < 2; ) {
-        int pos = rand() % (SIZE * SIZE);
-        int i = pos / SIZE;
-        int j = pos % SIZE;
-        if (game->grid[i][j] == EMPTY) {
-            game->grid[i][j] = (rand() % 10 == 0) ? 2 : 1;
-            added++;
-            game->empty_count--;
-        }
+    // Add two random tiles at the start
+    for (int added = 0; added < 2; added++) {
+        int k = puffer_rand(&game->rng) % game->empty_count;
+        unsigned char tile = (puffer_rand(&game->rng) % 10 == 0) ? 2 : 1;
+        game->board = place_tile(game->board, k, tile);
+        game->empty_count--;
     }
     
     update_observations(game);
@@ -134,162 +261,46 @@ void c_reset(Game* game) {
 
 void add_random_tile(Game* game) {
     if (game->empty_count == 0) return;
-    
-    // Use reservoir sampling for better performance
-    int chosen_pos = -1;
-    int count = 0;
-    
-    for (int pos = 0; pos < SIZE * SIZE; pos++) {
-        int i = pos / SIZE;
-        int j = pos % SIZE;
-        if (game->grid[i][j] == EMPTY) {
-            count++;
-            if (rand() % count == 0) {
-                chosen_pos = pos;
-            }
-        }
-    }
-    
-    if (chosen_pos >= 0) {
-        int i = chosen_pos / SIZE;
-        int j = chosen_pos % SIZE;
-        game->grid[i][j] = (rand() % 10 == 0) ? 2 : 1;
-        game->empty_count--;
-        game->grid_changed = true;
-    }
-    
-    update_observations(game);
-}
-
-// Optimized slide and merge with fewer memory operations
-static inline bool slide_and_merge(unsigned char* row, float* reward) {
-    bool moved = false;
-    int write_pos = 0;
-    
-    // Single pass: slide and identify merge candidates
-    for (int read_pos = 0; read_pos < SIZE; read_pos++) {
-        if (row[read_pos] != EMPTY) {
-            if (write_pos != read_pos) {
-                row[write_pos] = row[read_pos];
-                row[read_pos] = EMPTY;
-                moved = true;
-            }
-            write_pos++;
-        }
-    }
-    
-    // Merge pass
-    for (int i = 0; i < SIZE - 1; i++) {
-        if (row[i] != EMPTY && row[i] == row[i + 1]) {
-            row[i]++;
-            *reward += ((float)row[i]) * REWARD_MULTIPLIER;
-            // Shift remaining elements left
-            for (int j = i + 1; j < SIZE - 1; j++) {
-                row[j] = row[j + 1];
-            }
-            row[SIZE - 1] = EMPTY;
-            moved = true;
-        }
-    }
-    
-    return moved;
+    int k = puffer_rand(&game->rng) % game->empty_count;
+    unsigned char tile = (puffer_rand(&game->rng) % 10 == 0) ? 2 : 1;
+    game->board = place_tile(game->board, k, tile);
+    game->empty_count--;
 }
 
 bool move(Game* game, int direction, float* reward) {
-    bool moved = false;
-    unsigned char temp[SIZE];
-    
-    if (direction == UP || direction == DOWN) {
-        for (int col = 0; col < SIZE; col++) {
-            // Extract column
-            for (int i = 0; i < SIZE; i++) {
-                int idx = (direction == UP) ? i : SIZE - 1 - i;
-                temp[i] = game->grid[idx][col];
-            }
-            
-            if (slide_and_merge(temp, reward)) {
-                moved = true;
-                // Write back column
-                for (int i = 0; i < SIZE; i++) {
-                    int idx = (direction == UP) ? i : SIZE - 1 - i;
-                    game->grid[idx][col] = temp[i];
-                }
-            }
-        }
-    } else {
-        for (int row = 0; row < SIZE; row++) {
-            // Extract row
-            for (int i = 0; i < SIZE; i++) {
-                int idx = (direction == LEFT) ? i : SIZE - 1 - i;
-                temp[i] = game->grid[row][idx];
-            }
-            
-            if (slide_and_merge(temp, reward)) {
-                moved = true;
-                // Write back row
-                for (int i = 0; i < SIZE; i++) {
-                    int idx = (direction == LEFT) ? i : SIZE - 1 - i;
-                    game->grid[row][idx] = temp[i];
-                }
-            }
-        }
-    }
+    uint64_t board = apply_move(game->board, direction, reward);
+    bool moved = board != game->board;
 
     if (!moved) {
         *reward = INVALID_MOVE_PENALTY;
     } else {
-        game->grid_changed = true;
-        game->game_over_cached = false; // Invalidate cache
+        game->board = board;
+        game->empty_count = count_empty(board);
     }
 
     return moved;
 }
 
 bool is_game_over(Game* game) {
-    // Use cached result if grid hasn't changed
-    if (!game->grid_changed && game->game_over_cached) {
-        return game->game_over_cached;
-    }
-    
     // Quick check: if there are empty cells, game is not over
     if (game->empty_count > 0) {
-        game->game_over_cached = false;
-        game->grid_changed = false;
         return false;
     }
-    
-    // Check for possible merges
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            unsigned char current = game->grid[i][j];
-            if (i < SIZE - 1 && current == game->grid[i + 1][j]) {
-                game->game_over_cached = false;
-                game->grid_changed = false;
-                return false;
-            }
-            if (j < SIZE - 1 && current == game->grid[i][j + 1]) {
-                game->game_over_cached = false;
-                game->grid_changed = false;
-                return false;
-            }
-        }
-    }
-    
-    game->game_over_cached = true;
-    game->grid_changed = false;
-    return true;
+    // On a full board, any merge shows up in a left or an up move
+    float reward = 0.0f;
+    return apply_move(game->board, LEFT, &reward) == game->board
+        && apply_move(game->board, UP, &reward) == game->board;
 }
 
-// Optimized score calculation
 static inline unsigned char calc_score(Game* game) {
     unsigned char max_tile = 0;
-    // Unroll loop for better performance
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            if (game->grid[i][j] > max_tile) {
-                max_tile = game->grid[i][j];
-            }
+    uint64_t board = game->board;
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        unsigned char tile = board & 0xF;
+        if (tile > max_tile) {
+            max_tile = tile;
         }
+        board >>= 4;
     }
     return max_tile;
 }
@@ -301,8 +312,10 @@ void c_step(Game* game) {
     
     if (did_move) {
         add_random_tile(game);
-        game->score = calc_score(game);
-        update_empty_count(game); // Update after adding tile
+        // Spawns are at most a 4, so past that only merges raise the max tile
+        if (reward > 0.0f || game->score < 2) {
+            game->score = calc_score(game);
+        }
     }
     
     bool game_over = is_game_over(game);
@@ -323,6 +336,78 @@ void c_step(Game* game) {
     }
 }
 
+// --- Expectimax scripted baseline ---
+// Depth counts player moves. Chance nodes average over every empty cell with
+// the 90/10 spawn split, so keep depth at 2-3
+
+// Below any heuristic value, so lost boards are always avoided
+#define EXPECTIMAX_GAME_OVER -1e9f
+
+static inline float board_heuristic(uint64_t board) {
+    uint64_t t = transpose(board);
+    float score = 0.0f;
+    for (int i = 0; i < SIZE; i++) {
+        score += row_heuristic[(board >> (16*i)) & ROW_MASK];
+        score += row_heuristic[(t >> (16*i)) & ROW_MASK];
+    }
+    return score;
+}
+
+static float expectimax_max(uint64_t board, int depth);
+
+static float expectimax_chance(uint64_t board, int depth) {
+    int empty = count_empty(board);
+    if (depth == 0 || empty == 0) {
+        return board_heuristic(board);
+    }
+    float total = 0.0f;
+    for (int pos = 0; pos < SIZE * SIZE; pos++) {
+        if (get_tile(board, pos) != EMPTY) {
+            continue;
+        }
+        uint64_t two = board | (1ULL << (4*pos));
+        uint64_t four = board | (2ULL << (4*pos));
+        total += 0.9f*expectimax_max(two, depth) + 0.1f*expectimax_max(four, depth);
+    }
+    return total / empty;
+}
+
+static float expectimax_max(uint64_t board, int depth) {
+    float best = -INFINITY;
+    for (int direction = UP; direction <= RIGHT; direction++) {
+        float reward = 0.0f;
+        uint64_t next = apply_move(board, direction, &reward);
+        if (next == board) {
+            continue;
+        }
+        float value = expectimax_chance(next, depth - 1);
+        if (value > best) {
+            best = value;
+        }
+    }
+    return best == -INFINITY ? EXPECTIMAX_GAME_OVER : best;
+}
+
+// Returns an action in the env's 0-3 encoding. Always a legal move unless the
+// game is over, in which case it is 0
+int expectimax_action(Game* game, int depth) {
+    int best_action = -1;
+    float best = -INFINITY;
+    for (int direction = UP; direction <= RIGHT; direction++) {
+        float reward = 0.0f;
+        uint64_t next = apply_move(game->board, direction, &reward);
+        if (next == game->board) {
+            continue;
+        }
+        float value = expectimax_chance(next, depth - 1);
+        if (best_action == -1 || value > best) {
+            best = value;
+            best_action = direction - 1;
+        }
+    }
+    return best_action == -1 ? 0 : best_action;
+}
+
 // Rendering optimizations
 void c_render(Game* game) {
     static bool window_initialized = false;
@@ -346,7 +431,7 @@ void c_render(Game* game) {
     // Draw grid
     for (int i = 0; i < SIZE; i++) {
         for (int j = 0; j < SIZE; j++) {
-            int val = game->grid[i][j];
+            int val = get_tile(game->board, i * SIZE + j);
             
             // Use precomputed colors
             Color color = (val == 0) ? tile_colors[0] : 
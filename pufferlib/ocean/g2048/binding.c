@@ -1,11 +1,15 @@
+#include <Python.h>
+
 #include "2048.h"
 
+static PyObject* expectimax_actions(PyObject* self, PyObject* args);
+
 #define Env Game
+#define MY_METHODS {"expectimax_actions", expectimax_actions, METH_VARARGS, "Write the expectimax baseline's action into each env's action slot"}
 #include "../env_binding.h"
 
-// 2048.h does not have a 'size' field, so my_init can just return 0
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
-    // No custom initialization needed for 2048
+    init_move_tables();
     return 0;
 }
 
@@ -15,4 +19,29 @@ static int my_log(PyObject* dict, Log* log) {
     assign_to_dict(dict, "episode_return", log->episode_return);
     assign_to_dict(dict, "episode_length", log->episode_length);
     return 0;
-}
\ No newline at end of file
+}
+
+static PyObject* expectimax_actions(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 2) {
+        PyErr_SetString(PyExc_TypeError, "expectimax_actions requires 2 arguments");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    int depth = PyLong_AsLong(PyTuple_GetItem(args, 1));
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (depth < 1) {
+        PyErr_SetString(PyExc_ValueError, "depth must be at least 1");
+        return NULL;
+    }
+    vec_wait_async(vec);
+    for (int i = 0; i < vec->num_envs; i++) {
+        Env* env = vec->envs[i];
+        env->actions[0] = expectimax_action(env, depth);
+    }
+    Py_RETURN_NONE;
+}
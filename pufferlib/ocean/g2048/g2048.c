@@ -1,9 +1,13 @@
 #include "2048.h"
 #include "puffernet.h"
 
-int main() {
+int main(int argc, char** argv) {
+    // Pass --expectimax to watch the scripted baseline instead of the policy
+    bool use_expectimax = argc > 1 && strcmp(argv[1], "--expectimax") == 0;
     srand(time(NULL));
+    init_move_tables();
     Game env;
+    puffer_seed(&env.rng, time(NULL));
     unsigned char observations[SIZE * SIZE] = {0};
     unsigned char terminals[1] = {0};
     int actions[1] = {0};
@@ -35,6 +39,9 @@ int main() {
             env.actions[0] = action - 1;
         } else if (frame % 10 != 0) {
             continue;
+        } else if (use_expectimax) {
+            action = 1;
+            env.actions[0] = expectimax_action(&env, 2);
         } else {
             action = 1;
             for (int i = 0; i < 16; i++) {
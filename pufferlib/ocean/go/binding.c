@@ -1,5 +1,11 @@
+#include <Python.h>
+
 #include "go.h"
+
+static PyObject* group_liberties(PyObject* self, PyObject* args);
+
 #define Env CGo
+#define MY_METHODS {"group_liberties", group_liberties, METH_VARARGS, "Per env, each point's group liberty count and find_group_liberty, 0 and -1 if empty"}
 #include "../env_binding.h"
 
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
@@ -31,3 +37,35 @@ static int my_log(PyObject* dict, Log* log) {
     assign_to_dict(dict, "n", log->n);
     return 0;
 }
+
+static PyObject* group_liberties(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 1) {
+        PyErr_SetString(PyExc_TypeError, "group_liberties requires 1 argument");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    vec_wait_async(vec);
+    PyObject* out = PyList_New(vec->num_envs);
+    for (int i = 0; i < vec->num_envs; i++) {
+        Env* env = vec->envs[i];
+        int num_points = env->grid_size*env->grid_size;
+        PyObject* liberties = PyList_New(num_points);
+        PyObject* first = PyList_New(num_points);
+        for (int pos = 0; pos < num_points; pos++) {
+            int count = 0;
+            int liberty = -1;
+            if (env->board_states[pos] != 0) {
+                int root = find(env->groups, pos);
+                count = env->groups[root].liberties;
+                liberty = find_group_liberty(env, root);
+            }
+            PyList_SET_ITEM(liberties, pos, PyLong_FromLong(count));
+            PyList_SET_ITEM(first, pos, PyLong_FromLong(liberty));
+        }
+        PyList_SET_ITEM(out, i, Py_BuildValue("(NN)", liberties, first));
+    }
+    return out;
+}
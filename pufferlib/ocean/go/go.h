@@ -3,7 +3,9 @@
 #include <math.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define NOOP 0
 #define MOVE_MIN 1
@@ -23,12 +25,74 @@ struct Log {
     float n;
 };
 
+// Stones live in bitboards with one bit per point, y*grid_size + x. Boards up
+// to GO_MAX_SIZE fit in GO_WORDS words
+#define GO_MAX_SIZE 19
+#define GO_MAX_POINTS (GO_MAX_SIZE*GO_MAX_SIZE)
+#define GO_WORDS ((GO_MAX_POINTS + 63)/64)
+
+typedef struct Bitboard Bitboard;
+struct Bitboard {
+    uint64_t w[GO_WORDS];
+};
+
+static inline void bb_set(Bitboard* b, int pos) {
+    b->w[pos >> 6] |= 1ULL << (pos & 63);
+}
+
+static inline void bb_clear(Bitboard* b, int pos) {
+    b->w[pos >> 6] &= ~(1ULL << (pos & 63));
+}
+
+static inline int bb_count(const Bitboard* b) {
+    int count = 0;
+    for (int i = 0; i < GO_WORDS; i++) {
+        count += __builtin_popcountll(b->w[i]);
+    }
+    return count;
+}
+
+// Lowest set position, or -1 if empty
+static inline int bb_first(const Bitboard* b) {
+    for (int i = 0; i < GO_WORDS; i++) {
+        if (b->w[i]) {
+            return i*64 + __builtin_ctzll(b->w[i]);
+        }
+    }
+    return -1;
+}
+
+// Shifts toward higher positions by n < 64 bits
+static inline Bitboard bb_shift_up(Bitboard b, int n) {
+    Bitboard out;
+    for (int i = GO_WORDS - 1; i > 0; i--) {
+        out.w[i] = (b.w[i] << n) | (b.w[i - 1] >> (64 - n));
+    }
+    out.w[0] = b.w[0] << n;
+    return out;
+}
+
+// Shifts toward lower positions by n < 64 bits
+static inline Bitboard bb_shift_down(Bitboard b, int n) {
+    Bitboard out;
+    for (int i = 0; i < GO_WORDS - 1; i++) {
+        out.w[i] = (b.w[i] >> n) | (b.w[i + 1] << (64 - n));
+    }
+    out.w[GO_WORDS - 1] = b.w[GO_WORDS - 1] >> n;
+    return out;
+}
+
+// Union-find group. Only the root's size, hash and liberties are meaningful.
+// next links every stone of a group into a circular list
 typedef struct Group Group;
 struct Group {
     int parent;
     int rank;
     int size;
     int liberties;
+    int next;
+    uint64_t hash;  // xor of the zobrist keys of the group's stones
+    Bitboard libs;
 };
 
 int find(Group* groups, int x) {
@@ -44,19 +108,50 @@ void union_groups(Group* groups, int pos1, int pos2) {
     if (pos1 == pos2) return;
     
     if (groups[pos1].rank < groups[pos2].rank) {
-        groups[pos1].parent = pos2;
-        groups[pos2].size += groups[pos1].size;
-        groups[pos2].liberties += groups[pos1].liberties;
-    } else if (groups[pos1].rank > groups[pos2].rank) {
-        groups[pos2].parent = pos1;
-        groups[pos1].size += groups[pos2].size;
-        groups[pos1].liberties += groups[pos2].liberties;
-    } else {
-        groups[pos2].parent = pos1;
+        int tmp = pos1;
+        pos1 = pos2;
+        pos2 = tmp;
+    } else if (groups[pos1].rank == groups[pos2].rank) {
         groups[pos1].rank++;
-        groups[pos1].size += groups[pos2].size;
-        groups[pos1].liberties += groups[pos2].liberties;
     }
+    Group* root = &groups[pos1];
+    Group* child = &groups[pos2];
+    child->parent = pos1;
+    root->size += child->size;
+    root->hash ^= child->hash;
+    for (int i = 0; i < GO_WORDS; i++) {
+        root->libs.w[i] |= child->libs.w[i];
+    }
+    root->liberties = bb_count(&root->libs);
+    // Splice the two circular stone lists
+    int next = root->next;
+    root->next = child->next;
+    child->next = next;
+}
+
+// Zobrist keys shared by every env. The empty board hashes to a nonzero key so
+// zero can mark free slots in the position history
+static uint64_t go_zobrist[2][GO_MAX_POINTS];
+static uint64_t go_zobrist_empty;
+static int go_zobrist_ready = 0;
+
+static uint64_t zobrist_key(uint64_t* rng) {
+    uint64_t high = puffer_rand_u32(rng);
+    return (high << 32) | puffer_rand_u32(rng);
+}
+
+static void init_zobrist(void) {
+    if (go_zobrist_ready) {
+        return;
+    }
+    uint64_t rng = 0x5eed60;
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < GO_MAX_POINTS; i++) {
+            go_zobrist[p][i] = zobrist_key(&rng);
+        }
+    }
+    go_zobrist_empty = zobrist_key(&rng);
+    go_zobrist_ready = 1;
 }
 
 typedef struct Client Client;
@@ -68,6 +163,7 @@ struct CGo {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
     float score;
     int width;
     int height;
@@ -78,15 +174,20 @@ struct CGo {
     int grid_square_size;
     int grid_size;
     int* board_states;
-    int* previous_board_state;
     int last_capture_position;
-    int* temp_board_states;
     int moves_made;
     int* capture_count;
     float komi;
-    int* visited;
     Group* groups;
-    Group* temp_groups;
+    int* neighbors;  // 4 per point, -1 off the board
+    Bitboard stones[2];
+    Bitboard board_mask;
+    Bitboard not_left;  // board minus the x == 0 column
+    Bitboard not_right;  // board minus the x == grid_size - 1 column
+    uint64_t hash;
+    uint64_t* history;  // open addressed set of position hashes this game
+    int history_mask;
+    int history_count;
     float reward_move_pass;
     float reward_move_invalid;
     float reward_move_valid;
@@ -128,25 +229,49 @@ void generate_board_positions(CGo* env) {
 
 void init_groups(CGo* env) {
     for (int i = 0; i < (env->grid_size)*(env->grid_size); i++) {
-        env->groups[i].parent = i;
-        env->groups[i].rank = 0;
-        env->groups[i].size = 1;
-        env->groups[i].liberties = 0;
+        env->groups[i] = (Group){.parent = i, .size = 1, .next = i};
     }
 }
 
 void init(CGo* env) {
+    assert(env->grid_size <= GO_MAX_SIZE);
+    init_zobrist();
     int board_render_size = (env->grid_size-1)*(env->grid_size-1);
     int grid_size = env->grid_size*env->grid_size;
     env->board_x = (int*)calloc(board_render_size, sizeof(int));
     env->board_y = (int*)calloc(board_render_size, sizeof(int));
     env->board_states = (int*)calloc(grid_size, sizeof(int));
-    env->visited = (int*)calloc(grid_size, sizeof(int));
-    env->previous_board_state = (int*)calloc(grid_size, sizeof(int));
-    env->temp_board_states = (int*)calloc(grid_size, sizeof(int));
     env->capture_count = (int*)calloc(2, sizeof(int));
     env->groups = (Group*)calloc(grid_size, sizeof(Group));
-    env->temp_groups = (Group*)calloc(grid_size, sizeof(Group));
+    env->neighbors = (int*)calloc(grid_size*NUM_DIRECTIONS, sizeof(int));
+    memset(&env->board_mask, 0, sizeof(Bitboard));
+    memset(&env->not_left, 0, sizeof(Bitboard));
+    memset(&env->not_right, 0, sizeof(Bitboard));
+    for (int pos = 0; pos < grid_size; pos++) {
+        int x = pos % env->grid_size;
+        int y = pos / env->grid_size;
+        for (int i = 0; i < NUM_DIRECTIONS; i++) {
+            int nx = x + DIRECTIONS[i][0];
+            int ny = y + DIRECTIONS[i][1];
+            int valid = nx >= 0 && nx < env->grid_size && ny >= 0 && ny < env->grid_size;
+            env->neighbors[pos*NUM_DIRECTIONS + i] = valid ? ny*env->grid_size + nx : -1;
+        }
+        bb_set(&env->board_mask, pos);
+        if (x != 0) {
+            bb_set(&env->not_left, pos);
+        }
+        if (x != env->grid_size - 1) {
+            bb_set(&env->not_right, pos);
+        }
+    }
+    // A step adds at most two positions and games end after 3*grid_size^2 steps
+    int max_positions = 6*grid_size*grid_size + 1;
+    int capacity = 1;
+    while (capacity < 2*max_positions) {
+        capacity <<= 1;
+    }
+    env->history = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    env->history_mask = capacity - 1;
     generate_board_positions(env);
     init_groups(env);
 }
@@ -163,12 +288,10 @@ void c_close(CGo* env) {
     free(env->board_x);
     free(env->board_y);
     free(env->board_states);
-    free(env->visited);
-    free(env->previous_board_state);
-    free(env->temp_board_states);
     free(env->capture_count);
-    free(env->temp_groups);
     free(env->groups);
+    free(env->neighbors);
+    free(env->history);
 }
 
 void free_allocated(CGo* env) {
@@ -204,134 +327,89 @@ void compute_observations(CGo* env) {
 
 }
 
-int is_valid_position(CGo* env, int x, int y) {
-    return (x >= 0 && x < env->grid_size && y >= 0 && y < env->grid_size);
-}
-
-void reset_visited(CGo* env) {
-    memset(env->visited, 0, sizeof(int) * (env->grid_size) * (env->grid_size));
-}
-
-void flood_fill(CGo* env, int x, int y, int* territory, int player) {
-    if (!is_valid_position(env, x, y)) {
-        return;
-    }
-
-    int pos = y * (env->grid_size) + x;
-    if (env->visited[pos] || env->board_states[pos] != 0) {
-        return;
-    }
-    env->visited[pos] = 1;
-    territory[player]++;
-    // Check adjacent positions
-    for (int i = 0; i < 4; i++) {
-        flood_fill(env, x + DIRECTIONS[i][0], y + DIRECTIONS[i][1], territory, player);
-    }
+// Adds the orthogonal neighbors of every point in b, clipped to the board
+static inline Bitboard bb_expand(CGo* env, Bitboard b) {
+    Bitboard left = bb_shift_down(b, 1);
+    Bitboard right = bb_shift_up(b, 1);
+    Bitboard up = bb_shift_down(b, env->grid_size);
+    Bitboard down = bb_shift_up(b, env->grid_size);
+    Bitboard out;
+    for (int i = 0; i < GO_WORDS; i++) {
+        out.w[i] = (b.w[i] | (left.w[i] & env->not_right.w[i])
+            | (right.w[i] & env->not_left.w[i]) | up.w[i] | down.w[i])
+            & env->board_mask.w[i];
+    }
+    return out;
 }
 
 void compute_score_tromp_taylor(CGo* env) {
-    int player_score = 0;
-    int opponent_score = 0;
-    reset_visited(env);
-    
-    // Queue for BFS
-    int queue_size = (env->grid_size) * (env->grid_size);
-    int queue[queue_size];
-    
-    // First count stones
-    for (int i = 0; i < queue_size; i++) {
-        if (env->board_states[i] == 1) {
-            player_score++;
-        } else if (env->board_states[i] == 2) {
-            opponent_score++;
-        }
-    }
-    
-    // Then process empty territories
-    for (int start_pos = 0; start_pos < queue_size; start_pos++) {
-        // Skip if not empty or already visited
-        if (env->board_states[start_pos] != 0 || env->visited[start_pos]) {
-            continue;
-        }
-        
-        // Initialize BFS
-        int front = 0, rear = 0;
-        int territory_size = 0;
-        int bordering_player = 0;  // 0=neutral, 1=player1, 2=player2, 3=mixed
-        
-        queue[rear++] = start_pos;
-        env->visited[start_pos] = 1;
-        
-        // Process connected empty points
-        while (front < rear) {
-            int pos = queue[front++];
-            territory_size++;
-            int x = pos % env->grid_size;
-            int y = pos / env->grid_size;
-            
-            // Check all adjacent positions
-            for (int i = 0; i < 4; i++) {
-                int nx = x + DIRECTIONS[i][0];
-                int ny = y + DIRECTIONS[i][1];
-                
-                if (!is_valid_position(env, nx, ny)) {
-                    continue;
-                }
-                
-                int npos = ny * env->grid_size + nx;
-                
-                if (env->board_states[npos] == 0 && !env->visited[npos]) {
-                    // Add unvisited empty points to queue
-                    queue[rear++] = npos;
-                    env->visited[npos] = 1;
-                } else if (bordering_player == 0) {
-                    bordering_player = env->board_states[npos];
-                } else if (bordering_player != env->board_states[npos]) {
-                    bordering_player = 3;  // Mixed territory
-                }
+    Bitboard empty;
+    for (int i = 0; i < GO_WORDS; i++) {
+        empty.w[i] = env->board_mask.w[i] & ~(env->stones[0].w[i] | env->stones[1].w[i]);
+    }
+    // Grow each color through empty points. An empty point is territory if
+    // only one color reaches it
+    Bitboard reach[2];
+    for (int p = 0; p < 2; p++) {
+        reach[p] = env->stones[p];
+        int changed = 1;
+        while (changed) {
+            Bitboard grown = bb_expand(env, reach[p]);
+            changed = 0;
+            for (int i = 0; i < GO_WORDS; i++) {
+                uint64_t next = reach[p].w[i] | (grown.w[i] & empty.w[i]);
+                changed |= next != reach[p].w[i];
+                reach[p].w[i] = next;
             }
         }
-        
-        // Assign territory points
-        if (bordering_player == 1) {
-            player_score += territory_size;
-        } else if (bordering_player == 2) {
-            opponent_score += territory_size;
+    }
+    int area[2];
+    for (int p = 0; p < 2; p++) {
+        Bitboard territory;
+        for (int i = 0; i < GO_WORDS; i++) {
+            territory.w[i] = reach[p].w[i] & empty.w[i] & ~reach[1 - p].w[i];
         }
-        // Mixed territories (bordering_player == 3) are neutral and not counted
+        area[p] = bb_count(&env->stones[p]) + bb_count(&territory);
     }
-    
-    env->score = (float)player_score - (float)opponent_score - env->komi;
+    env->score = (float)area[0] - (float)area[1] - env->komi;
 }
 
-int find_in_group(int* group, int group_size, int value) {
-    for (int i = 0; i < group_size; i++) {
-        if (group[i] == value) {
-            return 1;  // Found
+// Returns 1 if the position already occurred this game
+int history_contains(CGo* env, uint64_t hash) {
+    int i = hash & env->history_mask;
+    while (env->history[i] != 0) {
+        if (env->history[i] == hash) {
+            return 1;
         }
+        i = (i + 1) & env->history_mask;
     }
-    return 0;  // Not found
+    return 0;
 }
 
+// Sized in init for every position of the longest game at half load
+void history_add(CGo* env, uint64_t hash) {
+    assert(2*(env->history_count + 1) <= env->history_mask + 1);
+    int i = hash & env->history_mask;
+    while (env->history[i] != 0) {
+        if (env->history[i] == hash) {
+            return;
+        }
+        i = (i + 1) & env->history_mask;
+    }
+    env->history[i] = hash;
+    env->history_count++;
+}
 
-void capture_group(CGo* env, int* board, int root, int* affected_groups, int* affected_count) {
-    // Reset visited array
-    reset_visited(env);
-
-    // Use a queue for BFS
-    int queue_size = (env->grid_size) * (env->grid_size);
-    int queue[queue_size];
-    int front = 0, rear = 0;
-
-    int captured_player = board[root];       // Player whose stones are being captured
+// Removes a captured group and hands its points back as liberties to the
+// capturing player's neighboring groups
+void capture_group(CGo* env, int root) {
+    int captured_player = env->board_states[root];       // Player whose stones are being captured
     int capturing_player = 3 - captured_player;          // Player who captures
-
-    queue[rear++] = root;
-    env->visited[root] = 1;
-
-    while (front != rear) {
-        int pos = queue[front++];
-        board[pos] = 0;  // Remove stone
+    int pos = root;
+    do {
+        env->board_states[pos] = 0;  // Remove stone
+        bb_clear(&env->stones[captured_player - 1], pos);
+        env->hash ^= go_zobrist[captured_player - 1][pos];
         env->capture_count[capturing_player - 1]++;  // Update capturing player's count
 	if(capturing_player-1 == 0){
 		env->rewards[0] += env->reward_player_capture;
@@ -340,157 +418,111 @@ void capture_group(CGo* env, int* board, int root, int* affected_groups, int* af
 		env->rewards[0] += env->reward_opponent_capture;
 		env->log.episode_return += env->reward_opponent_capture;
 	}
-        int x = pos % (env->grid_size);
-        int y = pos / (env->grid_size);
-
-        for (int i = 0; i < 4; i++) {
-            int nx = x + DIRECTIONS[i][0];
-            int ny = y + DIRECTIONS[i][1];
-            int npos = ny * (env->grid_size) + nx;
-
-            if (!is_valid_position(env, nx, ny)) {
+        pos = env->groups[pos].next;
+    } while (pos != root);
+
+    do {
+        int next = env->groups[pos].next;
+        int* neighbors = &env->neighbors[pos*NUM_DIRECTIONS];
+        for (int i = 0; i < NUM_DIRECTIONS; i++) {
+            int npos = neighbors[i];
+            if (npos < 0 || env->board_states[npos] != capturing_player) {
                 continue;
             }
-
-            if (board[npos] == captured_player && !env->visited[npos]) {
-                env->visited[npos] = 1;
-                queue[rear++] = npos;
-            }
-            else if (board[npos] == capturing_player) {
-                int adj_root = find(env->temp_groups, npos);
-                if (find_in_group(affected_groups, *affected_count, adj_root)) {
-                    continue;
-                }
-                affected_groups[(*affected_count)] = adj_root;
-                (*affected_count)++;
-            }
+            Group* group = &env->groups[find(env->groups, npos)];
+            bb_set(&group->libs, pos);
+            group->liberties = bb_count(&group->libs);
         }
-    }
+        env->groups[pos] = (Group){.parent = pos, .size = 1, .next = pos};
+        pos = next;
+    } while (pos != root);
 }
 
-
-int count_liberties(CGo* env, int root, int* queue) {
-    reset_visited(env);
-    int liberties = 0;
-    int front = 0;
-    int rear = 0;
-    
-    queue[rear++] = root;
-    env->visited[root] = 1;
-    while (front < rear) {
-        int pos = queue[front++];
-        int x = pos % (env->grid_size);
-        int y = pos / (env->grid_size);
-        
-        for (int i = 0; i < 4; i++) {
-            int nx = x + DIRECTIONS[i][0];
-            int ny = y + DIRECTIONS[i][1];
-            if (!is_valid_position(env, nx, ny)) {
-                continue;
-            }
-            
-            int npos = ny * (env->grid_size) + nx;
-            if (env->visited[npos]) {
-                continue;
-            }
-
-            int temp_npos = env->temp_board_states[npos];
-            if (temp_npos == 0) {
-                liberties++;
-                env->visited[npos] = 1;
-            } else if (temp_npos == env->temp_board_states[root]) {
-                queue[rear++] = npos;
-                env->visited[npos] = 1;
-            }
+void place_stone(CGo* env, int pos, int player) {
+    env->board_states[pos] = player;
+    bb_set(&env->stones[player - 1], pos);
+    env->hash ^= go_zobrist[player - 1][pos];
+    Group* group = &env->groups[pos];
+    *group = (Group){.parent = pos, .size = 1, .next = pos, .hash = go_zobrist[player - 1][pos]};
+    int* neighbors = &env->neighbors[pos*NUM_DIRECTIONS];
+    for (int i = 0; i < NUM_DIRECTIONS; i++) {
+        int npos = neighbors[i];
+        if (npos < 0) {
+            continue;
         }
-    }
-    return liberties;
-}
-
-int is_ko(CGo* env) {
-    for (int i = 0; i < (env->grid_size) * (env->grid_size); i++) {
-        if (env->temp_board_states[i] != env->previous_board_state[i]) {
-            return 0;  // Not a ko
+        if (env->board_states[npos] == 0) {
+            bb_set(&group->libs, npos);
+            continue;
+        }
+        Group* adjacent = &env->groups[find(env->groups, npos)];
+        bb_clear(&adjacent->libs, pos);
+        adjacent->liberties = bb_count(&adjacent->libs);
+    }
+    group->liberties = bb_count(&group->libs);
+    for (int i = 0; i < NUM_DIRECTIONS; i++) {
+        int npos = neighbors[i];
+        if (npos >= 0 && env->board_states[npos] == player) {
+            union_groups(env->groups, pos, npos);
         }
     }
-    return 1;  // Is a ko
 }
 
+// Checks legality from the neighboring groups before touching the board, so
+// rejected candidates cost a few lookups and need no undo
 int make_move(CGo* env, int pos, int player){
-    int x = pos % (env->grid_size);
-    int y = pos / (env->grid_size);
     // cannot place stone on occupied tile
     if (env->board_states[pos] != 0) {
         return 0 ;
     }
-    // temp structures
-    memcpy(env->temp_board_states, env->board_states, sizeof(int) * (env->grid_size) * (env->grid_size));
-    memcpy(env->temp_groups, env->groups, sizeof(Group) * (env->grid_size) * (env->grid_size));
-    // create new group
-    env->temp_board_states[pos] = player;
-    env->temp_groups[pos].parent = pos;
-    env->temp_groups[pos].rank = 0;
-    env->temp_groups[pos].size = 1;
-    env->temp_groups[pos].liberties = 0;
-    
-    int max_affected_groups = (env->grid_size) * (env->grid_size);
-    int affected_groups[max_affected_groups];
-    int affected_count = 0;
-    affected_groups[affected_count++] = pos;
-
-    int queue[(env->grid_size) * (env->grid_size)];
-
-    // Perform unions and track affected groups
-    for (int i = 0; i < 4; i++) {
-        int nx = x + DIRECTIONS[i][0];
-        int ny = y + DIRECTIONS[i][1];
-        int npos = ny * (env->grid_size) + nx;
-        if (!is_valid_position(env, nx, ny)) {
+    int* neighbors = &env->neighbors[pos*NUM_DIRECTIONS];
+    int captured[NUM_DIRECTIONS];
+    int captured_count = 0;
+    int has_liberty = 0;
+    uint64_t hash = env->hash ^ go_zobrist[player - 1][pos];
+    for (int i = 0; i < NUM_DIRECTIONS; i++) {
+        int npos = neighbors[i];
+        if (npos < 0) {
             continue;
         }
-        if (env->temp_board_states[npos] == player) {
-            union_groups(env->temp_groups, pos, npos);
-            affected_groups[affected_count++] = npos;
-        } else if (env->temp_board_states[npos] == 3 - player) {
-            affected_groups[affected_count++] = npos;
+        int state = env->board_states[npos];
+        if (state == 0) {
+            has_liberty = 1;
+            continue;
         }
-    }
-
-    // Recalculate liberties only for affected groups
-    for (int i = 0; i < affected_count; i++) {
-        int root = find(env->temp_groups, affected_groups[i]);
-        env->temp_groups[root].liberties = count_liberties(env, root, queue);
-    }
-
-    // Check for captures
-    bool captured = false;
-    for (int i = 0; i < affected_count; i++) {
-        int root = find(env->temp_groups, affected_groups[i]);
-        if (env->temp_board_states[root] == 3 - player && env->temp_groups[root].liberties == 0) {
-            capture_group(env, env->temp_board_states, root, affected_groups, &affected_count);
-            captured = true;
+        int root = find(env->groups, npos);
+        int liberties = env->groups[root].liberties;
+        if (state == player) {
+            has_liberty |= liberties > 1;
+            continue;
         }
-    }
-    // If captures occurred, recalculate liberties again
-    if (captured) {
-        for (int i = 0; i < affected_count; i++) {
-            int root = find(env->temp_groups, affected_groups[i]);
-            env->temp_groups[root].liberties = count_liberties(env, root, queue);
+        // Enemy group whose last liberty is pos
+        if (liberties != 1) {
+            continue;
+        }
+        int seen = 0;
+        for (int j = 0; j < captured_count; j++) {
+            seen |= captured[j] == root;
         }
-        // Check for ko rule violation
-        if(is_ko(env)) {
-            return 0;
+        if (!seen) {
+            captured[captured_count++] = root;
+            hash ^= env->groups[root].hash;
+            has_liberty = 1;
         }
     }
     // self capture
-    int root = find(env->temp_groups, pos);
-    if (env->temp_groups[root].liberties == 0) {
+    if (!has_liberty) {
         return 0;
     }
-    memcpy(env->board_states, env->temp_board_states, sizeof(int) * (env->grid_size) * (env->grid_size));
-    memcpy(env->groups, env->temp_groups, sizeof(Group) * (env->grid_size) * (env->grid_size));
+    // positional superko
+    if (history_contains(env, hash)) {
+        return 0;
+    }
+    place_stone(env, pos, player);
+    for (int i = 0; i < captured_count; i++) {
+        capture_group(env, captured[i]);
+    }
+    history_add(env, env->hash);
     return 1;
-
 }
 
 
@@ -505,15 +537,13 @@ void enemy_random_move(CGo* env){
             positions[count++] = i;
         }
     }
-    // Shuffle the positions
-    for(int i = count - 1; i > 0; i--){
-        int j = rand() % (i + 1);
+    // Try empty positions in random order, shuffling lazily so the first
+    // legal move stops the draws
+    for(int i = 0; i < count; i++){
+        int j = i + puffer_rand(&env->rng) % (count - i);
         int temp = positions[i];
         positions[i] = positions[j];
         positions[j] = temp;
-    }
-    // Try to make a move in a random empty position
-    for(int i = 0; i < count; i++){
         if(make_move(env, positions[i], 2)){
             return;
         }
@@ -522,34 +552,11 @@ void enemy_random_move(CGo* env){
     env->terminals[0] = 1;
 }
 
+// Lowest-index liberty. The old flood fill returned the first one in BFS
+// order, so the greedy opponent may pick a different liberty of groups with
+// two to four of them
 int find_group_liberty(CGo* env, int root){
-    reset_visited(env);
-    int queue[(env->grid_size)*(env->grid_size)];
-    int front = 0, rear = 0;
-    queue[rear++] = root;
-    env->visited[root] = 1;
-
-    while(front < rear){
-        int pos = queue[front++];
-        int x = pos % (env->grid_size);
-        int y = pos / (env->grid_size);
-
-        for(int i = 0; i < 4; i++){
-            int nx = x + DIRECTIONS[i][0];
-            int ny = y + DIRECTIONS[i][1];
-            int npos = ny * (env->grid_size) + nx;
-            if(!is_valid_position(env, nx, ny)){
-                continue;
-            }
-            if(env->board_states[npos] == 0){
-                return npos; // Found a liberty
-            } else if(env->board_states[npos] == env->board_states[root] && !env->visited[npos]){
-                env->visited[npos] = 1;
-                queue[rear++] = npos;
-            }
-        }
-    }
-    return -1; // Should not happen if liberties > 0
+    return bb_first(&env->groups[root].libs);
 }
 
 void enemy_greedy_hard(CGo* env){
@@ -625,16 +632,13 @@ void c_reset(CGo* env) {
     // We don't reset the log struct - leave it accumulating like in Pong
     env->terminals[0] = 0;
     env->score = 0;
-    for (int i = 0; i < (env->grid_size)*(env->grid_size); i++) {
-        env->board_states[i] = 0;
-        env->temp_board_states[i] = 0;
-        env->visited[i] = 0;
-        env->previous_board_state[i] = 0;
-        env->groups[i].parent = i;
-        env->groups[i].rank = 0;
-        env->groups[i].size = 0;
-        env->groups[i].liberties = 0;
-    }
+    memset(env->board_states, 0, (env->grid_size)*(env->grid_size)*sizeof(int));
+    init_groups(env);
+    memset(env->stones, 0, sizeof(env->stones));
+    memset(env->history, 0, (env->history_mask + 1)*sizeof(uint64_t));
+    env->history_count = 0;
+    env->hash = go_zobrist_empty;
+    history_add(env, env->hash);
     env->capture_count[0] = 0;
     env->capture_count[1] = 0;
     env->last_capture_position = -1;
@@ -681,7 +685,6 @@ void c_step(CGo* env) {
         return;
     }
     if (action >= MOVE_MIN && action <= (env->grid_size)*(env->grid_size)) {
-        memcpy(env->previous_board_state, env->board_states, sizeof(int) * (env->grid_size) * (env->grid_size));
         if(make_move(env, action-1, 1)) {
             env->moves_made++;
             env->rewards[0] = env->reward_move_valid;
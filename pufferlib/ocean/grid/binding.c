@@ -1,44 +1,244 @@
+#include <Python.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "grid.h"
 
-#define Env Grid 
+static PyObject* generate_levels(PyObject* self, PyObject* args, PyObject* kwargs);
+
+#define Env Grid
 #define MY_SHARED
+#define MY_METHODS {"generate_levels", (PyCFunction)generate_levels, METH_VARARGS | METH_KEYWORDS, "Write a maze level bank to disk"}
 #include "../env_binding.h"
 
+#define LEVELS_MAGIC 0x4c444947
+#define LEVELS_VERSION 1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    int num_maps;
+    int max_size;
+    int num_agents;
+    int size;
+    int seed;
+    int pad;
+    unsigned long long stride;
+} LevelHeader;
+
+typedef struct {
+    LevelBank* bank;
+    int size;
+    int seed;
+    int next;
+} LevelJob;
+
+// Size and difficulty come from the level's own seed, so a bank is the same
+// regardless of how levels are split across threads
+static void* levels_worker(void* arg) {
+    LevelJob* job = arg;
+    LevelBank* bank = job->bank;
+    Grid env = {0};
+    env.max_size = bank->max_size;
+    init_grid(&env);
+    while (1) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= bank->num_maps)
+            break;
+        uint64_t rng;
+        puffer_seed(&rng, job->seed + i);
+        int sz = job->size;
+        if (sz == -1) {
+            sz = 5 + (puffer_rand(&rng) % (bank->max_size-5));
+        }
+        if (sz % 2 == 0) {
+            sz -= 1;
+        }
+        float difficulty = puffer_randf(&rng);
+        memset(env.grid, 0, bank->max_size*bank->max_size);
+        create_maze_level(&env, sz, sz, difficulty, job->seed + i);
+        get_state(&env, bank_level(bank, i));
+    }
+    free(env.grid);
+    free(env.counts);
+    free(env.agents);
+    return NULL;
+}
+
+static LevelBank* build_levels(int num_maps, int max_size, int size, int seed, int num_threads) {
+    LevelBank* bank = make_level_bank(num_maps, max_size, 1);
+    LevelJob job = {.bank = bank, .size = size, .seed = seed};
+    if (num_threads <= 0)
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+        num_threads = 1;
+
+    // The calling thread works too and picks up whatever the threads that
+    // did start leave over, so failing to start any of them only costs time
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < num_threads - 1
+            && pthread_create(&threads[started], NULL, levels_worker, &job) == 0)
+        started++;
+    levels_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    return bank;
+}
+
+// Written to a temp file first so readers never see a partial bank
+static int write_levels(const char* path, LevelBank* bank, int size, int seed) {
+    LevelHeader header = {
+        .magic = LEVELS_MAGIC,
+        .version = LEVELS_VERSION,
+        .num_maps = bank->num_maps,
+        .max_size = bank->max_size,
+        .num_agents = bank->num_agents,
+        .size = size,
+        .seed = seed,
+        .stride = bank->stride,
+    };
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE* f = fopen(tmp, "wb");
+    int err = (f == NULL);
+    if (!err) {
+        err |= fwrite(&header, sizeof(header), 1, f) != 1;
+        err |= fwrite(bank->data, bank->stride, bank->num_maps, f) != (size_t)bank->num_maps;
+        err |= fclose(f) != 0;
+        err = err || rename(tmp, path) != 0;
+        if (err)
+            unlink(tmp);
+    }
+    return err;
+}
+
+// Maps a bank file read-only. Returns NULL if the file is missing, malformed
+// or was generated with different settings
+static LevelBank* map_levels(const char* path, int num_maps, int max_size, int size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LevelHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    LevelHeader* header = data;
+    size_t expected = sizeof(LevelHeader) + (size_t)header->num_maps*header->stride;
+    if (header->magic != LEVELS_MAGIC || header->version != LEVELS_VERSION
+            || header->max_size != max_size || header->size != size
+            || header->num_maps < num_maps || header->num_agents != 1
+            || header->stride != state_stride(max_size, 1)
+            || (size_t)st.st_size != expected) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    LevelBank* bank = calloc(1, sizeof(LevelBank));
+    bank->data = (char*)data + sizeof(LevelHeader);
+    bank->stride = header->stride;
+    bank->num_maps = num_maps;
+    bank->max_size = max_size;
+    bank->num_agents = 1;
+    bank->mapping = data;
+    bank->mapping_bytes = st.st_size;
+    return bank;
+}
+
+static PyObject* generate_levels(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* path;
+    int num_maps;
+    int max_size;
+    int size = -1;
+    int seed = 0;
+    int num_threads = 0;
+    static char* kwlist[] = {"path", "num_maps", "max_size", "size", "seed", "num_threads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sii|iii", kwlist,
+            &path, &num_maps, &max_size, &size, &seed, &num_threads)) {
+        return NULL;
+    }
+    if (max_size <= 5) {
+        PyErr_SetString(PyExc_ValueError, "max_size must be >5");
+        return NULL;
+    }
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    LevelBank* bank = build_levels(num_maps, max_size, size, seed, num_threads);
+    err = write_levels(path, bank, size, seed);
+    free(bank->data);
+    free(bank);
+    Py_END_ALLOW_THREADS
+    if (err) {
+        PyErr_Format(PyExc_OSError, "Failed to write level bank to %s", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_maps = unpack(kwargs, "num_maps");
     int max_size = unpack(kwargs, "max_size");
     int size = unpack(kwargs, "size");
-    State* levels = calloc(num_maps, sizeof(State));
 
     if (max_size <= 5) {
         PyErr_SetString(PyExc_ValueError, "max_size must be >5");
         return NULL;
     }
 
-    // Temporary env used to gen maps
-    Grid env;
-    env.max_size = max_size;
-    init_grid(&env);
-
-    srand(time(NULL));
-    int start_seed = rand();
-    for (int i = 0; i < num_maps; i++) {
-        int sz = size;
-        if (size == -1) {
-            sz = 5 + (rand() % (max_size-5));
+    const char* path = NULL;
+    PyObject* path_obj = PyDict_GetItemString(kwargs, "path");
+    if (path_obj != NULL && path_obj != Py_None) {
+        path = PyUnicode_AsUTF8(path_obj);
+        if (path == NULL) {
+            return NULL;
         }
+    }
 
-        if (sz % 2 == 0) {
-            sz -= 1;
+    // Levels saved by an earlier run are mapped zero-copy. The first process
+    // to find the file missing writes it under a lock while the others wait
+    LevelBank* bank = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    if (path != NULL) {
+        bank = map_levels(path, num_maps, max_size, size);
+        if (bank == NULL) {
+            char lock_path[4096];
+            snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+            int lock = open(lock_path, O_RDWR | O_CREAT, 0644);
+            if (lock >= 0 && flock(lock, LOCK_EX) == 0) {
+                bank = map_levels(path, num_maps, max_size, size);
+                if (bank == NULL) {
+                    bank = build_levels(num_maps, max_size, size, 0, 0);
+                    write_levels(path, bank, size, 0);
+                }
+                flock(lock, LOCK_UN);
+            }
+            if (lock >= 0)
+                close(lock);
         }
+    }
 
-        float difficulty = (float)rand()/(float)(RAND_MAX);
-        create_maze_level(&env, sz, sz, difficulty, start_seed + i);
-        init_state(&levels[i], max_size, 1);
-        get_state(&env, &levels[i]);
+    // No path or unwritable location: generate a private bank
+    if (bank == NULL) {
+        srand(time(NULL));
+        bank = build_levels(num_maps, max_size, size, rand(), 0);
     }
+    Py_END_ALLOW_THREADS
 
-    return PyLong_FromVoidPtr(levels);
+    return PyLong_FromVoidPtr(bank);
 }
 
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
@@ -52,7 +252,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         return 1;
     }
 
-    State* levels = (State*)PyLong_AsVoidPtr(handle_obj);
+    LevelBank* levels = (LevelBank*)PyLong_AsVoidPtr(handle_obj);
     if (!levels) {
         PyErr_SetString(PyExc_ValueError, "Invalid state handle");
         return 1;
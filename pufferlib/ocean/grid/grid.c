@@ -24,11 +24,10 @@ int main() {
     //load_locked_room_preset(env);
      
  
-    State* levels = calloc(1, sizeof(State));
+    LevelBank* levels = make_level_bank(1, max_size, num_agents);
 
     create_maze_level(env, 31, 31, 0.85, seed);
-    init_state(levels, max_size, num_agents);
-    get_state(env, levels);
+    get_state(env, bank_level(levels, 0));
     env->num_maps = 1;
     env->levels = levels;
     //generate_locked_room(env);
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <math.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define TWO_PI 2.0*PI
 #define MAX_SIZE 40
@@ -46,8 +47,8 @@ struct Log {
 bool is_agent(int idx) {
     return idx >= AGENT && idx < AGENT + 8;
 }
-int rand_color() {
-    return AGENT + rand()%8;
+int rand_color(uint64_t* rng) {
+    return AGENT + puffer_rand(rng)%8;
 }
 
 // 6 unique keys and doors
@@ -79,10 +80,11 @@ struct Agent {
 
 typedef struct Renderer Renderer;
 typedef struct State State;
+typedef struct LevelBank LevelBank;
 typedef struct Grid Grid;
 struct Grid{
     Renderer* renderer;
-    State* levels;
+    LevelBank* levels;
     int num_maps;
     int width;
     int height;
@@ -95,6 +97,7 @@ struct Grid{
     int max_size;
     bool discretize;
     Log log;
+    uint64_t rng;
     Agent* agents;
     unsigned char* grid;
     int* counts;
@@ -244,37 +247,65 @@ void spawn_agent(Grid* env, int idx, int x, int y) {
     agent->x = agent->spawn_x;
     agent->prev_y = agent->y;
     agent->prev_x = agent->x;
-    env->grid[adr] = agent->color;
     agent->direction = 0;
     agent->held = -1;
     agent->color = AGENT;
+    env->grid[adr] = agent->color;
 }
 
+// Levels are fixed-stride records: a State header followed by its agents and
+// a max_size*max_size grid. A bank is one flat buffer, so it can be written
+// to disk as is and mapped back without fixing up pointers
 struct State {
     int width;
     int height;
     int num_agents;
-    Agent* agents;
-    unsigned char* grid;
+    int pad;
+};
+
+Agent* state_agents(State* state) {
+    return (Agent*)(state + 1);
+}
+
+unsigned char* state_grid(State* state) {
+    return (unsigned char*)(state_agents(state) + state->num_agents);
+}
+
+size_t state_stride(int max_size, int num_agents) {
+    size_t bytes = sizeof(State) + num_agents*sizeof(Agent) + max_size*max_size;
+    return (bytes + 7) & ~(size_t)7;
+}
+
+struct LevelBank {
+    char* data;
+    size_t stride;
+    int num_maps;
+    int max_size;
+    int num_agents;
+    void* mapping;
+    size_t mapping_bytes;
 };
 
-void init_state(State* state, int max_size, int num_agents) {
-    state->agents = calloc(num_agents, sizeof(Agent));
-    state->grid = calloc(max_size*max_size, sizeof(unsigned char));
+LevelBank* make_level_bank(int num_maps, int max_size, int num_agents) {
+    LevelBank* bank = calloc(1, sizeof(LevelBank));
+    bank->stride = state_stride(max_size, num_agents);
+    bank->num_maps = num_maps;
+    bank->max_size = max_size;
+    bank->num_agents = num_agents;
+    bank->data = calloc(num_maps, bank->stride);
+    return bank;
 }
 
-void free_state(State* state) {
-    free(state->agents);
-    free(state->grid);
-    free(state);
+State* bank_level(LevelBank* bank, int idx) {
+    return (State*)(bank->data + idx*bank->stride);
 }
 
 void get_state(Grid* env, State* state) {
     state->width = env->width;
     state->height = env->height;
     state->num_agents = env->num_agents;
-    memcpy(state->agents, env->agents, env->num_agents*sizeof(Agent));
-    memcpy(state->grid, env->grid, env->max_size*env->max_size);
+    memcpy(state_agents(state), env->agents, env->num_agents*sizeof(Agent));
+    memcpy(state_grid(state), env->grid, env->max_size*env->max_size);
 }
 
 void set_state(Grid* env, State* state) {
@@ -282,16 +313,16 @@ void set_state(Grid* env, State* state) {
     env->height = state->height;
     env->horizon = 2*env->width*env->height;
     env->num_agents = state->num_agents;
-    memcpy(env->agents, state->agents, env->num_agents*sizeof(Agent));
-    memcpy(env->grid, state->grid, env->max_size*env->max_size);
+    memcpy(env->agents, state_agents(state), env->num_agents*sizeof(Agent));
+    memcpy(env->grid, state_grid(state), env->max_size*env->max_size);
 }
 
+// The level overwrites the whole grid, so only the visit counts need clearing
 void c_reset(Grid* env) {
-    memset(env->grid, 0, env->max_size*env->max_size);
     memset(env->counts, 0, env->max_size*env->max_size*sizeof(int));
     env->tick = 0;
-    int idx = rand() % env->num_maps;
-    set_state(env, &env->levels[idx]);
+    int idx = puffer_rand(&env->rng) % env->num_maps;
+    set_state(env, bank_level(env->levels, idx));
     compute_observations(env);
 }
 
@@ -429,9 +460,6 @@ void c_step(Grid* env) {
 
     if (done) {
         c_reset(env);
-        int idx = rand() % env->num_maps;
-        set_state(env, &env->levels[idx]);
-        compute_observations(env);
     }
 }
 
@@ -637,7 +665,8 @@ void generate_locked_room(Grid* env) {
 
 void generate_growing_tree_maze(unsigned char* grid,
         int width, int height, int max_size, float difficulty, int seed) {
-    srand(seed);
+    uint64_t rng;
+    puffer_seed(&rng, seed);
     int dx[4] = {-1, 0, 1, 0};
     int dy[4] = {0, 1, 0, -1};
     int dirs[4] = {0, 1, 2, 3};
@@ -657,8 +686,8 @@ void generate_growing_tree_maze(unsigned char* grid,
         }
     }
 
-    int x_init = rand() % (width - 1);
-    int y_init = rand() % (height - 1);
+    int x_init = puffer_rand(&rng) % (width - 1);
+    int y_init = puffer_rand(&rng) % (height - 1);
 
     if (x_init % 2 == 0) {
         x_init++;
@@ -677,8 +706,8 @@ void generate_growing_tree_maze(unsigned char* grid,
     //SetTargetFPS(60);
 
     while (num_cells > 0) {
-        if (rand() % 1000 > 1000*difficulty) {
-            int i = rand() % num_cells;
+        if (puffer_rand(&rng) % 1000 > 1000*difficulty) {
+            int i = puffer_rand(&rng) % num_cells;
             int tmp_x = cells[2*num_cells - 2];
             int tmp_y = cells[2*num_cells - 1];
             cells[2*num_cells - 2] = cells[2*i];
@@ -695,7 +724,7 @@ void generate_growing_tree_maze(unsigned char* grid,
 
         // In-place direction shuffle
         for (int i = 0; i < 4; i++) {
-            int ii = i + rand() % (4 - i);
+            int ii = i + puffer_rand(&rng) % (4 - i);
             int tmp = dirs[i];
             dirs[i] = dirs[ii];
             dirs[ii] = tmp;
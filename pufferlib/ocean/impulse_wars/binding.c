@@ -1,15 +1,26 @@
 #include <Python.h>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "env.h"
 
 static PyObject *get_consts(PyObject *self, PyObject *args);
+static PyObject *generate_map_assets(PyObject *self, PyObject *args, PyObject *kwargs);
 
 #define Env iwEnv
 #define MY_SHARED
-#define MY_METHODS {"get_consts", get_consts, METH_VARARGS, "Get constants"}
+#define MY_METHODS \
+    {"get_consts", get_consts, METH_VARARGS, "Get constants"}, \
+    {"generate_map_assets", (PyCFunction)generate_map_assets, METH_VARARGS | METH_KEYWORDS, "Precompute shared map assets"}
 
 #include "../env_binding.h"
 
+#define MAP_ASSETS_FILE "resources/impulse_wars/map_assets_v1.bin"
+
 #define setDictVal(dict, key, val)                                            \
     if (PyDict_SetItemString(dict, key, PyLong_FromLong(val)) < 0) {          \
         PyErr_SetString(PyExc_RuntimeError, "Failed to set " key " in dict"); \
@@ -76,9 +87,108 @@ static PyObject *get_consts(PyObject *self, PyObject *args) {
     return dict;
 }
 
+// Written to a temp file first so readers never see partial assets
+static int writeMapAssets(const char *path) {
+    const size_t size = mapAssetsSize();
+    uint8_t *buf = fastMalloc(size);
+    packMapAssets(buf);
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    int err = (f == NULL);
+    if (!err) {
+        err |= fwrite(buf, size, 1, f) != 1;
+        err |= fclose(f) != 0;
+        err = err || rename(tmp, path) != 0;
+        if (err) {
+            unlink(tmp);
+        }
+    }
+    fastFree(buf);
+    return err;
+}
+
+// Maps an assets file read-only and points the maps into it. Returns false
+// if the file is missing, stale or malformed
+static bool mapMapAssets(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mapAssetsHeader)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    if (!bindMapAssets(data, st.st_size)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    return true;
+}
+
+static PyObject *generate_map_assets(PyObject *self, PyObject *args, PyObject *kwargs) {
+    const char *path = MAP_ASSETS_FILE;
+    static char *kwlist[] = {"path", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|s", kwlist, &path)) {
+        return NULL;
+    }
+
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    // walls need to be created in a Box2D world to compute the assets,
+    // so use a throwaway env if the maps haven't been set up yet
+    if (maps[0]->paths == NULL) {
+        iwEnv *e = fastCalloc(1, sizeof(iwEnv));
+        initEnv(e, 2, 0, -1, 0, false, false, false, false);
+        initMaps(e);
+        // no drones were created
+        e->numDrones = 0;
+        destroyEnv(e);
+        fastFree(e->truncations);
+        fastFree(e);
+    }
+    err = writeMapAssets(path);
+    Py_END_ALLOW_THREADS
+    if (err) {
+        PyErr_Format(PyExc_OSError, "Failed to write map assets to %s", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject *my_shared(PyObject *self, PyObject *args, PyObject *kwargs) {
     VecEnv *ve = unpack_vecenv(args);
-    initMaps(ve->envs[0]);
+
+    // Map assets are shared read-only by every process. The first process
+    // to find the file missing computes and writes it under a lock while
+    // the others wait
+    if (maps[0]->paths == NULL && !mapMapAssets(MAP_ASSETS_FILE)) {
+        int lock = open(MAP_ASSETS_FILE ".lock", O_RDWR | O_CREAT, 0644);
+        if (lock >= 0 && flock(lock, LOCK_EX) == 0) {
+            if (!mapMapAssets(MAP_ASSETS_FILE)) {
+                initMaps(ve->envs[0]);
+                writeMapAssets(MAP_ASSETS_FILE);
+            }
+            flock(lock, LOCK_UN);
+        }
+        if (lock >= 0) {
+            close(lock);
+        }
+    }
+
+    // Fall back to private assets if the file can't be used
+    if (maps[0]->paths == NULL) {
+        initMaps(ve->envs[0]);
+    }
 
     for (uint16_t i = 0; i < ve->num_envs; i++) {
         iwEnv *e = (iwEnv *)ve->envs[i];
@@ -478,7 +478,7 @@ void setupEnv(iwEnv *e) {
         if (!e->isTraining) {
             firstMap = 1;
         }
-        mapIdx = randInt(&e->randState, firstMap, NUM_MAPS - 1);
+        mapIdx = randInt(&e->rng, firstMap, NUM_MAPS - 1);
     }
     DEBUG_LOGF("setting up map %d", mapIdx);
     setupMap(e, mapIdx);
@@ -493,7 +493,7 @@ void setupEnv(iwEnv *e) {
 
     DEBUG_LOG("creating weapon pickups");
     // start spawning pickups in a random quadrant
-    e->lastSpawnQuad = randInt(&e->randState, 0, 3);
+    e->lastSpawnQuad = randInt(&e->rng, 0, 3);
     for (uint8_t i = 0; i < maps[mapIdx]->weaponPickups; i++) {
         createWeaponPickup(e);
     }
@@ -548,7 +548,7 @@ iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, ui
     e->truncations = fastCalloc(numDrones, sizeof(uint8_t));
 
     setEnvFrameRate(e);
-    e->randState = seed;
+    e->rng = seed;
     e->needsReset = false;
 
     b2WorldDef worldDef = b2DefaultWorldDef();
@@ -565,19 +565,17 @@ iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, ui
     create_array(&e->floatingWalls, MAX_FLOATING_WALLS);
     create_array(&e->drones, e->numDrones);
     create_array(&e->pickups, MAX_WEAPON_PICKUPS);
-    create_array(&e->projectiles, 64);
-    create_array(&e->explosions, 8);
-    create_array(&e->explodingProjectiles, 8);
-    create_array(&e->dronePieces, 16);
-
-    e->mapPathing = fastCalloc(NUM_MAPS, sizeof(pathingInfo));
-    for (uint8_t i = 0; i < NUM_MAPS; i++) {
-        const mapEntry *map = maps[i];
-        pathingInfo *info = &e->mapPathing[i];
-        info->paths = fastMalloc(map->rows * map->columns * map->rows * map->columns * sizeof(uint8_t));
-        memset(info->paths, UINT8_MAX, map->rows * map->columns * map->rows * map->columns * sizeof(uint8_t));
-        info->pathBuffer = fastCalloc(3 * 8 * map->rows * map->columns, sizeof(int8_t));
-    }
+    create_array(&e->projectiles, MAX_PROJECTILES);
+    create_array(&e->explosions, MAX_EXPLOSIONS);
+    create_array(&e->explodingProjectiles, MAX_PROJECTILES);
+    create_array(&e->dronePieces, MAX_DRONE_PIECES);
+
+    e->projectileSlots = fastCalloc(MAX_PROJECTILES, sizeof(projectileEntity));
+    initEntityPool(&e->projectilePool, MAX_PROJECTILES);
+    e->dronePieceSlots = fastCalloc(MAX_DRONE_PIECES, sizeof(dronePieceEntity));
+    initEntityPool(&e->dronePiecePool, MAX_DRONE_PIECES);
+    e->explosionSlots = fastCalloc(MAX_EXPLOSIONS, sizeof(explosionInfo));
+    initEntityPool(&e->explosionPool, MAX_EXPLOSIONS);
 
     e->humanInput = false;
     e->humanDroneInput = 0;
@@ -617,7 +615,7 @@ void clearEnv(iwEnv *e) {
 
     for (size_t i = 0; i < cc_array_size(e->explosions); i++) {
         explosionInfo *explosion = safe_array_get_at(e->explosions, i);
-        fastFree(explosion);
+        destroyExplosionInfo(e, explosion);
     }
 
     for (size_t i = 0; i < cc_array_size(e->dronePieces); i++) {
@@ -637,13 +635,6 @@ void clearEnv(iwEnv *e) {
 void destroyEnv(iwEnv *e) {
     clearEnv(e);
 
-    for (uint8_t i = 0; i < NUM_MAPS; i++) {
-        pathingInfo *info = &e->mapPathing[i];
-        fastFree(info->paths);
-        fastFree(info->pathBuffer);
-    }
-    fastFree(e->mapPathing);
-
     for (size_t i = 0; i < cc_array_size(e->walls); i++) {
         wallEntity *wall = safe_array_get_at(e->walls, i);
         destroyWall(e, wall, false);
@@ -673,6 +664,13 @@ void destroyEnv(iwEnv *e) {
     cc_array_destroy(e->dronePieces);
 
     b2DestroyWorld(e->worldID);
+
+    fastFree(e->projectileSlots);
+    destroyEntityPool(&e->projectilePool);
+    fastFree(e->dronePieceSlots);
+    destroyEntityPool(&e->dronePiecePool);
+    fastFree(e->explosionSlots);
+    destroyEntityPool(&e->explosionPool);
 }
 
 void resetEnv(iwEnv *e) {
@@ -51,6 +51,30 @@ entity *getEntityByID(const iwEnv *e, const entityID *id) {
     return ent;
 }
 
+void initEntityPool(entityPool *pool, const uint16_t capacity) {
+    pool->capacity = capacity;
+    pool->free = fastCalloc(capacity, sizeof(uint16_t));
+    // hand out the lowest slots first
+    for (uint16_t i = 0; i < capacity; i++) {
+        pool->free[i] = capacity - i - 1;
+    }
+    pool->numFree = capacity;
+}
+
+void destroyEntityPool(entityPool *pool) {
+    fastFree(pool->free);
+}
+
+static inline uint16_t takePoolSlot(entityPool *pool) {
+    ASSERT(pool->numFree != 0);
+    return pool->free[--pool->numFree];
+}
+
+static inline void freePoolSlot(entityPool *pool, const uint16_t slot) {
+    ASSERT(pool->numFree < pool->capacity);
+    pool->free[pool->numFree++] = slot;
+}
+
 static inline bool entityTypeIsWall(const enum entityType type) {
     // walls are the first 3 entity types
     return type <= DEATH_WALL_ENTITY;
@@ -332,14 +356,14 @@ bool findOpenPos(iwEnv *e, const enum shapeCategory shapeType, b2Vec2 *emptyPos,
 
         uint16_t cellIdx;
         if (quad == -1) {
-            cellIdx = randInt(&e->randState, 0, nCells);
+            cellIdx = randInt(&e->rng, 0, nCells);
         } else {
             const float minX = e->map->spawnQuads[quad].min.x;
             const float minY = e->map->spawnQuads[quad].min.y;
             const float maxX = e->map->spawnQuads[quad].max.x;
             const float maxY = e->map->spawnQuads[quad].max.y;
 
-            b2Vec2 randPos = {.x = randFloat(&e->randState, minX, maxX), .y = randFloat(&e->randState, minY, maxY)};
+            b2Vec2 randPos = {.x = randFloat(&e->rng, minX, maxX), .y = randFloat(&e->rng, minY, maxY)};
             cellIdx = entityPosToCellIdx(e, randPos);
         }
         if (bitTest(checkedCells, cellIdx)) {
@@ -538,7 +562,7 @@ enum weaponType randWeaponPickupType(iwEnv *e) {
         totalWeight += spawnWeights[i - 1];
     }
 
-    const float randPick = randFloat(&e->randState, 0.0f, totalWeight);
+    const float randPick = randFloat(&e->rng, 0.0f, totalWeight);
     float cumulativeWeight = 0.0f;
     enum weaponType type = STANDARD_WEAPON;
     for (uint8_t i = 1; i < NUM_WEAPONS; i++) {
@@ -705,7 +729,7 @@ void createDrone(iwEnv *e, const uint8_t idx) {
         // doing this while training will result in much slower learning
         // due to drones starting much farther apart
         if (e->lastSpawnQuad == -1) {
-            spawnQuad = randInt(&e->randState, 0, 3);
+            spawnQuad = randInt(&e->rng, 0, 3);
         } else if (e->numDrones == 2) {
             spawnQuad = 3 - e->lastSpawnQuad;
         } else {
@@ -774,12 +798,20 @@ void droneAddEnergy(droneEntity *drone, float energy) {
 }
 
 void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
-    const float distance = randFloat(&e->randState, DRONE_PIECE_MIN_DISTANCE, DRONE_PIECE_MAX_DISTANCE);
-    const b2Vec2 direction = {.x = randFloat(&e->randState, -1.0f, 1.0f), .y = randFloat(&e->randState, -1.0f, 1.0f)};
+    // pieces only collide with walls and each other, so it's safe to skip
+    // them if the pool is exhausted
+    if (e->dronePiecePool.numFree == 0) {
+        DEBUG_LOG("drone piece pool exhausted");
+        return;
+    }
+
+    const float distance = randFloat(&e->rng, DRONE_PIECE_MIN_DISTANCE, DRONE_PIECE_MAX_DISTANCE);
+    const b2Vec2 direction = {.x = randFloat(&e->rng, -1.0f, 1.0f), .y = randFloat(&e->rng, -1.0f, 1.0f)};
     const b2Vec2 pos = b2MulAdd(drone->pos, distance, direction);
-    const b2Rot rot = b2MakeRot(randFloat(&e->randState, -PI, PI));
+    const b2Rot rot = b2MakeRot(randFloat(&e->rng, -PI, PI));
 
-    dronePieceEntity *piece = fastCalloc(1, sizeof(dronePieceEntity));
+    dronePieceEntity *piece = &e->dronePieceSlots[takePoolSlot(&e->dronePiecePool)];
+    memset(piece, 0x0, sizeof(dronePieceEntity));
     piece->droneIdx = drone->idx;
     piece->pos = pos;
     piece->rot = rot;
@@ -797,9 +829,9 @@ void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
     pieceBodyDef.linearDamping = DRONE_PIECE_LINEAR_DAMPING;
     pieceBodyDef.angularDamping = DRONE_PIECE_ANGULAR_DAMPING;
     const float bonus = 1.0f + min(b2Length(drone->velocity) / 15.0f, 5.0f);
-    const float speed = randFloat(&e->randState, DRONE_PIECE_MIN_SPEED, DRONE_PIECE_MAX_SPEED) * bonus;
+    const float speed = randFloat(&e->rng, DRONE_PIECE_MIN_SPEED, DRONE_PIECE_MAX_SPEED) * bonus;
     pieceBodyDef.linearVelocity = b2MulSV(speed, direction);
-    pieceBodyDef.angularVelocity = randFloat(&e->randState, -PI, PI);
+    pieceBodyDef.angularVelocity = randFloat(&e->rng, -PI, PI);
     pieceBodyDef.userData = ent;
     piece->bodyID = b2CreateBody(e->worldID, &pieceBodyDef);
 
@@ -831,7 +863,7 @@ void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
 void destroyDronePiece(iwEnv *e, dronePieceEntity *piece) {
     b2DestroyBody(piece->bodyID);
     destroyEntity(e, piece->ent);
-    fastFree(piece);
+    freePoolSlot(&e->dronePiecePool, piece - e->dronePieceSlots);
 }
 
 void destroyDroneShield(iwEnv *e, shieldEntity *shield, const bool createPieces) {
@@ -1100,11 +1132,12 @@ void createProjectile(iwEnv *e, droneEntity *drone, const b2Vec2 normAim) {
     b2Vec2 forwardVel = b2MulSV(b2Dot(drone->velocity, normAim), normAim);
     b2Vec2 lateralVel = b2Sub(drone->velocity, forwardVel);
     lateralVel = b2MulSV(projectileShapeDef.density * DRONE_MOVE_AIM_COEF, lateralVel);
-    b2Vec2 aim = weaponAdjustAim(&e->randState, drone->weaponInfo->type, drone->heat, normAim);
-    b2Vec2 fire = b2MulAdd(lateralVel, weaponFire(&e->randState, drone->weaponInfo->type), aim);
+    b2Vec2 aim = weaponAdjustAim(&e->rng, drone->weaponInfo->type, drone->heat, normAim);
+    b2Vec2 fire = b2MulAdd(lateralVel, weaponFire(&e->rng, drone->weaponInfo->type), aim);
     b2Body_ApplyLinearImpulseToCenter(projectileBodyID, fire, true);
 
-    projectileEntity *projectile = fastCalloc(1, sizeof(projectileEntity));
+    projectileEntity *projectile = &e->projectileSlots[takePoolSlot(&e->projectilePool)];
+    memset(projectile, 0x0, sizeof(projectileEntity));
     projectile->droneIdx = drone->idx;
     projectile->bodyID = projectileBodyID;
     projectile->shapeID = projectileShapeID;
@@ -1115,9 +1148,6 @@ void createProjectile(iwEnv *e, droneEntity *drone, const b2Vec2 normAim) {
     projectile->lastVelocity = projectile->velocity;
     projectile->speed = b2Length(projectile->velocity);
     projectile->lastSpeed = projectile->speed;
-    if (projectile->weaponInfo->type == BLACK_HOLE_WEAPON) {
-        create_array(&projectile->entsInBlackHole, 4);
-    }
     cc_array_add(e->projectiles, projectile);
 
     entity *ent = createEntity(e, PROJECTILE_ENTITY, projectile);
@@ -1163,6 +1193,23 @@ float getShapeProjectedPerimeter(const b2ShapeId shapeID, const b2Vec2 line) {
     return upper - lower;
 }
 
+// explosions are only tracked for rendering; returns NULL if the env isn't
+// being rendered or the pool is exhausted
+explosionInfo *createExplosionInfo(iwEnv *e) {
+    if (e->client == NULL || e->explosionPool.numFree == 0) {
+        return NULL;
+    }
+    explosionInfo *explInfo = &e->explosionSlots[takePoolSlot(&e->explosionPool)];
+    memset(explInfo, 0x0, sizeof(explosionInfo));
+    explInfo->renderSteps = UINT16_MAX;
+    cc_array_add(e->explosions, explInfo);
+    return explInfo;
+}
+
+void destroyExplosionInfo(iwEnv *e, explosionInfo *explInfo) {
+    freePoolSlot(&e->explosionPool, explInfo - e->explosionSlots);
+}
+
 // explodes projectile and ensures any other projectiles that are caught
 // in the explosion are also destroyed if necessary
 void createProjectileExplosion(iwEnv *e, projectileEntity *projectile, const bool initalProjectile) {
@@ -1179,11 +1226,9 @@ void createProjectileExplosion(iwEnv *e, projectileEntity *projectile, const boo
     droneEntity *parentDrone = safe_array_get_at(e->drones, projectile->droneIdx);
     createExplosion(e, parentDrone, projectile, &explosion);
 
-    if (e->client != NULL) {
-        explosionInfo *explInfo = fastCalloc(1, sizeof(explosionInfo));
+    explosionInfo *explInfo = createExplosionInfo(e);
+    if (explInfo != NULL) {
         explInfo->def = explosion;
-        explInfo->renderSteps = UINT16_MAX;
-        cc_array_add(e->explosions, explInfo);
     }
     if (!initalProjectile) {
         return;
@@ -1343,8 +1388,8 @@ bool explodeCallback(b2ShapeId shapeID, void *context) {
     // if the direction is zero, the magnitude cannot be calculated
     // correctly so set the direction randomly
     if (b2VecEqual(direction, b2Vec2_zero)) {
-        direction.x = randFloat(&ctx->e->randState, -1.0f, 1.0f);
-        direction.y = randFloat(&ctx->e->randState, -1.0f, 1.0f);
+        direction.x = randFloat(&ctx->e->rng, -1.0f, 1.0f);
+        direction.y = randFloat(&ctx->e->rng, -1.0f, 1.0f);
         direction = b2Normalize(direction);
     }
 
@@ -1602,15 +1647,7 @@ void destroyProjectile(iwEnv *e, projectileEntity *projectile, const bool proces
     e->stats[projectile->droneIdx].shotDistances[projectile->weaponInfo->type] += projectile->distance;
     e->stats[projectile->droneIdx].totalShotDistances += projectile->distance;
 
-    if (projectile->entsInBlackHole != NULL) {
-        for (uint8_t i = 0; i < cc_array_size(projectile->entsInBlackHole); i++) {
-            entityID *id = safe_array_get_at(projectile->entsInBlackHole, i);
-            fastFree(id);
-        }
-        cc_array_destroy(projectile->entsInBlackHole);
-    }
-
-    fastFree(projectile);
+    freePoolSlot(&e->projectilePool, projectile - e->projectileSlots);
 }
 
 // destroy projectiles that were caught in an explosion; projectiles
@@ -1819,6 +1856,12 @@ void droneShoot(iwEnv *e, droneEntity *drone, const b2Vec2 aim, const bool charg
     if (weaponNeedsCharge && (chargingWeapon || drone->weaponCharge < drone->weaponInfo->charge)) {
         return;
     }
+    // hold fire until there are slots for every projectile of the shot,
+    // so ammo, recoil and stats are only spent on shots that are created
+    if (e->projectilePool.numFree < drone->weaponInfo->numProjectiles) {
+        DEBUG_LOG("projectile pool exhausted");
+        return;
+    }
 
     if (drone->ammo != INFINITE) {
         drone->ammo--;
@@ -1951,13 +1994,11 @@ void droneBurst(iwEnv *e, droneEntity *drone) {
     }
     e->stats[drone->idx].totalBursts++;
 
-    if (e->client != NULL) {
-        explosionInfo *explInfo = fastCalloc(1, sizeof(explosionInfo));
+    explosionInfo *explInfo = createExplosionInfo(e);
+    if (explInfo != NULL) {
         explInfo->def = explosion;
         explInfo->isBurst = true;
         explInfo->droneIdx = drone->idx;
-        explInfo->renderSteps = UINT16_MAX;
-        cc_array_add(e->explosions, explInfo);
     }
 }
 
@@ -2041,19 +2082,15 @@ bool droneStep(iwEnv *e, droneEntity *drone) {
 void handleBlackHolePull(iwEnv *e, projectileEntity *projectile) {
     ASSERT(projectile->weaponInfo->type == BLACK_HOLE_WEAPON);
 
-    CC_ArrayIter entIter;
-    cc_array_iter_init(&entIter, projectile->entsInBlackHole);
-    entityID *id;
-    while (cc_array_iter_next(&entIter, (void **)&id) != CC_ITER_END) {
+    uint8_t i = 0;
+    while (i < projectile->numEntsInBlackHole) {
         // check if the entity is still valid
-        const entity *ent = getEntityByID(e, id);
+        const entity *ent = getEntityByID(e, &projectile->entsInBlackHole[i]);
         if (ent == NULL) {
-            fastFree(id);
-            enum cc_stat res = cc_array_iter_remove_fast(&entIter, NULL);
-            MAYBE_UNUSED(res);
-            ASSERT(res == CC_OK);
+            projectile->entsInBlackHole[i] = projectile->entsInBlackHole[--projectile->numEntsInBlackHole];
             continue;
         }
+        i++;
         const b2DistanceOutput output = closestPoint(projectile->ent, ent);
         const b2QueryFilter filter = {.categoryBits = PROJECTILE_SHAPE, .maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE};
         if (posBehindWall(e, projectile->pos, output.pointB, ent, filter, NULL)) {
@@ -2178,7 +2215,7 @@ void projectilesStep(iwEnv *e) {
             }
         }
 
-        if (projectile->entsInBlackHole != NULL) {
+        if (projectile->weaponInfo->type == BLACK_HOLE_WEAPON) {
             handleBlackHolePull(e, projectile);
         }
 
@@ -2712,11 +2749,11 @@ void handleProjectileBeginTouch(iwEnv *e, const entity *sensor, entity *visitor)
 
         // copy the entity ID so it won't be changed if the entity is
         // destroyed and reused later
-        const entityID *visitorID = visitor->id;
-        entityID *id = fastCalloc(1, sizeof(entityID));
-        id->id = visitorID->id;
-        id->generation = visitorID->generation;
-        cc_array_add(projectile->entsInBlackHole, id);
+        if (projectile->numEntsInBlackHole == MAX_ENTS_IN_BLACK_HOLE) {
+            DEBUG_LOG("too many entities in black hole");
+            break;
+        }
+        projectile->entsInBlackHole[projectile->numEntsInBlackHole++] = *visitor->id;
         break;
     default:
         ERRORF("invalid projectile type %d for begin touch event", sensor->type);
@@ -2768,11 +2805,9 @@ void handleProjectileEndTouch(const entity *sensor, entity *visitor) {
         }
 
         const entityID *visitorID = visitor->id;
-        for (uint8_t i = 0; i < cc_array_size(projectile->entsInBlackHole); ++i) {
-            entityID *id = safe_array_get_at(projectile->entsInBlackHole, i);
-            if (id->id == visitorID->id) {
-                fastFree(id);
-                cc_array_remove_fast_at(projectile->entsInBlackHole, i, NULL);
+        for (uint8_t i = 0; i < projectile->numEntsInBlackHole; ++i) {
+            if (projectile->entsInBlackHole[i].id == visitorID->id) {
+                projectile->entsInBlackHole[i] = projectile->entsInBlackHole[--projectile->numEntsInBlackHole];
                 return;
             }
         }
@@ -450,8 +450,8 @@ void setupMap(iwEnv *e, const uint8_t mapIdx) {
     e->mapIdx = mapIdx;
     e->map = maps[mapIdx];
     e->defaultWeapon = weaponInfos[maps[mapIdx]->defaultWeapon];
-    if (e->isTraining && randFloat(&e->randState, 0.0f, 1.0f) < 0.25f) {
-        e->defaultWeapon = weaponInfos[randInt(&e->randState, 0, NUM_WEAPONS - 1)];
+    if (e->isTraining && randFloat(&e->rng, 0.0f, 1.0f) < 0.25f) {
+        e->defaultWeapon = weaponInfos[randInt(&e->rng, 0, NUM_WEAPONS - 1)];
     }
 
     uint16_t cellIdx = 0;
@@ -576,6 +576,113 @@ bool posValidDroneSpawnPoint(const iwEnv *e, const b2Vec2 pos) {
     return true;
 }
 
+static inline uint32_t pathOffset(const iwEnv *e, uint16_t srcCellIdx, uint16_t destCellIdx) {
+    const uint8_t srcCol = srcCellIdx % e->map->columns;
+    const uint8_t srcRow = srcCellIdx / e->map->columns;
+    const uint8_t destCol = destCellIdx % e->map->columns;
+    const uint8_t destRow = destCellIdx / e->map->columns;
+    return (destRow * e->map->rows * e->map->columns * e->map->rows) + (destCol * e->map->rows * e->map->columns) + (srcRow * e->map->columns) + srcCol;
+}
+
+void pathfindBFS(const iwEnv *e, uint8_t *flatPaths, int8_t *pathBuffer, uint16_t destCellIdx) {
+    uint8_t (*paths)[e->map->columns] = (uint8_t (*)[e->map->columns])flatPaths;
+    int8_t (*buffer)[3] = (int8_t (*)[3])pathBuffer;
+
+    uint16_t start = 0;
+    uint16_t end = 1;
+
+    const mapCell *cell = safe_array_get_at(e->cells, destCellIdx);
+    if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
+        return;
+    }
+    const int8_t destCol = destCellIdx % e->map->columns;
+    const int8_t destRow = destCellIdx / e->map->columns;
+
+    buffer[start][0] = 8;
+    buffer[start][1] = destCol;
+    buffer[start][2] = destRow;
+    while (start < end) {
+        const int8_t direction = buffer[start][0];
+        const int8_t startCol = buffer[start][1];
+        const int8_t startRow = buffer[start][2];
+        start++;
+
+        if (startCol < 0 || startCol >= e->map->columns || startRow < 0 || startRow >= e->map->rows || paths[startRow][startCol] != UINT8_MAX) {
+            continue;
+        }
+        int16_t cellIdx = cellIndex(e, startCol, startRow);
+        const mapCell *cell = safe_array_get_at(e->cells, cellIdx);
+        if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
+            paths[startRow][startCol] = 8;
+            continue;
+        }
+
+        paths[startRow][startCol] = direction;
+
+        buffer[end][0] = 6; // up
+        buffer[end][1] = startCol;
+        buffer[end][2] = startRow + 1;
+        end++;
+
+        buffer[end][0] = 2; // down
+        buffer[end][1] = startCol;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 0; // right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow;
+        end++;
+
+        buffer[end][0] = 4; // left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow;
+        end++;
+
+        buffer[end][0] = 5; // up left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow + 1;
+        end++;
+
+        buffer[end][0] = 3; // down left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 1; // down right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 7; // up right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow + 1;
+        end++;
+    }
+}
+
+// runs a BFS to every open cell so scripted agents never have to pathfind
+// during an episode; cells that can't reach the destination are set to 8
+// the same as walls
+uint8_t *computeMapPaths(const iwEnv *e, const mapEntry *map) {
+    const uint16_t cells = map->columns * map->rows;
+    uint8_t *paths = fastMalloc(cells * cells * sizeof(uint8_t));
+    memset(paths, UINT8_MAX, cells * cells * sizeof(uint8_t));
+    int8_t *pathBuffer = fastCalloc(3 * 8 * cells, sizeof(int8_t));
+
+    for (uint16_t destCellIdx = 0; destCellIdx < cells; destCellIdx++) {
+        pathfindBFS(e, &paths[pathOffset(e, 0, destCellIdx)], pathBuffer, destCellIdx);
+    }
+    for (uint32_t i = 0; i < (uint32_t)cells * cells; i++) {
+        if (paths[i] == UINT8_MAX) {
+            paths[i] = 8;
+        }
+    }
+
+    fastFree(pathBuffer);
+    return paths;
+}
+
 void initMaps(iwEnv *e) {
     for (uint8_t i = 0; i < NUM_MAPS; i++) {
         setupMap(e, i);
@@ -621,6 +728,7 @@ void initMaps(iwEnv *e) {
         map->droneSpawns = droneSpawns;
         map->packedLayout = packedLayout;
         map->nearestWalls = nearestWalls;
+        map->paths = computeMapPaths(e, map);
 
         // clear floating walls from the map
         for (uint8_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
@@ -633,13 +741,149 @@ void initMaps(iwEnv *e) {
     e->mapIdx = -1;
 }
 
+// set when the map assets point into a mapped assets file instead of
+// being owned by the maps
+bool mapAssetsShared = false;
+
 void destroyMaps() {
+    if (mapAssetsShared) {
+        return;
+    }
     for (uint8_t i = 0; i < NUM_MAPS; i++) {
         mapEntry *map = maps[i];
         fastFree(map->droneSpawns);
         fastFree(map->packedLayout);
         fastFree(map->nearestWalls);
+        fastFree(map->paths);
+    }
+}
+
+// Map assets can be saved to a file so they can be computed once and
+// shared by every process. The file is a header followed by one section
+// per map, in the order of maps; each section holds the map's bounds and
+// spawn quadrants, then nearest walls, packed layout, drone spawns and
+// paths, padded to 8 bytes.
+
+#define MAP_ASSETS_MAGIC 0x50414d49
+#define MAP_ASSETS_VERSION 1
+
+typedef struct mapAssetsHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numMaps;
+    uint32_t maxNearestWalls;
+    uint64_t hash;
+    uint64_t size;
+} mapAssetsHeader;
+
+static inline uint64_t mapAssetsHashBytes(uint64_t hash, const void *data, const size_t size) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// hash of everything the assets are computed from so stale files can be
+// detected after maps or spawn settings change
+uint64_t mapAssetsHash() {
+    uint64_t hash = 1469598103934665603ULL;
+    const float settings[] = {WALL_THICKNESS, DRONE_WALL_SPAWN_DISTANCE, DRONE_DEATH_WALL_SPAWN_DISTANCE};
+    hash = mapAssetsHashBytes(hash, settings, sizeof(settings));
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        const mapEntry *map = maps[i];
+        hash = mapAssetsHashBytes(hash, &map->columns, sizeof(map->columns));
+        hash = mapAssetsHashBytes(hash, &map->rows, sizeof(map->rows));
+        hash = mapAssetsHashBytes(hash, map->layout, map->columns * map->rows);
+    }
+    return hash;
+}
+
+static inline size_t mapAssetsSectionSize(const mapEntry *map) {
+    const size_t cells = map->columns * map->rows;
+    const size_t size = (5 * sizeof(mapBounds)) + (MAX_NEAREST_WALLS * cells * sizeof(nearEntity)) + (2 * cells) + (cells * cells);
+    return (size + 7) & ~(size_t)7;
+}
+
+size_t mapAssetsSize() {
+    size_t size = sizeof(mapAssetsHeader);
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        size += mapAssetsSectionSize(maps[i]);
     }
+    return size;
+}
+
+// writes the assets computed by initMaps to buf, which must be
+// mapAssetsSize() bytes
+void packMapAssets(uint8_t *buf) {
+    memset(buf, 0x0, mapAssetsSize());
+    mapAssetsHeader *header = (mapAssetsHeader *)buf;
+    header->magic = MAP_ASSETS_MAGIC;
+    header->version = MAP_ASSETS_VERSION;
+    header->numMaps = NUM_MAPS;
+    header->maxNearestWalls = MAX_NEAREST_WALLS;
+    header->hash = mapAssetsHash();
+    header->size = mapAssetsSize();
+
+    uint8_t *section = buf + sizeof(mapAssetsHeader);
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        const mapEntry *map = maps[i];
+        const size_t cells = map->columns * map->rows;
+
+        mapBounds *bounds = (mapBounds *)section;
+        bounds[0] = map->bounds;
+        memcpy(&bounds[1], map->spawnQuads, 4 * sizeof(mapBounds));
+
+        nearEntity *nearestWalls = (nearEntity *)(bounds + 5);
+        for (size_t j = 0; j < MAX_NEAREST_WALLS * cells; j++) {
+            nearestWalls[j].idx = map->nearestWalls[j].idx;
+            nearestWalls[j].distanceSquared = map->nearestWalls[j].distanceSquared;
+        }
+        uint8_t *packedLayout = (uint8_t *)(nearestWalls + (MAX_NEAREST_WALLS * cells));
+        memcpy(packedLayout, map->packedLayout, cells);
+        bool *droneSpawns = (bool *)(packedLayout + cells);
+        memcpy(droneSpawns, map->droneSpawns, cells * sizeof(bool));
+        uint8_t *paths = (uint8_t *)(droneSpawns + cells);
+        memcpy(paths, map->paths, cells * cells);
+
+        section += mapAssetsSectionSize(map);
+    }
+}
+
+// points the map assets into buf, which must stay valid for as long as
+// the maps are used; returns false if buf was written by a different
+// version or from different maps or settings
+bool bindMapAssets(const uint8_t *buf, const size_t size) {
+    const mapAssetsHeader *header = (const mapAssetsHeader *)buf;
+    if (size < sizeof(mapAssetsHeader) || header->magic != MAP_ASSETS_MAGIC || header->version != MAP_ASSETS_VERSION) {
+        return false;
+    }
+    if (header->numMaps != NUM_MAPS || header->maxNearestWalls != MAX_NEAREST_WALLS || header->hash != mapAssetsHash()) {
+        return false;
+    }
+    if (header->size != size || size != mapAssetsSize()) {
+        return false;
+    }
+
+    const uint8_t *section = buf + sizeof(mapAssetsHeader);
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        mapEntry *map = maps[i];
+        const size_t cells = map->columns * map->rows;
+
+        const mapBounds *bounds = (const mapBounds *)section;
+        map->bounds = bounds[0];
+        memcpy(map->spawnQuads, &bounds[1], 4 * sizeof(mapBounds));
+
+        map->nearestWalls = (nearEntity *)(bounds + 5);
+        map->packedLayout = (uint8_t *)(map->nearestWalls + (MAX_NEAREST_WALLS * cells));
+        map->droneSpawns = (bool *)(map->packedLayout + cells);
+        map->paths = (uint8_t *)(map->droneSpawns + cells);
+
+        section += mapAssetsSectionSize(map);
+    }
+
+    mapAssetsShared = true;
+    return true;
 }
 
 void placeRandFloatingWall(iwEnv *e, const enum entityType wallType) {
@@ -924,7 +924,7 @@ void renderBrakeTrails(iwEnv *e, const droneEntity *drone) {
 }
 
 // TODO: improve
-void renderExplosions(const iwEnv *e) {
+void renderExplosions(iwEnv *e) {
     const uint16_t maxRenderSteps = EXPLOSION_TIME * e->frameRate;
 
     CC_ArrayIter iter;
@@ -935,7 +935,7 @@ void renderExplosions(const iwEnv *e) {
         if (explosion->renderSteps == UINT16_MAX) {
             explosion->renderSteps = maxRenderSteps;
         } else if (explosion->renderSteps == 0) {
-            fastFree(explosion);
+            destroyExplosionInfo(e, explosion);
             cc_array_iter_remove(&iter, NULL);
             continue;
         }
@@ -1210,7 +1210,7 @@ void renderDroneGuides(iwEnv *e, const droneEntity *drone, const bool ending) {
     if (!b2VecEqual(drone->lastMove, b2Vec2_zero) && !ending) {
         const float moveMagnitude = b2Length(drone->lastMove);
         const float thrusterAngle = RAD2DEG * b2Atan2(-drone->lastMove.y, -drone->lastMove.x);
-        const float flickerWidth = randFloat(&e->randState, -0.05f, 0.05f);
+        const float flickerWidth = randFloat(&e->rng, -0.05f, 0.05f);
         const float thrusterWidth = 2.5f * ((halfDroneRadius * moveMagnitude) + halfDroneRadius + flickerWidth);
         const b2Vec2 thrusterPos = b2MulAdd(drone->pos, -thrusterWidth / 2.0f, drone->lastMove);
         const Color thrusterColor = Fade(getDroneColor(drone->idx), 0.9);
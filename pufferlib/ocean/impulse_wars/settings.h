@@ -21,6 +21,9 @@ const uint8_t NUM_MAPS = 9;
 #define MAX_CELLS _MAX_MAP_COLUMNS *_MAX_MAP_ROWS + 1
 #define MAX_FLOATING_WALLS 18
 #define MAX_WEAPON_PICKUPS 12
+#define MAX_PROJECTILES 128
+#define MAX_DRONE_PIECES 64
+#define MAX_EXPLOSIONS 32
 
 #define MAX_NEAREST_WALLS 8
 
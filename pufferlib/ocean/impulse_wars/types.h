@@ -18,6 +18,8 @@ const uint8_t NUM_WALL_TYPES = 3;
 #define MAX_DRONE_TRAIL_POINTS 20
 #define MAX_PROJECTLE_TRAIL_POINTS 10
 
+#define MAX_ENTS_IN_BLACK_HOLE 32
+
 enum entityType {
     STANDARD_WALL_ENTITY,
     BOUNCY_WALL_ENTITY,
@@ -100,6 +102,9 @@ typedef struct mapEntry {
     bool *droneSpawns;
     uint8_t *packedLayout;
     nearEntity *nearestWalls;
+    // first move towards a destination cell from every source cell,
+    // indexed by pathOffset; 8 if there is no path
+    uint8_t *paths;
 } mapEntry;
 
 // a cell in the map; ent will be NULL if the cell is empty
@@ -196,7 +201,8 @@ typedef struct projectileEntity {
     bool setMine;
     uint8_t numDronesBehindWalls;
     uint8_t dronesBehindWalls[_MAX_DRONES];
-    CC_Array *entsInBlackHole;
+    uint8_t numEntsInBlackHole;
+    entityID entsInBlackHole[MAX_ENTS_IN_BLACK_HOLE];
     bool needsToBeDestroyed;
 
     entity *ent;
@@ -383,6 +389,15 @@ typedef struct explosionInfo {
     uint16_t renderSteps;
 } explosionInfo;
 
+// fixed-capacity free list of slot indices into a per-env array of
+// entities; only the entity structs are pooled, Box2D bodies are still
+// created and destroyed with the entity
+typedef struct entityPool {
+    uint16_t capacity;
+    uint16_t *free;
+    uint16_t numFree;
+} entityPool;
+
 typedef struct agentActions {
     b2Vec2 move;
     b2Vec2 aim;
@@ -393,11 +408,6 @@ typedef struct agentActions {
     bool discardWeapon;
 } agentActions;
 
-typedef struct pathingInfo {
-    uint8_t *paths;
-    int8_t *pathBuffer;
-} pathingInfo;
-
 typedef struct iwEnv {
     uint8_t numDrones;
     uint8_t numAgents;
@@ -421,7 +431,7 @@ typedef struct iwEnv {
     float deltaTime;
     uint8_t frameSkip;
     uint8_t box2dSubSteps;
-    uint64_t randState;
+    uint64_t rng;
     bool needsReset;
 
     uint16_t episodeLength;
@@ -446,7 +456,10 @@ typedef struct iwEnv {
     CC_Array *explodingProjectiles;
     CC_Array *dronePieces;
 
-    pathingInfo *mapPathing;
+    projectileEntity *projectileSlots;
+    entityPool projectilePool;
+    dronePieceEntity *dronePieceSlots;
+    entityPool dronePiecePool;
 
     uint16_t totalSteps;
     uint16_t totalSuddenDeathSteps;
@@ -466,6 +479,8 @@ typedef struct iwEnv {
     rayClient *client;
     float renderScale;
     CC_Array *explosions;
+    explosionInfo *explosionSlots;
+    entityPool explosionPool;
     b2Vec2 debugPoint;
 } iwEnv;
 
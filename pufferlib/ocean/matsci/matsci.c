@@ -13,7 +13,7 @@ int main() {
     c_render(&env);
     while (!WindowShouldClose()) {
 	for (int i=0; i<3*num_agents; i++) {
-            env.actions[i] = rndf(-1.0f, 1.0f);
+            env.actions[i] = rndf(&env.rng, -1.0f, 1.0f);
 	}
         c_step(&env);
         c_render(&env);
@@ -4,6 +4,7 @@
 #include <math.h>
 #include <lammps/library.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define WIDTH 1080
 #define HEIGHT 720
@@ -25,8 +26,8 @@ static inline float clampf(float v, float min, float max) {
     return v;
 }
 
-static inline float rndf(float a, float b) {
-    return a + ((float)rand() / (float)RAND_MAX) * (b - a);
+static inline float rndf(uint64_t* rng, float a, float b) {
+    return a + puffer_randf(rng) * (b - a);
 }
 
 static inline Vec3 add3(Vec3 a, Vec3 b) { return (Vec3){a.x + b.x, a.y + b.y, a.z + b.z}; }
@@ -66,6 +67,7 @@ typedef struct {
 
 typedef struct {
     Log log;                     // Required field
+    uint64_t rng;                // Required field. Seeded by env_binding.h
     float* observations;         // Required field. Ensure type matches in .py and .c
     float* actions;              // Required field. Ensure type matches in .py and .c
     float* rewards;              // Required field
@@ -125,9 +127,9 @@ void compute_observations(Matsci* env) {
 }
 
 void reset_atom(Matsci* env, double** x, int i) {
-    x[i][0] = rndf(-10.0f, 10.0f);
-    x[i][1] = rndf(-10.0f, 10.0f);
-    x[i][2] = rndf(-10.0f, 10.0f);
+    x[i][0] = rndf(&env->rng, -10.0f, 10.0f);
+    x[i][1] = rndf(&env->rng, -10.0f, 10.0f);
+    x[i][2] = rndf(&env->rng, -10.0f, 10.0f);
 }
 
 void c_reset(Matsci* env) {
@@ -136,9 +138,9 @@ void c_reset(Matsci* env) {
     for (int i=0; i<env->num_agents; i++) {
 	reset_atom(env, x, i);
     }
-    env->goal.x = rndf(-10.0f, 10.0f);
-    env->goal.y = rndf(-10.0f, 10.0f);
-    env->goal.z = rndf(-10.0f, 10.0f);
+    env->goal.x = rndf(&env->rng, -10.0f, 10.0f);
+    env->goal.y = rndf(&env->rng, -10.0f, 10.0f);
+    env->goal.z = rndf(&env->rng, -10.0f, 10.0f);
     env->tick = 0;
 }
 
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 const Color PUFF_RED = (Color){187, 0, 0, 255};
 const Color PUFF_CYAN = (Color){0, 187, 187, 255};
@@ -15,6 +16,7 @@ typedef struct {
 
 typedef struct {
     Log log;                     // Required field
+    uint64_t rng;                // Required field. Seeded by env_binding.h
     float* observations;         // Required field. Ensure type matches in .py and .c
     int* actions;                // Required field. Ensure type matches in .py and .c
     float* rewards;              // Required field
@@ -25,7 +27,7 @@ typedef struct {
 } Memory;
 
 void c_reset(Memory* env) {
-    env->goal = (rand()%2 == 0) ? -1 : 1;
+    env->goal = (puffer_rand(&env->rng)%2 == 0) ? -1 : 1;
     env->observations[0] = env->goal;
     env->tick = 0;
 }
@@ -1,23 +1,222 @@
+#include <Python.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "moba.h"
 
+static PyObject* generate_paths(PyObject* self, PyObject* args, PyObject* kwargs);
+
 #define Env MOBA
 #define MY_SHARED
+#define MY_METHODS {"generate_paths", (PyCFunction)generate_paths, METH_VARARGS | METH_KEYWORDS, "Precompute the MOBA path table"}
 #include "../env_binding.h"
 
+#define PATHS_FILE "resources/moba/ai_paths_v1.bin"
+#define PATHS_N 128
+
+typedef struct {
+    Map map;
+    const short* index;
+    const int* cells;
+    int walkable;
+    unsigned char* moves;
+    int next;
+} PathJob;
+
+// Claims rows until none are left. A worker that cannot get its scratch
+// claims nothing, so the rows fall to the others
+static void* paths_worker(void* arg) {
+    PathJob* job = arg;
+    unsigned char* scratch = calloc(PATHS_N*PATHS_N, 1);
+    int* buffer = calloc(3*8*PATHS_N*PATHS_N, sizeof(int));
+    while (scratch != NULL && buffer != NULL) {
+        int dst = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (dst >= job->walkable)
+            break;
+        paths_fill_rows(&job->map, job->index, job->cells, job->walkable,
+            job->moves, dst, dst + 1, scratch, buffer);
+    }
+    free(scratch);
+    free(buffer);
+    return NULL;
+}
+
+// Runs bfs from every walkable cell across threads and writes the packed
+// table. Written to a temp file first so readers never see a partial table
+static int write_paths(const char* path, unsigned char* grid, int num_threads) {
+    short* index = malloc(PATHS_N*PATHS_N*sizeof(short));
+    int* cells = malloc(PATHS_N*PATHS_N*sizeof(int));
+    if (index == NULL || cells == NULL) {
+        free(index);
+        free(cells);
+        return 1;
+    }
+    int walkable = 0;
+    for (int i = 0; i < PATHS_N*PATHS_N; i++) {
+        index[i] = -1;
+        if (grid[i] != WALL) {
+            index[i] = walkable;
+            cells[walkable++] = i;
+        }
+    }
+    size_t row_bytes = (walkable + 1)/2;
+    unsigned char* moves = malloc(walkable*row_bytes);
+    if (moves == NULL) {
+        free(index);
+        free(cells);
+        return 1;
+    }
+
+    PathJob job = {
+        .map = {.grid = grid, .width = PATHS_N, .height = PATHS_N},
+        .index = index,
+        .cells = cells,
+        .walkable = walkable,
+        .moves = moves,
+    };
+    if (num_threads <= 0)
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+        num_threads = 1;
+
+    // The calling thread works too and picks up whatever the threads that
+    // did start leave over, so failing to start any of them only costs time
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < num_threads - 1
+            && pthread_create(&threads[started], NULL, paths_worker, &job) == 0)
+        started++;
+    paths_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    PathHeader header = {
+        .magic = PATHS_MAGIC,
+        .version = PATHS_VERSION,
+        .width = PATHS_N,
+        .walkable = walkable,
+        .map_hash = paths_map_hash(grid, PATHS_N*PATHS_N),
+    };
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    // Rows are left unclaimed only if no worker got its scratch
+    int err = job.next < walkable;
+    FILE* f = err ? NULL : fopen(tmp, "wb");
+    err |= (f == NULL);
+    if (!err) {
+        err |= fwrite(&header, sizeof(header), 1, f) != 1;
+        err |= fwrite(index, sizeof(short), PATHS_N*PATHS_N, f) != PATHS_N*PATHS_N;
+        err |= fwrite(moves, row_bytes, walkable, f) != (size_t)walkable;
+        err |= fclose(f) != 0;
+        err = err || rename(tmp, path) != 0;
+        if (err)
+            unlink(tmp);
+    }
+    free(index);
+    free(cells);
+    free(moves);
+    return err;
+}
+
+// Maps a table file read-only and checks it against the current game map.
+// Returns NULL if the file is missing, stale or malformed
+static PathTable* map_paths(const char* path, unsigned char* grid) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PathHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    PathHeader* header = data;
+    size_t row_bytes = (header->walkable + 1)/2;
+    size_t expected = sizeof(PathHeader) + PATHS_N*PATHS_N*sizeof(short)
+        + (size_t)header->walkable*row_bytes;
+    if (header->magic != PATHS_MAGIC || header->version != PATHS_VERSION
+            || header->width != PATHS_N || (size_t)st.st_size != expected
+            || header->map_hash != paths_map_hash(grid, PATHS_N*PATHS_N)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    PathTable* table = calloc(1, sizeof(PathTable));
+    table->index = (const short*)((char*)data + sizeof(PathHeader));
+    table->moves = (const unsigned char*)(table->index + PATHS_N*PATHS_N);
+    table->row_bytes = row_bytes;
+    return table;
+}
+
+static PyObject* generate_paths(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* path = PATHS_FILE;
+    int num_threads = 0;
+    static char* kwlist[] = {"path", "num_threads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|si", kwlist, &path, &num_threads)) {
+        return NULL;
+    }
+    unsigned char* game_map_npy = read_file("resources/moba/game_map.npy");
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    err = write_paths(path, game_map_npy, num_threads);
+    Py_END_ALLOW_THREADS
+    free(game_map_npy);
+    if (err) {
+        PyErr_Format(PyExc_OSError, "Failed to write path table to %s", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     unsigned char* game_map_npy = read_file("resources/moba/game_map.npy");
-    int* ai_path_buffer = calloc(3*8*128*128, sizeof(int));
-    unsigned char* ai_paths = calloc(128*128*128*128, sizeof(unsigned char));
-    for (int i = 0; i < 128*128*128*128; i++) {
-        ai_paths[i] = 255;
+
+    // Shared read-only table. The first process to find it missing builds it
+    // under a lock while the others wait, then everyone maps the same file
+    PathTable* path_table = map_paths(PATHS_FILE, game_map_npy);
+    if (path_table == NULL) {
+        int lock = open(PATHS_FILE ".lock", O_RDWR | O_CREAT, 0644);
+        if (lock >= 0 && flock(lock, LOCK_EX) == 0) {
+            path_table = map_paths(PATHS_FILE, game_map_npy);
+            if (path_table == NULL && write_paths(PATHS_FILE, game_map_npy, 0) == 0) {
+                path_table = map_paths(PATHS_FILE, game_map_npy);
+            }
+            flock(lock, LOCK_UN);
+        }
+        if (lock >= 0)
+            close(lock);
+    }
+
+    // Fall back to a private table filled lazily during play
+    int* ai_path_buffer = NULL;
+    unsigned char* ai_paths = NULL;
+    if (path_table == NULL) {
+        ai_path_buffer = calloc(3*8*128*128, sizeof(int));
+        ai_paths = calloc(128*128*128*128, sizeof(unsigned char));
+        for (int i = 0; i < 128*128*128*128; i++) {
+            ai_paths[i] = 255;
+        }
     }
 
     PyObject* ai_path_buffer_handle = PyLong_FromVoidPtr(ai_path_buffer);
     PyObject* ai_paths_handle = PyLong_FromVoidPtr(ai_paths);
+    PyObject* path_table_handle = PyLong_FromVoidPtr(path_table);
     PyObject* game_map_handle = PyLong_FromVoidPtr(game_map_npy);
     PyObject* state = PyDict_New();
     PyDict_SetItemString(state, "ai_path_buffer", ai_path_buffer_handle);
     PyDict_SetItemString(state, "ai_paths", ai_paths_handle);
+    PyDict_SetItemString(state, "path_table", path_table_handle);
     PyDict_SetItemString(state, "game_map", game_map_handle);
     return PyLong_FromVoidPtr(state);
 }
@@ -63,6 +262,12 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         return 1;
     }
 
+    // Extract path_table. When present the lazy ai_paths table is unused
+    PyObject* path_table_obj = PyDict_GetItemString(state_dict, "path_table");
+    if (path_table_obj != NULL && PyLong_Check(path_table_obj)) {
+        env->path_table = (PathTable*)PyLong_AsVoidPtr(path_table_obj);
+    }
+
     // Extract ai_path_buffer
     PyObject* ai_path_buffer_obj = PyDict_GetItemString(state_dict, "ai_path_buffer");
     if (ai_path_buffer_obj == NULL) {
@@ -74,7 +279,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         return 1;
     }
     env->ai_path_buffer = (int*)PyLong_AsVoidPtr(ai_path_buffer_obj);
-    if (env->ai_path_buffer == NULL) {
+    if (env->ai_path_buffer == NULL && env->path_table == NULL) {
         PyErr_SetString(PyExc_ValueError, "Invalid ai_path_buffer pointer");
         return 1;
     }
@@ -90,7 +295,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         return 1;
     }
     env->ai_paths = (unsigned char*)PyLong_AsVoidPtr(ai_paths_obj);
-    if (env->ai_paths == NULL) {
+    if (env->ai_paths == NULL && env->path_table == NULL) {
         PyErr_SetString(PyExc_ValueError, "Invalid ai_paths pointer");
         return 1;
     }
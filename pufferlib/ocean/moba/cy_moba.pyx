@@ -187,7 +187,7 @@ cdef extern from "moba.h":
         Entity* scanned_targets[256][121];
         skill skills[10][3];
 
-        CachedRNG *rng;
+        CachedRNG *cached_rng;
 
     ctypedef struct GameRenderer
     GameRenderer* init_game_renderer(int cell_size, int width, int height)
@@ -134,7 +134,7 @@ void demo() {
         frame = (frame + 1) % 12;
     }
     free_mobanet(net);
-    free(weights);
+    free_weights(weights);
     free_allocated_moba(&env);
     //close_game_renderer(renderer);
 }
@@ -202,7 +202,7 @@ void test_bugs(float test_time) {
     printf("SPS: %f\n", 10.0f*i / (end - start));
     printf("Frames: %i\n", i);
     free_mobanet(net);
-    free(weights);
+    free_weights(weights);
     free_allocated_moba(&env);
 }
 
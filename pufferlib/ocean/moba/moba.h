@@ -7,6 +7,7 @@
 #include <time.h> // xxd -i game_map.npy > game_map.h #include "game_map.h"
 
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #if defined(PLATFORM_DESKTOP)
     #define GLSL_VERSION 330
@@ -337,6 +338,65 @@ unsigned char* precompute_pathing(Map* map){
     return paths;
 }
 
+// Compact first-move table, generated once and mapped read-only by every
+// process. Only walkable cells are indexed and moves are packed two per byte
+// (0-7 direction, 8 no move). Bump the version when the layout changes
+#define PATHS_MAGIC 0x4854504d
+#define PATHS_VERSION 1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int width;
+    unsigned int walkable;
+    unsigned long long map_hash;
+} PathHeader;
+
+typedef struct {
+    const short* index;
+    const unsigned char* moves;
+    int row_bytes;
+} PathTable;
+
+unsigned long long paths_map_hash(unsigned char* grid, int n) {
+    unsigned long long hash = 1469598103934665603ULL;
+    for (int i = 0; i < n; i++) {
+        hash = (hash ^ (grid[i] == WALL)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Fills packed rows [start, end) of the table. cells maps walkable index to
+// grid offset. scratch is one N*N bfs destination, buffer is bfs queue space
+void paths_fill_rows(Map* map, const short* index, const int* cells, int walkable,
+        unsigned char* moves, int start, int end, unsigned char* scratch, int* buffer) {
+    int N = map->width;
+    int row_bytes = (walkable + 1)/2;
+    for (int dst = start; dst < end; dst++) {
+        memset(scratch, 255, N*N);
+        int dst_adr = cells[dst];
+        bfs(map, scratch, buffer, dst_adr / N, dst_adr % N);
+        unsigned char* row = &moves[dst*row_bytes];
+        memset(row, 0, row_bytes);
+        for (int src = 0; src < walkable; src++) {
+            int atn = scratch[cells[src]];
+            if (atn > 8)
+                atn = 8;
+            row[src/2] |= atn << 4*(src & 1);
+        }
+    }
+}
+
+static inline int paths_lookup(PathTable* table, int y_dst, int x_dst, int y_src, int x_src) {
+    int dst = table->index[y_dst*128 + x_dst];
+    int src = table->index[y_src*128 + x_src];
+    if (dst < 0 || src < 0)
+        return 8;
+
+    unsigned char packed = table->moves[dst*table->row_bytes + src/2];
+    return (packed >> 4*(src & 1)) & 0xF;
+}
+
 struct MOBA {
     GameRenderer* client;
     int vision_range;
@@ -352,6 +412,7 @@ struct MOBA {
     unsigned char* orig_grid;
     unsigned char* ai_paths;
     int* ai_path_buffer;
+    PathTable* path_table;
     unsigned char* observations;
     int* actions;
     float* rewards;
@@ -360,6 +421,7 @@ struct MOBA {
     Entity* entities;
     Reward* reward_components;
     Log log;
+    uint64_t rng;
     PlayerLog player_logs[10];
 
     float reward_death;
@@ -376,7 +438,7 @@ struct MOBA {
     Entity* scanned_targets[256][121];
     skill skills[10][3];
 
-    CachedRNG *rng;
+    CachedRNG *cached_rng;
 };
 
 void add_log(MOBA* env, int radiant_victory, int dire_victory) {
@@ -429,8 +491,8 @@ void c_close(MOBA* env) {
     free(env->map->grid);
     free(env->map);
     free(env->orig_grid);
-    free(env->rng->rng);
-    free(env->rng);
+    free(env->cached_rng->rng);
+    free(env->cached_rng);
 }
 
 void free_allocated_moba(MOBA* env) {
@@ -588,14 +650,19 @@ int move_towards(MOBA* env, Entity* entity, int y_dst, int x_dst, float speed) {
     int y_src = entity->y;
     int x_src = entity->x;
 
-    int adr = ai_offset(y_dst, x_dst, y_src, x_src);
-    int atn = env->ai_paths[adr];
-
-    // Compute path if not cached
-    if (atn == 255) {
-        int bfs_adr = ai_offset(y_dst, x_dst, 0, 0);
-        bfs(env->map, &env->ai_paths[bfs_adr], env->ai_path_buffer, y_dst, x_dst);
+    int atn;
+    if (env->path_table != NULL) {
+        atn = paths_lookup(env->path_table, y_dst, x_dst, y_src, x_src);
+    } else {
+        int adr = ai_offset(y_dst, x_dst, y_src, x_src);
         atn = env->ai_paths[adr];
+
+        // Compute path if not cached
+        if (atn == 255) {
+            int bfs_adr = ai_offset(y_dst, x_dst, 0, 0);
+            bfs(env->map, &env->ai_paths[bfs_adr], env->ai_path_buffer, y_dst, x_dst);
+            atn = env->ai_paths[adr];
+        }
     }
 
     if (atn >= 8)
@@ -608,8 +675,8 @@ int move_towards(MOBA* env, Entity* entity, int y_dst, int x_dst, float speed) {
     if (move_to(env->map, entity, y_dst, x_dst) == 0)
         return 0;
 
-    float jitter_x = fast_rng(env->rng);
-    float jitter_y = fast_rng(env->rng);
+    float jitter_x = fast_rng(env->cached_rng);
+    float jitter_y = fast_rng(env->cached_rng);
     return move_to(env->map, entity, entity->y + jitter_y, entity->x + jitter_x);
 }
 
@@ -629,7 +696,7 @@ void kill_entity(Map* map, Entity* entity) {
     entity->y = 0;
 }
 
-void spawn_player(Map* map, Entity* entity) {
+void spawn_player(Map* map, Entity* entity, uint64_t* rng) {
     int pid = entity->pid;
     kill_entity(map, entity);
     entity->pid = pid;
@@ -655,8 +722,8 @@ void spawn_player(Map* map, Entity* entity) {
     bool valid_pos = false;
     int y, x;
     while (!valid_pos) {
-        y = entity->spawn_y + rand()%15 - 7;
-        x = entity->spawn_x + rand()%15 - 7;
+        y = entity->spawn_y + puffer_rand(rng)%15 - 7;
+        x = entity->spawn_x + puffer_rand(rng)%15 - 7;
         valid_pos = map->grid[map_offset(map, y, x)] == EMPTY;
     }
     entity->last_x = x;
@@ -714,7 +781,7 @@ int attack(MOBA* env, Entity* player, Entity* target, float damage) {
         target_log->reward_death = env->reward_death;
         player_log->kills += 1;
         target_log->deaths += 1;
-        spawn_player(env->map, target);
+        spawn_player(env->map, target, &env->rng);
     } else if (target_type == ENTITY_CREEP) {
         player_log->creeps_killed += 1;
         kill_entity(env->map, target);
@@ -848,8 +915,8 @@ int spawn_creep(MOBA* env, int idx, int lane) {
     Map* map = env->map;
     int y, x;
     for (int i = 0; i < 10; i++) {
-        y = spawn_y + rand() % 7 - 3;
-        x = spawn_x + rand() % 7 - 3;
+        y = spawn_y + puffer_rand(&env->rng) % 7 - 3;
+        x = spawn_x + puffer_rand(&env->rng) % 7 - 3;
         int adr = map_offset(map, y, x);
         if (map->grid[adr] == EMPTY) {
             break;
@@ -878,8 +945,8 @@ int spawn_neutral(MOBA* env, int idx) {
     int spawn_y = (int)neutral->spawn_y;
     int spawn_x = (int)neutral->spawn_x;
     for (int i = 0; i < 100; i++) {
-        y = spawn_y + rand() % 7 - 3;
-        x = spawn_x + rand() % 7 - 3;
+        y = spawn_y + puffer_rand(&env->rng) % 7 - 3;
+        x = spawn_x + puffer_rand(&env->rng) % 7 - 3;
         int adr = map_offset(map, y, x);
         if (map->grid[adr] == EMPTY) {
             break;
@@ -1107,7 +1174,7 @@ void randomize_tower_hp(MOBA* env) {
     for (int i = 0; i < NUM_TOWERS; i++) {
         int pid = TOWER_OFFSET + i;
         Entity* tower = &env->entities[pid];
-        tower->health = rand() % (int)tower->max_health + 1;
+        tower->health = puffer_rand(&env->rng) % (int)tower->max_health + 1;
     }
 }
 
@@ -1612,12 +1679,12 @@ void init_moba(MOBA* env, unsigned char* game_map_npy) {
         env->scanned_targets[i][1] = NULL;
     }
 
-    env->rng = (CachedRNG*)calloc(1, sizeof(CachedRNG));
-    env->rng->rng_n = 10000;
-    env->rng->rng_idx = 0;
-    env->rng->rng = calloc(env->rng->rng_n, sizeof(float));
-    for (int i = 0; i < env->rng->rng_n; i++)
-        env->rng->rng[i] = -1+2*((float)rand())/(float)RAND_MAX;
+    env->cached_rng = (CachedRNG*)calloc(1, sizeof(CachedRNG));
+    env->cached_rng->rng_n = 10000;
+    env->cached_rng->rng_idx = 0;
+    env->cached_rng->rng = calloc(env->cached_rng->rng_n, sizeof(float));
+    for (int i = 0; i < env->cached_rng->rng_n; i++)
+        env->cached_rng->rng[i] = -1 + 2*puffer_randf(&env->rng);
 
     // Initialize Players
     Entity *player;
@@ -1863,7 +1930,7 @@ void c_reset(MOBA* env) {
         player->level = 1;
         //player->x = 0;
         //player->y = 0;
-        spawn_player(env->map, player);
+        spawn_player(env->map, player, &env->rng);
     }
 
     rad = &env->entities[205];
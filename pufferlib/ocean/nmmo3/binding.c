@@ -1,8 +1,377 @@
+#include <Python.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "nmmo3.h"
 
+static PyObject* shared_close(PyObject* self, PyObject* args);
+static PyObject* map_obs_per_tile(PyObject* self, PyObject* args);
+
 #define Env MMO
+#define MY_SHARED
+#define MY_METHODS \
+    {"shared_close", shared_close, METH_VARARGS, "Stop a terrain bank's refresh thread and free the bank"}, \
+    {"map_obs_per_tile", map_obs_per_tile, METH_VARARGS, "Per env, the map part of every player's observation, rebuilt tile by tile"}
 #include "../env_binding.h"
 
+#define TERRAIN_MAGIC 0x4e524554
+#define TERRAIN_VERSION 1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    int num_terrains;
+    int width;
+    int height;
+    int x_border;
+    int y_border;
+    int seed;
+} TerrainHeader;
+
+// make_terrains results, raised by my_shared once it holds the GIL again
+enum {
+    TERRAIN_OK,
+    TERRAIN_NO_MEMORY,
+    TERRAIN_NO_GRASS,
+};
+
+typedef struct {
+    TerrainBank* bank;
+    uint64_t seed;
+    int next;
+    int no_grass;
+} TerrainJob;
+
+typedef struct {
+    TerrainBank* bank;
+    uint64_t seed;
+    int refresh_ms;
+} RefreshJob;
+
+// Slot i is always generated from seed i, so a bank does not depend on how
+// slots are split across threads
+static void* terrain_worker(void* arg) {
+    TerrainJob* job = arg;
+    TerrainBank* bank = job->bank;
+    size_t sz = (size_t)bank->width*bank->height;
+    while (1) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= bank->num_terrains)
+            break;
+        uint64_t rng;
+        puffer_seed(&rng, (job->seed << 32) + i);
+        bank->num_cands[i] = generate_bank_terrain(bank,
+            &bank->terrain[i*sz], &bank->spawn_cands[i*sz], &rng);
+        if (bank->num_cands[i] == 0)
+            __atomic_store_n(&job->no_grass, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// Returns 0 if some slot came out without grass
+static int build_terrains(TerrainBank* bank, int seed, int num_threads) {
+    TerrainJob job = {.bank = bank, .seed = (uint64_t)(unsigned int)seed};
+    if (num_threads <= 0)
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+        num_threads = 1;
+    if (num_threads > bank->num_terrains)
+        num_threads = bank->num_terrains;
+
+    // The calling thread works too and picks up whatever the threads that
+    // did start leave over, so failing to start any of them only costs time
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < num_threads - 1
+            && pthread_create(&threads[started], NULL, terrain_worker, &job) == 0)
+        started++;
+    terrain_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    return !job.no_grass;
+}
+
+// Waits refresh_ms or until shared_close wakes it. Returns 1 to stop
+static int refresh_wait(TerrainBank* bank, int refresh_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += refresh_ms / 1000;
+    deadline.tv_nsec += (refresh_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&bank->refresh_lock);
+    int err = 0;
+    while (!bank->refresh_stop && err != ETIMEDOUT)
+        err = pthread_cond_timedwait(&bank->refresh_wake, &bank->refresh_lock, &deadline);
+    int stop = bank->refresh_stop;
+    pthread_mutex_unlock(&bank->refresh_lock);
+    return stop;
+}
+
+// Regenerates slots round robin until shared_close. New terrains are built
+// in private buffers and only the copy in holds the slot lock. A terrain
+// without grass leaves its slot as it was
+static void* refresh_worker(void* arg) {
+    RefreshJob* job = arg;
+    TerrainBank* bank = job->bank;
+    size_t sz = (size_t)bank->width*bank->height;
+    char* terrain = calloc(sz, sizeof(char));
+    int* cands = calloc(sz, sizeof(int));
+    for (uint64_t gen = bank->num_terrains; terrain != NULL && cands != NULL; gen++) {
+        if (refresh_wait(bank, job->refresh_ms))
+            break;
+        uint64_t rng;
+        puffer_seed(&rng, (job->seed << 32) + gen);
+        int num_cands = generate_bank_terrain(bank, terrain, cands, &rng);
+        if (num_cands > 0)
+            store_bank_terrain(bank, gen % bank->num_terrains, terrain, cands, num_cands);
+    }
+    free(terrain);
+    free(cands);
+    free(job);
+    return NULL;
+}
+
+// Written to a temp file first so readers never see a partial bank
+static int write_terrains(const char* path, TerrainBank* bank, int seed) {
+    TerrainHeader header = {
+        .magic = TERRAIN_MAGIC,
+        .version = TERRAIN_VERSION,
+        .num_terrains = bank->num_terrains,
+        .width = bank->width,
+        .height = bank->height,
+        .x_border = bank->x_border,
+        .y_border = bank->y_border,
+        .seed = seed,
+    };
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE* f = fopen(tmp, "wb");
+    int err = (f == NULL);
+    if (!err) {
+        err |= fwrite(&header, sizeof(header), 1, f) != 1;
+        err |= fwrite(bank->blob, bank->blob_bytes, 1, f) != 1;
+        err |= fclose(f) != 0;
+        err = err || rename(tmp, path) != 0;
+        if (err)
+            unlink(tmp);
+    }
+    return err;
+}
+
+static void free_terrains(TerrainBank* bank) {
+    for (int i = 0; i < bank->num_terrains; i++) {
+        pthread_rwlock_destroy(&bank->locks[i]);
+    }
+    pthread_mutex_destroy(&bank->refresh_lock);
+    pthread_cond_destroy(&bank->refresh_wake);
+    free(bank->locks);
+    if (bank->mmapped) {
+        munmap(bank->blob - sizeof(TerrainHeader), sizeof(TerrainHeader) + bank->blob_bytes);
+    } else {
+        free(bank->blob);
+    }
+    free(bank);
+}
+
+// Maps a bank file copy-on-write, so envs share its pages until a refresh
+// thread replaces a slot. Returns NULL if the file is missing or stale
+static TerrainBank* map_terrains(const char* path, int num_terrains,
+        int width, int height, int x_border, int y_border, int seed) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TerrainHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    TerrainHeader* header = data;
+    size_t expected = sizeof(TerrainHeader)
+        + terrain_bank_bytes(num_terrains, width, height);
+    if (header->magic != TERRAIN_MAGIC || header->version != TERRAIN_VERSION
+            || header->num_terrains != num_terrains
+            || header->width != width || header->height != height
+            || header->x_border != x_border || header->y_border != y_border
+            || header->seed != seed || (size_t)st.st_size != expected) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    TerrainBank* bank = calloc(1, sizeof(TerrainBank));
+    if (bank == NULL || !init_terrain_bank(bank, (char*)data + sizeof(TerrainHeader),
+            num_terrains, width, height, x_border, y_border)) {
+        free(bank);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    bank->mmapped = 1;
+
+    // Every slot needs somewhere to spawn. Files from before empty terrains
+    // were redrawn can have an empty slot, so those are regenerated
+    for (int i = 0; i < num_terrains; i++) {
+        if (bank->num_cands[i] <= 0) {
+            free_terrains(bank);
+            return NULL;
+        }
+    }
+    return bank;
+}
+
+// Returns a TERRAIN_ status and sets *out only on success
+static int make_terrains(TerrainBank** out, int num_terrains, int width, int height,
+        int x_border, int y_border, int seed, int num_threads) {
+    *out = NULL;
+    TerrainBank* bank = calloc(1, sizeof(TerrainBank));
+    char* blob = calloc(terrain_bank_bytes(num_terrains, width, height), 1);
+    if (bank == NULL || blob == NULL || !init_terrain_bank(bank, blob,
+            num_terrains, width, height, x_border, y_border)) {
+        free(bank);
+        free(blob);
+        return TERRAIN_NO_MEMORY;
+    }
+    if (!build_terrains(bank, seed, num_threads)) {
+        free_terrains(bank);
+        return TERRAIN_NO_GRASS;
+    }
+    *out = bank;
+    return TERRAIN_OK;
+}
+
+// Optional kwargs: path to load or save the bank, num_threads for
+// generation and refresh_ms to keep regenerating slots in the background
+static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
+    int num_terrains = unpack(kwargs, "num_terrains");
+    int width = unpack(kwargs, "width");
+    int height = unpack(kwargs, "height");
+    int x_border = unpack(kwargs, "x_window");
+    int y_border = unpack(kwargs, "y_window");
+    int seed = unpack(kwargs, "seed");
+    if (num_terrains <= 0) {
+        PyErr_SetString(PyExc_ValueError, "num_terrains must be >0");
+        return NULL;
+    }
+
+    int num_threads = 0;
+    if (PyDict_GetItemString(kwargs, "num_threads") != NULL) {
+        num_threads = unpack(kwargs, "num_threads");
+    }
+    int refresh_ms = 0;
+    if (PyDict_GetItemString(kwargs, "refresh_ms") != NULL) {
+        refresh_ms = unpack(kwargs, "refresh_ms");
+    }
+    const char* path = NULL;
+    PyObject* path_obj = PyDict_GetItemString(kwargs, "path");
+    if (path_obj != NULL && path_obj != Py_None) {
+        path = PyUnicode_AsUTF8(path_obj);
+        if (path == NULL) {
+            return NULL;
+        }
+    }
+
+    TerrainBank* bank = NULL;
+    int status = TERRAIN_OK;
+    Py_BEGIN_ALLOW_THREADS
+    if (path != NULL) {
+        bank = map_terrains(path, num_terrains, width, height, x_border, y_border, seed);
+    }
+    // The first process to find the file missing writes it under a lock
+    // while the others wait
+    if (bank == NULL && path != NULL) {
+        char lock_path[4096];
+        snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+        int lock = open(lock_path, O_RDWR | O_CREAT, 0644);
+        if (lock >= 0 && flock(lock, LOCK_EX) == 0) {
+            bank = map_terrains(path, num_terrains, width, height, x_border, y_border, seed);
+            if (bank == NULL) {
+                status = make_terrains(&bank, num_terrains, width, height,
+                    x_border, y_border, seed, num_threads);
+                if (bank != NULL)
+                    write_terrains(path, bank, seed);
+            }
+            flock(lock, LOCK_UN);
+        }
+        if (lock >= 0)
+            close(lock);
+    }
+    if (bank == NULL && status == TERRAIN_OK) {
+        status = make_terrains(&bank, num_terrains, width, height,
+            x_border, y_border, seed, num_threads);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (status == TERRAIN_NO_MEMORY) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate terrain bank");
+        return NULL;
+    }
+    if (status == TERRAIN_NO_GRASS) {
+        PyErr_Format(PyExc_ValueError, "No grass in %d terrain tries at %dx%d. "
+            "Use a larger map", MAX_TERRAIN_TRIES, width, height);
+        return NULL;
+    }
+
+    // The bank works without refresh, so failing to start it only warns
+    if (refresh_ms > 0) {
+        RefreshJob* job = calloc(1, sizeof(RefreshJob));
+        if (job != NULL) {
+            job->bank = bank;
+            job->seed = (uint64_t)(unsigned int)seed;
+            job->refresh_ms = refresh_ms;
+            bank->refreshing = pthread_create(&bank->refresh_thread,
+                NULL, refresh_worker, job) == 0;
+        }
+        if (!bank->refreshing) {
+            free(job);
+            if (PyErr_WarnEx(PyExc_RuntimeWarning,
+                    "Could not start the terrain refresh thread", 1) < 0) {
+                free_terrains(bank);
+                return NULL;
+            }
+        }
+    }
+    return PyLong_FromVoidPtr(bank);
+}
+
+// Call after vec_close on every env that uses the bank
+static PyObject* shared_close(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 1) {
+        PyErr_SetString(PyExc_TypeError, "shared_close requires 1 argument");
+        return NULL;
+    }
+    TerrainBank* bank = (TerrainBank*)PyLong_AsVoidPtr(PyTuple_GetItem(args, 0));
+    if (bank == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "Invalid terrain bank handle");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (bank->refreshing) {
+        pthread_mutex_lock(&bank->refresh_lock);
+        bank->refresh_stop = 1;
+        pthread_cond_signal(&bank->refresh_wake);
+        pthread_mutex_unlock(&bank->refresh_lock);
+        pthread_join(bank->refresh_thread, NULL);
+    }
+    free_terrains(bank);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->width = unpack(kwargs, "width");
     env->height = unpack(kwargs, "height");
@@ -23,6 +392,22 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->reward_item_level = unpack(kwargs, "reward_item_level");
     env->reward_market = unpack(kwargs, "reward_market");
     env->reward_death = unpack(kwargs, "reward_death");
+
+    // Terrain bank from shared(). Without one, reset generates terrain
+    PyObject* handle_obj = PyDict_GetItemString(kwargs, "terrain_bank");
+    if (handle_obj != NULL && handle_obj != Py_None) {
+        if (!PyLong_Check(handle_obj)) {
+            PyErr_SetString(PyExc_TypeError, "terrain_bank handle must be an integer");
+            return 1;
+        }
+        TerrainBank* bank = (TerrainBank*)PyLong_AsVoidPtr(handle_obj);
+        if (bank == NULL || bank->width != env->width || bank->height != env->height
+                || bank->x_border != env->x_window || bank->y_border != env->y_window) {
+            PyErr_SetString(PyExc_ValueError, "terrain_bank does not match env size");
+            return 1;
+        }
+        env->terrain_bank = bank;
+    }
     init(env);
     return 0;
 }
@@ -48,3 +433,28 @@ static int my_log(PyObject* dict, Log* log) {
     assign_to_dict(dict, "c", log->c);
     return 0;
 }
+
+static PyObject* map_obs_per_tile(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 1) {
+        PyErr_SetString(PyExc_TypeError, "map_obs_per_tile requires 1 argument");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    vec_wait_async(vec);
+    PyObject* out = PyList_New(vec->num_envs);
+    for (int i = 0; i < vec->num_envs; i++) {
+        Env* env = vec->envs[i];
+        int window = (2*env->x_window + 1)*(2*env->y_window + 1)*TILE_OBS;
+        PyObject* bytes = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)env->num_players*window);
+        if (bytes == NULL) {
+            Py_DECREF(out);
+            return NULL;
+        }
+        compute_map_obs_per_tile(env, (unsigned char*)PyBytes_AS_STRING(bytes));
+        PyList_SET_ITEM(out, i, bytes);
+    }
+    return out;
+}
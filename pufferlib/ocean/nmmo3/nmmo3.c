@@ -181,6 +181,7 @@ void demo(int num_players) {
         .x_window = 7,
         .y_window = 5,
     };
+    puffer_seed(&env.rng, time(NULL));
     allocate_mmo(&env);
 
     c_reset(&env);
@@ -210,7 +211,7 @@ void demo(int num_players) {
     }
 
     free_mmonet(net);
-    free(weights);
+    free_weights(weights);
     free_allocated_mmo(&env);
     //close_client(client);
 }
@@ -251,7 +252,7 @@ void test_mmonet_performance(int num_players, int timeout) {
     printf("Test Environment Performance FPS: %f\n", sps);
     free_allocated_mmo(&env);
     free_mmonet(net);
-    free(weights);
+    free_weights(weights);
 }
 
 void copy_cast(float* input, unsigned char* output, int width, int height) {
@@ -345,8 +346,10 @@ void test_flood_fill(int width, int height, int colors) {
     }
 
     char filled[width*height];
+    uint64_t rng;
+    puffer_seed(&rng, time(NULL));
     flood_fill((unsigned char*)unfilled, (char*)filled,
-        width, height, colors, width*height);
+        width, height, colors, width*height, &rng);
 
     // Cast and colorize
     unsigned char output[width*height];
@@ -388,7 +391,9 @@ void test_cellular_automata(int width, int height, int colors, int max_fill) {
         }
     }
 
-    cellular_automata((char*)grid, width, height, colors, max_fill);
+    uint64_t rng;
+    puffer_seed(&rng, time(NULL));
+    cellular_automata((char*)grid, width, height, colors, max_fill, &rng);
 
     // Colorize
     unsigned char output[width*height];
@@ -409,7 +414,9 @@ void test_cellular_automata(int width, int height, int colors, int max_fill) {
 void test_generate_terrain(int width, int height, int x_border, int y_border) {
     char terrain[width][height];
     unsigned char rendered[width][height][3];
-    generate_terrain((char*)terrain, (unsigned char*)rendered, width, height, x_border, y_border);
+    uint64_t rng;
+    puffer_seed(&rng, time(NULL));
+    generate_terrain((char*)terrain, (unsigned char*)rendered, width, height, x_border, y_border, &rng);
 
 
     // Colorize
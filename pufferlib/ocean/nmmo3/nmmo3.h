@@ -16,9 +16,11 @@
 #include <assert.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 #include "simplex.h"
 #include "tile_atlas.h"
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #if defined(PLATFORM_DESKTOP)
     #define GLSL_VERSION 330
@@ -160,6 +162,9 @@
 #define D_MAP 0
 #define D_ITEM 1
 
+// Bytes per tile in the map part of an observation
+#define TILE_OBS 10
+
 // Extra constants
 #define IN_COMBAT_TICKS 5
 #define LEVEL_MUL 2.0
@@ -174,17 +179,17 @@ void range(int* array, int n) {
     }
 }
 
-void shuffle(int* array, int n) {
+void shuffle(int* array, int n, uint64_t* rng) {
     for (int i = 0; i < n; i++) {
-        int j = rand() % n;
+        int j = puffer_rand(rng) % n;
         int temp = array[i];
         array[i] = array[j];
         array[j] = temp;
     }
 }
 
-double sample_exponential(double halving_rate) {
-    double u = (double)rand() / RAND_MAX; // Random number u in [0, 1)
+double sample_exponential(double halving_rate, uint64_t* rng) {
+    double u = puffer_randf(rng); // Random number u in [0, 1)
     return 1 + halving_rate*(-log(1 - u) / log(2));
 }
 
@@ -275,7 +280,7 @@ void perlin_noise(float* map, int width, int height,
 }
 
 void flood_fill(unsigned char* input, char* output,
-        int width, int height, int n, int max_fill) {
+        int width, int height, int n, int max_fill, uint64_t* rng) {
 
     for (int r = 0; r < height; r++) {
         for (int c = 0; c < width; c++) {
@@ -285,7 +290,7 @@ void flood_fill(unsigned char* input, char* output,
 
     int* pos = calloc(width*height, sizeof(int));
     range((int*)pos, width*height);
-    shuffle((int*)pos, width*height);
+    shuffle((int*)pos, width*height, rng);
 
     short queue[2*max_fill];
     for (int i = 0; i < 2*max_fill; i++) {
@@ -301,7 +306,7 @@ void flood_fill(unsigned char* input, char* output,
             continue;
         }
 
-        int color = rand() % n;
+        int color = puffer_rand(rng) % n;
         output[adr] = color;
         queue[0] = r;
         queue[1] = c;
@@ -366,7 +371,7 @@ void flood_fill(unsigned char* input, char* output,
 }
 
 void cellular_automata(char* grid,
-        int width, int height, int colors, int max_fill) {
+        int width, int height, int colors, int max_fill, uint64_t* rng) {
 
     int* pos = calloc(2*width*height, sizeof(int));
     int pos_sz = 0;
@@ -389,7 +394,7 @@ void cellular_automata(char* grid,
         for (int i = 0; i < pos_sz; i+=2) {
             int r = pos[i];
             int c = pos[i + 1];
-            int adr = rand() % pos_sz;
+            int adr = puffer_rand(rng) % pos_sz;
             if (adr % 2 == 1) {
                 adr--;
             }
@@ -450,7 +455,7 @@ void cellular_automata(char* grid,
             }
 
             int idx = 0;
-            int winner = rand() % num_ties;
+            int winner = puffer_rand(rng) % num_ties;
             for (int j = 0; j < colors; j++) {
                 if (counts[j] == max_count) {
                     if (idx == winner) {
@@ -469,12 +474,12 @@ void cellular_automata(char* grid,
 }
 
 void generate_terrain(char* terrain, unsigned char* rendered,
-        int R, int C, int x_border, int y_border) {
+        int R, int C, int x_border, int y_border, uint64_t* rng) {
     // Perlin noise for the base terrain
     // TODO: Not handling octaves correctly
     float* perlin_map = calloc(R*C, sizeof(float));
-    int offset_x = rand() % 100000;
-    int offset_y = rand() % 100000;
+    int offset_x = puffer_rand(rng) % 100000;
+    int offset_y = puffer_rand(rng) % 100000;
     perlin_noise(perlin_map, C, R, 1.0/64.0, 2, offset_x, offset_y);
  
     // Flood fill connected components to determine biomes
@@ -486,10 +491,10 @@ void generate_terrain(char* terrain, unsigned char* rendered,
         }
     }
     char *biomes = calloc(R*C, sizeof(char));
-    flood_fill(ridges, biomes, R, C, 4, 4000);
+    flood_fill(ridges, biomes, R, C, 4, 4000, rng);
 
     // Cellular automata to cover unfilled ridges
-    cellular_automata(biomes, R, C, 4, 4000);
+    cellular_automata(biomes, R, C, 4, 4000, rng);
 
     unsigned char (*rendered_ary)[C][3] = (unsigned char(*)[C][3])rendered;
 
@@ -511,6 +516,9 @@ void generate_terrain(char* terrain, unsigned char* rendered,
                 }
             }
             terrain[adr] = tile;
+            if (rendered == NULL) {
+                continue;
+            }
             rendered_ary[r][c][0] = RENDER_COLORS[tile][0];
             rendered_ary[r][c][1] = RENDER_COLORS[tile][1];
             rendered_ary[r][c][2] = RENDER_COLORS[tile][2];
@@ -675,6 +683,7 @@ Respawnable pop_from_buffer(RespawnBuffer* buffer, int tick) {
 }
 
 typedef struct Client Client;
+typedef struct TerrainBank TerrainBank;
 typedef struct MMO MMO;
 struct MMO {
     Client* client;
@@ -687,10 +696,13 @@ struct MMO {
     int num_gems;
     char* terrain; // TODO: Unsigned?
     unsigned char* rendered;
+    TerrainBank* terrain_bank; // Optional, shared between envs
+    int* spawn_cands;
     Entity* players;
     Entity* enemies;
     short* pids;
     unsigned char* items;
+    unsigned char* tile_obs;
     unsigned char* counts;
     unsigned char* observations;
     float* rewards;
@@ -714,6 +726,7 @@ struct MMO {
     RespawnBuffer* enemy_respawn_buffer;
     RespawnBuffer* drop_respawn_buffer;
     Log log;
+    uint64_t rng;
     float reward_combat_level;
     float reward_prof_level;
     float reward_item_level;
@@ -768,8 +781,11 @@ void init(MMO* env) {
     env->terrain = calloc(sz, sizeof(char));
     env->rendered = calloc(sz*3, sizeof(unsigned char));
 
+    env->spawn_cands = calloc(sz, sizeof(int));
+
     env->pids = calloc(sz, sizeof(short));
     env->items = calloc(sz, sizeof(unsigned char));
+    env->tile_obs = calloc(sz*TILE_OBS, sizeof(unsigned char));
 
     // Circular buffers for respawning resources and enemies
     env->resource_respawn_buffer = make_respawn_buffer(2*env->num_resources
@@ -801,8 +817,10 @@ void c_close(MMO* env) {
     free(env->counts);
     free(env->terrain);
     free(env->rendered);
+    free(env->spawn_cands);
     free(env->pids);
     free(env->items);
+    free(env->tile_obs);
     free_respawn_buffer(env->resource_respawn_buffer);
     free_respawn_buffer(env->enemy_respawn_buffer);
     free_respawn_buffer(env->drop_respawn_buffer);
@@ -911,6 +929,114 @@ bool is_water(int tile) {
     return (tile >= TILE_SPRING_WATER && tile <= TILE_WINTER_WATER);
 }
 
+// Grass tiles in random order. Resources, gems and spawns are placed by
+// walking this list, so it is computed once per terrain
+int build_spawn_cands(char* terrain, int* cands, int sz, uint64_t* rng) {
+    range(cands, sz);
+    shuffle(cands, sz, rng);
+    int n = 0;
+    for (int i = 0; i < sz; i++) {
+        int cand = cands[i];
+        if (is_grass(terrain[cand])) {
+            cands[n++] = cand;
+        }
+    }
+    return n;
+}
+
+#define MAX_TERRAIN_TRIES 100
+
+// Terrain without grass leaves nothing to spawn on, so such maps are drawn
+// again. Only tiny maps can keep failing, and those return 0
+int generate_spawnable_terrain(char* terrain, unsigned char* rendered, int* cands,
+        int width, int height, int x_border, int y_border, uint64_t* rng) {
+    for (int i = 0; i < MAX_TERRAIN_TRIES; i++) {
+        generate_terrain(terrain, rendered, width, height, x_border, y_border, rng);
+        int num_cands = build_spawn_cands(terrain, cands, width*height, rng);
+        if (num_cands > 0) {
+            return num_cands;
+        }
+    }
+    return 0;
+}
+
+// Pregenerated terrains shared read-only by every env of one map size.
+// Reset copies a random slot instead of running terrain generation. The
+// blob holds terrain, candidate counts and candidate lists back to back so
+// it can be written to disk and mapped as is. Slots are guarded by rwlocks
+// so an optional background thread can regenerate them during training.
+// That thread sleeps on refresh_wake and exits once refresh_stop is set
+struct TerrainBank {
+    int num_terrains;
+    int width;
+    int height;
+    int x_border;
+    int y_border;
+    char* blob;
+    size_t blob_bytes;
+    char* terrain;
+    int* num_cands;
+    int* spawn_cands;
+    pthread_rwlock_t* locks;
+    int mmapped;
+    pthread_t refresh_thread;
+    pthread_mutex_t refresh_lock;
+    pthread_cond_t refresh_wake;
+    int refreshing;
+    int refresh_stop;
+};
+
+size_t terrain_bank_bytes(int num_terrains, int width, int height) {
+    size_t sz = (size_t)width*height;
+    size_t terrain_bytes = (num_terrains*sz + 3) & ~(size_t)3;
+    return terrain_bytes + num_terrains*sizeof(int) + num_terrains*sz*sizeof(int);
+}
+
+// Points the bank arrays into blob, which must hold terrain_bank_bytes.
+// Returns 0 if the slot locks could not be allocated
+int init_terrain_bank(TerrainBank* bank, char* blob, int num_terrains,
+        int width, int height, int x_border, int y_border) {
+    size_t sz = (size_t)width*height;
+    bank->num_terrains = num_terrains;
+    bank->width = width;
+    bank->height = height;
+    bank->x_border = x_border;
+    bank->y_border = y_border;
+    bank->blob = blob;
+    bank->blob_bytes = terrain_bank_bytes(num_terrains, width, height);
+    bank->terrain = blob;
+    bank->num_cands = (int*)(blob + ((num_terrains*sz + 3) & ~(size_t)3));
+    bank->spawn_cands = bank->num_cands + num_terrains;
+    bank->locks = calloc(num_terrains, sizeof(pthread_rwlock_t));
+    if (bank->locks == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < num_terrains; i++) {
+        pthread_rwlock_init(&bank->locks[i], NULL);
+    }
+    pthread_mutex_init(&bank->refresh_lock, NULL);
+    pthread_cond_init(&bank->refresh_wake, NULL);
+    bank->refreshing = 0;
+    bank->refresh_stop = 0;
+    return 1;
+}
+
+// Generates one terrain into caller-owned buffers. Returns 0 if it has no grass
+int generate_bank_terrain(TerrainBank* bank, char* terrain, int* cands, uint64_t* rng) {
+    return generate_spawnable_terrain(terrain, NULL, cands, bank->width,
+        bank->height, bank->x_border, bank->y_border, rng);
+}
+
+// Replaces a slot. Readers see either the old or the new terrain
+void store_bank_terrain(TerrainBank* bank, int idx, char* terrain, int* cands, int num_cands) {
+    size_t sz = (size_t)bank->width*bank->height;
+    pthread_rwlock_wrlock(&bank->locks[idx]);
+    memcpy(&bank->terrain[idx*sz], terrain, sz);
+    memcpy(&bank->spawn_cands[idx*sz], cands, num_cands*sizeof(int));
+    bank->num_cands[idx] = num_cands;
+    pthread_rwlock_unlock(&bank->locks[idx]);
+}
+
 int map_offset(MMO* env, int r, int c) {
     return r*env->width + c;
 }
@@ -919,7 +1045,106 @@ float sell_price(int idx) {
     return 0.5 + 0.1*idx;
 }
 
+// Packed observation records, one per tile, in the same 10 byte layout as
+// the map part of an observation. Terrain and item bytes are written when
+// those change and entity bytes when pids change. Entity state is synced
+// once per tick, so each observation window is a handful of row copies.
+// Byte 6 holds the entity's combat level until the per-player fix-up
+// turns it into the level delta
+void write_tile_entity(MMO* env, int adr, Entity* seen) {
+    unsigned char* tile = &env->tile_obs[adr*TILE_OBS];
+    tile[4] = seen->type;
+    tile[5] = seen->element;
+    tile[6] = seen->comb_lvl;
+    tile[7] = seen->hp / 20; // Bucketed for discrete
+    tile[8] = seen->anim;
+    tile[9] = seen->dir;
+}
+
+void set_pid(MMO* env, int adr, int pid) {
+    env->pids[adr] = pid;
+    if (pid == -1) {
+        memset(&env->tile_obs[adr*TILE_OBS + 4], 0, TILE_OBS - 4);
+    } else {
+        write_tile_entity(env, adr, get_entity(env, pid));
+    }
+}
+
+void set_item(MMO* env, int adr, int item) {
+    env->items[adr] = item;
+    unsigned char* tile = &env->tile_obs[adr*TILE_OBS];
+    tile[2] = item % 17;
+    tile[3] = item / 17;
+}
+
+// Rebuilds every record from terrain with no items or entities
+void reset_tile_obs(MMO* env) {
+    int sz = env->width*env->height;
+    memset(env->tile_obs, 0, sz*TILE_OBS);
+    for (int adr = 0; adr < sz; adr++) {
+        unsigned char terrain = env->terrain[adr];
+        env->tile_obs[adr*TILE_OBS] = terrain % 4;
+        env->tile_obs[adr*TILE_OBS + 1] = terrain / 4;
+    }
+}
+
+void sync_tile_entities(MMO* env) {
+    for (int pid = 0; pid < env->num_players + env->num_enemies; pid++) {
+        Entity* entity = get_entity(env, pid);
+        int adr = map_offset(env, entity->r, entity->c);
+        if (env->pids[adr] == pid) {
+            write_tile_entity(env, adr, entity);
+        }
+    }
+}
+
+// Reference for the map part of compute_all_obs, kept for testing. Reads
+// terrain, items and entities tile by tile, as observations were built
+// before the packed records. Writes num_players windows to out
+void compute_map_obs_per_tile(MMO* env, unsigned char* out) {
+    for (int pid = 0; pid < env->num_players; pid++) {
+        Entity* player = get_entity(env, pid);
+        int comb_lvl = player->comb_lvl;
+        for (int obs_r = player->r - env->y_window; obs_r <= player->r + env->y_window; obs_r++) {
+            for (int obs_c = player->c - env->x_window; obs_c <= player->c + env->x_window; obs_c++) {
+                int map_adr = map_offset(env, obs_r, obs_c);
+                unsigned char terrain = env->terrain[map_adr];
+                out[0] = terrain % 4;
+                out[1] = terrain / 4;
+                unsigned char item = env->items[map_adr];
+                out[2] = item % 17;
+                out[3] = item / 17;
+
+                int seen_pid = env->pids[map_adr];
+                if (seen_pid == -1) {
+                    memset(&out[4], 0, TILE_OBS - 4);
+                } else {
+                    Entity* seen = get_entity(env, seen_pid);
+                    out[4] = seen->type;
+                    out[5] = seen->element;
+                    int delta_comb_obs = (seen->comb_lvl - comb_lvl) / 2;
+                    if (delta_comb_obs < 0) {
+                        delta_comb_obs = 0;
+                    }
+                    if (delta_comb_obs > 4) {
+                        delta_comb_obs = 4;
+                    }
+                    out[6] = delta_comb_obs;
+                    out[7] = seen->hp / 20;
+                    out[8] = seen->anim;
+                    out[9] = seen->dir;
+                }
+                out += TILE_OBS;
+            }
+        }
+    }
+}
+
 void compute_all_obs(MMO* env) {
+    sync_tile_entities(env);
+    int obs_cols = 2*env->x_window + 1;
+    int obs_rows = 2*env->y_window + 1;
+    int row_bytes = obs_cols*TILE_OBS;
     for (int pid = 0; pid < env->num_players; pid++) {
         Entity* player = get_entity(env, pid);
         int r = player->r;
@@ -935,41 +1160,29 @@ void compute_all_obs(MMO* env) {
         assert(start_col >= 0);
         assert(end_col <= env->width);
 
-        int comb_lvl = player->comb_lvl;
         int obs_adr = pid*(11*15*10+47+10);
+        unsigned char* window = &env->observations[obs_adr];
         for (int obs_r = start_row; obs_r < end_row; obs_r++) {
-            for (int obs_c = start_col; obs_c < end_col; obs_c++) {
-                int map_adr = map_offset(env, obs_r, obs_c);
-
-                // Split by terrain type and season
-                unsigned char terrain = env->terrain[map_adr];
-                env->observations[obs_adr] = terrain % 4;
-                env->observations[obs_adr+1] = terrain / 4;
+            int map_adr = map_offset(env, obs_r, start_col);
+            memcpy(&env->observations[obs_adr], &env->tile_obs[map_adr*TILE_OBS], row_bytes);
+            obs_adr += row_bytes;
+        }
 
-                // Split by item type and tier
-                unsigned char item = env->items[map_adr];
-                env->observations[obs_adr+2] = item % 17;
-                env->observations[obs_adr+3] = item / 17;
-
-                int pid = env->pids[map_adr];
-                if (pid != -1) {
-                    Entity* seen = get_entity(env, pid);
-                    env->observations[obs_adr+4] = seen->type;
-                    env->observations[obs_adr+5] = seen->element;
-                    int delta_comb_obs = (seen->comb_lvl - comb_lvl) / 2;
-                    if (delta_comb_obs < 0) {
-                        delta_comb_obs = 0;
-                    }
-                    if (delta_comb_obs > 4) {
-                        delta_comb_obs = 4;
-                    }
-                    env->observations[obs_adr+6] = delta_comb_obs;
-                    env->observations[obs_adr+7] = seen->hp / 20; // Bucketed for discrete
-                    env->observations[obs_adr+8] = seen->anim;
-                    env->observations[obs_adr+9] = seen->dir;
-                }
-                obs_adr += 10;
+        // Entity levels relative to this player
+        int comb_lvl = player->comb_lvl;
+        for (int i = 0; i < obs_rows*obs_cols; i++) {
+            unsigned char* tile = &window[i*TILE_OBS];
+            if (tile[4] == ENTITY_NULL) {
+                continue;
+            }
+            int delta_comb_obs = (tile[6] - comb_lvl) / 2;
+            if (delta_comb_obs < 0) {
+                delta_comb_obs = 0;
+            }
+            if (delta_comb_obs > 4) {
+                delta_comb_obs = 4;
             }
+            tile[6] = delta_comb_obs;
         }
 
         // Player observation
@@ -1020,7 +1233,7 @@ int safe_tile(MMO* env, int delta) {
     int idx;
     while (!valid) {
         valid = true;
-        idx = rand() % (env->width * env->height);
+        idx = puffer_rand(&env->rng) % (env->width * env->height);
         char tile = env->terrain[idx];
         if (!is_grass(tile)) {
             valid = false;
@@ -1089,7 +1302,7 @@ void spawn(MMO* env, Entity* entity) {
         entity->is_equipped[idx] = 0;
     }
 
-    entity->goal = (rand() % 2) == 0;
+    entity->goal = (puffer_rand(&env->rng) % 2) == 0;
     memset(entity->min_comb_prof, 0, sizeof(entity->min_comb_prof));
     entity->min_comb_prof_idx = 0;
 }
@@ -1099,8 +1312,8 @@ void give_starter_gear(MMO* env, int pid, int tier) {
     assert(tier <= env->tiers);
 
     Entity* player = &env->players[pid];
-    int idx = (rand() % 6) + 1;
-    tier = (rand() % tier) + 1;
+    int idx = (puffer_rand(&env->rng) % 6) + 1;
+    tier = (puffer_rand(&env->rng) % tier) + 1;
     player->inventory[0] = item_index(idx, tier);
     player->gold += 50;
 }
@@ -1143,7 +1356,7 @@ void pickup_item(MMO* env, int pid) {
     // This is the only item that can be picked up without a tool
     if (ground_type == I_TOOL) {
         player->inventory[inventory_idx] = ground_id;
-        env->items[adr] = 0;
+        set_item(env, adr, 0);
         return;
     }
 
@@ -1174,7 +1387,7 @@ void pickup_item(MMO* env, int pid) {
 
     // Some items are different on the ground and in inventory
     if (ground_type == I_ORE) {
-        int armor_id = I_HELM + rand() % 3;
+        int armor_id = I_HELM + puffer_rand(&env->rng) % 3;
         ground_id = item_index(armor_id, ground_tier);
     } else if (ground_type == I_HILT) {
         ground_id = item_index(I_SWORD, ground_tier);
@@ -1184,7 +1397,7 @@ void pickup_item(MMO* env, int pid) {
         ground_id = item_index(ground_type, ground_tier);
     }
     player->inventory[inventory_idx] = ground_id;
-    env->items[adr] = 0;
+    set_item(env, adr, 0);
 }
 
 bool dest_check(MMO* env, int r, int c);
@@ -1220,10 +1433,10 @@ void move(MMO* env, int pid, int direction, bool run) {
     entity->r = rr;
     entity->c = cc;
     entity->anim = (run ? ANIM_RUN : ANIM_MOVE);
-    env->pids[map_offset(env, rr, cc)] = pid;
+    set_pid(env, map_offset(env, rr, cc), pid);
 
     int old_adr = map_offset(env, r, c);
-    env->pids[old_adr] = -1;
+    set_pid(env, old_adr, -1);
 
     // Update visitation map. Skips run tiles
     if (entity->type == ENTITY_PLAYER) {
@@ -1264,7 +1477,7 @@ void wander(MMO* env, int pid) {
     }
 
     // Move randomly
-    int direction = rand() % 4;
+    int direction = puffer_rand(&env->rng) % 4;
     if (direction == ATN_UP) {
         end_r -= 1;
     } else if (direction == ATN_DOWN) {
@@ -1373,7 +1586,7 @@ void drop_loot(MMO* env, int pid) {
             if (env->items[adr] != 0) {
                 continue;
             }
-            env->items[adr] = drop;
+            set_item(env, adr, drop);
             Respawnable elem = {.id = drop, .r = r+dr, .c = c+dc};
             add_to_buffer(env->drop_respawn_buffer, elem, env->tick);
             return;
@@ -1641,15 +1854,32 @@ void c_reset(MMO* env) {
     clear_respawn_buffer(env->resource_respawn_buffer);
     clear_respawn_buffer(env->enemy_respawn_buffer);
 
-    // TODO: Check width/height args!
-    generate_terrain(env->terrain, env->rendered, env->width, env->height,
-        env->x_window, env->y_window);
+    // Copy a pregenerated terrain if there is a bank for this map size.
+    // The slot stays read locked until spawn candidates are consumed
+    TerrainBank* bank = env->terrain_bank;
+    int bank_idx = 0;
+    int* spawn_cands = env->spawn_cands;
+    int num_cands;
+    if (bank != NULL) {
+        size_t sz = (size_t)env->width*env->height;
+        bank_idx = puffer_rand(&env->rng) % bank->num_terrains;
+        pthread_rwlock_rdlock(&bank->locks[bank_idx]);
+        memcpy(env->terrain, &bank->terrain[bank_idx*sz], sz);
+        spawn_cands = &bank->spawn_cands[bank_idx*sz];
+        num_cands = bank->num_cands[bank_idx];
+    } else {
+        // TODO: Check width/height args!
+        num_cands = generate_spawnable_terrain(env->terrain, env->rendered,
+            spawn_cands, env->width, env->height, env->x_window, env->y_window,
+            &env->rng);
+    }
 
     for (int i = 0; i < env->width*env->height; i++) {
         env->pids[i] = -1;
         env->items[i] = 0;
         //env->counts[i] = 0;
     }
+    reset_tile_obs(env);
     
     // Pid crops?
     int ore_count = 0;
@@ -1663,21 +1893,16 @@ void c_reset(MMO* env) {
     int player_count = 0;
     int enemy_count = 0;
 
-    // Randomly generate spawn candidates
-    int *spawn_cands = calloc(env->width*env->height, sizeof(int));
-    range((int*)spawn_cands, env->width*env->height);
-    shuffle((int*)spawn_cands, env->width*env->height);
-
-    for (int cand_idx = 0; cand_idx < env->width*env->height; cand_idx++) {
-        int cand = spawn_cands[cand_idx];
+    // Walk the shuffled grass tiles from a random offset so that banked
+    // terrains still get fresh resource placements. Terrain without grass,
+    // which only tiny maps produce, gets no resources, as before the bank
+    int cand_start = num_cands > 0 ? puffer_rand(&env->rng) % num_cands : 0;
+    for (int cand_idx = 0; cand_idx < num_cands; cand_idx++) {
+        int cand = spawn_cands[(cand_start + cand_idx) % num_cands];
         int r = cand / env->width;
         int c = cand % env->width;
         int tile = env->terrain[cand];
 
-        if (!is_grass(tile)) {
-            continue;
-        }
-
         // Materials only spawn south
         //if (r < env->height/2) {
         //    continue;
@@ -1721,11 +1946,11 @@ void c_reset(MMO* env) {
         //int tier = 1 + env->tiers*level/env->levels;
         int tier = 0;
         while (tier < 1 || tier > env->tiers) {
-            tier = sample_exponential(1);
+            tier = sample_exponential(1, &env->rng);
         }
 
         if (spawned) {
-            env->items[adr] = item_index(i_type, tier);
+            set_item(env, adr, item_index(i_type, tier));
             continue;
         }
 
@@ -1746,7 +1971,7 @@ void c_reset(MMO* env) {
         }
 
         if (i_type > 0) {
-            env->items[adr] = item_index(i_type, tier);
+            set_item(env, adr, item_index(i_type, tier));
         }
 
         if (
@@ -1773,7 +1998,9 @@ void c_reset(MMO* env) {
     assert(fire_gem_count == env->num_gems);
     assert(air_gem_count == env->num_gems);
     assert(water_gem_count == env->num_gems);
-    free(spawn_cands);
+    if (bank != NULL) {
+        pthread_rwlock_unlock(&bank->locks[bank_idx]);
+    }
 
     //int distance = abs(r - env->height/2);
     for (int player_count = 0; player_count < env->num_players; player_count++) {
@@ -1786,7 +2013,7 @@ void c_reset(MMO* env) {
         player->hp_max = 99;
         spawn(env, player);
         int adr = map_offset(env, player->r, player->c);
-        env->pids[adr] = pid;
+        set_pid(env, adr, pid);
         // Debug starter gear
         //give_starter_gear(env, pid, env->tiers);
     }
@@ -1797,9 +2024,9 @@ void c_reset(MMO* env) {
     for (int enemy_count = 0; enemy_count < env->num_enemies; enemy_count++) {
         int level = 0;
         while (level < 1 || level > env->levels) {
-            level = sample_exponential(8);
+            level = sample_exponential(8, &env->rng);
         }
-        if (rand() % 8 == 0) {
+        if (puffer_rand(&env->rng) % 8 == 0) {
             level = 1;
         }
         //if (distance > 8 && r < env->height/2 && enemy_count < env->num_enemies) {
@@ -1828,7 +2055,7 @@ void c_reset(MMO* env) {
         enemy->element = element;
         enemy->ranged = ranged;
 
-        env->pids[adr] = env->num_players + enemy_count;
+        set_pid(env, adr, env->num_players + enemy_count);
         enemy->comb_lvl = level;
     }
 
@@ -1846,7 +2073,7 @@ void c_step(MMO* env) {
         int item_id = item.id;
         assert(item_id > 0);
         int adr = map_offset(env, item.r, item.c);
-        env->items[adr] = item_id;
+        set_item(env, adr, item_id);
     }
 
     // Respawn enemies
@@ -1858,7 +2085,7 @@ void c_step(MMO* env) {
         int lvl = entity->comb_lvl;
         spawn(env, entity);
         int adr = map_offset(env, entity->r, entity->c);
-        env->pids[adr] = pid;
+        set_pid(env, adr, pid);
         entity->comb_lvl = lvl;
     }
 
@@ -1871,7 +2098,7 @@ void c_step(MMO* env) {
         int c = item.c;
         int adr = map_offset(env, r, c);
         if (env->items[adr] == id) {
-            env->items[adr] = 0;
+            set_item(env, adr, 0);
         }
     }
 
@@ -1888,11 +2115,11 @@ void c_step(MMO* env) {
             if (entity->anim != ANIM_DEATH) {
                 entity->anim = ANIM_DEATH;
             } else if (env->pids[adr] == pid) {
-                env->pids[adr] = -1;
+                set_pid(env, adr, -1);
             } else if (entity_type == ENTITY_PLAYER) {
                 spawn(env, entity);
                 adr = map_offset(env, entity->r, entity->c);
-                env->pids[adr] = pid;
+                set_pid(env, adr, pid);
                 //give_starter_gear(env, pid, env->tiers);
             }
             continue;
@@ -1901,19 +2128,19 @@ void c_step(MMO* env) {
         // Teleportitis: Randomly teleport players and enemies
         // to a safe tile. This prevents players from clumping
         // and messing up training dynamics
-        double prob = (double)rand() / RAND_MAX;
+        double prob = puffer_randf(&env->rng);
         if (prob < env->teleportitis_prob) {
             r = entity->r;
             c = entity->c;
             adr = map_offset(env, r, c);
-            env->pids[adr] = -1;
+            set_pid(env, adr, -1);
 
             int idx = safe_tile(env, 5);
             r = idx / env->width;
             c = idx % env->width;
 
             adr = map_offset(env, r, c);
-            env->pids[adr] = pid;
+            set_pid(env, adr, pid);
 
             entity->r = r;
             entity->c = c;
@@ -1935,13 +2162,13 @@ void c_step(MMO* env) {
                     r = entity->r;
                     c = entity->c;
                     adr = map_offset(env, r, c);
-                    env->pids[adr] = -1;
+                    set_pid(env, adr, -1);
                     int lvl = entity->comb_lvl;
                     spawn(env, entity);
                     r = entity->r;
                     c = entity->c;
                     adr = map_offset(env, r, c);
-                    env->pids[adr] = pid;
+                    set_pid(env, adr, pid);
                     if (entity->type == ENTITY_PLAYER) {
                         //give_starter_gear(env, pid, env->tiers);
                     } else {
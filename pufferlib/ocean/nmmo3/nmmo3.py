@@ -18,7 +18,8 @@ class NMMO3(pufferlib.PufferEnv):
             item_respawn_ticks=100, x_window=7, y_window=5,
             reward_combat_level=1.0, reward_prof_level=1.0,
             reward_item_level=0.5, reward_market=0.01,
-            reward_death=-1.0, log_interval=128, buf=None, seed=0):
+            reward_death=-1.0, num_terrains=None, terrain_path=None,
+            terrain_refresh_ms=0, log_interval=128, buf=None, seed=0):
 
         self.log_interval = log_interval
 
@@ -146,6 +147,28 @@ class NMMO3(pufferlib.PufferEnv):
         self.render_mode = 'human'
 
         super().__init__(buf)
+
+        # One shared terrain bank per map size. By default it holds 16
+        # terrains per env of that size. num_terrains=0 generates terrain
+        # on every reset instead
+        sizes = list(zip(width, height))
+        terrain_banks = {}
+        for w, h in sizes:
+            if (w, h) in terrain_banks:
+                continue
+            bank_size = num_terrains
+            if bank_size is None:
+                bank_size = 16*sizes.count((w, h))
+            if bank_size <= 0:
+                continue
+            path = None
+            if terrain_path is not None:
+                path = f'{terrain_path}_{w}x{h}.bin'
+            terrain_banks[(w, h)] = binding.shared(num_terrains=bank_size,
+                width=w, height=h, x_window=x_window, y_window=y_window,
+                seed=seed, path=path, refresh_ms=terrain_refresh_ms)
+        self.terrain_banks = terrain_banks
+
         player_count = 0
         enemy_count = 0
         c_envs = []
@@ -178,6 +201,7 @@ class NMMO3(pufferlib.PufferEnv):
                 reward_item_level=reward_item_level,
                 reward_market=reward_market,
                 reward_death=reward_death,
+                terrain_bank=terrain_banks.get((width[i], height[i])),
             )
             c_envs.append(env_id)
             player_count += players
@@ -211,6 +235,9 @@ class NMMO3(pufferlib.PufferEnv):
 
     def close(self):
         binding.vec_close(self.c_envs)
+        for bank in self.terrain_banks.values():
+            binding.shared_close(bank)
+        self.terrain_banks = {}
 
 def test_performance(cls, timeout=10, atn_cache=1024):
     env = cls(num_envs=1)
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include "../puffer_rand.h"
 
 typedef struct Position {
     int x;
@@ -45,10 +46,10 @@ static inline Position pos_move(Position pos, int direction, int distance) {
     return pos;
 }
 
-static inline int rand_range(int min, int max) {
+static inline int rand_range(uint64_t* rng, int min, int max) {
   if (min == max) {
     return min;
   }
 
-  return min + (rand() % (max - min));
+  return min + (puffer_rand(rng) % (max - min));
 }
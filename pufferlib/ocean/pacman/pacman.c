@@ -48,7 +48,7 @@ void demo() {
         }
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
     close_client(client);
 }
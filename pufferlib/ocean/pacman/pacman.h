@@ -122,6 +122,7 @@ typedef struct PacmanEnv {
         float *rewards;
         char *terminals;
         Log log;
+        uint64_t rng;
 
         int step_count;
         int score;
@@ -314,7 +315,7 @@ static inline void reset_round(PacmanEnv *env) {
         Ghost *ghost = &env->ghosts[i];
         ghost->pos = ghost->spawn_pos;
         ghost->direction = UP;
-        ghost->start_timeout = rand_range(env->min_start_timeout, env->max_start_timeout);
+        ghost->start_timeout = rand_range(&env->rng, env->min_start_timeout, env->max_start_timeout);
         ghost->frightened = false;
         ghost->return_to_spawn = false;
         ghost->half_move = false;
@@ -327,7 +328,7 @@ static inline void reset_round(PacmanEnv *env) {
     }
 
     if (env->randomize_starting_position) {
-        int player_randomizer = rand() % NUM_DOTS;
+        int player_randomizer = puffer_rand(&env->rng) % NUM_DOTS;
         env->player_pos = env->possible_spawn_pos[player_randomizer];
     } else {
         env->player_pos = env->player_spawn_pos;
@@ -424,7 +425,7 @@ static inline int ghost_direction(PacmanEnv *env, Ghost *ghost) {
     }
 
     if (ghost->frightened) {
-        int random_index = rand() % option_count;
+        int random_index = puffer_rand(&env->rng) % option_count;
         return directions[random_index];
     }
 
@@ -54,7 +54,7 @@ void demo() {
         c_render(&env);
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
     close_client(env.client);
 }
@@ -0,0 +1,38 @@
+// Reentrant per-env random numbers. Every env keeps a uint64_t rng field
+// that env_binding.h seeds, and draws through these helpers instead of the
+// global rand(). Results then depend only on the env's own seed, not on
+// how envs are grouped into threads or worker processes.
+#ifndef PUFFER_RAND_H
+#define PUFFER_RAND_H
+
+#include <stdint.h>
+
+#define PUFFER_RAND_MAX 0x7fffffff
+
+// PCG32 (XSH-RR) with a fixed stream. 64 bits of state, 32 bit output
+static inline uint32_t puffer_rand_u32(uint64_t* rng) {
+    uint64_t old = *rng;
+    *rng = old*6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+static inline void puffer_seed(uint64_t* rng, uint64_t seed) {
+    *rng = 0;
+    puffer_rand_u32(rng);
+    *rng += seed;
+    puffer_rand_u32(rng);
+}
+
+// Drop-in for rand(). Uniform int in [0, PUFFER_RAND_MAX]
+static inline int puffer_rand(uint64_t* rng) {
+    return (int)(puffer_rand_u32(rng) >> 1);
+}
+
+// Uniform float in [0, 1)
+static inline float puffer_randf(uint64_t* rng) {
+    return (puffer_rand_u32(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
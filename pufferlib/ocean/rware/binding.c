@@ -1,6 +1,14 @@
+#include <Python.h>
+
 #include "rware.h"
 
+static PyObject* agent_cells(PyObject* self, PyObject* args);
+static PyObject* place_agents(PyObject* self, PyObject* args);
+
 #define Env CRware
+#define MY_METHODS \
+    {"agent_cells", agent_cells, METH_VARARGS, "Per env, agent_locations and cell_agents"}, \
+    {"place_agents", place_agents, METH_VARARGS, "Move every env's unloaded agents to the given cells and directions"}
 #include "../env_binding.h"
 
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
@@ -22,3 +30,92 @@ static int my_log(PyObject* dict, Log* log) {
     assign_to_dict(dict, "episode_length", log->episode_length);
     return 0;
 }
+
+static PyObject* int_list(int* values, int n) {
+    PyObject* out = PyList_New(n);
+    for (int i = 0; i < n; i++) {
+        PyList_SET_ITEM(out, i, PyLong_FromLong(values[i]));
+    }
+    return out;
+}
+
+static PyObject* agent_cells(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 1) {
+        PyErr_SetString(PyExc_TypeError, "agent_cells requires 1 argument");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    vec_wait_async(vec);
+    PyObject* out = PyList_New(vec->num_envs);
+    for (int i = 0; i < vec->num_envs; i++) {
+        Env* env = vec->envs[i];
+        int map_size = map_sizes[env->map_choice - 1];
+        PyList_SET_ITEM(out, i, Py_BuildValue("(NN)",
+            int_list(env->agent_locations, env->num_agents),
+            int_list(env->cell_agents, map_size)));
+    }
+    return out;
+}
+
+// Sets up movement cases for tests. Shelves stay where they are
+static PyObject* place_agents(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 3) {
+        PyErr_SetString(PyExc_TypeError, "place_agents requires 3 arguments");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    PyObject* locations = PySequence_Fast(PyTuple_GetItem(args, 1), "locations must be a sequence");
+    if (!locations) {
+        return NULL;
+    }
+    PyObject* directions = PySequence_Fast(PyTuple_GetItem(args, 2), "directions must be a sequence");
+    if (!directions) {
+        Py_DECREF(locations);
+        return NULL;
+    }
+    vec_wait_async(vec);
+    for (int i = 0; i < vec->num_envs; i++) {
+        Env* env = vec->envs[i];
+        int map_size = map_sizes[env->map_choice - 1];
+        if (PySequence_Fast_GET_SIZE(locations) != env->num_agents
+                || PySequence_Fast_GET_SIZE(directions) != env->num_agents) {
+            PyErr_SetString(PyExc_ValueError, "Need a location and direction per agent");
+            break;
+        }
+        for (int cell = 0; cell < map_size; cell++) {
+            env->cell_agents[cell] = -1;
+        }
+        for (int agent = 0; agent < env->num_agents; agent++) {
+            int location = PyLong_AsLong(PySequence_Fast_GET_ITEM(locations, agent));
+            int direction = PyLong_AsLong(PySequence_Fast_GET_ITEM(directions, agent));
+            if (PyErr_Occurred()) {
+                break;
+            }
+            if (location < 0 || location >= map_size || env->cell_agents[location] != -1
+                    || direction < 0 || direction >= NUM_DIRECTIONS) {
+                PyErr_Format(PyExc_ValueError, "Bad location or direction for agent %d", agent);
+                break;
+            }
+            env->agent_locations[agent] = location;
+            env->old_agent_locations[agent] = location;
+            env->cell_agents[location] = agent;
+            env->agent_directions[agent] = direction;
+            env->agent_states[agent] = UNLOADED;
+        }
+        if (PyErr_Occurred()) {
+            break;
+        }
+    }
+    Py_DECREF(locations);
+    Py_DECREF(directions);
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
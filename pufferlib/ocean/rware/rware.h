@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define NOOP 0
 #define FORWARD 1
@@ -146,6 +147,12 @@ struct MovementGraph {
     int* cycle_ids;
     int* weights;
     int num_cycles;
+    int* cycle_sizes;
+    bool* cycle_movable;
+    int* in_degrees;       // agents waiting to move into each agent's cell
+    int* weight_counts;    // num_agents + 1 buckets for sorting by weight
+    int* order;            // agents outside cycles, highest weight first
+    int num_ordered;
 };
 
 struct CRware {
@@ -156,6 +163,7 @@ struct CRware {
     unsigned char* terminals;
     Log* agent_logs;
     Log log;
+    uint64_t rng;
     float* scores;
     int reward_type;
     int width;
@@ -165,6 +173,7 @@ struct CRware {
     int num_agents;
     int num_requested_shelves;
     int* agent_locations;
+    int* cell_agents;    // agent in each map cell, -1 if empty
     int* old_agent_locations;
     int* agent_directions;
     int* agent_states;
@@ -183,12 +192,21 @@ void add_log(CRware* env, Log* agent_log) {
 }
 
 int find_agent_at_position(CRware* env, int position) {
-    for (int i = 0; i < env->num_agents; i++) {
-        if (env->agent_locations[i] == position) {
-            return i;
-        }
+    if (position == -1) {
+        return -1;
     }
-    return -1;
+    return env->cell_agents[position];
+}
+
+// Keeps cell_agents in sync. Agents in a cycle move into cells that have not
+// been vacated yet, so only clear the old cell if nobody has moved in
+void set_agent_location(CRware* env, int agent_idx, int position) {
+    int old_position = env->agent_locations[agent_idx];
+    if (env->cell_agents[old_position] == agent_idx) {
+        env->cell_agents[old_position] = -1;
+    }
+    env->cell_agents[position] = agent_idx;
+    env->agent_locations[agent_idx] = position;
 }
 
 void place_agent(CRware* env, int agent_idx) {
@@ -197,7 +215,7 @@ void place_agent(CRware* env, int agent_idx) {
     
     int found_valid_position = 0;
     while (!found_valid_position) {
-        int random_pos = rand() % map_size;
+        int random_pos = puffer_rand(&env->rng) % map_size;
         
         // Skip if position is not empty
         if (env->warehouse_states[random_pos] != EMPTY) {
@@ -213,7 +231,8 @@ void place_agent(CRware* env, int agent_idx) {
         // Position is valid, place the agent
         env->old_agent_locations[agent_idx] = random_pos;
         env->agent_locations[agent_idx] = random_pos;
-        env->agent_directions[agent_idx] = rand() % 4;
+        env->cell_agents[random_pos] = agent_idx;
+        env->agent_directions[agent_idx] = puffer_rand(&env->rng) % 4;
         env->agent_states[agent_idx] = 0;
         found_valid_position = 1;
     }
@@ -232,7 +251,7 @@ int request_new_shelf(CRware* env) {
         total_shelves = 144;
         shelf_locations = medium_shelf_locations;
     }
-    int random_index = rand() % total_shelves;
+    int random_index = puffer_rand(&env->rng) % total_shelves;
     int shelf_location = shelf_locations[random_index];
     if (env->warehouse_states[shelf_location] == SHELF ) {
         env->warehouse_states[shelf_location] = REQUESTED_SHELF;
@@ -242,10 +261,11 @@ int request_new_shelf(CRware* env) {
 }
 
 void generate_map(CRware* env,const int* map) {
-    // seed new random
-    srand(time(NULL));
     int map_size = map_sizes[env->map_choice - 1];
     memcpy(env->warehouse_states, map, map_size * sizeof(int));
+    for (int i = 0; i < map_size; i++) {
+        env->cell_agents[i] = -1;
+    }
 
     int requested_shelves_count = 0;
     while (requested_shelves_count < env->num_requested_shelves) {
@@ -263,6 +283,12 @@ MovementGraph* init_movement_graph(CRware* env) {
     graph->cycle_ids = (int*)calloc(env->num_agents, sizeof(int));
     graph->weights = (int*)calloc(env->num_agents, sizeof(int));
     graph->num_cycles = 0;
+    graph->cycle_sizes = (int*)calloc(env->num_agents, sizeof(int));
+    graph->cycle_movable = (bool*)calloc(env->num_agents, sizeof(bool));
+    graph->in_degrees = (int*)calloc(env->num_agents, sizeof(int));
+    graph->weight_counts = (int*)calloc(env->num_agents + 1, sizeof(int));
+    graph->order = (int*)calloc(env->num_agents, sizeof(int));
+    graph->num_ordered = 0;
 
     // Initialize arrays
     for (int i = 0; i < env->num_agents; i++) {
@@ -276,6 +302,7 @@ void init(CRware* env) {
     int map_size = map_sizes[env->map_choice - 1];
     env->warehouse_states = (int*)calloc(map_size, sizeof(int));
     env->agent_locations = (int*)calloc(env->num_agents, sizeof(int));
+    env->cell_agents = (int*)calloc(map_size, sizeof(int));
     env->old_agent_locations = (int*)calloc(env->num_agents, sizeof(int));
     env->agent_directions = (int*)calloc(env->num_agents, sizeof(int));
     env->agent_states = (int*)calloc(env->num_agents, sizeof(int));
@@ -304,11 +331,17 @@ void allocate(CRware* env) {
 void c_close(CRware* env) {
     free(env->warehouse_states);
     free(env->agent_locations);
+    free(env->cell_agents);
     free(env->agent_directions);
     free(env->agent_states);
     free(env->movement_graph->target_positions);
     free(env->movement_graph->cycle_ids);
     free(env->movement_graph->weights);
+    free(env->movement_graph->cycle_sizes);
+    free(env->movement_graph->cycle_movable);
+    free(env->movement_graph->in_degrees);
+    free(env->movement_graph->weight_counts);
+    free(env->movement_graph->order);
     free(env->movement_graph);
     free(env->agent_logs);
     free(env->scores);
@@ -431,124 +464,92 @@ int get_new_position(CRware* env, int agent_idx) {
     return new_position;
 }
 
-int detect_cycle_for_agent(CRware* env, int start_agent) {
-    MovementGraph* graph = env->movement_graph;
-    
-    // If already processed or no target, skip
-    if (graph->cycle_ids[start_agent] != -1 || 
-        graph->target_positions[start_agent] == -1) {
-        return -1;
-    }
-
-    // Initialize tortoise and hare
-    int tortoise = find_agent_at_position(env, graph->target_positions[start_agent]);
-    if (tortoise == -1) return -1;
-    int hare = tortoise;
-
-    // Move hare ahead by one step
-    hare = find_agent_at_position(env, graph->target_positions[hare]);
-    if (hare == -1) return -1;
+void update_movement_graph(CRware* env, int agent_idx) {
+    env->movement_graph->target_positions[agent_idx] = get_new_position(env, agent_idx);
+}
 
-    // Loop to detect cycle
-    while (tortoise != hare) {
-        tortoise = find_agent_at_position(env, graph->target_positions[tortoise]);
-        if (tortoise == -1) return -1;
+// Agent in the cell agent_idx wants to move into, or -1
+static inline int blocking_agent(CRware* env, int agent_idx) {
+    return find_agent_at_position(env, env->movement_graph->target_positions[agent_idx]);
+}
 
-        hare = find_agent_at_position(env, graph->target_positions[hare]);
-        if (hare == -1) return -1;
-        hare = find_agent_at_position(env, graph->target_positions[hare]);
-        if (hare == -1) return -1;
+// Each agent waits on at most one other agent, so repeatedly removing agents
+// nobody is waiting on visits every agent outside a cycle, from the back of
+// each queue to the front. Whatever remains lies on a cycle
+void resolve_movement_graph(CRware* env) {
+    MovementGraph* graph = env->movement_graph;
+    int num_agents = env->num_agents;
+    for (int i = 0; i < num_agents; i++) {
+        graph->cycle_ids[i] = -1;
+        graph->weights[i] = 0;
+        graph->in_degrees[i] = 0;
     }
+    graph->num_cycles = 0;
 
-    // Find the start of the cycle
-    tortoise = start_agent;
-    while (tortoise != hare) {
-        tortoise = find_agent_at_position(env, graph->target_positions[tortoise]);
-        hare = find_agent_at_position(env, graph->target_positions[hare]);
+    for (int i = 0; i < num_agents; i++) {
+        int blocker = blocking_agent(env, i);
+        if (blocker != -1) {
+            graph->in_degrees[blocker]++;
+        }
     }
 
-    int cycle_start = tortoise;
-
-    // Mark all agents in the cycle
-    int cycle_id = graph->num_cycles++;
-    int current = cycle_start;
-    do {
-        graph->cycle_ids[current] = cycle_id;
-        current = find_agent_at_position(env, graph->target_positions[current]);
-    } while (current != cycle_start);
-
-    return cycle_id;
-}
-
-void detect_cycles(CRware* env) {
-    for (int i = 0; i < env->num_agents; i++) {
-        if(env->movement_graph->cycle_ids[i] == -1) {
-            detect_cycle_for_agent(env, i);
+    // Weights count the longest queue ending at each agent, leaves are 1
+    int* queue = graph->order;
+    int head = 0;
+    int tail = 0;
+    for (int i = 0; i < num_agents; i++) {
+        if (graph->in_degrees[i] == 0) {
+            queue[tail++] = i;
         }
     }
-}
-
-void calculate_weights(CRware* env) {
-    MovementGraph* graph = env->movement_graph;
-    
-    // First pass: identify leaf nodes (agents not targeted by others)
-    for (int i = 0; i < env->num_agents; i++) {
-        if (graph->cycle_ids[i] != -1) continue;  // Skip agents in cycles
-        
-        bool is_leaf = true;
-        for (int j = 0; j < env->num_agents; j++) {
-            if (graph->target_positions[j] != env->agent_locations[i]) continue;
-            is_leaf = false;
-            break;
+    while (head < tail) {
+        int agent = queue[head++];
+        graph->weights[agent] += 1;
+        int blocker = blocking_agent(env, agent);
+        if (blocker == -1) {
+            continue;
         }
-        
-        if (is_leaf) {
-            graph->weights[i] = 1;  // Leaf node
+        graph->weights[blocker] = max(graph->weights[blocker], graph->weights[agent]);
+        if (--graph->in_degrees[blocker] == 0) {
+            queue[tail++] = blocker;
         }
     }
 
-    bool changed = true;
-    while(changed) {
-        changed = false;
-        for (int i = 0; i < env->num_agents; i++) {
-            if (graph->cycle_ids[i] != -1) continue;
-            
-            // Find agents targeting this agent's position
-            int max_child_weight = 0;
-            for (int j = 0; j < env->num_agents; j++) {
-                if (graph->target_positions[j] != env->agent_locations[i]) continue;
-                max_child_weight = max(max_child_weight, graph->weights[j]);
-            }
-            
-            if (max_child_weight == 0 || graph->weights[i] == max_child_weight + 1) {
-                continue;
-            }
-            graph->weights[i] = max_child_weight + 1;
-            changed = true;
+    for (int i = 0; i < num_agents; i++) {
+        if (graph->in_degrees[i] == 0 || graph->cycle_ids[i] != -1) {
+            continue;
         }
+        int cycle_id = graph->num_cycles++;
+        int cycle_size = 0;
+        int current = i;
+        do {
+            graph->cycle_ids[current] = cycle_id;
+            graph->weights[current] = 0;
+            cycle_size++;
+            current = blocking_agent(env, current);
+        } while (current != i);
+        graph->cycle_sizes[cycle_id] = cycle_size;
     }
-}
 
-void update_movement_graph(CRware* env, int agent_idx) {
-    MovementGraph* graph = env->movement_graph;
-    int new_position = get_new_position(env, agent_idx);
-    if (new_position == -1) {
-        return;
+    // Counting sort by descending weight, ties in agent order
+    int max_weight = 0;
+    memset(graph->weight_counts, 0, (num_agents + 1) * sizeof(int));
+    for (int i = 0; i < num_agents; i++) {
+        if (graph->cycle_ids[i] != -1) continue;
+        graph->weight_counts[graph->weights[i]]++;
+        max_weight = max(max_weight, graph->weights[i]);
     }
-    graph->target_positions[agent_idx] = new_position;
-
-    // reset cycle and weights
-    for (int i = 0; i < env->num_agents; i++) {
-        graph->cycle_ids[i] = -1;
-        graph->weights[i] = 0;
+    int offset = 0;
+    for (int weight = max_weight; weight > 0; weight--) {
+        int count = graph->weight_counts[weight];
+        graph->weight_counts[weight] = offset;
+        offset += count;
     }
-    graph->num_cycles = 0;
-
-    // detect cycles with Floyd algorithm
-    detect_cycles(env);
-
-    // calculate weights for tree
-    calculate_weights(env);
+    for (int i = 0; i < num_agents; i++) {
+        if (graph->cycle_ids[i] != -1) continue;
+        graph->order[graph->weight_counts[graph->weights[i]]++] = i;
+    }
+    graph->num_ordered = offset;
 }
 
 void move_agent(CRware* env, int agent_idx) {
@@ -567,7 +568,7 @@ void move_agent(CRware* env, int agent_idx) {
         if (current_position_state != GOAL) {
             env->warehouse_states[agent_location] = 0;
         }
-        env->agent_locations[agent_idx] = new_position;
+        set_agent_location(env, agent_idx, new_position);
         return;
     }
     // if agent is holding requested shelf
@@ -584,7 +585,7 @@ void move_agent(CRware* env, int agent_idx) {
         }
         env->warehouse_states[new_position] = SHELF;
     }
-    env->agent_locations[agent_idx] = new_position;
+    set_agent_location(env, agent_idx, new_position);
     env->movement_graph->target_positions[agent_idx] = -1;
 }
 
@@ -628,56 +629,38 @@ void pickup_shelf(CRware* env, int agent_idx) {
 }
 
 void process_cycle_movements(CRware* env, MovementGraph* graph) {
+    // Swaps between two agents are not allowed
     for (int cycle = 0; cycle < graph->num_cycles; cycle++) {
-        int cycle_size = 0;
-        for (int i = 0; i < env->num_agents; i++) {
-            if (graph->cycle_ids[i] == cycle) {
-                cycle_size++;
-            }
-        }
-        if (cycle_size == 2) continue;
-
-        bool can_move_cycle = true;
-        // Verify all agents in cycle can move
-        for (int i = 0; i < env->num_agents; i++) {
-            if (graph->cycle_ids[i] != cycle) continue;
-            int new_pos = get_new_position(env, i);
-            if (new_pos == -1) {
-                can_move_cycle = false;
-                break;
-            }
-        }
-        
-        // Move all agents in cycle if possible
-        if (!can_move_cycle) continue;
-        for (int i = 0; i < env->num_agents; i++) {
-            if (graph->cycle_ids[i] != cycle) continue;
-            if (env->actions[i] != FORWARD) continue;            
-            move_agent(env, i);
+        graph->cycle_movable[cycle] = graph->cycle_sizes[cycle] != 2;
+    }
+    // Verify all agents in cycle can move
+    for (int i = 0; i < env->num_agents; i++) {
+        int cycle = graph->cycle_ids[i];
+        if (cycle != -1 && get_new_position(env, i) == -1) {
+            graph->cycle_movable[cycle] = false;
         }
     }
+    // Cycles are disjoint, so agents of all cycles can move in one pass
+    for (int i = 0; i < env->num_agents; i++) {
+        int cycle = graph->cycle_ids[i];
+        if (cycle == -1 || !graph->cycle_movable[cycle]) continue;
+        if (env->actions[i] != FORWARD) continue;
+        move_agent(env, i);
+    }
 }
 
 void process_tree_movements(CRware* env, MovementGraph* graph) {
-    int max_weight = 0;
-    for (int i = 0; i < env->num_agents; i++) {
-        if (graph->cycle_ids[i] == -1 && graph->weights[i] > max_weight) {
-            max_weight = graph->weights[i];
-        }
-    }
     // Process from highest weight to lowest
-    for (int weight = max_weight; weight > 0; weight--) {
-        for (int i = 0; i < env->num_agents; i++) {
-            if (graph->cycle_ids[i] != -1 || graph->weights[i] != weight) continue;
-            if (env->actions[i] != FORWARD) continue;
+    for (int j = 0; j < graph->num_ordered; j++) {
+        int i = graph->order[j];
+        if (env->actions[i] != FORWARD) continue;
 
-            int new_pos = get_new_position(env, i);
-            if (new_pos == -1) continue;
+        int new_pos = get_new_position(env, i);
+        if (new_pos == -1) continue;
 
-            int target_agent = find_agent_at_position(env, new_pos);
-            if (target_agent != -1) continue;
-            move_agent(env, i);
-        }
+        int target_agent = find_agent_at_position(env, new_pos);
+        if (target_agent != -1) continue;
+        move_agent(env, i);
     }
 }
 
@@ -688,6 +671,8 @@ void c_step(CRware* env) {
         env->old_agent_locations[i] = env->agent_locations[i];
         env->agent_logs[i].episode_length += 1;
         int action = env->actions[i];
+        // Targets only last for the step they were chosen in
+        graph->target_positions[i] = -1;
         
 	    // Handle direction changes and non-movement actions
         if (action != NOOP && action != TOGGLE_LOAD) {
@@ -705,6 +690,7 @@ void c_step(CRware* env) {
         if (env->actions[i] == FORWARD) is_movement++;
     }
     if (is_movement>=1) {
+        resolve_movement_graph(env);
         // Process movements in cycles first
         process_cycle_movements(env, graph);
         // process tree movements
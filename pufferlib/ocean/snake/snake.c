@@ -42,7 +42,7 @@ int demo() {
         c_render(&env);
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     close_client(env.client);
     free_csnake(&env);
     return 0;
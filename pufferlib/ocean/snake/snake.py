@@ -12,7 +12,7 @@ class Snake(pufferlib.PufferEnv):
             num_snakes=256, num_food=4096,
             vision=5, leave_corpse_on_death=True,
             reward_food=0.1, reward_corpse=0.1, reward_death=-1.0,
-            report_interval=128, max_snake_length=1024,
+            report_interval=128, max_snake_length=1024, num_threads=1,
             render_mode='human', buf=None, seed=0):
         
         if num_envs is not None:
@@ -75,7 +75,7 @@ class Snake(pufferlib.PufferEnv):
             )
             c_envs.append(env_id)
             offset += ns
-        self.c_envs = binding.vectorize(*c_envs)
+        self.c_envs = binding.vectorize(*c_envs, num_threads=num_threads)
  
     def reset(self, seed=None):
         self.tick = 0
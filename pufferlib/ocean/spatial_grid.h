@@ -0,0 +1,303 @@
+// Uniform grid for neighbor queries. Rebuild it with a counting sort over
+// cells, then run k-nearest or box queries against it. Envs that move items
+// between queries refile them with grid_move. Items are indices into the
+// caller's own arrays, so positions can live in any struct. Use a single cell
+// along an axis for 2D envs.
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <float.h>
+
+typedef struct {
+    float min[3];
+    float max[3];
+    float cell[3];
+    float inv_cell[3];
+    int dims[3];
+    int num_cells;
+    int capacity;
+    int* cell_start;
+    int* items;
+    int* item_cell;
+    int* item_slot;
+} SpatialGrid;
+
+// Caller-defined item filter. Return true to skip an item
+typedef bool (*grid_skip_fn)(void* ctx, int idx);
+
+static inline void grid_free(SpatialGrid* grid) {
+    free(grid->cell_start);
+    free(grid->items);
+    free(grid->item_cell);
+    free(grid->item_slot);
+}
+
+// Returns false if an allocation fails, with nothing left allocated
+static inline bool grid_init(SpatialGrid* grid, const float min[3],
+        const float max[3], const int dims[3], int capacity) {
+    grid->num_cells = 1;
+    for (int d = 0; d < 3; d++) {
+        grid->min[d] = min[d];
+        grid->max[d] = max[d];
+        grid->dims[d] = (dims[d] < 1) ? 1 : dims[d];
+        grid->cell[d] = (max[d] - min[d]) / grid->dims[d];
+        grid->inv_cell[d] = (grid->cell[d] > 0) ? 1.0f/grid->cell[d] : 0.0f;
+        grid->num_cells *= grid->dims[d];
+    }
+    grid->capacity = capacity;
+    grid->cell_start = calloc(grid->num_cells + 1, sizeof(int));
+    grid->items = calloc(capacity, sizeof(int));
+    grid->item_cell = calloc(capacity, sizeof(int));
+    grid->item_slot = calloc(capacity, sizeof(int));
+    if (grid->cell_start == NULL || grid->items == NULL
+            || grid->item_cell == NULL || grid->item_slot == NULL) {
+        grid_free(grid);
+        memset(grid, 0, sizeof(SpatialGrid));
+        return false;
+    }
+    return true;
+}
+
+// Out of range and NaN positions clamp to the border cells
+static inline int grid_coord(SpatialGrid* grid, float v, int d) {
+    float f = (v - grid->min[d])*grid->inv_cell[d];
+    if (!(f >= 0.0f)) {
+        return 0;
+    }
+    if (f >= (float)grid->dims[d]) {
+        return grid->dims[d] - 1;
+    }
+    return (int)f;
+}
+
+static inline int grid_cell(SpatialGrid* grid, int cx, int cy, int cz) {
+    return (cz*grid->dims[1] + cy)*grid->dims[0] + cx;
+}
+
+// pos points at the x of item 0. y and z follow x, and items are stride bytes apart
+static inline void grid_build(SpatialGrid* grid, const float* pos, size_t stride, int n) {
+    int* start = grid->cell_start;
+    memset(start, 0, (grid->num_cells + 1)*sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const float* p = (const float*)((const char*)pos + i*stride);
+        int cell = grid_cell(grid, grid_coord(grid, p[0], 0),
+            grid_coord(grid, p[1], 1), grid_coord(grid, p[2], 2));
+        grid->item_cell[i] = cell;
+        start[cell + 1]++;
+    }
+    for (int c = 0; c < grid->num_cells; c++) {
+        start[c + 1] += start[c];
+    }
+    // Fill back to front so each cell lists items in ascending index order.
+    // Afterwards start[c + 1] holds the first slot of cell c
+    for (int i = n - 1; i >= 0; i--) {
+        int cell = grid->item_cell[i];
+        int slot = --start[cell + 1];
+        grid->items[slot] = i;
+        grid->item_slot[i] = slot;
+    }
+    for (int c = 0; c < grid->num_cells; c++) {
+        start[c] = start[c + 1];
+    }
+    start[grid->num_cells] = n;
+}
+
+static inline void grid_swap_slots(SpatialGrid* grid, int a, int b) {
+    int ia = grid->items[a];
+    int ib = grid->items[b];
+    grid->items[a] = ib;
+    grid->items[b] = ia;
+    grid->item_slot[ib] = a;
+    grid->item_slot[ia] = b;
+}
+
+// Refiles item i under the cell of its new position. The item walks through
+// the cells between its old and new cell in storage order, one swap per cell,
+// so small moves are cheap. Items no longer stay sorted within a cell, which
+// queries do not rely on
+static inline void grid_move(SpatialGrid* grid, int i, float x, float y, float z) {
+    int cell = grid_cell(grid, grid_coord(grid, x, 0),
+        grid_coord(grid, y, 1), grid_coord(grid, z, 2));
+    int* start = grid->cell_start;
+    int c = grid->item_cell[i];
+    int s = grid->item_slot[i];
+    // Moving up, take the last slot of cell c and hand it to cell c + 1
+    for (; c < cell; c++) {
+        grid_swap_slots(grid, s, start[c + 1] - 1);
+        s = --start[c + 1];
+    }
+    // Moving down, take the first slot of cell c and hand it to cell c - 1
+    for (; c > cell; c--) {
+        grid_swap_slots(grid, s, start[c]);
+        s = start[c]++;
+    }
+    grid->item_cell[i] = cell;
+}
+
+// Bounded max-heap on (dist, idx) so results do not depend on cell order
+static inline bool grid_heap_less(float da, int ia, float db, int ib) {
+    return da < db || (da == db && ia < ib);
+}
+
+static inline void grid_heap_sift_down(float* dist, int* idx, int n, int i) {
+    while (1) {
+        int big = i;
+        int l = 2*i + 1;
+        int r = l + 1;
+        if (l < n && grid_heap_less(dist[big], idx[big], dist[l], idx[l])) {
+            big = l;
+        }
+        if (r < n && grid_heap_less(dist[big], idx[big], dist[r], idx[r])) {
+            big = r;
+        }
+        if (big == i) {
+            return;
+        }
+        float td = dist[i]; dist[i] = dist[big]; dist[big] = td;
+        int ti = idx[i]; idx[i] = idx[big]; idx[big] = ti;
+        i = big;
+    }
+}
+
+static inline void grid_heap_push(float* dist, int* idx, int* n, int k, float d, int j) {
+    if (*n < k) {
+        int i = (*n)++;
+        dist[i] = d;
+        idx[i] = j;
+        while (i > 0) {
+            int parent = (i - 1)/2;
+            if (!grid_heap_less(dist[parent], idx[parent], dist[i], idx[i])) {
+                break;
+            }
+            float td = dist[i]; dist[i] = dist[parent]; dist[parent] = td;
+            int ti = idx[i]; idx[i] = idx[parent]; idx[parent] = ti;
+            i = parent;
+        }
+    } else if (grid_heap_less(d, j, dist[0], idx[0])) {
+        dist[0] = d;
+        idx[0] = j;
+        grid_heap_sift_down(dist, idx, k, 0);
+    }
+}
+
+// Lower bound on the distance from q to any cell outside the block of radius
+// r around cell c. FLT_MAX once the block covers the whole grid
+static inline float grid_shell_bound(SpatialGrid* grid, const float q[3], const int c[3], int r) {
+    float bound = FLT_MAX;
+    for (int d = 0; d < 3; d++) {
+        if (c[d] - r > 0) {
+            float gap = q[d] - (grid->min[d] + (c[d] - r)*grid->cell[d]);
+            bound = (gap < bound) ? gap : bound;
+        }
+        if (c[d] + r + 1 < grid->dims[d]) {
+            float gap = grid->min[d] + (c[d] + r + 1)*grid->cell[d] - q[d];
+            bound = (gap < bound) ? gap : bound;
+        }
+    }
+    return (bound < 0) ? 0 : bound;
+}
+
+// Writes up to k nearest items to (x, y, z) into out_idx and their squared
+// distances into out_dist, nearest first. Returns the number found. Items at
+// NaN distance are never returned. Searches shells of cells outward and stops
+// once no unvisited cell can be closer
+static inline int grid_knn(SpatialGrid* grid, const float* pos, size_t stride,
+        float x, float y, float z, int k, int* out_idx, float* out_dist,
+        grid_skip_fn skip, void* ctx) {
+    if (k <= 0) {
+        return 0;
+    }
+    float q[3] = {x, y, z};
+    int c[3] = {grid_coord(grid, x, 0), grid_coord(grid, y, 1), grid_coord(grid, z, 2)};
+    int max_r = grid->dims[0];
+    max_r = (grid->dims[1] > max_r) ? grid->dims[1] : max_r;
+    max_r = (grid->dims[2] > max_r) ? grid->dims[2] : max_r;
+
+    int n = 0;
+    for (int r = 0; r < max_r; r++) {
+        for (int dz = -r; dz <= r; dz++) {
+            int cz = c[2] + dz;
+            if (cz < 0 || cz >= grid->dims[2]) {
+                continue;
+            }
+            for (int dy = -r; dy <= r; dy++) {
+                int cy = c[1] + dy;
+                if (cy < 0 || cy >= grid->dims[1]) {
+                    continue;
+                }
+                // Interior rows were searched by earlier shells, so only visit the ends
+                bool face = (dz == -r || dz == r || dy == -r || dy == r);
+                int step = (face || r == 0) ? 1 : 2*r;
+                for (int dx = -r; dx <= r; dx += step) {
+                    int cx = c[0] + dx;
+                    if (cx < 0 || cx >= grid->dims[0]) {
+                        continue;
+                    }
+                    int cell = grid_cell(grid, cx, cy, cz);
+                    for (int s = grid->cell_start[cell]; s < grid->cell_start[cell + 1]; s++) {
+                        int j = grid->items[s];
+                        if (skip != NULL && skip(ctx, j)) {
+                            continue;
+                        }
+                        const float* p = (const float*)((const char*)pos + j*stride);
+                        float ox = p[0] - x;
+                        float oy = p[1] - y;
+                        float oz = p[2] - z;
+                        float dist = ox*ox + oy*oy + oz*oz;
+                        if (dist == dist) {
+                            grid_heap_push(out_dist, out_idx, &n, k, dist, j);
+                        }
+                    }
+                }
+            }
+        }
+        // The small slack covers rounding in the distance computation
+        float bound = grid_shell_bound(grid, q, c, r);
+        if (bound == FLT_MAX || (n == k && out_dist[0] < 0.9998f*bound*bound)) {
+            break;
+        }
+    }
+
+    // Heap sort in place, nearest first. n never exceeds k, and checking k
+    // lets the compiler drop the sort for single nearest queries
+    for (int end = n - 1; k > 1 && end > 0; end--) {
+        float td = out_dist[0]; out_dist[0] = out_dist[end]; out_dist[end] = td;
+        int ti = out_idx[0]; out_idx[0] = out_idx[end]; out_idx[end] = ti;
+        grid_heap_sift_down(out_dist, out_idx, end, 0);
+    }
+    return n;
+}
+
+// Collects items in cells overlapping the box [lo, hi] into out. The caller
+// still applies the exact distance test. Returns the number of items in those
+// cells, which is more than were written if it exceeds max_out
+static inline int grid_query_box(SpatialGrid* grid, const float lo[3],
+        const float hi[3], int* out, int max_out) {
+    int cmin[3];
+    int cmax[3];
+    for (int d = 0; d < 3; d++) {
+        cmin[d] = grid_coord(grid, lo[d], d);
+        cmax[d] = grid_coord(grid, hi[d], d);
+    }
+    int n = 0;
+    for (int cz = cmin[2]; cz <= cmax[2]; cz++) {
+        for (int cy = cmin[1]; cy <= cmax[1]; cy++) {
+            for (int cx = cmin[0]; cx <= cmax[0]; cx++) {
+                int cell = grid_cell(grid, cx, cy, cz);
+                for (int s = grid->cell_start[cell]; s < grid->cell_start[cell + 1]; s++) {
+                    if (n < max_out) {
+                        out[n] = grid->items[s];
+                    }
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 #include <time.h>
 #include "raylib.h"
@@ -60,6 +61,7 @@ typedef struct Log {
 
 typedef struct Tactical {
     Log log;
+    uint64_t rng;
     Client* client;
     int num_agents;
     unsigned char* observations;
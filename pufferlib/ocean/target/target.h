@@ -8,6 +8,7 @@
 #include <string.h>
 #include <math.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 // Required struct. Only use floats!
 typedef struct {
@@ -41,6 +42,7 @@ typedef struct {
 // Recommended that you name it the same as the env file
 typedef struct {
     Log log; // Required field. Env binding code uses this to aggregate logs
+    uint64_t rng;
     Client* client;
     Agent* agents;
     Goal* goals;
@@ -74,8 +76,8 @@ void update_goals(Target* env) {
             if (dist > 32) {
                 continue;
             }
-            goal->x = rand() % env->width;
-            goal->y = rand() % env->height;
+            goal->x = puffer_rand(&env->rng) % env->width;
+            goal->y = puffer_rand(&env->rng) % env->height;
             env->rewards[a] = 1.0f;
             env->log.perf += 1.0f;
             env->log.score += 1.0f;
@@ -116,13 +118,13 @@ void compute_observations(Target* env) {
 // Required function
 void c_reset(Target* env) {
     for (int i=0; i<env->num_agents; i++) {
-        env->agents[i].x = rand() % env->width;
-        env->agents[i].y = rand() % env->height;
+        env->agents[i].x = puffer_rand(&env->rng) % env->width;
+        env->agents[i].y = puffer_rand(&env->rng) % env->height;
         env->agents[i].ticks_since_reward = 0;
     }
     for (int i=0; i<env->num_goals; i++) {
-        env->goals[i].x = rand() % env->width;
-        env->goals[i].y = rand() % env->height;
+        env->goals[i].x = puffer_rand(&env->rng) % env->width;
+        env->goals[i].y = puffer_rand(&env->rng) % env->height;
     }
     compute_observations(env);
 }
@@ -156,8 +158,8 @@ void c_step(Target* env) {
         agent->y = clip(agent->y, 0, env->height);
 
         if (agent->ticks_since_reward % 512 == 0) {
-            env->agents[i].x = rand() % env->width;
-            env->agents[i].y = rand() % env->height;
+            env->agents[i].x = puffer_rand(&env->rng) % env->width;
+            env->agents[i].y = puffer_rand(&env->rng) % env->height;
         }
     }
     update_goals(env);
@@ -180,6 +180,7 @@ void demo() {
     TerraformNet* net = init_terranet(weights, 1, 11, 6);
     srand(time(NULL));
     Terraform env = {.size = 64, .num_agents = 1, .reset_frequency = 8192, .reward_scale = 0.04f};
+    puffer_seed(&env.rng, time(NULL));
     allocate(&env);
 
     c_reset(&env);
@@ -207,7 +208,7 @@ void demo() {
     free_allocated(&env);
     close_client(env.client);
     free_terranet(net);
-    free(weights);
+    free_weights(weights);
 }
 
 void test_performance(int timeout) {
@@ -218,6 +219,7 @@ void test_performance(int timeout) {
         .reset_frequency = 512,
         .reward_scale = 0.01f,
     };
+    puffer_seed(&env.rng, time(NULL));
     allocate(&env);
     c_reset(&env);
 
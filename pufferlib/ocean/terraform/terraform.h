@@ -8,6 +8,7 @@
 #include <float.h>
 #include <time.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include "simplex.h"
 #include "raymath.h"
 #include "rlgl.h"
@@ -41,7 +42,6 @@ const unsigned char TARGET = 2;
 #define OBSERVATION_SIZE (2*VISION + 1)
 #define TOTAL_OBS (OBSERVATION_SIZE*OBSERVATION_SIZE + 4)
 #define DOZER_STEP_HEIGHT 5.0f 
-struct timespec ts;
 
 typedef struct Log Log;
 struct Log {
@@ -72,6 +72,7 @@ typedef struct Dozer {
 typedef struct Client Client;
 typedef struct Terraform {
     Log log;
+    uint64_t rng;
     Log* agent_logs;
     Client* client;
     Dozer* dozers;
@@ -104,8 +105,8 @@ typedef struct Terraform {
     float* quadrant_centroids;
 } Terraform;
 
-float randf(float min, float max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randf(uint64_t* rng, float min, float max) {
+    return min + (max - min)*puffer_randf(rng);
 }
 
 void perlin_noise(float* map, int width, int height,
@@ -265,22 +266,16 @@ void init(Terraform* env) {
         env->dozers[i].quadrant_progress = 0.0f;
         env->dozers[i].highest_quadrant_progress = 0.0f;
     }
-    clock_gettime(CLOCK_REALTIME, &ts);
-    unsigned int base_seed = (unsigned int)(ts.tv_nsec ^ ts.tv_sec ^ getpid());
-    unsigned int seed1 = base_seed;
-    unsigned int seed2 = base_seed + 99991;
-    srand(seed1);
-    int offset_x1 = rand() % 10000;
-    int offset_y1 = rand() % 10000;
-    srand(seed2);
-    int offset_x2 = rand() % 10000;
-    int offset_y2 = rand() % 10000;
+    int offset_x1 = puffer_rand(&env->rng) % 10000;
+    int offset_y1 = puffer_rand(&env->rng) % 10000;
+    int offset_x2 = puffer_rand(&env->rng) % 10000;
+    int offset_y2 = puffer_rand(&env->rng) % 10000;
     perlin_noise(env->orig_map, env->size, env->size, 1.0/(env->size / 4.0), 8, offset_x1, offset_y1, MAX_DIRT_HEIGHT+20);
     // perlin_noise(env->target_map, env->size, env->size, 1.0/(env->size / 4.0), 8, offset_x2, offset_y2, MAX_DIRT_HEIGHT+55);
     env->returns = calloc(env->num_agents, sizeof(float));
     calculate_total_delta(env);
     env->stuck_count = calloc(env->num_agents, sizeof(int));
-    env->tick = rand() % 512;
+    env->tick = puffer_rand(&env->rng) % 512;
     env->quadrants_solved = 0.0f;
 }
 
@@ -386,7 +381,7 @@ void c_reset(Terraform* env) {
     memcpy(env->quadrant_volume_deltas, env->volume_deltas, env->num_quadrants*sizeof(float));
     memset(env->complete_quadrants, 0, env->num_quadrants*sizeof(int));
 
-    int num_quadrants_to_precomplete = rand() % 5 + 25; // e.g. 30 to 34
+    int num_quadrants_to_precomplete = puffer_rand(&env->rng) % 5 + 25; // e.g. 30 to 34
     
     // Create array of available quadrants
     int available[env->num_quadrants];
@@ -451,8 +446,8 @@ void c_reset(Terraform* env) {
         temp.load_indices = env->dozers[i].load_indices;
         env->dozers[i] = temp;
         do {
-            env->dozers[i].x = rand() % env->size;
-            env->dozers[i].y = rand() % env->size;
+            env->dozers[i].x = puffer_rand(&env->rng) % env->size;
+            env->dozers[i].y = puffer_rand(&env->rng) % env->size;
         } while (env->map[map_idx(env, env->dozers[i].x, env->dozers[i].y)] != 0.0f);
         for (int j = 0; j < (2*SCOOP_SIZE + 1)*(2*SCOOP_SIZE + 1); j++) {
             env->dozers[i].load_indices[j] = -1;
@@ -676,8 +671,8 @@ void c_step(Terraform* env) {
         // Teleportitis
         if (env->tick % 512 == 0) {
              do {
-                 env->dozers[i].x = rand() % env->size;
-                 env->dozers[i].y = rand() % env->size;
+                 env->dozers[i].x = puffer_rand(&env->rng) % env->size;
+                 env->dozers[i].y = puffer_rand(&env->rng) % env->size;
                  env->stuck_count[i] = 0;
              } while (env->map[map_idx(env, env->dozers[i].x, env->dozers[i].y)] != 0.0f);
         }
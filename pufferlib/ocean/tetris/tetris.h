@@ -1,4 +1,5 @@
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include "tetrominoes.h"
 #include <assert.h>
 #include <limits.h>
@@ -57,6 +58,7 @@ typedef struct Client {
 typedef struct Tetris {
 	Client *client;
 	Log log;
+	uint64_t rng;
 	float *observations;
 	int *actions;
 	float *rewards;
@@ -168,14 +170,14 @@ void restore_grid(Tetris *env) { memset(env->grid, 0, env->n_rows * env->n_cols
 
 void initialize_deck(Tetris *env) {
 	for (int i = 0; i < env->deck_size; i++) {
-		env->tetromino_deck[i] = rand() % NUM_TETROMINOES;
+		env->tetromino_deck[i] = puffer_rand(&env->rng) % NUM_TETROMINOES;
 	}
 	env->cur_position_in_deck = 0;
 	env->cur_tetromino = env->tetromino_deck[env->cur_position_in_deck];
 }
 
 void spawn_new_tetromino(Tetris *env) {
-	env->tetromino_deck[env->cur_position_in_deck] = rand() % NUM_TETROMINOES;
+	env->tetromino_deck[env->cur_position_in_deck] = puffer_rand(&env->rng) % NUM_TETROMINOES;
 	env->cur_position_in_deck = (env->cur_position_in_deck + 1) % env->deck_size;
 	env->cur_tetromino = env->tetromino_deck[env->cur_position_in_deck];
 	env->cur_tetromino_rot = 0;
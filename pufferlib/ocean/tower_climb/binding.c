@@ -1,26 +1,80 @@
+#include <pthread.h>
+#include <unistd.h>
+
 #include "tower_climb.h"
 
 #define Env CTowerClimb
 #define MY_SHARED
 #include "../env_binding.h"
 
-static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
-    int num_maps = unpack(kwargs, "num_maps");
-    Level* levels = calloc(num_maps, sizeof(Level));
-    PuzzleState* puzzle_states = calloc(num_maps, sizeof(PuzzleState));
+typedef struct {
+    Level* levels;
+    PuzzleState* puzzle_states;
+    int num_maps;
+    int next;
+} LevelJob;
 
-    for (int i = 0; i < num_maps; i++) {
-        int goal_height = rand() % 4 + 5;
+// Each thread claims levels one at a time and verifies them with its own arena
+static void* levels_worker(void* arg) {
+    LevelJob* job = arg;
+    BFSArena* arena = make_bfs_arena();
+    while (1) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->num_maps)
+            break;
+        uint64_t rng;
+        puffer_seed(&rng, i);
+        int goal_height = puffer_rand(&rng) % 4 + 5;
         int min_moves = 10;
         int max_moves = 15;
-        init_level(&levels[i]);
-        init_puzzle_state(&puzzle_states[i]);
-        cy_init_random_level(&levels[i], goal_height, max_moves, min_moves, i);
-        levelToPuzzleState(&levels[i], &puzzle_states[i]);
+        init_level(&job->levels[i]);
+        init_puzzle_state(&job->puzzle_states[i]);
+        cy_init_random_level(arena, &job->levels[i], goal_height, max_moves, min_moves, i);
+        levelToPuzzleState(&job->levels[i], &job->puzzle_states[i]);
     }
+    free_bfs_arena(arena);
+    return NULL;
+}
+
+// Optional num_threads kwarg, defaulting to one thread per core
+static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
+    int num_maps = unpack(kwargs, "num_maps");
+    int num_threads = 0;
+    if (PyDict_GetItemString(kwargs, "num_threads") != NULL) {
+        num_threads = unpack(kwargs, "num_threads");
+    }
+    if (num_threads <= 0)
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+        num_threads = 1;
+
+    LevelJob job = {
+        .levels = calloc(num_maps, sizeof(Level)),
+        .puzzle_states = calloc(num_maps, sizeof(PuzzleState)),
+        .num_maps = num_maps,
+    };
+    if (job.levels == NULL || job.puzzle_states == NULL) {
+        free(job.levels);
+        free(job.puzzle_states);
+        return PyErr_NoMemory();
+    }
+
+    // The calling thread works too and picks up whatever the threads that
+    // did start leave over, so failing to start any of them only costs time
+    Py_BEGIN_ALLOW_THREADS
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < num_threads - 1
+            && pthread_create(&threads[started], NULL, levels_worker, &job) == 0)
+        started++;
+    levels_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    Py_END_ALLOW_THREADS
 
-    PyObject* levels_handle = PyLong_FromVoidPtr(levels);
-    PyObject* puzzles_handle = PyLong_FromVoidPtr(puzzle_states);
+    PyObject* levels_handle = PyLong_FromVoidPtr(job.levels);
+    PyObject* puzzles_handle = PyLong_FromVoidPtr(job.puzzle_states);
     PyObject* state = PyDict_New();
     PyDict_SetItemString(state, "levels", levels_handle);
     PyDict_SetItemString(state, "puzzles", puzzles_handle);
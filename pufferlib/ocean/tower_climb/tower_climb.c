@@ -110,20 +110,23 @@ void demo() {
 
     srand(time(NULL));
     
+    BFSArena* arena = make_bfs_arena();
     for (int i = 0; i < num_maps; i++) {
         int goal_height = rand() % 4 + 5;
         int min_moves = 10;
         int max_moves = 15;
         init_level(&levels[i]);
         init_puzzle_state(&puzzle_states[i]);
-        cy_init_random_level(&levels[i], goal_height, max_moves, min_moves, i);
+        cy_init_random_level(arena, &levels[i], goal_height, max_moves, min_moves, i);
         levelToPuzzleState(&levels[i], &puzzle_states[i]);
     }
+    free_bfs_arena(arena);
 
     CTowerClimb* env = allocate();
     env->num_maps = num_maps;
     env->all_levels = levels;
     env->all_puzzles = puzzle_states;
+    puffer_seed(&env->rng, time(NULL));
 
     int random_level = 5 + (rand() % 4);
     init_random_level(env, random_level, 15, 10, rand());
@@ -191,10 +194,9 @@ void demo() {
     close_client(client);
     free_allocated(env);
     free_tower_climb_net(net);
-    free(weights);
+    free_weights(weights);
     free(levels[0].map);
     free(levels);
-    free(puzzle_states[0].blocks);
     free(puzzle_states);
 }
 
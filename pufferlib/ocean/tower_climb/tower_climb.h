@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include "raymath.h"
 #include "rlgl.h"
 #include <time.h>
@@ -60,9 +61,6 @@
 #define MAX_BFS_SIZE 10000000
 #define MAX_NEIGHBORS 6 // based on action space
 
-// hash table 
-#define TABLE_SIZE 10000003
-
 // direction vectors
 #define NUM_DIRECTIONS 4
 static const int BFS_DIRECTION_VECTORS_X[NUM_DIRECTIONS] = {1, 0, -1, 0};
@@ -121,7 +119,7 @@ void free_level(Level* lvl){
 
 typedef struct PuzzleState PuzzleState;
 struct PuzzleState {
-    unsigned char* blocks;
+    unsigned char blocks[BLOCK_BYTES];
     int robot_position;
     int robot_orientation;
     int robot_state;
@@ -129,11 +127,10 @@ struct PuzzleState {
 };
 
 void init_puzzle_state(PuzzleState* ps){
-	ps->blocks = calloc(BLOCK_BYTES, sizeof(unsigned char));
+	memset(ps->blocks, 0, BLOCK_BYTES);
 }
 
 void free_puzzle_state(PuzzleState* ps){
-	free(ps->blocks);
 	free(ps);
 }
 
@@ -158,6 +155,7 @@ struct CTowerClimb {
     unsigned char* terminals;
     unsigned char* truncations;
     Log log;
+    uint64_t rng;
     Log buffer;
     float score;
     int num_maps;
@@ -345,7 +343,7 @@ void c_reset(CTowerClimb* env) {
     // Always use pre-generated maps (ensure at least 1 exists during initialization)
     // printf("num maps: %d\n", env->num_maps);
     if (env->num_maps > 0) {
-        int idx = rand() % env->num_maps;
+        int idx = puffer_rand(&env->rng) % env->num_maps;
         setPuzzle(env, &env->all_puzzles[idx], &env->all_levels[idx]);
     } else {
         // Emergency fallback: use a simple default level
@@ -559,7 +557,7 @@ int handle_block_falling(PuzzleState* outState, int* affected_blocks, int* block
 
 int push(PuzzleState* outState, int action, const Level* lvl, int mode, CTowerClimb* env, int block_offset){
     int first_block_index = outState->robot_position + BFS_DIRECTION_VECTORS_X[outState->robot_orientation] + BFS_DIRECTION_VECTORS_Z[outState->robot_orientation]*lvl->cols;                          
-    int* blocks_to_move = calloc(lvl->cols, sizeof(int));
+    int blocks_to_move[lvl->cols];
     for(int i = 0; i < lvl->cols; i++) {
         blocks_to_move[i] = (i == 0) ? first_block_index : -1;
     }
@@ -600,9 +598,7 @@ int push(PuzzleState* outState, int action, const Level* lvl, int mode, CTowerCl
         count++;
     }
     outState->block_grabbed = -1;
-    int result =  handle_block_falling(outState, affected_blocks, blocks_to_move,count, lvl);
-    free(blocks_to_move);
-    return result;
+    return handle_block_falling(outState, affected_blocks, blocks_to_move,count, lvl);
 }
 
 int pull(PuzzleState* outState, int action, const Level* lvl, int mode, CTowerClimb* env, int block_offset){
@@ -867,22 +863,45 @@ void c_step(CTowerClimb* env) {
 
 typedef struct BFSNode {
     PuzzleState state;
+    uint64_t hash;  // hashPuzzleState(&state)
     int depth;      // how many moves from start
     int parent;     // index in BFS array of who generated me
     int action;     // which action led here (if you want to reconstruct the path)
 } BFSNode;
 
-static BFSNode* queueBuffer = NULL;
-static int front = 0, back = 0;
+// Scratch memory for bfs. The node array is both the queue and the visited
+// set's storage: every state is enqueued exactly once, and the open addressing
+// table maps hashes to node indices. Slots are live only if their stamp matches
+// the current search, so starting a search clears nothing. Both arrays grow by
+// doubling up to MAX_BFS_SIZE nodes and are reused across searches, so one
+// arena per thread makes repeated verification allocation free
+typedef struct BFSArena BFSArena;
+struct BFSArena {
+    BFSNode* nodes;
+    int capacity;
+    int* slots;
+    unsigned int* stamps;
+    int slot_mask;
+    unsigned int stamp;
+};
 
-// hash table for visited states
-typedef struct VisitedNode {
-    PuzzleState state;
-    uint64_t hashVal;
-    struct VisitedNode* next;
-} VisitedNode;
+BFSArena* make_bfs_arena(void) {
+    BFSArena* arena = calloc(1, sizeof(BFSArena));
+    arena->capacity = 4096;
+    arena->nodes = malloc(arena->capacity * sizeof(BFSNode));
+    arena->slot_mask = 2*arena->capacity - 1;
+    arena->slots = malloc(2*arena->capacity * sizeof(int));
+    arena->stamps = calloc(2*arena->capacity, sizeof(unsigned int));
+    return arena;
+}
+
+void free_bfs_arena(BFSArena* arena) {
+    free(arena->nodes);
+    free(arena->slots);
+    free(arena->stamps);
+    free(arena);
+}
 
-static VisitedNode* visitedTable[TABLE_SIZE];
 // Helper to incorporate a 32-bit integer into the hash one byte at a time.
 static inline uint64_t fnv1a_hash_int(uint64_t h, int value) {
     // Break the int into 4 bytes (assuming 32-bit int).
@@ -925,211 +944,131 @@ int equalPuzzleState(const PuzzleState* a, const PuzzleState* b) {
     return 1;
 }
 
-void resetVisited(void) {
-    memset(visitedTable, 0, sizeof(visitedTable));
-}
-
-// Helper function to find a node in the hash table
-static VisitedNode* findNode(const PuzzleState* s, uint64_t hv, size_t idx) {
-    VisitedNode* node = visitedTable[idx];
-    while (node) {
-        if (node->hashVal == hv && equalPuzzleState(&node->state, s)) {
-            return node;
-        }
-        node = node->next;
+static void insertSlot(BFSArena* arena, int index) {
+    int slot = arena->nodes[index].hash & arena->slot_mask;
+    while (arena->stamps[slot] == arena->stamp) {
+        slot = (slot + 1) & arena->slot_mask;
     }
-    return NULL;
-}
-
-int isVisited(const PuzzleState* s) {
-    uint64_t hv = hashPuzzleState(s);
-    size_t idx = (size_t)(hv % TABLE_SIZE);
-    return findNode(s, hv, idx) != NULL;
+    arena->slots[slot] = index;
+    arena->stamps[slot] = arena->stamp;
 }
 
-void markVisited(const PuzzleState* s) {
-    uint64_t hv = hashPuzzleState(s);
-    size_t idx = (size_t)(hv % TABLE_SIZE);
-    // Return if already present
-    if (findNode(s, hv, idx)) {
-        return;
+// Makes room for one more node, keeping the table at most half full.
+// Returns 0 once the search would exceed MAX_BFS_SIZE nodes
+static int reserveNode(BFSArena* arena, int back) {
+    if (back < arena->capacity) {
+        return 1;
     }
-    // Insert new node
-    VisitedNode* node = (VisitedNode*)malloc(sizeof(VisitedNode));
-    node->state.blocks = (unsigned char*)malloc(BLOCK_BYTES * sizeof(unsigned char));
-    // Copy the blocks data
-    memcpy(node->state.blocks, s->blocks, BLOCK_BYTES * sizeof(unsigned char));
-    // Copy other fields
-    node->state.robot_position = s->robot_position;
-    node->state.robot_orientation = s->robot_orientation;
-    node->state.robot_state = s->robot_state;
-    node->state.block_grabbed = s->block_grabbed;
-    node->hashVal = hv;
-    node->next = visitedTable[idx];
-    visitedTable[idx] = node;
-}
-
-static PuzzleState copyPuzzleState(const PuzzleState* src) 
-{
-    PuzzleState dst = {
-	    .blocks = NULL,
-	    .robot_position = src->robot_position,
-	    .robot_orientation = src->robot_orientation,
-	    .robot_state = src->robot_state,
-	    .block_grabbed = src->block_grabbed
-    };
-    if(src->blocks) {
-	    dst.blocks = (unsigned char*)calloc(BLOCK_BYTES, sizeof(unsigned char));
-	    if (dst.blocks) {
-		    memcpy(dst.blocks, src->blocks, BLOCK_BYTES);
-	    }
+    if (arena->capacity >= MAX_BFS_SIZE) {
+        return 0;
+    }
+    int capacity = 2*arena->capacity;
+    if (capacity > MAX_BFS_SIZE) {
+        capacity = MAX_BFS_SIZE;
+    }
+    // The slot count stays a power of two at least twice the capacity
+    int num_slots = arena->slot_mask + 1;
+    while (num_slots < 2*capacity) {
+        num_slots *= 2;
+    }
+    BFSNode* nodes = realloc(arena->nodes, capacity * sizeof(BFSNode));
+    int* slots = malloc(num_slots * sizeof(int));
+    unsigned int* stamps = calloc(num_slots, sizeof(unsigned int));
+    if (!nodes || !slots || !stamps) {
+        if (nodes) arena->nodes = nodes;
+        free(slots);
+        free(stamps);
+        return 0;
+    }
+    free(arena->slots);
+    free(arena->stamps);
+    arena->nodes = nodes;
+    arena->capacity = capacity;
+    arena->slots = slots;
+    arena->stamps = stamps;
+    arena->slot_mask = num_slots - 1;
+    arena->stamp = 1;
+    for (int i = 0; i < back; i++) {
+        insertSlot(arena, i);
     }
-    return dst;
+    return 1;
 }
 
-// This function fills out up to MAX_NEIGHBORS BFSNodes in 'outNeighbors'
-// from a given BFSNode 'current'. It returns how many neighbors it produced.
-int getNeighbors(const BFSNode* current, BFSNode* outNeighbors,  Level* lvl) {
-    int count = 0;
-    // We'll read the current BFSNode's puzzle state
-    const PuzzleState* curState = &current->state;
-    // Try each action
-    for (int i = 0; i < 6; i++) {
-        int action = i;
-        // 1) Make a copy of the current puzzle state
-        PuzzleState newState = copyPuzzleState(curState); 
-        // 2) Attempt to apply the action to newState
-        int success = applyAction(&newState, action, lvl, PLG_MODE, NULL);
-        if (!success) {
-            // Move was invalid, skip
-	    free(newState.blocks);
-            continue;
+// Adds nodes[index] to the visited set unless an equal state is already there.
+// Returns 1 if it was new
+static int markVisited(BFSArena* arena, int index) {
+    BFSNode* node = &arena->nodes[index];
+    int slot = node->hash & arena->slot_mask;
+    while (arena->stamps[slot] == arena->stamp) {
+        BFSNode* other = &arena->nodes[arena->slots[slot]];
+        if (other->hash == node->hash && equalPuzzleState(&other->state, &node->state)) {
+            return 0;
         }
-        // 3) If valid, build a BFSNode
-        BFSNode neighbor;
-        neighbor.state = newState;
-        neighbor.depth = current->depth + 1;
-        neighbor.parent = -1;   // BFS sets or overwrites this later
-        neighbor.action = action; // record which action led here
-        // 4) Add to 'outNeighbors' array
-        outNeighbors[count++] = neighbor;
-        // If you only allow up to 6 total, we can break if we reach that
-        if (count >= MAX_NEIGHBORS) break;
-    }
-    return count; // how many valid neighbors we produced
-}
-
-void freeQueueBuffer(BFSNode* queueBuffer, int back){
-    if (!queueBuffer) return;
-    for (int i = 0; i < back; i++) {
-        free(queueBuffer[i].state.blocks); 
+        slot = (slot + 1) & arena->slot_mask;
     }
-    free(queueBuffer);
+    arena->slots[slot] = index;
+    arena->stamps[slot] = arena->stamp;
+    return 1;
 }
 
-// Example BFS
-int bfs(PuzzleState* start, int maxDepth, Level* lvl, int min_moves) {
-    // Clear or init your BFS queue
-    queueBuffer = (BFSNode*)malloc(MAX_BFS_SIZE * sizeof(BFSNode));
-    if (!queueBuffer) {
-        printf("Failed to allocate memory for BFS queue\n");
-        return 0;
+// Breadth-first search for the goal within maxDepth moves. Neighbors are
+// expanded straight into the arena's free tail and kept only if unvisited.
+// Returns 1 if the shortest solution takes at least min_moves
+int bfs(BFSArena* arena, PuzzleState* start, int maxDepth, Level* lvl, int min_moves) {
+    arena->stamp++;
+    if (arena->stamp == 0) {
+        memset(arena->stamps, 0, (arena->slot_mask + 1) * sizeof(unsigned int));
+        arena->stamp = 1;
     }
-    front = 0;
-    back = 0;
+    int front = 0;
+    int back = 0;
     // Enqueue start node
-    BFSNode startNode;
-    startNode.state = copyPuzzleState(start);  // copy puzzle state
-    startNode.depth = 0;
-    startNode.parent = -1;
-    startNode.action = -1;
-    queueBuffer[back++] = startNode;
+    BFSNode* startNode = &arena->nodes[back];
+    startNode->state = *start;
+    startNode->hash = hashPuzzleState(start);
+    startNode->depth = 0;
+    startNode->parent = -1;
+    startNode->action = -1;
+    markVisited(arena, back++);
     // BFS loop
     while (front < back) {
-        if (back >= MAX_BFS_SIZE) {
-            printf("BFS queue overflow! Increase MAX_BFS_SIZE or optimize search.\n");
-            freeQueueBuffer(queueBuffer, back);
-            queueBuffer = NULL;
-            return 0;
+        int currentIndex = front++;
+        BFSNode* current = &arena->nodes[currentIndex];
+        if (isGoal(&current->state, lvl)) {
+            return current->depth >= min_moves;
         }
-        BFSNode current = queueBuffer[front];
-        int currentIndex = front;
-        front++;
-        // If current.state is the goal, reconstruct path
-        if (isGoal(&current.state, lvl)) {
-            if(current.depth < min_moves){
-                freeQueueBuffer(queueBuffer, back);
-                queueBuffer = NULL;
+        if (current->depth >= maxDepth) continue;
+        int depth = current->depth;
+        for (int action = 0; action < MAX_NEIGHBORS; action++) {
+            if (!reserveNode(arena, back)) {
+                printf("BFS queue overflow! Increase MAX_BFS_SIZE or optimize search.\n");
                 return 0;
             }
-            // Store nodes in order
-            BFSNode* path = (BFSNode*)malloc((current.depth + 1) * sizeof(BFSNode));
-            BFSNode node = current;
-            int idx = current.depth;
-            // Walk backwards to get path
-            while (idx >= 0) {
-                path[idx] = node;
-                if (node.parent != -1) {
-                    node = queueBuffer[node.parent];
-                }
-                idx--;
+            BFSNode* next = &arena->nodes[back];
+            next->state = arena->nodes[currentIndex].state;
+            if (!applyAction(&next->state, action, lvl, PLG_MODE, NULL)) {
+                continue;
             }
-            free(path);
-            freeQueueBuffer(queueBuffer, back);
-            queueBuffer = NULL;
-            return 1;
-        }
-        if (current.depth >= maxDepth) continue;
-        // generate neighbors
-        BFSNode neighbors[MAX_NEIGHBORS];
-        int nCount = getNeighbors(&current, neighbors, lvl);
-        for (int i = 0; i < nCount; i++) {
-            PuzzleState* nxt = &neighbors[i].state;
-            if (!isVisited(nxt)) {
-                markVisited(nxt);
-                neighbors[i].depth = current.depth + 1;
-                neighbors[i].parent = currentIndex;
-                queueBuffer[back++] = neighbors[i];
-            } else {
-                free(nxt->blocks);
+            next->hash = hashPuzzleState(&next->state);
+            next->depth = depth + 1;
+            next->parent = currentIndex;
+            next->action = action;
+            if (markVisited(arena, back)) {
+                back++;
             }
-        }        
+        }
     }
-    freeQueueBuffer(queueBuffer, back);
-    queueBuffer = NULL;
     // If we exit while, no solution found within maxDepth
-    //printf("No solution within %d moves.\n", maxDepth);
     return 0;
 }
 
-void cleanupVisited(void) {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        VisitedNode* current = visitedTable[i];
-        while (current != NULL) {
-            VisitedNode* next = current->next;
-            free(current->state.blocks);
-            free(current);
-            current = next;
-        }
-        visitedTable[i] = NULL;
-    }
-}
-int verify_level(Level* level, int max_moves, int min_moves){
-    // converting level to puzzle state
-    PuzzleState* state = calloc(1, sizeof(PuzzleState));
-    init_puzzle_state(state);
-    levelToPuzzleState(level, state);
-    // reset visited hash table
-    resetVisited();
-    markVisited(state);
-    // Run BFS
-    int solvable = bfs(state, max_moves, level, min_moves);
-    cleanupVisited();
-    free_puzzle_state(state);
-    return solvable;
+int verify_level(BFSArena* arena, Level* level, int max_moves, int min_moves){
+    PuzzleState state;
+    levelToPuzzleState(level, &state);
+    return bfs(arena, &state, max_moves, level, min_moves);
 }
 
-void gen_level(Level* lvl, int goal_level) {
+void gen_level(Level* lvl, int goal_level, uint64_t* rng) {
     // Initialize an illegal level in case we need to return early
     int legal_width_size = 8;
     int legal_depth_size = 8;
@@ -1145,7 +1084,7 @@ void gen_level(Level* lvl, int goal_level) {
                 int within_legal_bounds = x>=1 && x < legal_width_size && z >= 1 && z < legal_depth_size && y>=1 && y < goal_level;
                 int allowed_block_placement = within_legal_bounds && (z <= (legal_depth_size - y));
                 if (allowed_block_placement){
-                    int chance = (rand() % 2 ==0) ? 1 : 0;
+                    int chance = (puffer_rand(rng) % 2 ==0) ? 1 : 0;
                     lvl->map[block_index] = chance;
                     // create spawn point above an existing block
                     if (spawn_created == 0 && y == 2 && lvl->map[block_index - area] == 1){
@@ -1159,7 +1098,7 @@ void gen_level(Level* lvl, int goal_level) {
                      lvl->map[block_index - 1 - area] == 1 || 
                      lvl->map[block_index + 1 - area] == 1)) {
                     // 33% chance to place goal here, unless we're at the last valid position
-                    if (rand() % 3 == 0 || (x == col_max-1 && z == 0)) {
+                    if (puffer_rand(rng) % 3 == 0 || (x == col_max-1 && z == 0)) {
                         goal_created = 1;
                         goal_index = block_index;
                         lvl->map[goal_index] = 2;
@@ -1184,24 +1123,29 @@ void gen_level(Level* lvl, int goal_level) {
 
 void init_random_level(CTowerClimb* env, int goal_level, int max_moves, int min_moves, int seed) {
 	time_t t;
-    srand((unsigned) time(&t) + seed); // Increment seed for each level
+    uint64_t rng;
+    puffer_seed(&rng, (unsigned) time(&t) + seed); // Increment seed for each level
     reset_level(env->level);
-    gen_level(env->level, goal_level);
+    gen_level(env->level, goal_level, &rng);
     // guarantee a map is created
-    while(env->level->spawn_location == 0 || env->level->goal_location == 999 || verify_level(env->level,max_moves, min_moves) == 0){
+    BFSArena* arena = make_bfs_arena();
+    while(env->level->spawn_location == 0 || env->level->goal_location == 999 || verify_level(arena, env->level,max_moves, min_moves) == 0){
         reset_level(env->level);
-        gen_level(env->level,goal_level);
+        gen_level(env->level,goal_level, &rng);
     }
+    free_bfs_arena(arena);
     levelToPuzzleState(env->level, env->state);
 }
 
-void cy_init_random_level(Level* level, int goal_level, int max_moves, int min_moves, int seed) {
+// Thread safe given a separate level and arena per thread
+void cy_init_random_level(BFSArena* arena, Level* level, int goal_level, int max_moves, int min_moves, int seed) {
     time_t t;
-    srand((unsigned) time(&t) + seed); // Increment seed for each level
-    gen_level(level, goal_level);
+    uint64_t rng;
+    puffer_seed(&rng, (unsigned) time(&t) + seed); // Increment seed for each level
+    gen_level(level, goal_level, &rng);
     // guarantee a map is created
-    while(level->spawn_location == 0 || level->goal_location == 999 || verify_level(level,max_moves, min_moves) == 0){
-        gen_level(level, goal_level);
+    while(level->spawn_location == 0 || level->goal_location == 999 || verify_level(arena, level,max_moves, min_moves) == 0){
+        gen_level(level, goal_level, &rng);
     }
 }
 
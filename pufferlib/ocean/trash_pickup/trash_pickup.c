@@ -72,7 +72,7 @@ void demo(int grid_size, int num_agents, int num_trash, int num_bins, int max_st
     }
 
     free_convlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
     //close_client(client);
 }
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 
 #define EMPTY 0
 #define TRASH 1
@@ -55,6 +56,7 @@ typedef struct {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
 
     int grid_size;
     int num_agents;
@@ -190,8 +192,8 @@ void place_random_entities(CTrashPickupEnv* env, int count, int item_type, int g
     int placed = 0;
     while (placed < count) 
     {
-        int x = rand() % env->grid_size;
-        int y = rand() % env->grid_size;
+        int x = puffer_rand(&env->rng) % env->grid_size;
+        int y = puffer_rand(&env->rng) % env->grid_size;
 
         GridCell* gridCell = &env->grid[get_grid_index(env, x, y)];
 
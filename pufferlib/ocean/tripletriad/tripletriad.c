@@ -74,7 +74,7 @@ void interactive() {
         c_render(&env);
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     close_client(env.client);
     free_allocated_ctripletriad(&env);
 }
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include <stdio.h>
 
 #define SELECT_CARD_1 0
@@ -44,6 +45,7 @@ struct CTripleTriad {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    uint64_t rng;
     int card_width;
     int card_height;
     float* board_x;
@@ -88,7 +90,7 @@ void generate_cards_in_hand(CTripleTriad* env) {
     for(int i=0; i< 2; i++) {
         for(int j=0; j< 5; j++) {
             for(int k=0; k< 4; k++) {
-                env->cards_in_hand[i][j][k] = (rand() % 7) + 1;
+                env->cards_in_hand[i][j][k] = (puffer_rand(&env->rng) % 7) + 1;
             }
         }
     }
@@ -264,7 +266,7 @@ void c_reset(CTripleTriad* env) {
     for(int i=0; i< 2; i++) {
         for(int j=0; j< 5; j++) {
             for(int k=0; k< 4; k++) {
-                env->cards_in_hand[i][j][k] = (rand() % 7) + 1;
+                env->cards_in_hand[i][j][k] = (puffer_rand(&env->rng) % 7) + 1;
             }
         }
     }
@@ -378,7 +380,7 @@ int get_bot_card_placement(CTripleTriad* env) {
     
     // Randomly select a valid placement
     if (num_valid_placements > 0) {
-        return valid_placements[rand() % num_valid_placements];
+        return valid_placements[puffer_rand(&env->rng) % num_valid_placements];
     }
 
     // If no valid placements, return 0 (this should not happen in a normal game)
@@ -398,7 +400,7 @@ int get_bot_card_selection(CTripleTriad* env) {
 
     // Randomly select a valid card
     if (num_valid_selections > 0) {
-        return valid_selections[rand() % num_valid_selections];
+        return valid_selections[puffer_rand(&env->rng) % num_valid_selections];
     }
 
     // If no valid selections, return 0 (this should not happen in a normal game)
@@ -32,7 +32,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->ftmp4 = unpack(kwargs, "ftmp4");
     env->mode7 = unpack(kwargs, "mode7");
     env->render_many = unpack(kwargs, "render_many");
-    env->rng = unpack(kwargs, "rng");
+    env->track_seed = unpack(kwargs, "rng");
     env->method = unpack(kwargs, "method");
     env->i = unpack(kwargs, "i");
 
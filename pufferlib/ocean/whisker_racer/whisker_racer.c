@@ -27,7 +27,7 @@ void demo() {
         .corner_thresh = 0.5,
         .mode7 = 1, // If mode7 = 1 then 640X480 recommended
         .render_many = 0,
-        .rng = 3, // rng = 3 for puffer track
+        .track_seed = 3, // track_seed = 3 for puffer track
         .i = 1, // i = 1 for puffer track
         .method = 1, // method = 1 for puffer track
     };
@@ -63,7 +63,7 @@ void demo() {
         c_render(&env);
     }
     free_linearlstm(net);
-    free(weights);
+    free_weights(weights);
     free_allocated(&env);
     close_client(env.client);
 }
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <string.h>
 #include "raylib.h"
+#include "../puffer_rand.h"
 #include <time.h>
 
 #define LEFT 0
@@ -57,6 +58,7 @@ typedef struct Client {
 typedef struct WhiskerRacer {
     Client* client;
     Log log;
+    uint64_t rng;
     float* observations;
     float* actions;
     float* rewards;
@@ -64,7 +66,7 @@ typedef struct WhiskerRacer {
     int i;
 
     int debug;
-    unsigned int rng;
+    unsigned int track_seed;
     int render_many;
 
     float corner_thresh;
@@ -191,7 +193,7 @@ void close_client(Client* client) {
 }
 
 void get_random_start(WhiskerRacer* env) {
-    int start_idx = rand() % env->track.total_points;
+    int start_idx = puffer_rand(&env->rng) % env->track.total_points;
     env->near_point_idx = start_idx;
 
     env->px = env->track.centerline[start_idx].x;
@@ -904,7 +906,8 @@ void init(WhiskerRacer* env) {
 
     env->texture_initialized = 0;
 
-    srand(env->rng + env->i);
+    // Track layouts are tied to the libc rand() sequence for each seed
+    srand(env->track_seed + env->i);
 
     GenerateRandomTrack(env);
 }
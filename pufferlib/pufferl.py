@@ -335,14 +335,11 @@ class PuffeRL:
 
             shape = self.values.shape
             advantages = torch.zeros(shape, device=device)
-            advantages = compute_puff_advantage(self.values, self.rewards,
-                self.terminals, self.ratio, advantages, config['gamma'],
-                config['gae_lambda'], config['vtrace_rho_clip'], config['vtrace_c_clip'])
+            advantages, prio_probs = compute_puff_advantage_prio(self.values,
+                self.rewards, self.terminals, self.ratio, advantages, config['gamma'],
+                config['gae_lambda'], config['vtrace_rho_clip'], config['vtrace_c_clip'], a)
 
             profile('train_copy', epoch)
-            adv = advantages.abs().sum(axis=1)
-            prio_weights = torch.nan_to_num(adv**a, 0, 0, 0)
-            prio_probs = (prio_weights + 1e-6)/(prio_weights.sum() + 1e-6)
             idx = torch.multinomial(prio_probs, self.minibatch_segments)
             mb_prio = (self.segments*prio_probs[idx, None])**-anneal_beta
             mb_obs = self.observations[idx]
@@ -659,6 +656,32 @@ def compute_puff_advantage(values, rewards, terminals,
     return advantages
 
 
+def compute_puff_advantage_prio(values, rewards, terminals, ratio, advantages,
+        gamma, gae_lambda, vtrace_rho_clip, vtrace_c_clip, prio_alpha):
+    '''Puffer advantage fused with prioritized replay weights. Returns
+    advantages and per-segment sampling probabilities'''
+
+    device = values.device
+    if not ADVANTAGE_CUDA:
+        values = values.cpu()
+        rewards = rewards.cpu()
+        terminals = terminals.cpu()
+        ratio = ratio.cpu()
+        advantages = advantages.cpu()
+
+    segments = values.shape[0]
+    prio_weights = torch.empty(segments, device=values.device)
+    prio_probs = torch.empty(segments, device=values.device)
+    torch.ops.pufferlib.compute_puff_advantage_prio(values, rewards, terminals,
+        ratio, advantages, prio_weights, prio_probs, gamma, gae_lambda,
+        vtrace_rho_clip, vtrace_c_clip, prio_alpha)
+
+    if not ADVANTAGE_CUDA:
+        return advantages.to(device), prio_probs.to(device)
+
+    return advantages, prio_probs
+
+
 def abbreviate(num, b2, c2):
     if num < 1e3:
         return str(num)
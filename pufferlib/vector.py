@@ -3,6 +3,7 @@
 from pdb import set_trace as T
 
 import numpy as np
+import pickle
 import time
 import psutil
 
@@ -19,6 +20,28 @@ CLOSE = 4
 MAIN = 5
 INFO = 6
 
+# Workers and the main process spin this long on the shared semaphore
+# array before blocking on a wakeup semaphore
+SPIN_TIMEOUT = 0.001
+
+# Per-worker shared slot for pickled infos. Larger infos use the pipe
+INFO_BYTES = 1 << 16
+
+# Ocean envs whose Python step only copies actions, calls vec_step and
+# periodically logs. Native skips step, so other envs would silently lose
+# action transforms or bookkeeping
+NATIVE_STEP_ENVS = {
+    'asteroids.Asteroids', 'battle.Battle', 'blastar.Blastar',
+    'checkers.Checkers', 'connect4.Connect4', 'convert.Convert',
+    'convert_circle.ConvertCircle', 'cpr.PyCPR', 'drone_race.DroneRace',
+    'drone_swarm.DroneSwarm', 'enduro.Enduro', 'freeway.Freeway',
+    'g2048.G2048', 'go.Go', 'matsci.Matsci', 'memory.Memory',
+    'pacman.Pacman', 'rware.Rware', 'snake.Snake', 'squared.Squared',
+    'target.Target', 'template.Template', 'terraform.Terraform',
+    'tetris.Tetris', 'tower_climb.TowerClimb', 'trash_pickup.TrashPickupEnv',
+    'tripletriad.TripleTriad',
+}
+
 def recv_precheck(vecenv):
     if vecenv.flag != RECV:
         raise pufferlib.APIUsageError('Call reset before stepping')
@@ -170,7 +193,8 @@ class Serial:
             env.close()
 
 def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, atn_shape, atn_dtype,
-        num_envs, num_agents, num_workers, worker_idx, send_pipe, recv_pipe, shm, is_native, seed):
+        num_envs, num_agents, num_workers, worker_idx, send_pipe, shm, is_native, seed,
+        wake, done):
 
     # Environments read and write directly to shared memory
     shape = (num_workers, num_envs*num_agents)
@@ -194,6 +218,10 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
 
     semaphores=np.ndarray(num_workers, dtype=np.uint8, buffer=shm['semaphores'])
     notify=np.ndarray(num_workers, dtype=bool, buffer=shm['notify'])
+    seeds=np.ndarray(num_workers, dtype=np.int64, buffer=shm['seeds'])
+    info_sizes=np.ndarray(num_workers, dtype=np.int32, buffer=shm['info_sizes'])
+    info_buf=np.ndarray((num_workers, INFO_BYTES),
+        dtype=np.uint8, buffer=shm['infos'])[worker_idx]
     start = time.time()
     while True:
         if notify[worker_idx]:
@@ -202,14 +230,18 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
 
         sem = semaphores[worker_idx]
         if sem >= MAIN:
-            if time.time() - start > 0.5:
-                time.sleep(0.01)
+            if time.time() - start > SPIN_TIMEOUT:
+                # Sleep until the main process posts the next command
+                wake.acquire()
+                wake.release()
+                start = time.time()
             continue
 
-        start = time.time()
+        # Main posts wake once per command. Consuming it here keeps the
+        # count balanced and orders the seed/action writes before our reads
+        wake.acquire()
         if sem == RESET:
-            seed = recv_pipe.recv()
-            _, infos = envs.reset(seed=seed)
+            _, infos = envs.reset(seed=int(seeds[worker_idx]))
         elif sem == STEP:
             _, _, _, _, infos = envs.step(atn_arr)
         elif sem == CLOSE:
@@ -218,11 +250,20 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
             break
 
         if infos:
+            data = pickle.dumps(infos, protocol=pickle.HIGHEST_PROTOCOL)
+            if len(data) <= INFO_BYTES:
+                info_buf[:len(data)] = np.frombuffer(data, dtype=np.uint8)
+                info_sizes[worker_idx] = len(data)
+            else:
+                info_sizes[worker_idx] = -1
+                send_pipe.send(infos)
             semaphores[worker_idx] = INFO
-            send_pipe.send(infos)
         else:
             semaphores[worker_idx] = MAIN
 
+        done.release()
+        start = time.time()
+
 class Multiprocessing:
     '''Runs environments in parallel using multiprocessing
 
@@ -306,6 +347,9 @@ class Multiprocessing:
             masks=RawArray('b', num_agents),
             semaphores=RawArray('c', num_workers),
             notify=RawArray('b', num_workers),
+            seeds=RawArray('q', num_workers),
+            info_sizes=RawArray('i', num_workers),
+            infos=RawArray('B', num_workers * INFO_BYTES),
         )
         shape = (num_workers, agents_per_worker)
         self.obs_batch_shape = (self.agents_per_batch, *obs_shape)
@@ -321,11 +365,22 @@ class Multiprocessing:
             masks=np.ndarray(shape, dtype=bool, buffer=self.shm['masks']),
             semaphores=np.ndarray(num_workers, dtype=np.uint8, buffer=self.shm['semaphores']),
             notify=np.ndarray(num_workers, dtype=bool, buffer=self.shm['notify']),
+            seeds=np.ndarray(num_workers, dtype=np.int64, buffer=self.shm['seeds']),
+            info_sizes=np.ndarray(num_workers, dtype=np.int32, buffer=self.shm['info_sizes']),
+            infos=np.ndarray((num_workers, INFO_BYTES), dtype=np.uint8, buffer=self.shm['infos']),
         )
         self.buf['semaphores'][:] = MAIN 
 
-        from multiprocessing import Pipe, Process
-        self.send_pipes, w_recv_pipes = zip(*[Pipe() for _ in range(num_workers)])
+        # Wakeups for idle processes. POSIX semaphores only enter the
+        # kernel when someone is actually asleep, so the hot path stays
+        # in user space. Each command posts wake once and each finished
+        # command posts done once
+        from multiprocessing import Pipe, Process, Semaphore
+        self.wake = [Semaphore(0) for _ in range(num_workers)]
+        self.done = Semaphore(0)
+        self.done_credits = 0
+        self.pending = np.zeros(num_workers, dtype=bool)
+        self.idle_start = time.time()
         w_send_pipes, self.recv_pipes = zip(*[Pipe() for _ in range(num_workers)])
         self.recv_pipe_dict = {p: i for i, p in enumerate(self.recv_pipes)}
 
@@ -339,8 +394,8 @@ class Multiprocessing:
                 args=(env_creators[start:end], env_args[start:end],
                     env_kwargs[start:end], obs_shape, obs_dtype,
                     atn_shape, atn_dtype, envs_per_worker, driver_env.num_agents,
-                    num_workers, i, w_send_pipes[i], w_recv_pipes[i],
-                    self.shm, is_native, seed_i)
+                    num_workers, i, w_send_pipes[i],
+                    self.shm, is_native, seed_i, self.wake[i], self.done)
             )
             p.start()
             self.processes.append(p)
@@ -353,6 +408,37 @@ class Multiprocessing:
         self.ready_workers = []
         self.waiting_workers = []
 
+    def _worker_done(self, worker):
+        if not self.pending[worker]:
+            return []
+
+        # Consume the done post that goes with this worker's command
+        if self.done_credits > 0:
+            self.done_credits -= 1
+        else:
+            self.done.acquire()
+
+        self.pending[worker] = False
+        self.idle_start = time.time()
+        if self.buf['semaphores'][worker] == INFO:
+            return self._recv_infos(worker)
+
+        return []
+
+    def _worker_busy(self):
+        # Block until some worker finishes if none has for a while
+        if time.time() - self.idle_start > SPIN_TIMEOUT:
+            self.done.acquire()
+            self.done_credits += 1
+            self.idle_start = time.time()
+
+    def _recv_infos(self, worker):
+        size = self.buf['info_sizes'][worker]
+        if size < 0:
+            return self.recv_pipes[worker].recv()
+
+        return pickle.loads(self.buf['infos'][worker, :size].tobytes())
+
     def recv(self):
         recv_precheck(self)
         while True:
@@ -363,16 +449,18 @@ class Multiprocessing:
                 if sem >= MAIN:
                     self.waiting_workers.pop(0)
                     self.ready_workers.append(worker)
+                    self.infos[worker] = self._worker_done(worker)
+                else:
+                    self._worker_busy()
             else:
                 worker = self.waiting_workers.pop(0)
                 sem = self.buf['semaphores'][worker]
                 if sem >= MAIN:
                     self.ready_workers.append(worker)
+                    self.infos[worker] = self._worker_done(worker)
                 else:
                     self.waiting_workers.append(worker)
-
-            if sem == INFO:
-                self.infos[worker] = self.recv_pipes[worker].recv()
+                    self._worker_busy()
 
             if not self.ready_workers:
                 continue
@@ -451,6 +539,13 @@ class Multiprocessing:
         idxs = self.w_slice
         self.actions[idxs] = actions
         self.buf['semaphores'][idxs] = STEP
+        self.pending[idxs] = True
+        if isinstance(idxs, slice):
+            idxs = range(idxs.start, idxs.stop)
+        elif isinstance(idxs, int):
+            idxs = (idxs,)
+        for worker in idxs:
+            self.wake[worker].release()
 
     def async_reset(self, seed=0):
         # Flush any waiting workers
@@ -459,10 +554,10 @@ class Multiprocessing:
             sem = self.buf['semaphores'][worker]
             if sem >= MAIN:
                 self.ready_workers.append(worker)
-                if sem == INFO:
-                    self.recv_pipes[worker].recv()
+                self._worker_done(worker)
             else:
                 self.waiting_workers.append(worker)
+                self._worker_busy()
 
         self.flag = RECV
         self.prev_env_id = []
@@ -473,11 +568,11 @@ class Multiprocessing:
         self.waiting_workers = list(range(self.num_workers))
         self.infos = [[] for _ in range(self.num_workers)]
 
+        self.buf['seeds'][:] = seed + np.arange(self.num_workers)
         self.buf['semaphores'][:] = RESET
+        self.pending[:] = True
         for i in range(self.num_workers):
-            start = i*self.envs_per_worker
-            end = (i+1)*self.envs_per_worker
-            self.send_pipes[i].send(seed+i)
+            self.wake[i].release()
 
     def notify(self):
         self.buf['notify'][:] = True
@@ -487,6 +582,141 @@ class Multiprocessing:
         for p in self.processes:
             p.terminate()
 
+class Native:
+    '''Steps a native Ocean env on C threads without Python workers
+
+    All num_envs copies are merged into one C vec env. num_workers sets
+    the thread count and batch_size splits the envs into contiguous
+    batches. A sent batch steps in the background while the next ready
+    batch is returned from recv, and results are views of the env buffers.
+    Only the C step runs, so envs are limited to NATIVE_STEP_ENVS
+    '''
+    reset = reset
+    step = step
+
+    @property
+    def num_envs(self):
+        return self.agents_per_batch
+
+    def __init__(self, env_creators, env_args, env_kwargs, num_envs,
+            num_workers=None, batch_size=None, zero_copy=True, seed=0, **kwargs):
+        if batch_size is None:
+            batch_size = num_envs
+        elif batch_size == 'auto':
+            batch_size = num_envs // 2 if num_envs % 2 == 0 else num_envs
+        if num_workers is None:
+            num_workers = 1
+        elif num_workers == 'auto':
+            num_workers = psutil.cpu_count(logical=False)
+
+        if num_envs % batch_size != 0:
+            raise pufferlib.APIUsageError('num_envs must be divisible by batch_size')
+        if any(k != env_kwargs[0] for k in env_kwargs) or any(a != env_args[0] for a in env_args):
+            raise pufferlib.APIUsageError('Native vectorization requires identical env args')
+
+        kwargs = dict(env_kwargs[0])
+        c_envs_per_shard = kwargs.get('num_envs', 1)
+        kwargs['num_envs'] = c_envs_per_shard * num_envs
+        self.driver_env = driver_env = env_creators[0](*env_args[0], seed=seed, **kwargs)
+        if not isinstance(driver_env, PufferEnv):
+            raise pufferlib.APIUsageError('Native vectorization requires a native PufferEnv')
+
+        env_cls = type(driver_env)
+        env_name = env_cls.__module__.rsplit('.', 1)[-1] + '.' + env_cls.__name__
+        if not env_cls.__module__.startswith('pufferlib.ocean.') or env_name not in NATIVE_STEP_ENVS:
+            driver_env.close()
+            raise pufferlib.APIUsageError(f'{env_cls.__name__} has Python step logic '
+                'that Native would skip. Use Serial or Multiprocessing instead')
+
+        import sys
+        self.binding = getattr(sys.modules[env_cls.__module__], 'binding', None)
+        if self.binding is None or not hasattr(self.binding, 'vec_step_async') \
+                or not hasattr(driver_env, 'c_envs'):
+            raise pufferlib.APIUsageError('Native vectorization requires an Ocean env built with vec_init')
+
+        num_c_envs = kwargs['num_envs']
+        if driver_env.num_agents % num_c_envs != 0:
+            raise pufferlib.APIUsageError('Native vectorization requires the same number of agents per env')
+
+        self.binding.vec_threads(driver_env.c_envs, num_workers)
+
+        self.emulated = driver_env.emulated
+        self.num_agents = driver_env.num_agents
+        self.num_batches = num_envs // batch_size
+        self.c_envs_per_batch = num_c_envs // self.num_batches
+        self.agents_per_batch = self.num_agents // self.num_batches
+        self.log_interval = getattr(driver_env, 'log_interval',
+            getattr(driver_env, 'report_interval', 128))
+
+        self.single_observation_space = driver_env.single_observation_space
+        self.single_action_space = driver_env.single_action_space
+        self.action_space = pufferlib.spaces.joint_space(self.single_action_space, self.agents_per_batch)
+        self.observation_space = pufferlib.spaces.joint_space(self.single_observation_space, self.agents_per_batch)
+
+        self.agent_ids = np.arange(self.num_agents)
+        self.ready = []
+        self.in_flight = None
+        self.current = None
+        self.infos = []
+        self.tick = 0
+        self.initialized = False
+        self.flag = RESET
+
+    def _agents(self, batch):
+        start = batch * self.agents_per_batch
+        return slice(start, start + self.agents_per_batch)
+
+    def _wait(self):
+        if self.in_flight is not None:
+            self.binding.vec_wait(self.driver_env.c_envs)
+            self.ready.append(self.in_flight)
+            self.in_flight = None
+
+    def recv(self):
+        recv_precheck(self)
+        if not self.ready:
+            self._wait()
+
+        self.current = batch = self.ready.pop(0)
+        s = self._agents(batch)
+        env = self.driver_env
+        infos = self.infos
+        self.infos = []
+        return (env.observations[s], env.rewards[s], env.terminals[s],
+            env.truncations[s], infos, self.agent_ids[s], env.masks[s])
+
+    def send(self, actions):
+        actions = send_precheck(self, actions)
+        env = self.driver_env
+        s = self._agents(self.current)
+        env.actions[s] = actions.reshape(env.actions[s].shape)
+
+        self._wait()
+        start = self.current * self.c_envs_per_batch
+        self.binding.vec_step_async(env.c_envs, start, start + self.c_envs_per_batch)
+        self.in_flight = self.current
+
+        self.tick += 1
+        if self.tick % (self.log_interval * self.num_batches) == 0:
+            log = self.binding.vec_log(env.c_envs)
+            if log:
+                self.infos.append(log)
+
+    def async_reset(self, seed=0):
+        self._wait()
+        self.driver_env.reset(seed=seed)
+        self.ready = list(range(self.num_batches))
+        self.infos = []
+        self.tick = 0
+        self.flag = RECV
+
+    def notify(self):
+        self.driver_env.notify()
+
+    def close(self):
+        self._wait()
+        self.driver_env.close()
+
 class Ray():
     '''Runs environments in parallel on multiple processes using Ray
 
@@ -638,7 +868,8 @@ def make(env_creator_or_creators, env_args=None, env_kwargs=None, backend=Puffer
 
         return vecenv
 
-    if 'num_workers' in kwargs:
+    # Native threads split C envs, so num_workers need not divide num_envs
+    if 'num_workers' in kwargs and backend is not Native:
         if kwargs['num_workers'] == 'auto':
             kwargs['num_workers'] = num_envs
 
@@ -705,6 +936,9 @@ def make(env_creator_or_creators, env_args=None, env_kwargs=None, backend=Puffer
 
     # TODO: First step action space check
     
+    if backend is Native:
+        kwargs['seed'] = seed
+
     return backend(env_creators, env_args, env_kwargs, num_envs, **kwargs)
 
 def make_seeds(seed, num_envs):
@@ -1,3 +1,5 @@
+import numpy as np
+
 from pufferlib.ocean.breakout import breakout
 
 kwargs = dict(
@@ -60,6 +62,64 @@ def test_env_binding():
     breakout.binding.vec_step(c_envs)
     breakout.binding.vec_close(c_envs)
 
+    # Threaded vec usage
+    threaded = breakout.Breakout(num_envs=8)
+    c_envs = breakout.binding.vec_init(
+        threaded.observations,
+        threaded.actions,
+        threaded.rewards,
+        threaded.terminals,
+        threaded.truncations,
+        threaded.num_agents,
+        0,
+        num_threads=4,
+        **kwargs
+    )
+    serial = breakout.Breakout(num_envs=8)
+    s_envs = breakout.binding.vec_init(
+        serial.observations,
+        serial.actions,
+        serial.rewards,
+        serial.terminals,
+        serial.truncations,
+        serial.num_agents,
+        0,
+        **kwargs
+    )
+    breakout.binding.vec_reset(c_envs, 0)
+    breakout.binding.vec_reset(s_envs, 0)
+    for _ in range(16):
+        actions = np.random.randint(0, 3, size=threaded.actions.shape)
+        threaded.actions[:] = actions
+        serial.actions[:] = actions
+        breakout.binding.vec_step(c_envs)
+        breakout.binding.vec_step(s_envs)
+
+    # Per-env rng: results do not depend on the thread count
+    assert np.array_equal(threaded.observations, serial.observations)
+    assert np.array_equal(threaded.rewards, serial.rewards)
+    breakout.binding.vec_close(c_envs)
+    breakout.binding.vec_close(s_envs)
+
+    # Async halves match a full synchronous step
+    asynced = breakout.Breakout(num_envs=8)
+    serial = breakout.Breakout(num_envs=8)
+    breakout.binding.vec_threads(asynced.c_envs, 2)
+    asynced.reset(seed=0)
+    serial.reset(seed=0)
+    for _ in range(16):
+        actions = np.random.randint(0, 3, size=serial.actions.shape)
+        asynced.actions[:] = actions
+        serial.actions[:] = actions
+        breakout.binding.vec_step_async(asynced.c_envs, 0, 4)
+        breakout.binding.vec_step_async(asynced.c_envs, 4, 8)
+        breakout.binding.vec_wait(asynced.c_envs)
+        breakout.binding.vec_step(serial.c_envs)
+
+    assert np.array_equal(asynced.observations, serial.observations)
+    asynced.close()
+    serial.close()
+
     try:
         c_env = breakout.binding.env_init()
         raise Exception('init missing args. Should have thrown TypeError')
@@ -100,6 +160,22 @@ def test_env_binding():
     except TypeError:
         pass
 
+    try:
+        c_envs = breakout.binding.vec_init(
+            reference.observations,
+            reference.actions,
+            reference.rewards,
+            reference.terminals,
+            reference.truncations,
+            reference.num_agents,
+            0,
+            num_threads=0,
+            **kwargs
+        )
+        raise Exception('vec_init bad num_threads. Should have thrown ValueError')
+    except ValueError:
+        pass
+
     try:
         breakout.binding.vec_reset()
         raise Exception('vec_reset missing arg. Should have thrown TypeError')
@@ -0,0 +1,75 @@
+import numpy as np
+
+from pufferlib.ocean.g2048 import g2048
+from pufferlib.ocean.g2048 import binding
+
+# Actions are 0-3 for up, down, left, right. Boards hold tile exponents
+
+def slide_left(row):
+    tiles = [t for t in row if t != 0]
+    out = []
+    i = 0
+    while i < len(tiles):
+        if i + 1 < len(tiles) and tiles[i] == tiles[i + 1] and tiles[i] < 15:
+            out.append(tiles[i] + 1)
+            i += 2
+        else:
+            out.append(tiles[i])
+            i += 1
+    return out + [0]*(len(row) - len(out))
+
+def is_legal(board, action):
+    if action == 0:
+        view = board.T
+    elif action == 1:
+        view = board.T[:, ::-1]
+    elif action == 2:
+        view = board
+    else:
+        view = board[:, ::-1]
+
+    return any(list(row) != slide_left(row) for row in view)
+
+def first_legal(board):
+    for action in range(4):
+        if is_legal(board, action):
+            return action
+    return 0
+
+def mean_episode_return(policy, num_envs=16, episodes=32, max_steps=20000):
+    env = g2048.G2048(num_envs=num_envs)
+    env.reset(seed=0)
+    returns = np.zeros(num_envs)
+    finished = []
+    for _ in range(max_steps):
+        actions = policy(env)
+        for i in range(num_envs):
+            assert is_legal(env.observations[i], actions[i])
+
+        env.step(actions)
+        returns += env.rewards
+        # The env resets itself on game over, which is the only -1 reward
+        for i in np.where(env.rewards == -1.0)[0]:
+            finished.append(returns[i])
+            returns[i] = 0
+        if len(finished) >= episodes:
+            break
+
+    env.close()
+    assert len(finished) >= episodes
+    return np.mean(finished)
+
+def first_legal_policy(env):
+    return np.array([first_legal(obs) for obs in env.observations])
+
+def test_expectimax_beats_first_legal():
+    baseline = mean_episode_return(first_legal_policy)
+    for depth in (1, 2):
+        def policy(env):
+            binding.expectimax_actions(env.c_envs, depth)
+            return env.actions.copy()
+
+        assert mean_episode_return(policy) > baseline
+
+if __name__ == '__main__':
+    test_expectimax_beats_first_legal()
@@ -0,0 +1,120 @@
+import numpy as np
+
+from pufferlib.ocean.go import go
+from pufferlib.ocean.go import binding
+
+# Brute force Go rules: flood fill groups, capture, suicide and positional
+# superko, replayed alongside the incremental C engine
+
+def neighbors(pos, n):
+    x, y = pos % n, pos // n
+    if x > 0: yield pos - 1
+    if x < n - 1: yield pos + 1
+    if y > 0: yield pos - n
+    if y < n - 1: yield pos + n
+
+def group(board, pos, n):
+    stones, liberties, stack = {pos}, set(), [pos]
+    while stack:
+        for npos in neighbors(stack.pop(), n):
+            if board[npos] == 0:
+                liberties.add(npos)
+            elif board[npos] == board[pos] and npos not in stones:
+                stones.add(npos)
+                stack.append(npos)
+    return stones, liberties
+
+def play(board, pos, player, history, n):
+    '''Returns the board after a legal move, or None'''
+    if board[pos] != 0:
+        return None
+
+    board = board.copy()
+    board[pos] = player
+    for npos in neighbors(pos, n):
+        if board[npos] == 3 - player:
+            stones, liberties = group(board, npos, n)
+            if not liberties:
+                board[list(stones)] = 0
+
+    if not group(board, pos, n)[1]:
+        return None
+    if board.tobytes() in history:
+        return None
+
+    return board
+
+def group_would_live(board, pos, n):
+    '''True if a move is only illegal because it repeats a position'''
+    return play(board, pos, 1, set(), n) is not None
+
+def read_board(env, n):
+    obs = env.observations[0]
+    return (obs[:n*n] + 2*obs[n*n:2*n*n]).astype(np.int32)
+
+def test_go_matches_brute_force(grid_size=7, steps=4000, seed=0):
+    n = grid_size
+    rng = np.random.RandomState(seed)
+    env = go.Go(num_envs=1, grid_size=grid_size)
+    env.reset(seed=seed)
+
+    board = read_board(env, n)
+    history = {board.tobytes()}
+    checked = {'legal': 0, 'illegal': 0, 'capture': 0, 'superko': 0}
+    for _ in range(steps):
+        # Mostly empty points, with some occupied points and passes
+        empty = np.flatnonzero(board == 0)
+        if rng.rand() < 0.05 or len(empty) == 0:
+            action = 0
+        elif rng.rand() < 0.1:
+            action = rng.randint(n*n) + 1
+        else:
+            action = rng.choice(empty) + 1
+
+        after_player = board
+        if action != 0:
+            after_player = play(board, action - 1, 1, history, n)
+            if after_player is None and board[action - 1] == 0:
+                checked['superko' if group_would_live(board, action - 1, n) else 'illegal'] += 1
+
+        # c_reset clears the terminal flag, but every step that doesn't end
+        # the game leaves a stone on the board
+        env.step(np.array([action]))
+        new_board = read_board(env, n)
+        if not new_board.any():
+            board = new_board
+            history = {board.tobytes()}
+            continue
+
+        if after_player is None:
+            # Rejected moves leave the board untouched and the opponent idle
+            assert np.array_equal(new_board, board)
+        else:
+            checked['legal'] += action != 0
+            if action != 0:
+                history.add(after_player.tobytes())
+
+            # The opponent placed exactly one stone, legally
+            placed = np.flatnonzero((after_player == 0) & (new_board == 2))
+            assert len(placed) == 1
+            expected = play(after_player, placed[0], 2, history, n)
+            assert expected is not None
+            assert np.array_equal(new_board, expected)
+            checked['capture'] += (after_player != 0).sum() + 1 > (new_board != 0).sum()
+            history.add(new_board.tobytes())
+
+        board = new_board
+        liberties, first = binding.group_liberties(env.c_envs)[0]
+        for pos in range(n*n):
+            if board[pos] == 0:
+                assert liberties[pos] == 0 and first[pos] == -1
+                continue
+            _, libs = group(board, pos, n)
+            assert liberties[pos] == len(libs)
+            assert first[pos] == min(libs)
+
+    env.close()
+    assert all(checked.values()), checked
+
+if __name__ == '__main__':
+    test_go_matches_brute_force()
@@ -0,0 +1,124 @@
+import numpy as np
+import gymnasium
+
+import pufferlib
+import pufferlib.vector
+from pufferlib.vector import INFO_BYTES
+
+INFO_INTERVAL = 5
+BIG_INFO_INTERVAL = 97
+
+class Counter(pufferlib.PufferEnv):
+    '''Observes [env id, steps since reset, last action]'''
+    def __init__(self, env_id=0, buf=None, seed=0):
+        self.single_observation_space = gymnasium.spaces.Box(
+            low=0, high=2**30, shape=(3,), dtype=np.int32)
+        self.single_action_space = gymnasium.spaces.Discrete(1000)
+        self.render_mode = None
+        self.num_agents = 1
+        super().__init__(buf)
+        self.env_id = env_id
+
+    def reset(self, seed=0):
+        self.tick = 0
+        self.observations[:] = [self.env_id, 0, 0]
+        self.rewards[:] = 0
+        return self.observations, []
+
+    def step(self, actions):
+        self.tick += 1
+        self.observations[:] = [self.env_id, self.tick, actions[0]]
+        self.rewards[:] = self.tick
+        self.terminals[:] = False
+        self.truncations[:] = False
+
+        info = []
+        if self.tick % INFO_INTERVAL == 0:
+            info.append({'env_id': self.env_id, 'tick': self.tick})
+        if self.tick % BIG_INFO_INTERVAL == 0:
+            # Too big for the shared info slot, so it goes over the pipe
+            info.append({'env_id': self.env_id, 'tick': -self.tick,
+                'pad': bytes(INFO_BYTES)})
+
+        return (self.observations, self.rewards,
+            self.terminals, self.truncations, info)
+
+    def close(self):
+        pass
+
+def expected_infos(env_id, tick):
+    infos = set()
+    if tick == 0:
+        return infos
+    if tick % INFO_INTERVAL == 0:
+        infos.add((env_id, tick))
+    if tick % BIG_INFO_INTERVAL == 0:
+        infos.add((env_id, -tick))
+    return infos
+
+def stress(num_envs, batch_size, cycles, resets, **kwargs):
+    # One env per worker so infos come back unaveraged
+    vecenv = pufferlib.vector.Multiprocessing([Counter]*num_envs,
+        [[] for _ in range(num_envs)], [dict(env_id=i) for i in range(num_envs)],
+        num_envs, num_workers=num_envs, batch_size=batch_size,
+        overwork=True, **kwargs)
+    try:
+        run(vecenv, num_envs, batch_size, cycles, resets)
+    finally:
+        vecenv.close()
+
+def run(vecenv, num_envs, batch_size, cycles, resets):
+    rng = np.random.RandomState(0)
+    reset_at = set(rng.choice(cycles, resets, replace=False))
+    ticks = np.zeros(num_envs, dtype=np.int64)
+    sent = np.zeros(num_envs, dtype=np.int64)
+    seen = np.zeros(num_envs, dtype=np.int64)
+
+    vecenv.async_reset(0)
+    for k in range(cycles):
+        if k in reset_at:
+            # Anything in flight is flushed and every env starts over
+            vecenv.async_reset(k)
+            ticks[:] = 0
+            sent[:] = 0
+
+        obs, rewards, _, _, infos, env_ids, _ = vecenv.recv()
+        assert len(env_ids) == batch_size
+        assert len(set(env_ids)) == batch_size
+
+        # Each env comes back exactly one step after its last action
+        assert np.array_equal(obs[:, 0], env_ids)
+        assert np.array_equal(obs[:, 1], ticks[env_ids])
+        assert np.array_equal(obs[:, 2], sent[env_ids])
+        assert np.array_equal(rewards, ticks[env_ids])
+
+        expected = set()
+        for i in env_ids:
+            expected |= expected_infos(i, ticks[i])
+
+        got = [(info['env_id'], info['tick']) for info in infos]
+        assert len(got) == len(set(got))
+        assert set(got) == expected
+
+        actions = rng.randint(0, 1000, batch_size)
+        vecenv.send(actions)
+        ticks[env_ids] += 1
+        sent[env_ids] = actions
+        seen[env_ids] += 1
+
+    assert seen.min() > 0
+
+def test_multiprocessing_stress_zero_copy():
+    stress(num_envs=8, batch_size=4, cycles=3000, resets=5)
+
+def test_multiprocessing_stress_full_async():
+    stress(num_envs=8, batch_size=4, cycles=3000, resets=5,
+        zero_copy=False, sync_traj=False)
+
+def test_multiprocessing_stress_one_worker_per_batch():
+    stress(num_envs=8, batch_size=1, cycles=3000, resets=5)
+
+if __name__ == '__main__':
+    test_multiprocessing_stress_zero_copy()
+    test_multiprocessing_stress_full_async()
+    test_multiprocessing_stress_one_worker_per_batch()
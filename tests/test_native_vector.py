@@ -0,0 +1,99 @@
+import numpy as np
+import pytest
+
+import pufferlib
+import pufferlib.vector
+from pufferlib.ocean.squared import squared
+
+# Ocean vec_reset seeds env i with i + seed*num_envs, so backends only agree
+# on per-env seeds when there is one env per shard and the seed is 0
+SEED = 0
+
+def rollout(vecenv, actions):
+    obs, _ = vecenv.reset(seed=SEED)
+    trajectory = [(obs.copy(), None, None)]
+    for atn in actions:
+        obs, rewards, terminals, _, _ = vecenv.step(atn)
+        trajectory.append((obs.copy(), rewards.copy(), terminals.copy()))
+
+    vecenv.close()
+    return trajectory
+
+def test_native_matches_serial_and_multiprocessing(num_envs=4, steps=256):
+    actions = np.random.RandomState(0).randint(0, 5, (steps, num_envs))
+    native = rollout(pufferlib.vector.make(squared.Squared, num_envs=num_envs,
+        num_workers=2, backend=pufferlib.vector.Native, seed=SEED), actions)
+    assert any(rew.any() for _, rew, _ in native[1:])
+    assert any(term.any() for _, _, term in native[1:])
+
+    for backend in [pufferlib.vector.Serial, pufferlib.vector.Multiprocessing]:
+        other = rollout(pufferlib.vector.make(squared.Squared, num_envs=num_envs,
+            num_workers=num_envs, overwork=True, backend=backend, seed=SEED), actions)
+        for (n_obs, n_rew, n_term), (o_obs, o_rew, o_term) in zip(native, other):
+            assert np.array_equal(n_obs, o_obs)
+            assert np.array_equal(n_rew, o_rew)
+            assert np.array_equal(n_term, o_term)
+
+def test_native_async_order(num_envs=8, batch_size=2, steps=64):
+    num_batches = num_envs // batch_size
+    actions = np.random.RandomState(1).randint(0, 5, (steps, num_envs))
+
+    # Each env sees the same action sequence as in a plain synchronous run
+    reference = squared.Squared(num_envs=num_envs)
+    obs, _ = reference.reset(seed=SEED)
+    expected = [(obs.copy(), np.zeros(num_envs, np.float32), np.zeros(num_envs, bool))]
+    for atn in actions:
+        obs, rewards, terminals, _, _ = reference.step(atn)
+        expected.append((obs.copy(), rewards.copy(), terminals.copy()))
+    reference.close()
+
+    vecenv = pufferlib.vector.make(squared.Squared, num_envs=num_envs,
+        num_workers=3, batch_size=batch_size, backend=pufferlib.vector.Native, seed=SEED)
+    vecenv.async_reset(SEED)
+    for k in range(steps):
+        for b in range(num_batches):
+            obs, rewards, terminals, _, _, env_ids, _ = vecenv.recv()
+
+            # Batches come back in the order they were sent, each exactly once
+            envs = np.arange(b*batch_size, (b + 1)*batch_size)
+            assert np.array_equal(env_ids, envs)
+
+            e_obs, e_rew, e_term = expected[k]
+            assert np.array_equal(obs, e_obs[envs])
+            if k > 0:
+                assert np.array_equal(rewards, e_rew[envs])
+                assert np.array_equal(terminals, e_term[envs])
+
+            vecenv.send(actions[k, envs])
+
+    vecenv.close()
+
+class ClippedSquared(squared.Squared):
+    def step(self, actions):
+        return super().step(np.clip(actions, 0, 3))
+
+def test_native_rejects_python_step():
+    with pytest.raises(pufferlib.APIUsageError):
+        pufferlib.vector.make(ClippedSquared, num_envs=2,
+            backend=pufferlib.vector.Native, seed=SEED)
+
+def test_native_skips_empty_logs(num_envs=2, steps=64):
+    vecenv = pufferlib.vector.make(squared.Squared, num_envs=num_envs,
+        backend=pufferlib.vector.Native, seed=SEED)
+    vecenv.log_interval = 1
+    vecenv.reset(seed=SEED)
+
+    # Squared logs nothing until an episode ends
+    logs = []
+    for k in range(steps):
+        _, _, _, _, infos = vecenv.step(np.zeros(num_envs, dtype=np.int32))
+        logs.extend(infos)
+
+    vecenv.close()
+    assert logs and all(logs)
+
+if __name__ == '__main__':
+    test_native_matches_serial_and_multiprocessing()
+    test_native_async_order()
+    test_native_rejects_python_step()
+    test_native_skips_empty_logs()
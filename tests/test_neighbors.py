@@ -0,0 +1,64 @@
+import numpy as np
+
+from pufferlib.ocean.battle import battle
+from pufferlib.ocean.boids import boids
+from pufferlib.ocean.drone_swarm import drone_swarm
+
+# The cell list neighbor search must match the naive all-pairs scan exactly
+
+def test_boids_neighbors(num_boids=64, steps=128):
+    kwargs = dict(num_boids=num_boids, avoid_factor=1.0,
+        centering_factor=0.01, matching_factor=0.1)
+    fast = boids.Boids(**kwargs)
+    naive = boids.Boids(naive_neighbors=True, **kwargs)
+    fast.reset(seed=0)
+    naive.reset(seed=0)
+    for _ in range(steps):
+        actions = np.random.randint(0, 5, size=(num_boids, 2))
+        fast.step(actions)
+        naive.step(actions)
+        assert np.array_equal(fast.rewards, naive.rewards)
+        assert np.array_equal(fast.observations, naive.observations)
+
+    fast.close()
+    naive.close()
+
+def test_drone_swarm_neighbors(num_drones=256, steps=256):
+    fast = drone_swarm.DroneSwarm(num_envs=1, num_drones=num_drones)
+    naive = drone_swarm.DroneSwarm(num_envs=1, num_drones=num_drones,
+        naive_neighbors=True)
+    fast.reset(seed=0)
+    naive.reset(seed=0)
+    for _ in range(steps):
+        actions = np.random.uniform(-1, 1, size=(num_drones, 4)).astype(np.float32)
+        fast.step(actions)
+        naive.step(actions)
+        assert np.array_equal(fast.rewards, naive.rewards)
+        assert np.array_equal(fast.observations, naive.observations)
+
+    fast.close()
+    naive.close()
+
+# Covers observations, scripted moves and attack targets. With 8 agents
+# there are too few enemies and observations are padded with allies
+def test_battle_neighbors(steps=256):
+    for num_agents in (512, 8):
+        kwargs = dict(num_envs=1, num_agents=num_agents, num_armies=2, size_x=2, size_z=2)
+        fast = battle.Battle(**kwargs)
+        naive = battle.Battle(naive_neighbors=True, **kwargs)
+        fast.reset(seed=0)
+        naive.reset(seed=0)
+        for _ in range(steps):
+            actions = np.random.uniform(-1, 1, size=(num_agents, 3)).astype(np.float32)
+            fast.step(actions)
+            naive.step(actions)
+            assert np.array_equal(fast.rewards, naive.rewards)
+            assert np.array_equal(fast.observations, naive.observations)
+
+        fast.close()
+        naive.close()
+
+if __name__ == '__main__':
+    test_boids_neighbors()
+    test_drone_swarm_neighbors()
+    test_battle_neighbors()
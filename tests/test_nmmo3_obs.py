@@ -0,0 +1,33 @@
+import numpy as np
+
+from pufferlib.ocean.nmmo3 import nmmo3
+from pufferlib.ocean.nmmo3 import binding
+
+# Observations are copied from packed per-tile records. They must match
+# windows rebuilt tile by tile from terrain, items and entities
+
+MAP_OBS = 11*15*10
+
+def check_map_obs(env):
+    expected = np.frombuffer(binding.map_obs_per_tile(env.c_envs)[0], dtype=np.uint8)
+    expected = expected.reshape(env.num_players, MAP_OBS)
+    assert np.array_equal(env.observations[:, :MAP_OBS], expected)
+
+def test_nmmo3_map_obs(steps=500, seed=0):
+    # Frequent teleports, deaths and respawns move entities and items around
+    env = nmmo3.NMMO3(num_envs=1, width=[128], height=[128], num_players=64,
+        num_enemies=128, num_resources=128, num_weapons=64, num_gems=32,
+        tiers=2, levels=7, teleportitis_prob=0.01, enemy_respawn_ticks=2,
+        item_respawn_ticks=10, num_terrains=4, seed=seed)
+    env.reset(seed=seed)
+    check_map_obs(env)
+
+    rng = np.random.RandomState(seed)
+    for _ in range(steps):
+        env.step(rng.randint(0, 26, env.num_players))
+        check_map_obs(env)
+
+    env.close()
+
+if __name__ == '__main__':
+    test_nmmo3_map_obs()
@@ -0,0 +1,98 @@
+import shutil
+
+import torch
+
+from pufferlib import _C
+
+# As in pufferl.py, the CUDA ops only exist if nvcc built them
+ADVANTAGE_CUDA = torch.cuda.is_available() and shutil.which('nvcc') is not None
+
+GAMMA = 0.99
+LAMBDA = 0.95
+RHO_CLIP = 1.0
+C_CLIP = 0.9
+
+# Rows are vectorized 8 at a time and timesteps are transposed in 8x8
+# tiles, so cover ragged blocks and ragged tiles on both axes
+NUM_STEPS = (1, 7, 8, 9, 16, 37)
+HORIZONS = (2, 7, 8, 9, 64, 67)
+
+def make_inputs(num_steps, horizon, seed):
+    gen = torch.Generator().manual_seed(seed)
+    values = 4*torch.rand(num_steps, horizon, generator=gen) - 2
+    rewards = 4*torch.rand(num_steps, horizon, generator=gen) - 2
+    importance = 2*torch.rand(num_steps, horizon, generator=gen)
+
+    # Fractional dones catch reordered products that 0/1 would hide
+    terminal = (torch.rand(num_steps, horizon, generator=gen) < 0.125).float()
+    fraction = torch.rand(num_steps, horizon, generator=gen)
+    dones = torch.where(torch.rand(num_steps, horizon, generator=gen) < 0.5, terminal, fraction)
+
+    # The last timestep must be left untouched, so don't start from zeros
+    advantages = 4*torch.rand(num_steps, horizon, generator=gen) - 2
+    return values, rewards, dones, importance, advantages
+
+def bits(tensor):
+    return tensor.contiguous().view(torch.int32)
+
+def test_advantage_vectorized_matches_scalar():
+    seed = 0
+    for num_steps in NUM_STEPS:
+        for horizon in HORIZONS:
+            values, rewards, dones, importance, advantages = make_inputs(num_steps, horizon, seed)
+            seed += 1
+
+            batched = advantages.clone()
+            torch.ops.pufferlib.compute_puff_advantage(values, rewards, dones,
+                importance, batched, GAMMA, LAMBDA, RHO_CLIP, C_CLIP)
+
+            # A single row always takes the scalar path
+            scalar = advantages.clone()
+            for r in range(num_steps):
+                row = scalar[r:r+1]
+                torch.ops.pufferlib.compute_puff_advantage(values[r:r+1],
+                    rewards[r:r+1], dones[r:r+1], importance[r:r+1], row,
+                    GAMMA, LAMBDA, RHO_CLIP, C_CLIP)
+
+            assert torch.equal(bits(batched), bits(scalar)), (num_steps, horizon)
+            assert torch.equal(batched[:, -1], advantages[:, -1])
+
+def test_advantage_prio_matches_unfused():
+    devices = ['cpu'] + (['cuda'] if ADVANTAGE_CUDA else [])
+    seed = 0
+    for device in devices:
+        for num_steps, horizon in [(1, 2), (7, 9), (37, 67), (4096, 64)]:
+            inputs = make_inputs(num_steps, horizon, seed)
+            values, rewards, dones, importance, advantages = [t.to(device) for t in inputs]
+            seed += 1
+
+            # Rows with nan and inf advantages get zero weight
+            if num_steps > 2:
+                values[1, 3] = float('nan')
+                rewards[2, 5] = float('inf')
+
+            for alpha in (0.0, 0.6, 1.0):
+                reference = advantages.clone()
+                torch.ops.pufferlib.compute_puff_advantage(values, rewards, dones,
+                    importance, reference, GAMMA, LAMBDA, RHO_CLIP, C_CLIP)
+                adv = reference.abs().sum(axis=1)
+                ref_weights = torch.nan_to_num(adv**alpha, 0, 0, 0)
+                ref_probs = (ref_weights + 1e-6)/(ref_weights.sum() + 1e-6)
+
+                fused = advantages.clone()
+                weights = torch.empty(num_steps, device=device)
+                probs = torch.empty(num_steps, device=device)
+                torch.ops.pufferlib.compute_puff_advantage_prio(values, rewards,
+                    dones, importance, fused, weights, probs, GAMMA, LAMBDA,
+                    RHO_CLIP, C_CLIP, alpha)
+
+                # Same advantages, but sums run in a different order
+                assert torch.equal(bits(fused), bits(reference)), (device, num_steps, horizon)
+                torch.testing.assert_close(weights, ref_weights, rtol=1e-5, atol=0)
+                torch.testing.assert_close(probs, ref_probs, rtol=1e-5, atol=0)
+                if num_steps > 2 and alpha > 0:
+                    assert weights[1] == 0 and weights[2] == 0
+
+if __name__ == '__main__':
+    test_advantage_vectorized_matches_scalar()
+    test_advantage_prio_matches_unfused()
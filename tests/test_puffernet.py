@@ -71,6 +71,11 @@ def test_puffernet_linear_layer(batch_size=16, input_size=128, hidden_size=128):
 
     assert_near(output_puffer, output_torch.numpy())
 
+def test_puffernet_linear_layer_ragged():
+    # Sizes that leave tails in every SIMD tile dimension
+    test_puffernet_linear_layer(batch_size=5, input_size=37, hidden_size=19)
+    test_puffernet_linear_layer(batch_size=1, input_size=3, hidden_size=1)
+
 def test_puffernet_convolution_layer(batch_size=16, in_width=11, in_height=11,
         in_channels=19, out_channels=32, kernel_size=5, stride=3):
     input_np = make_dummy_data(batch_size, in_channels, in_height, in_width)
@@ -119,7 +124,7 @@ def test_puffernet_convolution_3d_layer(batch_size=4096, in_width=9, in_height=5
     
     
 
-def test_puffernet_lstm(batch_size=16, input_size=128, hidden_size=128):
+def test_puffernet_lstm(batch_size=16, input_size=128, hidden_size=128, fused=False):
     input_np = make_dummy_data(batch_size, input_size, seed=42)
     state_h_np = make_dummy_data(batch_size, hidden_size, seed=43)
     state_c_np = make_dummy_data(batch_size, hidden_size, seed=44)
@@ -146,13 +151,53 @@ def test_puffernet_lstm(batch_size=16, input_size=128, hidden_size=128):
     state_c_torch = state_c_torch.detach()
 
     # PufferNet done second because it is in-place on the state vars
-    puffernet.puf_lstm(input_np, state_h_np, state_c_np, weights_input_np,
+    puf_lstm = puffernet.puf_lstm_fused if fused else puffernet.puf_lstm
+    puf_lstm(input_np, state_h_np, state_c_np, weights_input_np,
         weights_state_np, bias_input_np, bias_state_np, buffer_np,
         batch_size, input_size, hidden_size)
 
     assert_near(state_h_np, state_h_torch.numpy()[0])
     assert_near(state_c_np, state_c_torch.numpy()[0])
 
+def test_puffernet_lstm_fused():
+    test_puffernet_lstm(fused=True)
+    test_puffernet_lstm(batch_size=3, input_size=37, hidden_size=19, fused=True)
+
+def test_puffernet_lstm_sequence(seq_len=8, batch_size=16, input_size=128, hidden_size=128):
+    input_np = make_dummy_data(seq_len, batch_size, input_size, seed=42)
+    state_h_np = make_dummy_data(batch_size, hidden_size, seed=43)
+    state_c_np = make_dummy_data(batch_size, hidden_size, seed=44)
+    weights_input_np = make_dummy_data(4*hidden_size, input_size, seed=45)
+    weights_state_np = make_dummy_data(4*hidden_size, hidden_size, seed=46)
+    bias_input_np = make_dummy_data(4*hidden_size, seed=47)
+    bias_state_np = make_dummy_data(4*hidden_size, seed=48)
+    output_np = np.zeros((seq_len, batch_size, hidden_size), dtype=np.float32)
+
+    input_torch = torch.from_numpy(input_np)
+    state_h_torch = torch.from_numpy(state_h_np).view(1, batch_size, hidden_size)
+    state_c_torch = torch.from_numpy(state_c_np).view(1, batch_size, hidden_size)
+    torch_lstm = torch.nn.LSTM(input_size, hidden_size, num_layers=1)
+    torch_lstm.weight_ih_l0.data = torch.from_numpy(weights_input_np)
+    torch_lstm.weight_hh_l0.data = torch.from_numpy(weights_state_np)
+    torch_lstm.bias_ih_l0.data = torch.from_numpy(bias_input_np)
+    torch_lstm.bias_hh_l0.data = torch.from_numpy(bias_state_np)
+    output_torch, (state_h_torch, state_c_torch) = torch_lstm(input_torch, (state_h_torch, state_c_torch))
+    output_torch = output_torch.detach()
+    state_h_torch = state_h_torch.detach()
+    state_c_torch = state_c_torch.detach()
+
+    # PufferNet done second because it is in-place on the state vars
+    puffernet.puf_lstm_sequence(input_np, state_h_np, state_c_np, weights_input_np,
+        weights_state_np, bias_input_np, bias_state_np, output_np,
+        batch_size, input_size, hidden_size, seq_len)
+
+    assert_near(output_np, output_torch.numpy())
+    assert_near(state_h_np, state_h_torch.numpy()[0])
+    assert_near(state_c_np, state_c_torch.numpy()[0])
+
+def test_puffernet_lstm_sequence_odd_sizes():
+    test_puffernet_lstm_sequence(seq_len=5, batch_size=3, input_size=37, hidden_size=19)
+
 def test_puffernet_embedding(batch_size=16, num_embeddings=128, embedding_dim=32):
     input_np = make_dummy_int_data(num_embeddings, batch_size, seed=42)
     weights_np = make_dummy_data(num_embeddings, embedding_dim, seed=43)
@@ -252,9 +297,13 @@ if __name__ == '__main__':
     test_puffernet_relu()
     test_puffernet_sigmoid()
     test_puffernet_linear_layer()
+    test_puffernet_linear_layer_ragged()
     test_puffernet_convolution_layer()
     test_puffernet_convolution_3d_layer()
     test_puffernet_lstm()
+    test_puffernet_lstm_fused()
+    test_puffernet_lstm_sequence()
+    test_puffernet_lstm_sequence_odd_sizes()
     test_puffernet_embedding()
     test_puffernet_layernorm()
     test_puffernet_one_hot()
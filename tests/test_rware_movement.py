@@ -0,0 +1,83 @@
+import numpy as np
+
+from pufferlib.ocean.rware import rware
+from pufferlib.ocean.rware import binding
+
+NOOP, FORWARD = 0, 1
+RIGHT, DOWN, LEFT, UP = 0, 1, 2, 3
+COLS = 10 # tiny map
+
+def cell(x, y):
+    return x + y*COLS
+
+def check_cells(env, num_agents):
+    '''Every agent is filed under its own cell and no two agents share one'''
+    locations, cell_agents = binding.agent_cells(env.c_envs)[0]
+    assert len(set(locations)) == num_agents
+    for agent, location in enumerate(locations):
+        assert cell_agents[location] == agent
+    assert sum(a != -1 for a in cell_agents) == num_agents
+    return np.array(locations)
+
+def test_rware_random_moves(num_agents=30, steps=2000, seed=0):
+    rng = np.random.RandomState(seed)
+    env = rware.Rware(num_agents=num_agents, map_choice=1)
+    env.reset(seed=seed)
+    before = check_cells(env, num_agents)
+    for _ in range(steps):
+        # Mostly forward so that queues and cycles form
+        actions = np.where(rng.rand(num_agents) < 0.6, FORWARD,
+            rng.randint(0, 5, num_agents))
+        env.step(actions)
+        after = check_cells(env, num_agents)
+
+        # Only forward moves, one cell at a time, and never a swap
+        moved = before != after
+        assert np.all(actions[moved] == FORWARD)
+        dist = np.abs(before % COLS - after % COLS) + np.abs(before // COLS - after // COLS)
+        assert np.all(dist[moved] == 1)
+        for i in np.flatnonzero(moved):
+            j = np.flatnonzero(before == after[i])
+            assert len(j) == 0 or after[j[0]] != before[i]
+        before = after
+
+    env.close()
+
+# Moves on the grid alternate parity, so cycles have even length and the
+# smallest are swaps and 2x2 rotations
+LAYOUT = [
+    # Swap, not allowed, with a queue behind it
+    (cell(1, 0), RIGHT, cell(1, 0)),
+    (cell(2, 0), LEFT, cell(2, 0)),
+    (cell(0, 0), RIGHT, cell(0, 0)),
+    # Rotation, with a queue into a cell the cycle refills
+    (cell(4, 3), RIGHT, cell(5, 3)),
+    (cell(5, 3), DOWN, cell(5, 4)),
+    (cell(5, 4), LEFT, cell(4, 4)),
+    (cell(4, 4), UP, cell(4, 3)),
+    (cell(4, 2), DOWN, cell(4, 2)),
+    (cell(4, 1), DOWN, cell(4, 1)),
+    # Queue into an empty cell moves as a whole
+    (cell(1, 9), RIGHT, cell(2, 9)),
+    (cell(2, 9), RIGHT, cell(3, 9)),
+    (cell(3, 9), RIGHT, cell(4, 9)),
+    # Two agents want one cell and the longer queue wins
+    (cell(9, 9), LEFT, cell(9, 9)),
+    (cell(7, 9), RIGHT, cell(8, 9)),
+    (cell(6, 9), RIGHT, cell(7, 9)),
+]
+
+def test_rware_cycles_and_queues():
+    num_agents = len(LAYOUT)
+    env = rware.Rware(num_agents=num_agents, map_choice=1)
+    env.reset(seed=0)
+    start, directions, expected = zip(*LAYOUT)
+    binding.place_agents(env.c_envs, start, directions)
+    env.step(np.full(num_agents, FORWARD))
+    after = check_cells(env, num_agents)
+    assert list(after) == list(expected)
+    env.close()
+
+if __name__ == '__main__':
+    test_rware_random_moves()
+    test_rware_cycles_and_queues()